@@ -0,0 +1,55 @@
+#include <benchmark/benchmark.h>
+
+#include "utils/types.h"
+
+#include <cstring>
+#include <deque>
+#include <mutex>
+
+namespace
+{
+/**
+ * A batch of rows on its way from the scanning thread to javascript (like the row batches of scanToStream)
+ */
+struct RowBatch
+{
+  unsigned int y;
+  RawImagePtr rows;
+};
+
+/**
+ * The native side of streaming rows to javascript: every batch is copied into an image of its own
+ * & queued for the event loop, as the receiver's rows are only valid during the call.
+ * Arguments: rows per batch (A4 width at 300 dpi, RGB)
+ */
+void copyRowBatches(benchmark::State &state)
+{
+  const unsigned int width = 2480;
+  const unsigned int height = 3508;
+  const unsigned int batchRows = static_cast<unsigned int>(state.range(0));
+  const RawImage page(width, height);
+  std::memset(page.pixels, 0x7F, page.bytesPerRow * height);
+
+  std::mutex batchesMutex;
+  std::deque<RowBatch> batches;
+  for (auto _ : state)
+  {
+    for (unsigned int y = 0; y < height; y += batchRows)
+    {
+      unsigned int count = std::min(batchRows, height - y);
+      RowBatch batch;
+      batch.y = y;
+      batch.rows = RawImagePtr(new RawImage(width, count));
+      std::memcpy(batch.rows->pixels, page.pixels + y * page.bytesPerRow, count * page.bytesPerRow);
+      std::lock_guard<std::mutex> lock(batchesMutex);
+      batches.push_back(batch);
+    }
+    // the event loop takes them all at once
+    std::lock_guard<std::mutex> lock(batchesMutex);
+    batches.clear();
+  }
+  state.SetBytesProcessed(state.iterations() * page.bytesPerRow * height);
+}
+}
+
+BENCHMARK(copyRowBatches)->ArgName("rows")->Arg(1)->Arg(16)->Arg(128)->Arg(1024)->Unit(benchmark::kMillisecond);
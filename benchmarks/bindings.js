@@ -0,0 +1,51 @@
+// Measures the cost of the javascript bindings (marshalling of options, images & row batches) and prints JSON.
+// Usage: node benchmarks/bindings.js [iterations] > bindings.json
+const scanahedron = require("../build/Release/libscanahedron.node")
+
+const iterations = parseInt(process.argv[2] || "10", 10);
+
+const scanners = scanahedron.getScanners();
+const scanner = scanners.find((descriptor) => descriptor.startsWith("test:")) || scanners[0];
+if (!scanner) {
+    console.error("No scanner available");
+    process.exit(1);
+}
+
+async function measure(name, run) {
+    const times = [];
+    for (let i = 0; i < iterations; ++i) {
+        const start = process.hrtime.bigint();
+        await run();
+        times.push(Number(process.hrtime.bigint() - start) / 1e6);
+    }
+    times.sort((a, b) => a - b);
+    return {
+        name: name,
+        iterations: iterations,
+        mean_ms: times.reduce((sum, time) => sum + time, 0) / times.length,
+        median_ms: times[Math.floor(times.length / 2)],
+        min_ms: times[0],
+        max_ms: times[times.length - 1]
+    };
+}
+
+async function main() {
+    const benchmarks = [];
+    benchmarks.push(await measure("getCapabilities", () => scanahedron.getCapabilities(scanner)));
+    benchmarks.push(await measure("getConfiguration", () => scanahedron.getConfiguration(scanner)));
+    benchmarks.push(await measure("scanToBuffer", () => scanahedron.scanToBuffer(scanner)));
+    benchmarks.push(await measure("scanToBufferAsync", () => scanahedron.scanToBufferAsync(scanner)));
+    benchmarks.push(await measure("scanToBufferAsync/polling", () => scanahedron.scanToBufferAsync(scanner, { polling: true })));
+    let batches = 0;
+    benchmarks.push(await measure("scanToStream", () => scanahedron.scanToStream(scanner, () => ++batches)));
+
+    console.log(JSON.stringify({
+        context: { date: new Date().toISOString(), node: process.version, scanner: scanner, streamedBatches: batches },
+        benchmarks: benchmarks
+    }, null, 2));
+}
+
+main().catch((error) => {
+    console.error(error);
+    process.exit(1);
+});
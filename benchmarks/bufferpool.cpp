@@ -0,0 +1,31 @@
+#include <benchmark/benchmark.h>
+
+#include "utils/bufferpool.h"
+
+namespace
+{
+const size_t A4_RGB_600_DPI = 5100 * 7020 * 3;
+const size_t PAGE_SIZE = 4096;
+
+/**
+ * Acquire a page sized pixel buffer, fill every page of it (like the unpacker does) & release it again.
+ * Arguments: capacity in MB (0 maps fresh memory for every scan), huge pages
+ */
+void acquireAndFill(benchmark::State &state)
+{
+  BufferPool pool(static_cast<size_t>(state.range(0)) * 1024 * 1024, state.range(1) != 0);
+  for (auto _ : state)
+  {
+    unsigned char *pixels = pool.acquire(A4_RGB_600_DPI);
+    for (size_t offset = 0; offset < A4_RGB_600_DPI; offset += PAGE_SIZE)
+    {
+      pixels[offset] = 1;
+    }
+    benchmark::DoNotOptimize(pixels);
+    pool.release(pixels, A4_RGB_600_DPI);
+  }
+  state.SetBytesProcessed(state.iterations() * A4_RGB_600_DPI);
+}
+}
+
+BENCHMARK(acquireAndFill)->ArgNames({"capacityMB", "hugePages"})->Args({0, 0})->Args({0, 1})->Args({512, 0})->Args({512, 1})->Unit(benchmark::kMillisecond);
@@ -0,0 +1,58 @@
+#include <benchmark/benchmark.h>
+
+#include "processing/itemdetector.h"
+
+#include <cstring>
+
+namespace
+{
+const unsigned int WIDTH = 5100; // A4 at 600 dpi
+const unsigned int HEIGHT = 7014;
+
+/**
+ * A flatbed with three items (e.g. receipts & a photo) on a white lid
+ */
+RawImagePtr createFlatbed(unsigned int bytesPerPixel)
+{
+  RawImagePtr image(new RawImage(WIDTH, HEIGHT, bytesPerPixel == 1 ? PixelFormat::Gray8 : PixelFormat::Rgb8));
+  const size_t bytesPerRow = static_cast<size_t>(WIDTH) * bytesPerPixel;
+  std::memset(image->pixels, 245, bytesPerRow * HEIGHT);
+  struct
+  {
+    unsigned int x, y, width, height;
+    unsigned char value;
+  } items[] = {{300, 400, 1800, 4200, 200}, {2600, 500, 2100, 2800, 90}, {2600, 4000, 2000, 2600, 30}};
+  for (const auto &item : items)
+  {
+    for (unsigned int y = item.y; y < item.y + item.height; ++y)
+    {
+      std::memset(image->pixels + y * bytesPerRow + item.x * bytesPerPixel, item.value, static_cast<size_t>(item.width) * bytesPerPixel);
+    }
+  }
+  return image;
+}
+
+/**
+ * Detect the items of a full flatbed scan, reports the throughput of the image.
+ * Arguments: bytes per pixel, mask size
+ */
+void detectItems(benchmark::State &state)
+{
+  RawImagePtr image = createFlatbed(static_cast<unsigned int>(state.range(0)));
+  ItemDetectorOptions options;
+  options.maskSize = static_cast<unsigned int>(state.range(1));
+  ItemDetector detector(options);
+
+  size_t found = 0;
+  for (auto _ : state)
+  {
+    auto items = detector.detect(*image);
+    found = items.size();
+    benchmark::DoNotOptimize(items.data());
+  }
+  state.counters["items"] = static_cast<double>(found);
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(WIDTH) * HEIGHT * getBytesPerPixel(image->format));
+}
+}
+
+BENCHMARK(detectItems)->ArgNames({"bpp", "mask"})->Args({1, 512})->Args({3, 512})->Args({3, 1024})->Unit(benchmark::kMillisecond);
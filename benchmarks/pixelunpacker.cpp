@@ -0,0 +1,114 @@
+#include <benchmark/benchmark.h>
+
+#include "scanner/pixelunpacker.h"
+
+#include <vector>
+
+namespace
+{
+const unsigned int WIDTH = 5100; // A4 width at 600 dpi
+const unsigned int HEIGHT = 256;
+
+/**
+ * Receiver that only touches the delivered rows
+ */
+class NullReceiver : public IScanReceiver
+{
+public:
+  virtual void begin(const ImageHeader &header) {}
+  virtual void rows(const unsigned char *pixels, unsigned int y, unsigned int count) { benchmark::DoNotOptimize(pixels); }
+  virtual void end() {}
+};
+
+FrameParameters createFrame(FrameParameters::Format format, unsigned int depth)
+{
+  FrameParameters frame;
+  frame.format = format;
+  frame.depth = depth;
+  frame.pixelsPerLine = WIDTH;
+  frame.lines = HEIGHT;
+  frame.bytesPerLine = (WIDTH * (format == FrameParameters::Rgb ? 3 : 1) * depth + 7) / 8;
+  frame.lastFrame = format != FrameParameters::Red && format != FrameParameters::Green;
+  return frame;
+}
+
+/**
+ * Unpack a frame fed in chunks that split rows, reports the throughput of the raw input.
+ * Arguments: format, depth, kernel level
+ */
+void unpackFrame(benchmark::State &state)
+{
+  auto format = static_cast<FrameParameters::Format>(state.range(0));
+  auto depth = static_cast<unsigned int>(state.range(1));
+  const PixelKernels *kernels = getPixelKernels(static_cast<KernelLevel>(state.range(2)));
+  if (!kernels)
+  {
+    state.SkipWithError("Kernel level not supported by this CPU");
+    return;
+  }
+
+  FrameParameters frame = createFrame(format, depth);
+  std::vector<unsigned char> data(static_cast<size_t>(frame.bytesPerLine) * frame.lines, 0x5A);
+  const size_t chunkSize = 32 * 1024 + 7;
+
+  for (auto _ : state)
+  {
+    NullReceiver receiver;
+    PixelUnpacker unpacker(receiver, *kernels);
+    unpacker.beginFrame(frame);
+    for (size_t offset = 0; offset < data.size(); offset += chunkSize)
+    {
+      unpacker.feed(data.data() + offset, std::min(chunkSize, data.size() - offset));
+    }
+    unpacker.endFrame();
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+  state.SetLabel(kernels->name);
+}
+
+void allFormats(benchmark::internal::Benchmark *benchmark)
+{
+  benchmark->ArgNames({"format", "depth", "kernels"});
+  for (int level : {static_cast<int>(KernelLevel::Scalar), static_cast<int>(KernelLevel::Sse2), static_cast<int>(KernelLevel::Avx2)})
+  {
+    for (int format : {FrameParameters::Gray, FrameParameters::Rgb, FrameParameters::Red})
+    {
+      for (int depth : {1, 8, 16})
+      {
+        benchmark->Args({format, depth, level});
+      }
+    }
+  }
+}
+}
+
+BENCHMARK(unpackFrame)->Apply(allFormats);
+
+namespace
+{
+/**
+ * Collect the blank page statistics of unpacked rows, reports the throughput of the samples.
+ * Arguments: kernel level
+ */
+void accumulateStatistics(benchmark::State &state)
+{
+  const PixelKernels *kernels = getPixelKernels(static_cast<KernelLevel>(state.range(0)));
+  if (!kernels)
+  {
+    state.SkipWithError("Kernel level not supported by this CPU");
+    return;
+  }
+
+  std::vector<unsigned char> samples(static_cast<size_t>(WIDTH) * 3 * HEIGHT, 0xF0);
+  for (auto _ : state)
+  {
+    PageStatistics statistics;
+    kernels->accumulateStatistics(samples.data(), samples.size(), 128, statistics);
+    benchmark::DoNotOptimize(statistics);
+  }
+  state.SetBytesProcessed(state.iterations() * samples.size());
+  state.SetLabel(kernels->name);
+}
+}
+
+BENCHMARK(accumulateStatistics)->ArgName("kernels")->Arg(static_cast<int>(KernelLevel::Scalar))->Arg(static_cast<int>(KernelLevel::Sse2))->Arg(static_cast<int>(KernelLevel::Avx2));
@@ -0,0 +1,119 @@
+#include <benchmark/benchmark.h>
+
+#include "encoder/parallelpngencoder.h"
+#include "encoder/pngencoder.h"
+
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+const std::string OUTPUT_FILE = "benchmark_output.png";
+
+/**
+ * Synthetic page: mostly white paper with some structure, similar to a scanned document
+ */
+std::vector<unsigned char> createPage(const ImageHeader &header)
+{
+  std::vector<unsigned char> pixels(header.getBytesPerRow() * header.height);
+  for (size_t i = 0; i < pixels.size(); ++i)
+  {
+    pixels[i] = (i / 7919) % 5 == 0 ? static_cast<unsigned char>(i * 31) : 250 - (i % 3);
+  }
+  return pixels;
+}
+
+void encodePage(IScanReceiver &encoder, const ImageHeader &header, const std::vector<unsigned char> &pixels)
+{
+  const unsigned int batchRows = 32;
+  const size_t bytesPerRow = header.getBytesPerRow();
+  encoder.begin(header);
+  for (unsigned int y = 0; y < header.height; y += batchRows)
+  {
+    encoder.rows(pixels.data() + y * bytesPerRow, y, std::min(batchRows, header.height - y));
+  }
+  encoder.end();
+}
+
+/**
+ * Encode an A4 page at 300 dpi (RGB) with the given thread count & compression level.
+ * Thread count 1 is the libpng based encoder.
+ */
+void encodePng(benchmark::State &state)
+{
+  ImageHeader header;
+  header.width = 2480;
+  header.height = 3508;
+  header.format = PixelFormat::Rgb8;
+  static const std::vector<unsigned char> pixels = createPage(header);
+
+  EncoderOptions options;
+  options.threads = static_cast<unsigned int>(state.range(0));
+  options.compressionLevel = static_cast<int>(state.range(1));
+  for (auto _ : state)
+  {
+    if (options.threads > 1)
+    {
+      ParallelPngEncoder encoder(OUTPUT_FILE, options);
+      encodePage(encoder, header, pixels);
+    }
+    else
+    {
+      PngEncoder encoder(OUTPUT_FILE, options);
+      encodePage(encoder, header, pixels);
+    }
+  }
+  std::remove(OUTPUT_FILE.c_str());
+  state.SetBytesProcessed(state.iterations() * pixels.size());
+}
+
+/**
+ * Encode an RGB page of the given size with the given compression level (libpng based encoder).
+ * Arguments: width & height in pixels, level
+ */
+void encodePngSize(benchmark::State &state)
+{
+  ImageHeader header;
+  header.width = static_cast<unsigned int>(state.range(0));
+  header.height = static_cast<unsigned int>(state.range(1));
+  header.format = PixelFormat::Rgb8;
+  const std::vector<unsigned char> pixels = createPage(header);
+
+  EncoderOptions options;
+  options.compressionLevel = static_cast<int>(state.range(2));
+  for (auto _ : state)
+  {
+    PngEncoder encoder(OUTPUT_FILE, options);
+    encodePage(encoder, header, pixels);
+  }
+  std::remove(OUTPUT_FILE.c_str());
+  state.SetBytesProcessed(state.iterations() * pixels.size());
+}
+
+/**
+ * Encode the same A4 page at 300 dpi in each pixel format (libpng based encoder, default level),
+ * reports the pages per second to compare the native gray formats with RGB.
+ */
+void encodePngFormat(benchmark::State &state)
+{
+  ImageHeader header;
+  header.width = 2480;
+  header.height = 3508;
+  header.format = static_cast<PixelFormat>(state.range(0));
+  const std::vector<unsigned char> pixels = createPage(header);
+
+  for (auto _ : state)
+  {
+    PngEncoder encoder(OUTPUT_FILE);
+    encodePage(encoder, header, pixels);
+  }
+  std::remove(OUTPUT_FILE.c_str());
+  state.SetItemsProcessed(state.iterations());
+  state.SetLabel(getFormatName(header.format));
+}
+}
+
+BENCHMARK(encodePng)->ArgNames({"threads", "level"})->ArgsProduct({{1, 2, 4, 8}, {1, 6}})->Unit(benchmark::kMillisecond)->UseRealTime();
+// A6 at 150 dpi, A4 at 150, 300 & 600 dpi
+BENCHMARK(encodePngSize)->ArgNames({"width", "height", "level"})->ArgsProduct({{620}, {874}, {1, 6, 9}})->ArgsProduct({{1240}, {1754}, {1, 6, 9}})->ArgsProduct({{2480}, {3508}, {1, 6, 9}})->ArgsProduct({{4960}, {7016}, {1, 6, 9}})->Unit(benchmark::kMillisecond);
+BENCHMARK(encodePngFormat)->ArgName("format")->DenseRange(static_cast<int>(PixelFormat::Gray1), static_cast<int>(PixelFormat::Rgb16))->Unit(benchmark::kMillisecond);
@@ -0,0 +1,113 @@
+#include <benchmark/benchmark.h>
+
+#include "scanner/sanescannerinterface.h"
+#include "scanner/scanservice.h"
+#include "scanner/rawimagereceiver.h"
+#include "syntheticscanner.h"
+
+#include <cstdio>
+
+namespace
+{
+const unsigned int A4_WIDTH_300_DPI = 2480;
+const unsigned int A4_HEIGHT_300_DPI = 3508;
+
+const char *const FILE_FORMATS[] = {"png", "pnm", "tiff", "jpeg"};
+
+/**
+ * Scan a synthetic A4 page at 300 dpi to a file through the whole service (scheduling, unpacking & encoding).
+ * Arguments: frame format (gray / RGB), file format (png, pnm, tiff, jpeg)
+ */
+void scanToFileSynthetic(benchmark::State &state)
+{
+  auto format = static_cast<FrameParameters::Format>(state.range(0));
+  const std::string fileFormat = FILE_FORMATS[state.range(1)];
+  const std::string path = "benchmark_scan." + fileFormat;
+  auto interface = std::make_shared<SyntheticScannerInterface>(SyntheticScannerInterface::createFrame(format, A4_WIDTH_300_DPI, A4_HEIGHT_300_DPI));
+  ScanService service(interface);
+
+  for (auto _ : state)
+  {
+    if (!service.scanToFile(nullptr, path))
+    {
+      state.SkipWithError("The file was not stored");
+      break;
+    }
+  }
+  std::remove(path.c_str());
+  state.SetBytesProcessed(state.iterations() * interface->getPageSize());
+  state.SetLabel(fileFormat);
+}
+
+/**
+ * Scan a synthetic A4 page at 300 dpi to a buffer, step by step through a scan session or in one call.
+ * Arguments: session (0 / 1)
+ */
+void scanToBufferSynthetic(benchmark::State &state)
+{
+  auto interface = std::make_shared<SyntheticScannerInterface>(
+      SyntheticScannerInterface::createFrame(FrameParameters::Rgb, A4_WIDTH_300_DPI, A4_HEIGHT_300_DPI));
+  ScanService service(interface);
+
+  for (auto _ : state)
+  {
+    if (state.range(0))
+    {
+      RawImageReceiver receiver;
+      IScanSessionPtr session = service.startScan(nullptr, receiver);
+      while (!session->read())
+      {
+      }
+      benchmark::DoNotOptimize(receiver.getImage()->pixels);
+    }
+    else
+    {
+      benchmark::DoNotOptimize(service.scanToBuffer(nullptr)->pixels);
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * interface->getPageSize());
+}
+
+/**
+ * Scan to a PNG file with the SANE "test" backend (if it is installed), including the backend's reads.
+ * The backend's default page & mode are used.
+ */
+void scanToFileSaneTest(benchmark::State &state)
+{
+  const std::string path = "benchmark_sane.png";
+  ScanService service(std::make_shared<SaneScannerInterface>());
+  ScannerDeviceDescriptorPtr testDevice;
+  for (const auto &device : service.getAvailableScanners())
+  {
+    if (device->descriptor.compare(0, 5, "test:") == 0)
+    {
+      testDevice = device;
+      break;
+    }
+  }
+  if (!testDevice)
+  {
+    state.SkipWithError("The SANE test backend is not available");
+    return;
+  }
+
+  for (auto _ : state)
+  {
+    try
+    {
+      service.scanToFile(testDevice, path);
+    }
+    catch (const std::exception &e)
+    {
+      state.SkipWithError(e.what());
+      break;
+    }
+  }
+  std::remove(path.c_str());
+  state.SetItemsProcessed(state.iterations());
+}
+}
+
+BENCHMARK(scanToFileSynthetic)->ArgNames({"frame", "file"})->ArgsProduct({{FrameParameters::Gray, FrameParameters::Rgb}, {0, 1, 2, 3}})->Unit(benchmark::kMillisecond);
+BENCHMARK(scanToBufferSynthetic)->ArgName("session")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(scanToFileSaneTest)->Unit(benchmark::kMillisecond);
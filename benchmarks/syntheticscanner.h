@@ -0,0 +1,149 @@
+#pragma once
+
+#include "scanner/iscannerinterface.h"
+#include "scanner/pixelunpacker.h"
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * Scanner interface that delivers a generated document page without any hardware,
+ * fed through the pixel unpacker in chunks like sane_read, to measure everything above the backend.
+ */
+class SyntheticScannerInterface : public IScannerInterface
+{
+public:
+  /**
+   * Raw bytes per read, split rows like a backend does.
+   * Only used by value (std::min takes references), so that it needs no definition outside the class before C++17.
+   */
+  static constexpr size_t CHUNK_SIZE = 64 * 1024 + 7;
+
+  explicit SyntheticScannerInterface(const FrameParameters &frame_) : frame(frame_), data(frame_.bytesPerLine * frame_.lines)
+  {
+    // mostly white paper with some structure, similar to a scanned document
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+      data[i] = (i / 7919) % 5 == 0 ? static_cast<unsigned char>(i * 31) : 250 - (i % 3);
+    }
+    devices.push_back(ScannerDeviceDescriptorPtr(new ScannerDeviceDescriptor()));
+    devices[0]->descriptor = "synthetic";
+  }
+
+  /**
+   * A single frame page of the given format (8 bit) & size
+   */
+  static FrameParameters createFrame(FrameParameters::Format format, unsigned int width, unsigned int height)
+  {
+    FrameParameters frame;
+    frame.format = format;
+    frame.depth = 8;
+    frame.pixelsPerLine = width;
+    frame.lines = height;
+    frame.bytesPerLine = width * (format == FrameParameters::Rgb ? 3 : 1);
+    return frame;
+  }
+
+  size_t getPageSize() const
+  {
+    return data.size();
+  }
+
+  virtual bool init() { return true; }
+  virtual bool exit() { return true; }
+  virtual std::vector<ScannerDeviceDescriptorPtr> getDevices() { return devices; }
+  virtual ScannerCapabilities getCapabilities(ScannerDeviceDescriptorPtr device) { return ScannerCapabilities(); }
+  virtual ScannerConfiguration getConfiguration(ScannerDeviceDescriptorPtr device) { return ScannerConfiguration(); }
+  virtual void setConfiguration(ScannerDeviceDescriptorPtr device, const ScannerConfiguration &configuration) {}
+  virtual ScannerStatistics getStatistics() { return ScannerStatistics(); }
+  virtual void cancel(ScannerDeviceDescriptorPtr device) {}
+
+  virtual RawImagePtr scanToBuffer(ScannerDeviceDescriptorPtr device)
+  {
+    RawImagePtr image(new RawImage(frame.pixelsPerLine, frame.lines, PixelUnpacker::getImageHeader(frame).format));
+    ImageCollector collector(*image);
+    scan(device, collector);
+    return image;
+  }
+
+  virtual void scan(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver)
+  {
+    PixelUnpacker unpacker(receiver);
+    unpacker.beginFrame(frame);
+    for (size_t offset = 0; offset < data.size(); offset += CHUNK_SIZE)
+    {
+      unpacker.feed(data.data() + offset, std::min(size_t(CHUNK_SIZE), data.size() - offset));
+    }
+    unpacker.endFrame();
+  }
+
+  virtual IScanSessionPtr startScan(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver)
+  {
+    return IScanSessionPtr(new Session(*this, receiver));
+  }
+
+  virtual unsigned int scanBatch(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver)
+  {
+    scan(device, receiver);
+    return 1;
+  }
+
+private:
+  /**
+   * Copies the rows into a preallocated image
+   */
+  class ImageCollector : public IScanReceiver
+  {
+  public:
+    explicit ImageCollector(RawImage &image_) : image(image_) {}
+    virtual void begin(const ImageHeader &header) {}
+    virtual void rows(const unsigned char *pixels, unsigned int y, unsigned int count)
+    {
+      std::copy(pixels, pixels + count * image.bytesPerRow, image.pixels + y * image.bytesPerRow);
+    }
+    virtual void end() {}
+
+  private:
+    RawImage &image;
+  };
+
+  /**
+   * Feeds one chunk per read, the descriptor is never readable (read it like a blocking backend)
+   */
+  class Session : public IScanSession
+  {
+  public:
+    Session(SyntheticScannerInterface &scanner_, IScanReceiver &receiver) : scanner(scanner_), unpacker(receiver)
+    {
+      unpacker.beginFrame(scanner.frame);
+    }
+    virtual int getSelectFd() { return -1; }
+    virtual bool read()
+    {
+      if (complete)
+      {
+        return true;
+      }
+      size_t length = std::min(size_t(CHUNK_SIZE), scanner.data.size() - offset);
+      unpacker.feed(scanner.data.data() + offset, length);
+      offset += length;
+      if (offset < scanner.data.size())
+      {
+        return false;
+      }
+      unpacker.endFrame();
+      complete = true;
+      return true;
+    }
+
+  private:
+    SyntheticScannerInterface &scanner;
+    PixelUnpacker unpacker;
+    size_t offset = 0;
+    bool complete = false;
+  };
+
+  FrameParameters frame;
+  std::vector<unsigned char> data;
+  std::vector<ScannerDeviceDescriptorPtr> devices;
+};
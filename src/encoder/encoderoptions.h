@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+
+/**
+ * Options for the encoding of scanned images to files
+ */
+struct EncoderOptions
+{
+  /**
+   * Compression schemes of TIFF files
+   */
+  enum TiffCompression
+  {
+    TiffNone,
+    TiffLzw,
+    TiffDeflate
+  };
+
+  /**
+   * Name of the encoder (e.g. "png", "pnm", "tiff", "jpeg"), empty to choose it by the file extension
+   */
+  std::string format;
+
+  /**
+   * zlib compression level (0 - 9), -1 for the library's default
+   */
+  int compressionLevel = -1;
+
+  /**
+   * Number of threads compressing the image, 1 encodes on the scanning thread
+   */
+  unsigned int threads = 1;
+
+  /**
+   * JPEG quality (1 - 100)
+   */
+  int quality = 90;
+
+  TiffCompression tiffCompression = TiffDeflate;
+};
@@ -0,0 +1,90 @@
+#include "encoderregistry.h"
+#include "jpegencoder.h"
+#include "parallelpngencoder.h"
+#include "pngencoder.h"
+#include "pnmencoder.h"
+#include "tiffencoder.h"
+
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+namespace
+{
+std::string getExtension(const std::string &path)
+{
+    size_t dot = path.find_last_of('.');
+    size_t separator = path.find_last_of('/');
+    if (dot == std::string::npos || (separator != std::string::npos && dot < separator))
+    {
+        return std::string();
+    }
+    std::string extension = path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+    return extension;
+}
+}
+
+EncoderRegistry::EncoderRegistry()
+{
+    registerEncoder("png", {"png"}, [](const std::string &path, const EncoderOptions &options) -> IImageEncoderPtr {
+        if (options.threads > 1)
+        {
+            return IImageEncoderPtr(new ParallelPngEncoder(path, options));
+        }
+        return IImageEncoderPtr(new PngEncoder(path, options));
+    });
+    registerEncoder("pnm", {"pnm", "pgm", "ppm", "pam"}, [](const std::string &path, const EncoderOptions &options) {
+        return IImageEncoderPtr(new PnmEncoder(path, getExtension(path) == "pam"));
+    });
+    registerEncoder("tiff", {"tif", "tiff"}, [](const std::string &path, const EncoderOptions &options) {
+        return IImageEncoderPtr(new TiffEncoder(path, options));
+    });
+    registerEncoder("jpeg", {"jpg", "jpeg"}, [](const std::string &path, const EncoderOptions &options) {
+        return IImageEncoderPtr(new JpegEncoder(path, options));
+    });
+}
+
+void EncoderRegistry::registerEncoder(const std::string &format, const std::vector<std::string> &extensions, EncoderFactory factory)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    factories[format] = factory;
+    for (const auto &extension : extensions)
+    {
+        formatsByExtension[extension] = format;
+    }
+}
+
+IImageEncoderPtr EncoderRegistry::create(const std::string &destinationPath, const EncoderOptions &options) const
+{
+    EncoderFactory factory;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::string format = options.format;
+        if (format.empty())
+        {
+            auto byExtension = formatsByExtension.find(getExtension(destinationPath));
+            // Without a known extension, the file is stored as PNG (as it always was)
+            format = byExtension != formatsByExtension.end() ? byExtension->second : "png";
+        }
+
+        auto registered = factories.find(format);
+        if (registered == factories.end())
+        {
+            throw std::runtime_error("No encoder for the format: " + format);
+        }
+        factory = registered->second;
+    }
+    return factory(destinationPath, options);
+}
+
+std::vector<std::string> EncoderRegistry::getFormats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> formats;
+    for (const auto &factory : factories)
+    {
+        formats.push_back(factory.first);
+    }
+    return formats;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "iimageencoder.h"
+#include "encoderoptions.h"
+
+#include <functional>
+#include <mutex>
+
+SHARED_PTR(EncoderRegistry);
+/**
+ * Keeps track of the available image encoders and picks one for a destination file,
+ * by the explicit format of the options or by the file extension.
+ * Encoders may be registered while scans on other threads create theirs.
+ */
+class EncoderRegistry
+{
+public:
+  typedef std::function<IImageEncoderPtr(const std::string &destinationPath, const EncoderOptions &options)> EncoderFactory;
+
+  /**
+   * Creates a registry with the built in encoders (PNG, PNM/PAM, TIFF & JPEG)
+   */
+  EncoderRegistry();
+
+  /**
+   * Add (or replace) an encoder.
+   * @param format the name of the encoder, as used in the options
+   * @param extensions the file extensions (lower case, without dot) the encoder is used for
+   */
+  void registerEncoder(const std::string &format, const std::vector<std::string> &extensions, EncoderFactory factory);
+
+  /**
+   * Create the encoder for the given destination.
+   * @throws std::runtime_error if no encoder matches
+   */
+  IImageEncoderPtr create(const std::string &destinationPath, const EncoderOptions &options) const;
+
+  /**
+   * The names of the registered encoders
+   */
+  std::vector<std::string> getFormats() const;
+
+private:
+  /**
+   * Guards the factories & the extensions, the factories run without it
+   */
+  mutable std::mutex mutex;
+  std::map<std::string, EncoderFactory> factories;
+  std::map<std::string, std::string> formatsByExtension;
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "scanner/iscanreceiver.h"
+
+SHARED_PTR(IImageEncoder);
+/**
+ * Encodes the rows of a scan to an image file while they arrive.
+ */
+class IImageEncoder : public IScanReceiver
+{
+public:
+  /**
+   * True, once all rows were written and the file was closed
+   */
+  virtual bool isComplete() const = 0;
+};
@@ -0,0 +1,140 @@
+#include "jpegencoder.h"
+#include "utils/pixelkernels.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+/**
+ * Rows converted to 8 bit at once
+ */
+const unsigned int MAX_CONVERTED_ROWS = 16;
+
+/**
+ * libjpeg would exit the process on errors, report them as exceptions instead
+ */
+void throwJpegError(j_common_ptr jpeg)
+{
+    char message[JMSG_LENGTH_MAX];
+    (*jpeg->err->format_message)(jpeg, message);
+    throw std::runtime_error(std::string("JPEG encoding failed: ") + message);
+}
+}
+
+JpegEncoder::JpegEncoder(const std::string &destinationPath_, const EncoderOptions &options_)
+    : destinationPath(destinationPath_), options(options_)
+{
+    jpeg.err = jpeg_std_error(&errors);
+    errors.error_exit = throwJpegError;
+    jpeg_create_compress(&jpeg);
+}
+
+JpegEncoder::~JpegEncoder()
+{
+    jpeg_destroy_compress(&jpeg);
+    if (file)
+    {
+        std::fclose(file);
+    }
+}
+
+void JpegEncoder::begin(const ImageHeader &header_)
+{
+    header = header_;
+    const unsigned int channels = getChannels(header.format);
+
+    file = std::fopen(destinationPath.c_str(), "wb");
+    if (!file)
+    {
+        throw std::runtime_error("Could not open " + destinationPath + " for writing.");
+    }
+
+    jpeg_stdio_dest(&jpeg, file);
+    jpeg.image_width = header.width;
+    jpeg.image_height = header.height;
+    jpeg.input_components = channels;
+    jpeg.in_color_space = channels == 1 ? JCS_GRAYSCALE : JCS_RGB;
+    jpeg_set_defaults(&jpeg);
+    jpeg_set_quality(&jpeg, std::max(1, std::min(100, options.quality)), TRUE);
+    jpeg_start_compress(&jpeg, TRUE);
+
+    // JPEG only has 8 bit samples, lineart & 16 bit rows are converted
+    if (getBitsPerSample(header.format) != 8)
+    {
+        converted.resize(static_cast<size_t>(header.width) * channels * MAX_CONVERTED_ROWS);
+    }
+}
+
+void JpegEncoder::rows(const unsigned char *pixels, unsigned int y, unsigned int count)
+{
+    count = std::min(count, jpeg.image_height - jpeg.next_scanline);
+    const size_t bytesPerRow = header.getBytesPerRow();
+    if (!converted.empty())
+    {
+        writeConvertedRows(pixels, count);
+        return;
+    }
+    rowPointers.resize(count);
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        rowPointers[i] = const_cast<JSAMPROW>(pixels + i * bytesPerRow);
+    }
+    unsigned int written = 0;
+    while (written < count)
+    {
+        written += jpeg_write_scanlines(&jpeg, rowPointers.data() + written, count - written);
+    }
+}
+
+void JpegEncoder::writeConvertedRows(const unsigned char *pixels, unsigned int count)
+{
+    const PixelKernels &kernels = getPixelKernels();
+    const size_t bytesPerRow = header.getBytesPerRow();
+    const size_t samplesPerRow = static_cast<size_t>(header.width) * getChannels(header.format);
+    while (count > 0)
+    {
+        unsigned int batch = std::min(count, MAX_CONVERTED_ROWS);
+        rowPointers.resize(batch);
+        for (unsigned int i = 0; i < batch; ++i)
+        {
+            rowPointers[i] = converted.data() + i * samplesPerRow;
+            if (header.format == PixelFormat::Gray1)
+            {
+                kernels.expand1To8(pixels + i * bytesPerRow, rowPointers[i], samplesPerRow, 0x00);
+            }
+            else
+            {
+                kernels.narrow16To8(pixels + i * bytesPerRow, rowPointers[i], samplesPerRow);
+            }
+        }
+        unsigned int written = 0;
+        while (written < batch)
+        {
+            written += jpeg_write_scanlines(&jpeg, rowPointers.data() + written, batch - written);
+        }
+        pixels += batch * bytesPerRow;
+        count -= batch;
+    }
+}
+
+void JpegEncoder::end()
+{
+    if (jpeg.next_scanline != header.height)
+    {
+        throw std::runtime_error("The scan ended before all rows of the JPEG were written.");
+    }
+    jpeg_finish_compress(&jpeg);
+    int result = std::fclose(file);
+    file = nullptr;
+    if (result != 0)
+    {
+        throw std::runtime_error("Could not write " + destinationPath);
+    }
+    complete = true;
+}
+
+bool JpegEncoder::isComplete() const
+{
+    return complete;
+}
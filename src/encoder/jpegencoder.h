@@ -0,0 +1,45 @@
+#pragma once
+
+#include "encoderoptions.h"
+#include "iimageencoder.h"
+
+#include <cstdio>
+#include <jpeglib.h>
+
+/**
+ * Encoder that writes the rows to a JPEG file (libjpeg(-turbo)) as they arrive.
+ * Lineart & 16 bit rows are converted to 8 bit, as JPEG has no other sample sizes.
+ */
+class JpegEncoder : public IImageEncoder
+{
+public:
+  JpegEncoder(const std::string &destinationPath, const EncoderOptions &options = EncoderOptions());
+
+  ~JpegEncoder();
+
+  virtual void begin(const ImageHeader &header);
+
+  virtual void rows(const unsigned char *pixels, unsigned int y, unsigned int count);
+
+  virtual void end();
+
+  virtual bool isComplete() const;
+
+private:
+  /**
+   * Convert lineart or 16 bit rows to 8 bit & write them
+   */
+  void writeConvertedRows(const unsigned char *pixels, unsigned int count);
+
+  std::string destinationPath;
+  EncoderOptions options;
+  FILE *file = nullptr;
+
+  jpeg_compress_struct jpeg;
+  jpeg_error_mgr errors;
+
+  ImageHeader header;
+  std::vector<JSAMPROW> rowPointers;
+  std::vector<unsigned char> converted;
+  bool complete = false;
+};
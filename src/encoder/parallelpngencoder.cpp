@@ -0,0 +1,287 @@
+#include "parallelpngencoder.h"
+#include "utils/pixelkernels.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+const unsigned char PNG_SIGNATURE[] = {137, 80, 78, 71, 13, 10, 26, 10};
+const unsigned int DEFLATE_WINDOW_SIZE = 32 * 1024;
+const unsigned char PNG_FILTER_UP = 2;
+
+void storeBigEndian(unsigned char *destination, uint32_t value)
+{
+    destination[0] = static_cast<unsigned char>(value >> 24);
+    destination[1] = static_cast<unsigned char>(value >> 16);
+    destination[2] = static_cast<unsigned char>(value >> 8);
+    destination[3] = static_cast<unsigned char>(value);
+}
+
+/**
+ * Apply the PNG "up" filter to a row. The up filter only depends on the row above,
+ * so the rows of a stripe can be filtered without its predecessors.
+ */
+void filterRow(const unsigned char *row, const unsigned char *previous, unsigned int bytesPerRow, unsigned char *destination)
+{
+    *destination++ = PNG_FILTER_UP;
+    if (!previous)
+    {
+        std::memcpy(destination, row, bytesPerRow);
+        return;
+    }
+    for (unsigned int i = 0; i < bytesPerRow; ++i)
+    {
+        destination[i] = static_cast<unsigned char>(row[i] - previous[i]);
+    }
+}
+}
+
+ParallelPngEncoder::ParallelPngEncoder(const std::string &destinationPath_, const EncoderOptions &options_, size_t stripeBytes_)
+    : destinationPath(destinationPath_), options(options_), stripeBytes(stripeBytes_)
+{
+}
+
+ParallelPngEncoder::~ParallelPngEncoder()
+{
+    // Let the pool finish the stripes in flight before their buffers are released.
+    pool.reset();
+    if (file)
+    {
+        std::fclose(file);
+    }
+}
+
+void ParallelPngEncoder::begin(const ImageHeader &header_)
+{
+    header = header_;
+    file = std::fopen(destinationPath.c_str(), "wb");
+    if (!file)
+    {
+        throw std::runtime_error("Could not open " + destinationPath + " for writing.");
+    }
+
+    bytesPerRow = static_cast<unsigned int>(header.getBytesPerRow());
+    rowsPerStripe = static_cast<unsigned int>(std::max<size_t>(1, stripeBytes / std::max(1u, bytesPerRow)));
+    // Enough rows to fill the deflate window, plus the row above them for the filter
+    contextRows = (DEFLATE_WINDOW_SIZE + bytesPerRow) / (bytesPerRow + 1) + 1;
+    pool.reset(new ThreadPool(options.threads));
+    checksum = adler32(0, nullptr, 0);
+
+    write(PNG_SIGNATURE, sizeof(PNG_SIGNATURE));
+
+    unsigned char imageHeader[13];
+    storeBigEndian(imageHeader, header.width);
+    storeBigEndian(imageHeader + 4, header.height);
+    imageHeader[8] = static_cast<unsigned char>(getBitsPerSample(header.format)); // bit depth
+    imageHeader[9] = getChannels(header.format) == 1 ? 0 : 2;                    // gray or RGB
+    imageHeader[10] = 0;                                                         // deflate
+    imageHeader[11] = 0;                                                         // adaptive filtering
+    imageHeader[12] = 0;                                                         // no interlace
+    writeChunk("IHDR", imageHeader, sizeof(imageHeader));
+
+    const unsigned char zlibHeader[] = {0x78, 0x9C};
+    writeChunk("IDAT", zlibHeader, sizeof(zlibHeader));
+
+    current = StripePtr(new Stripe());
+    current->startsAtTop = true;
+}
+
+void ParallelPngEncoder::rows(const unsigned char *pixels, unsigned int y, unsigned int count)
+{
+    while (count > 0 && receivedRows < header.height)
+    {
+        unsigned int stripeRows = static_cast<unsigned int>(current->rows.size() / bytesPerRow) - current->contextRows;
+        unsigned int take = std::min(std::min(count, rowsPerStripe - stripeRows), header.height - receivedRows);
+        const size_t stripeBytes = current->rows.size();
+        current->rows.insert(current->rows.end(), pixels, pixels + static_cast<size_t>(take) * bytesPerRow);
+        toPngSamples(current->rows.data() + stripeBytes, static_cast<size_t>(take) * bytesPerRow);
+        pixels += static_cast<size_t>(take) * bytesPerRow;
+        count -= take;
+        receivedRows += take;
+
+        if (receivedRows == header.height)
+        {
+            submitStripe(true);
+        }
+        else if (stripeRows + take == rowsPerStripe)
+        {
+            submitStripe(false);
+        }
+    }
+}
+
+void ParallelPngEncoder::toPngSamples(unsigned char *data, size_t length) const
+{
+    // PNG lineart has 0 as black & big endian samples
+    if (header.format == PixelFormat::Gray1)
+    {
+        for (size_t i = 0; i < length; ++i)
+        {
+            data[i] = static_cast<unsigned char>(~data[i]);
+        }
+    }
+    else if (getBitsPerSample(header.format) == 16 && HOST_IS_LITTLE_ENDIAN)
+    {
+        getPixelKernels().swap16(data, data, length / 2);
+    }
+}
+
+void ParallelPngEncoder::submitStripe(bool last)
+{
+    StripePtr stripe = current;
+    stripe->last = last;
+    lastSubmitted = last;
+
+    // The next stripe starts with the end of this one as context (taken before the pool releases the rows)
+    current = StripePtr(new Stripe());
+    unsigned int availableRows = static_cast<unsigned int>(stripe->rows.size() / bytesPerRow);
+    unsigned int keptRows = std::min(contextRows, availableRows);
+    current->contextRows = keptRows;
+    current->startsAtTop = stripe->startsAtTop && keptRows == availableRows;
+    current->rows.assign(stripe->rows.end() - static_cast<size_t>(keptRows) * bytesPerRow, stripe->rows.end());
+
+    const unsigned int bytesPerRow_ = bytesPerRow;
+    const int compressionLevel = options.compressionLevel;
+    inFlight.push_back(std::make_pair(stripe, pool->submit([stripe, bytesPerRow_, compressionLevel]() {
+                                          compressStripe(*stripe, bytesPerRow_, compressionLevel);
+                                      })));
+
+    // Bound the memory: write out the oldest stripes while too many are in flight
+    while (inFlight.size() > 2 * pool->size())
+    {
+        writeOldestStripe();
+    }
+}
+
+void ParallelPngEncoder::writeOldestStripe()
+{
+    StripePtr stripe = inFlight.front().first;
+    std::future<void> done = std::move(inFlight.front().second);
+    inFlight.pop_front();
+    done.get();
+
+    writeChunk("IDAT", stripe->compressed.data(), stripe->compressed.size());
+    checksum = adler32_combine(checksum, stripe->checksum, stripe->filteredBytes);
+}
+
+void ParallelPngEncoder::compressStripe(Stripe &stripe, unsigned int bytesPerRow, int compressionLevel)
+{
+    const unsigned int totalRows = static_cast<unsigned int>(stripe.rows.size() / bytesPerRow);
+    // Without the row above, the first context row cannot be filtered, it only serves as reference.
+    const unsigned int firstFiltered = stripe.startsAtTop ? 0 : 1;
+    const size_t filteredBytesPerRow = bytesPerRow + 1;
+
+    std::vector<unsigned char> filtered(static_cast<size_t>(totalRows - firstFiltered) * filteredBytesPerRow);
+    for (unsigned int i = firstFiltered; i < totalRows; ++i)
+    {
+        const unsigned char *row = stripe.rows.data() + static_cast<size_t>(i) * bytesPerRow;
+        const unsigned char *previous = i > 0 ? row - bytesPerRow : nullptr;
+        filterRow(row, previous, bytesPerRow, filtered.data() + (i - firstFiltered) * filteredBytesPerRow);
+    }
+    stripe.rows = std::vector<unsigned char>();
+
+    const size_t dictionaryBytes = static_cast<size_t>(stripe.contextRows - firstFiltered) * filteredBytesPerRow;
+    const unsigned char *data = filtered.data() + dictionaryBytes;
+    const size_t dataBytes = filtered.size() - dictionaryBytes;
+
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, compressionLevel, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        throw std::runtime_error("Could not initialize the deflate stream.");
+    }
+    if (dictionaryBytes > 0)
+    {
+        deflateSetDictionary(&stream, filtered.data(), static_cast<uInt>(dictionaryBytes));
+    }
+
+    // Room for the data, the flush marker & the end of the stream
+    stripe.compressed.resize(deflateBound(&stream, dataBytes) + 16);
+    stream.next_in = const_cast<unsigned char *>(data);
+    stream.avail_in = static_cast<uInt>(dataBytes);
+    const int flush = stripe.last ? Z_FINISH : Z_SYNC_FLUSH;
+    int result = Z_OK;
+    size_t produced = 0;
+    do
+    {
+        if (produced == stripe.compressed.size())
+        {
+            stripe.compressed.resize(stripe.compressed.size() * 2);
+        }
+        stream.next_out = stripe.compressed.data() + produced;
+        stream.avail_out = static_cast<uInt>(stripe.compressed.size() - produced);
+        result = deflate(&stream, flush);
+        produced = stripe.compressed.size() - stream.avail_out;
+    } while (result == Z_OK && (stream.avail_out == 0 || (stripe.last && result != Z_STREAM_END)));
+    stripe.compressed.resize(produced);
+    deflateEnd(&stream);
+    if (result == Z_STREAM_ERROR || stream.avail_in != 0 || (stripe.last && result != Z_STREAM_END))
+    {
+        throw std::runtime_error("Deflating a PNG stripe failed.");
+    }
+
+    stripe.checksum = adler32(adler32(0, nullptr, 0), data, static_cast<uInt>(dataBytes));
+    stripe.filteredBytes = dataBytes;
+}
+
+void ParallelPngEncoder::end()
+{
+    if (receivedRows != header.height)
+    {
+        throw std::runtime_error("The scan ended before all rows of the PNG were written.");
+    }
+    if (!lastSubmitted)
+    {
+        // Only for images without rows: the stream still needs its final block.
+        submitStripe(true);
+    }
+    while (!inFlight.empty())
+    {
+        writeOldestStripe();
+    }
+
+    unsigned char trailer[4];
+    storeBigEndian(trailer, static_cast<uint32_t>(checksum));
+    writeChunk("IDAT", trailer, sizeof(trailer));
+    writeChunk("IEND", nullptr, 0);
+
+    if (std::fclose(file) != 0)
+    {
+        file = nullptr;
+        throw std::runtime_error("Could not write " + destinationPath);
+    }
+    file = nullptr;
+    complete = true;
+}
+
+bool ParallelPngEncoder::isComplete() const
+{
+    return complete;
+}
+
+void ParallelPngEncoder::writeChunk(const char *type, const unsigned char *data, size_t length)
+{
+    unsigned char prefix[8];
+    storeBigEndian(prefix, static_cast<uint32_t>(length));
+    std::memcpy(prefix + 4, type, 4);
+    write(prefix, sizeof(prefix));
+    write(data, length);
+
+    uLong crc = crc32(0, reinterpret_cast<const Bytef *>(type), 4);
+    if (length > 0)
+    {
+        crc = crc32(crc, data, static_cast<uInt>(length));
+    }
+    unsigned char suffix[4];
+    storeBigEndian(suffix, static_cast<uint32_t>(crc));
+    write(suffix, sizeof(suffix));
+}
+
+void ParallelPngEncoder::write(const void *data, size_t length)
+{
+    if (length > 0 && std::fwrite(data, 1, length, file) != length)
+    {
+        throw std::runtime_error("Could not write " + destinationPath);
+    }
+}
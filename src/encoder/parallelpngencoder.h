@@ -0,0 +1,95 @@
+#pragma once
+
+#include "encoderoptions.h"
+#include "iimageencoder.h"
+#include "utils/threadpool.h"
+
+#include <cstdio>
+#include <zlib.h>
+
+/**
+ * Encoder that writes the rows to a PNG file on several threads.
+ *
+ * The rows are grouped in stripes, every stripe is filtered & deflated on its own thread and the
+ * results are joined to a single zlib stream (like pigz does): each stripe is primed with the last
+ * 32KB of its predecessor as dictionary and ends byte aligned with a sync flush, the checksums are combined.
+ * Only a bounded number of stripes is in flight, so the memory stays independent of the image size.
+ */
+class ParallelPngEncoder : public IImageEncoder
+{
+public:
+  static const size_t DEFAULT_STRIPE_BYTES = 1024 * 1024;
+
+  ParallelPngEncoder(const std::string &destinationPath, const EncoderOptions &options, size_t stripeBytes = DEFAULT_STRIPE_BYTES);
+
+  ~ParallelPngEncoder();
+
+  virtual void begin(const ImageHeader &header);
+
+  virtual void rows(const unsigned char *pixels, unsigned int y, unsigned int count);
+
+  virtual void end();
+
+  virtual bool isComplete() const;
+
+private:
+  /**
+   * A group of rows, compressed independently from the others
+   */
+  struct Stripe
+  {
+    // Raw rows: the context rows (end of the previous stripe) followed by the stripe's own rows
+    std::vector<unsigned char> rows;
+    unsigned int contextRows = 0;
+    // True, if the first row is the first row of the image
+    bool startsAtTop = false;
+    bool last = false;
+
+    std::vector<unsigned char> compressed;
+    uLong checksum = 0;
+    size_t filteredBytes = 0;
+  };
+  typedef std::shared_ptr<Stripe> StripePtr;
+
+  /**
+   * Convert appended rows in place to the sample layout of PNG
+   */
+  void toPngSamples(unsigned char *data, size_t length) const;
+
+  /**
+   * Hand the current stripe to the thread pool & prepare the next one
+   */
+  void submitStripe(bool last);
+
+  /**
+   * Wait for the oldest stripe in flight & append it to the file
+   */
+  void writeOldestStripe();
+
+  /**
+   * Filter & deflate a stripe (runs on the pool)
+   */
+  static void compressStripe(Stripe &stripe, unsigned int bytesPerRow, int compressionLevel);
+
+  void writeChunk(const char *type, const unsigned char *data, size_t length);
+
+  void write(const void *data, size_t length);
+
+  std::string destinationPath;
+  EncoderOptions options;
+  size_t stripeBytes;
+
+  FILE *file = nullptr;
+  ImageHeader header;
+  unsigned int bytesPerRow = 0;
+  unsigned int rowsPerStripe = 0;
+  unsigned int contextRows = 0;
+  unsigned int receivedRows = 0;
+
+  std::unique_ptr<ThreadPool> pool;
+  StripePtr current;
+  std::deque<std::pair<StripePtr, std::future<void>>> inFlight;
+  uLong checksum = 0;
+  bool lastSubmitted = false;
+  bool complete = false;
+};
@@ -0,0 +1,104 @@
+#include "pngencoder.h"
+#include "utils/pixelkernels.h"
+
+#include <stdexcept>
+
+namespace
+{
+void throwPngError(png_structp png, png_const_charp message)
+{
+    throw std::runtime_error(std::string("PNG encoding failed: ") + message);
+}
+
+void ignorePngWarning(png_structp png, png_const_charp message)
+{
+}
+}
+
+PngEncoder::PngEncoder(const std::string &destinationPath_, const EncoderOptions &options_)
+    : destinationPath(destinationPath_), options(options_)
+{
+}
+
+PngEncoder::~PngEncoder()
+{
+    release();
+}
+
+void PngEncoder::begin(const ImageHeader &header_)
+{
+    header = header_;
+    file = std::fopen(destinationPath.c_str(), "wb");
+    if (!file)
+    {
+        throw std::runtime_error("Could not open " + destinationPath + " for writing.");
+    }
+
+    png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, throwPngError, ignorePngWarning);
+    info = png ? png_create_info_struct(png) : nullptr;
+    if (!info)
+    {
+        throw std::runtime_error("Could not create the PNG structures.");
+    }
+
+    png_init_io(png, file);
+    int colorType = getChannels(header.format) == 1 ? PNG_COLOR_TYPE_GRAY : PNG_COLOR_TYPE_RGB;
+    if (options.compressionLevel >= 0)
+    {
+        png_set_compression_level(png, options.compressionLevel);
+    }
+    png_set_IHDR(png, info, header.width, header.height, getBitsPerSample(header.format), colorType, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png, info);
+
+    // PNG lineart has 0 as black & big endian samples, libpng converts the rows while it writes them
+    if (header.format == PixelFormat::Gray1)
+    {
+        png_set_invert_mono(png);
+    }
+    if (getBitsPerSample(header.format) == 16 && HOST_IS_LITTLE_ENDIAN)
+    {
+        png_set_swap(png);
+    }
+}
+
+void PngEncoder::rows(const unsigned char *pixels, unsigned int y, unsigned int count)
+{
+    const size_t bytesPerRow = header.getBytesPerRow();
+    for (unsigned int i = 0; i < count && writtenRows < header.height; ++i)
+    {
+        png_write_row(png, const_cast<png_bytep>(pixels + static_cast<size_t>(i) * bytesPerRow));
+        writtenRows++;
+    }
+}
+
+void PngEncoder::end()
+{
+    if (writtenRows != header.height)
+    {
+        throw std::runtime_error("The scan ended before all rows of the PNG were written.");
+    }
+    png_write_end(png, nullptr);
+    release();
+    complete = true;
+}
+
+bool PngEncoder::isComplete() const
+{
+    return complete;
+}
+
+void PngEncoder::release()
+{
+    if (png)
+    {
+        png_destroy_write_struct(&png, info ? &info : nullptr);
+        png = nullptr;
+        info = nullptr;
+    }
+    if (file)
+    {
+        std::fclose(file);
+        file = nullptr;
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "encoderoptions.h"
+#include "iimageencoder.h"
+
+#include <cstdio>
+#include <png.h>
+
+/**
+ * Encoder that writes the rows to a PNG file as they arrive.
+ * Only the current row is kept in memory, the encoding overlaps with the scan.
+ */
+class PngEncoder : public IImageEncoder
+{
+public:
+  explicit PngEncoder(const std::string &destinationPath, const EncoderOptions &options = EncoderOptions());
+
+  ~PngEncoder();
+
+  virtual void begin(const ImageHeader &header);
+
+  virtual void rows(const unsigned char *pixels, unsigned int y, unsigned int count);
+
+  virtual void end();
+
+  virtual bool isComplete() const;
+
+private:
+  /**
+   * Release the libpng structures & the file
+   */
+  void release();
+
+  std::string destinationPath;
+  EncoderOptions options;
+  FILE *file = nullptr;
+  png_structp png = nullptr;
+  png_infop info = nullptr;
+
+  ImageHeader header;
+  unsigned int writtenRows = 0;
+  bool complete = false;
+};
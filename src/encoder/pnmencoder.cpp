@@ -0,0 +1,128 @@
+#include "pnmencoder.h"
+#include "utils/pixelkernels.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+const size_t FILE_BUFFER_SIZE = 1024 * 1024;
+}
+
+PnmEncoder::PnmEncoder(const std::string &destinationPath_, bool arbitraryMap_)
+    : destinationPath(destinationPath_), arbitraryMap(arbitraryMap_)
+{
+}
+
+PnmEncoder::~PnmEncoder()
+{
+    if (file)
+    {
+        std::fclose(file);
+    }
+}
+
+void PnmEncoder::begin(const ImageHeader &header_)
+{
+    header = header_;
+    const unsigned int channels = getChannels(header.format);
+    const unsigned int bits = getBitsPerSample(header.format);
+    const unsigned int maximum = bits == 1 ? 1 : bits == 16 ? 65535 : 255;
+
+    file = std::fopen(destinationPath.c_str(), "wb");
+    if (!file)
+    {
+        throw std::runtime_error("Could not open " + destinationPath + " for writing.");
+    }
+    std::setvbuf(file, nullptr, _IOFBF, FILE_BUFFER_SIZE);
+
+    std::ostringstream stream;
+    if (arbitraryMap)
+    {
+        stream << "P7\nWIDTH " << header.width << "\nHEIGHT " << header.height << "\nDEPTH " << channels << "\nMAXVAL " << maximum
+               << "\nTUPLTYPE " << (bits == 1 ? "BLACKANDWHITE" : channels == 1 ? "GRAYSCALE" : "RGB") << "\nENDHDR\n";
+    }
+    else if (bits == 1)
+    {
+        // PBM has the same layout as the lineart rows
+        stream << "P4\n"
+               << header.width << " " << header.height << "\n";
+    }
+    else
+    {
+        stream << (channels == 1 ? "P5" : "P6") << "\n"
+               << header.width << " " << header.height << "\n"
+               << maximum << "\n";
+    }
+
+    // PNM has big endian samples & PAM has a byte per lineart sample (with 1 as white), other rows are written as they are
+    if ((bits == 16 && HOST_IS_LITTLE_ENDIAN) || (bits == 1 && arbitraryMap))
+    {
+        row.resize(static_cast<size_t>(header.width) * channels * (bits == 16 ? 2 : 1));
+    }
+    const std::string pnmHeader = stream.str();
+    if (std::fwrite(pnmHeader.data(), 1, pnmHeader.size(), file) != pnmHeader.size())
+    {
+        throw std::runtime_error("Could not write " + destinationPath);
+    }
+}
+
+void PnmEncoder::rows(const unsigned char *pixels, unsigned int y, unsigned int count)
+{
+    count = std::min(count, header.height - writtenRows);
+    const size_t bytesPerRow = header.getBytesPerRow();
+    if (row.empty())
+    {
+        const size_t bytes = static_cast<size_t>(count) * bytesPerRow;
+        if (std::fwrite(pixels, 1, bytes, file) != bytes)
+        {
+            throw std::runtime_error("Could not write " + destinationPath);
+        }
+        writtenRows += count;
+        return;
+    }
+
+    const PixelKernels &kernels = getPixelKernels();
+    for (unsigned int i = 0; i < count; ++i, ++writtenRows)
+    {
+        const unsigned char *source = pixels + i * bytesPerRow;
+        if (header.format == PixelFormat::Gray1)
+        {
+            // Black becomes 0x00 & white 0xFF, keep one bit of it
+            kernels.expand1To8(source, row.data(), header.width, 0x00);
+            for (auto &sample : row)
+            {
+                sample &= 1;
+            }
+        }
+        else
+        {
+            kernels.swap16(source, row.data(), row.size() / 2);
+        }
+        if (std::fwrite(row.data(), 1, row.size(), file) != row.size())
+        {
+            throw std::runtime_error("Could not write " + destinationPath);
+        }
+    }
+}
+
+void PnmEncoder::end()
+{
+    if (writtenRows != header.height)
+    {
+        throw std::runtime_error("The scan ended before all rows of the PNM were written.");
+    }
+    int result = std::fclose(file);
+    file = nullptr;
+    if (result != 0)
+    {
+        throw std::runtime_error("Could not write " + destinationPath);
+    }
+    complete = true;
+}
+
+bool PnmEncoder::isComplete() const
+{
+    return complete;
+}
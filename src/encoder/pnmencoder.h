@@ -0,0 +1,39 @@
+#pragma once
+
+#include "iimageencoder.h"
+
+#include <cstdio>
+
+/**
+ * Encoder that writes the rows uncompressed to a PBM/PGM/PPM (or PAM) file.
+ * 8 bit & lineart rows are written as they are, so this is about as fast as the disk.
+ */
+class PnmEncoder : public IImageEncoder
+{
+public:
+  /**
+   * @param arbitraryMap true to write a PAM (P7) header instead of PGM/PPM
+   */
+  PnmEncoder(const std::string &destinationPath, bool arbitraryMap = false);
+
+  ~PnmEncoder();
+
+  virtual void begin(const ImageHeader &header);
+
+  virtual void rows(const unsigned char *pixels, unsigned int y, unsigned int count);
+
+  virtual void end();
+
+  virtual bool isComplete() const;
+
+private:
+  std::string destinationPath;
+  bool arbitraryMap;
+  FILE *file = nullptr;
+
+  ImageHeader header;
+  // Rows that need a conversion are converted here, empty if the rows are written as they are
+  std::vector<unsigned char> row;
+  unsigned int writtenRows = 0;
+  bool complete = false;
+};
@@ -0,0 +1,90 @@
+#include "tiffencoder.h"
+
+#include <cstring>
+#include <stdexcept>
+
+TiffEncoder::TiffEncoder(const std::string &destinationPath_, const EncoderOptions &options_)
+    : destinationPath(destinationPath_), options(options_)
+{
+}
+
+TiffEncoder::~TiffEncoder()
+{
+    if (tiff)
+    {
+        TIFFClose(tiff);
+    }
+}
+
+void TiffEncoder::begin(const ImageHeader &header_)
+{
+    header = header_;
+    const unsigned int channels = getChannels(header.format);
+    const unsigned int bits = getBitsPerSample(header.format);
+
+    tiff = TIFFOpen(destinationPath.c_str(), "w");
+    if (!tiff)
+    {
+        throw std::runtime_error("Could not open " + destinationPath + " for writing.");
+    }
+
+    TIFFSetField(tiff, TIFFTAG_IMAGEWIDTH, header.width);
+    TIFFSetField(tiff, TIFFTAG_IMAGELENGTH, header.height);
+    TIFFSetField(tiff, TIFFTAG_SAMPLESPERPIXEL, channels);
+    // The samples are stored in host byte order, libtiff marks the file accordingly
+    TIFFSetField(tiff, TIFFTAG_BITSPERSAMPLE, bits);
+    // In lineart rows a set bit is black
+    TIFFSetField(tiff, TIFFTAG_PHOTOMETRIC, bits == 1 ? PHOTOMETRIC_MINISWHITE : channels == 1 ? PHOTOMETRIC_MINISBLACK : PHOTOMETRIC_RGB);
+    TIFFSetField(tiff, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+    TIFFSetField(tiff, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
+
+    switch (options.tiffCompression)
+    {
+    case EncoderOptions::TiffLzw:
+        TIFFSetField(tiff, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
+        break;
+    case EncoderOptions::TiffDeflate:
+        TIFFSetField(tiff, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
+        break;
+    default:
+        TIFFSetField(tiff, TIFFTAG_COMPRESSION, COMPRESSION_NONE);
+        break;
+    }
+    // The horizontal predictor works on whole samples only
+    if (options.tiffCompression != EncoderOptions::TiffNone && bits >= 8)
+    {
+        TIFFSetField(tiff, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+    }
+    TIFFSetField(tiff, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(tiff, 0));
+
+    row.resize(header.getBytesPerRow());
+}
+
+void TiffEncoder::rows(const unsigned char *pixels, unsigned int y, unsigned int count)
+{
+    for (unsigned int i = 0; i < count && writtenRows < header.height; ++i)
+    {
+        std::memcpy(row.data(), pixels + i * row.size(), row.size());
+        if (TIFFWriteScanline(tiff, row.data(), writtenRows, 0) < 0)
+        {
+            throw std::runtime_error("Could not write " + destinationPath);
+        }
+        writtenRows++;
+    }
+}
+
+void TiffEncoder::end()
+{
+    if (writtenRows != header.height)
+    {
+        throw std::runtime_error("The scan ended before all rows of the TIFF were written.");
+    }
+    TIFFClose(tiff);
+    tiff = nullptr;
+    complete = true;
+}
+
+bool TiffEncoder::isComplete() const
+{
+    return complete;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "encoderoptions.h"
+#include "iimageencoder.h"
+
+#include <tiffio.h>
+
+/**
+ * Encoder that writes the rows to a TIFF file (uncompressed, LZW or Deflate) as they arrive.
+ */
+class TiffEncoder : public IImageEncoder
+{
+public:
+  TiffEncoder(const std::string &destinationPath, const EncoderOptions &options = EncoderOptions());
+
+  ~TiffEncoder();
+
+  virtual void begin(const ImageHeader &header);
+
+  virtual void rows(const unsigned char *pixels, unsigned int y, unsigned int count);
+
+  virtual void end();
+
+  virtual bool isComplete() const;
+
+private:
+  std::string destinationPath;
+  EncoderOptions options;
+  TIFF *tiff = nullptr;
+
+  ImageHeader header;
+  // libtiff may modify the row while encoding (predictor), so each row is copied here first
+  std::vector<unsigned char> row;
+  unsigned int writtenRows = 0;
+  bool complete = false;
+};
@@ -1,6 +1,17 @@
 #ifndef NO_NODE
 #include <node.h>
+#include <node_buffer.h>
+#include <uv.h>
 #include <iostream>
+#include <cstdlib>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+#include "scanner/rawimagereceiver.h"
+#include "scanner/replayscannerinterface.h"
 #include "scanner/sanescannerinterface.h"
 #include "scanner/scanservice.h"
 
@@ -10,22 +21,187 @@ namespace carbonpaper
 using v8::Array;
 using v8::Boolean;
 using v8::Exception;
+using v8::Function;
 using v8::FunctionCallbackInfo;
 using v8::Isolate;
 using v8::Local;
+using v8::Null;
 using v8::Number;
 using v8::Object;
+using v8::Persistent;
+using v8::Promise;
 using v8::String;
 using v8::Uint32;
 using v8::Uint8Array;
 using v8::Value;
 
-ScanServicePtr scanService;
+std::mutex sharedServiceMutex;
+std::condition_variable sharedServiceReleased;
+std::weak_ptr<ScanService> sharedService;
+bool sharedServiceAlive = false;
+
+/**
+ * Create the scanner interface given by the environment.
+ * The environment variable SCANAHEDRON_DEVICE_CACHE may name a file that caches the devices across restarts.
+ * SCANAHEDRON_RECORD may name a file the scans are recorded to, SCANAHEDRON_REPLAY a recording that is replayed
+ * instead of using SANE (SCANAHEDRON_REPLAY_PACE=fast replays it as fast as possible).
+ */
+IScannerInterfacePtr createScannerInterface()
+{
+  const char *replayFile = std::getenv("SCANAHEDRON_REPLAY");
+  if (replayFile)
+  {
+    const char *pace = std::getenv("SCANAHEDRON_REPLAY_PACE");
+    bool fast = pace && std::string(pace) == "fast";
+    return IScannerInterfacePtr(new ReplayScannerInterface(replayFile, fast ? ReplayScannerInterface::AsFastAsPossible : ReplayScannerInterface::Original));
+  }
+
+  const char *cacheFile = std::getenv("SCANAHEDRON_DEVICE_CACHE");
+  const char *recordingFile = std::getenv("SCANAHEDRON_RECORD");
+  auto saneInterface = std::make_shared<SaneScannerInterface>(cacheFile ? cacheFile : "");
+  saneInterface->setRecordingFile(recordingFile ? recordingFile : "");
+  return saneInterface;
+}
+
+/**
+ * Take a reference to the scan service of the process, it is created by the first context.
+ * Once the last reference is gone (the last context is cleaned up & its scans are done), SANE exits;
+ * a context loaded afterwards waits for that, before it starts a new session.
+ */
+ScanServicePtr acquireScanService()
+{
+  std::unique_lock<std::mutex> lock(sharedServiceMutex);
+  ScanServicePtr scanService = sharedService.lock();
+  if (scanService)
+  {
+    return scanService;
+  }
+  sharedServiceReleased.wait(lock, []() { return !sharedServiceAlive; });
+
+  scanService = ScanServicePtr(new ScanService(createScannerInterface()), [](ScanService *service) {
+    std::lock_guard<std::mutex> lock(sharedServiceMutex);
+    delete service;
+    sharedServiceAlive = false;
+    sharedServiceReleased.notify_all();
+  });
+  sharedService = scanService;
+  sharedServiceAlive = true;
+  return scanService;
+}
+
+class AddonInstance;
+
+/**
+ * A request of a context from its start to its completion, on the event loop of the context or its thread pool
+ */
+struct InFlightRequest
+{
+  virtual ~InFlightRequest();
+
+  /**
+   * Called on the javascript thread when the context is torn down (abandoned is set for all requests first):
+   * cancel the job, end the session, close the handles that are idle & drop the javascript state.
+   * The request then completes as usual, but settles nothing.
+   */
+  virtual void abandon() = 0;
+
+  /**
+   * The instance, that tracks the request (see AddonInstance::track)
+   */
+  AddonInstance *addon = nullptr;
+  bool abandoned = false;
+};
+
+/**
+ * The state of the addon in one context (the main thread or a worker_thread), every context runs its own event loop.
+ * The scan service (& with it the SANE session) is shared by all contexts of the process.
+ */
+class AddonInstance
+{
+public:
+  explicit AddonInstance(uv_loop_t *loop_) : loop(loop_) {}
+
+  /**
+   * The shared scan service, taken on first use: loading the addon never waits for the service of
+   * an ended context to exit (see acquireScanService)
+   */
+  ScanServicePtr getScanService()
+  {
+    std::lock_guard<std::mutex> lock(scanServiceMutex);
+    if (!scanService)
+    {
+      scanService = acquireScanService();
+    }
+    return scanService;
+  }
+
+  /**
+   * Keep track of a request until it is deleted (on the javascript thread)
+   */
+  void track(InFlightRequest *request)
+  {
+    request->addon = this;
+    requests.insert(request);
+  }
+
+  void untrack(InFlightRequest *request)
+  {
+    requests.erase(request);
+  }
+
+  /**
+   * Called by the cleanup hook of the context: abandon the requests & run the loop until they completed,
+   * so that no handle of the addon is left open & nothing reaches the loop of the context afterwards
+   */
+  void tearDown()
+  {
+    std::vector<InFlightRequest *> abandoned(requests.begin(), requests.end());
+    for (auto request : abandoned)
+    {
+      request->abandoned = true;
+    }
+    for (auto request : abandoned)
+    {
+      // abandoning a request may complete another one (e.g. the work waiting for its turn)
+      if (requests.count(request))
+      {
+        request->abandon();
+      }
+    }
+    while (!requests.empty())
+    {
+      uv_run(loop, UV_RUN_ONCE);
+    }
+  }
+
+  uv_loop_t *const loop;
+
+private:
+  std::mutex scanServiceMutex;
+  ScanServicePtr scanService;
+  std::set<InFlightRequest *> requests;
+};
+
+InFlightRequest::~InFlightRequest()
+{
+  if (addon)
+  {
+    addon->untrack(this);
+  }
+}
+
+/**
+ * The instance of the context, that called a javascript function
+ */
+AddonInstance &getAddon(const FunctionCallbackInfo<Value> &args)
+{
+  return *static_cast<AddonInstance *>(args.Data().As<v8::External>()->Value());
+}
 
 /**
  * Get a device descriptor via the device's name
  */
-ScannerDeviceDescriptorPtr getDeviceByName(const std::string &deviceName)
+ScannerDeviceDescriptorPtr getDeviceByName(ScanServicePtr scanService, const std::string &deviceName)
 {
   for (const auto &device : scanService->getAvailableScanners())
   {
@@ -38,26 +214,154 @@ ScannerDeviceDescriptorPtr getDeviceByName(const std::string &deviceName)
 }
 
 /**
- * Access the list of existing scanners
+ * Create the javascript list of the scanner names
  */
-void getScanners(const FunctionCallbackInfo<Value> &args)
+Local<Array> createScannerList(Isolate *isolate, const std::vector<ScannerDeviceDescriptorPtr> &devices)
 {
-  Isolate *isolate = args.GetIsolate();
   Local<Array> deviceNames = Array::New(isolate);
 
   unsigned int i = 0;
-  for (const auto &device : scanService->getAvailableScanners())
+  for (const auto &device : devices)
   {
     deviceNames->Set(i++, String::NewFromUtf8(isolate, device->descriptor.c_str()));
   }
+  return deviceNames;
+}
+
+/**
+ * Access the list of existing scanners
+ */
+void getScanners(const FunctionCallbackInfo<Value> &args)
+{
+  Isolate *isolate = args.GetIsolate();
+  ScanServicePtr scanService = getAddon(args).getScanService();
+  args.GetReturnValue().Set(createScannerList(isolate, scanService->getAvailableScanners()));
+}
+
+/**
+ * The async resource of a request: its promise is settled (& its callbacks are called) in the resource's callback scope,
+ * so that the continuations (then, await) run right away, like after any other callback from node
+ */
+class RequestResource : public node::AsyncResource
+{
+public:
+  RequestResource(Isolate *isolate, const char *name)
+      : node::AsyncResource(isolate, Object::New(isolate), name)
+  {
+  }
+
+  /**
+   * Enter the callback scope (on the javascript thread, within a handle scope), the microtasks run when it is left
+   */
+  class Scope : public node::AsyncResource::CallbackScope
+  {
+  public:
+    explicit Scope(RequestResource &resource)
+        : CallbackScope(&resource)
+    {
+    }
+  };
+};
+
+/**
+ * State of a warmup running on the libuv thread pool
+ */
+struct WarmupRequest : public InFlightRequest
+{
+  uv_work_t work;
+  Isolate *isolate;
+  std::unique_ptr<RequestResource> resource;
+  Persistent<Promise::Resolver> resolver;
+
+  std::vector<ScannerDeviceDescriptorPtr> devices;
+  std::string error;
+
+  virtual void abandon()
+  {
+    // the warmup cannot be cancelled, it runs to its end
+    resolver.Reset();
+  }
+};
+
+void runWarmup(uv_work_t *work)
+{
+  WarmupRequest *request = static_cast<WarmupRequest *>(work->data);
+  try
+  {
+    // a first use by warmup waits for the service here, off the javascript thread
+    ScanServicePtr scanService = request->addon->getScanService();
+    scanService->warmup();
+    request->devices = scanService->getAvailableScanners();
+  }
+  catch (const std::exception &exception)
+  {
+    request->error = exception.what();
+  }
+}
+
+void completeWarmup(uv_work_t *work, int status)
+{
+  WarmupRequest *request = static_cast<WarmupRequest *>(work->data);
+  if (request->abandoned)
+  {
+    delete request;
+    return;
+  }
+  Isolate *isolate = request->isolate;
+  v8::HandleScope scope(isolate);
+  RequestResource::Scope callbackScope(*request->resource);
+  Local<v8::Context> context = isolate->GetCurrentContext();
+  Local<Promise::Resolver> resolver = Local<Promise::Resolver>::New(isolate, request->resolver);
+
+  if (!request->error.empty())
+  {
+    resolver->Reject(context, Exception::Error(String::NewFromUtf8(isolate, request->error.c_str())));
+  }
+  else
+  {
+    resolver->Resolve(context, createScannerList(isolate, request->devices));
+  }
+
+  request->resolver.Reset();
+  delete request;
+}
+
+/**
+ * Initialise SANE & discover the scanners on a worker thread, so that later calls don't block on it.
+ * 
+ * Returns a promise, that resolves to the list of scanners (same as getScanners).
+ */
+void warmup(const FunctionCallbackInfo<Value> &args)
+{
+  Isolate *isolate = args.GetIsolate();
+  AddonInstance &addon = getAddon(args);
+  Local<Promise::Resolver> resolver = Promise::Resolver::New(isolate->GetCurrentContext()).ToLocalChecked();
+
+  WarmupRequest *request = new WarmupRequest();
+  request->work.data = request;
+  request->isolate = isolate;
+  request->resource.reset(new RequestResource(isolate, "scanahedron:warmup"));
+  request->resolver.Reset(isolate, resolver);
+  addon.track(request);
 
-  args.GetReturnValue().Set(deviceNames);
+  uv_queue_work(addon.loop, &request->work, runWarmup, completeWarmup);
+  args.GetReturnValue().Set(resolver->GetPromise());
+}
+
+/**
+ * The job of a synchronous call: it runs on the javascript thread, so it fails on a busy device instead of waiting
+ * (a polled scan is driven by this very event loop, it would never give up the device)
+ */
+ScanJob createCallJob(ScanJob job = ScanJob(JobPriority::Interactive))
+{
+  job.waitForTurn = false;
+  return job;
 }
 
 /**
  * Get a scanner descriptor out of the data in the given argument (device name)
  */
-ScannerDeviceDescriptorPtr getDeviceDescriptor(Isolate *isolate, Local<Value> argument)
+ScannerDeviceDescriptorPtr getDeviceDescriptor(Isolate *isolate, ScanServicePtr scanService, Local<Value> argument)
 {
 
   ScannerDeviceDescriptorPtr usedDevice = nullptr;
@@ -65,7 +369,7 @@ ScannerDeviceDescriptorPtr getDeviceDescriptor(Isolate *isolate, Local<Value> ar
   {
     v8::String::Utf8Value paramDeviceName(argument);
     std::string deviceName = std::string(*paramDeviceName);
-    usedDevice = getDeviceByName(deviceName);
+    usedDevice = getDeviceByName(scanService, deviceName);
     if (usedDevice == nullptr)
     {
       isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "Scanner with the given name not found!")));
@@ -92,13 +396,23 @@ ScannerDeviceDescriptorPtr getDeviceDescriptor(Isolate *isolate, Local<Value> ar
 void getCapabilities(const FunctionCallbackInfo<Value> &args)
 {
   Isolate *isolate = args.GetIsolate();
-  ScannerDeviceDescriptorPtr usedDevice = getDeviceDescriptor(isolate, args[0]);
+  ScanServicePtr scanService = getAddon(args).getScanService();
+  ScannerDeviceDescriptorPtr usedDevice = getDeviceDescriptor(isolate, scanService, args[0]);
   if (usedDevice == nullptr)
   {
     return;
   }
 
-  ScannerCapabilities capabilities = scanService->getCapabilities(usedDevice);
+  ScannerCapabilities capabilities;
+  try
+  {
+    capabilities = scanService->getCapabilities(usedDevice, createCallJob());
+  }
+  catch (const std::exception &exception)
+  {
+    isolate->ThrowException(Exception::Error(String::NewFromUtf8(isolate, exception.what())));
+    return;
+  }
 
   Local<Object> obj = Object::New(isolate);
   obj->Set(String::NewFromUtf8(isolate, "minX"), Number::New(isolate, capabilities.minX));
@@ -151,13 +465,23 @@ void getCapabilities(const FunctionCallbackInfo<Value> &args)
 void getConfiguration(const FunctionCallbackInfo<Value> &args)
 {
   Isolate *isolate = args.GetIsolate();
-  ScannerDeviceDescriptorPtr usedDevice = getDeviceDescriptor(isolate, args[0]);
+  ScanServicePtr scanService = getAddon(args).getScanService();
+  ScannerDeviceDescriptorPtr usedDevice = getDeviceDescriptor(isolate, scanService, args[0]);
   if (usedDevice == nullptr)
   {
     return;
   }
 
-  ScannerConfiguration configuration = scanService->getConfiguration(usedDevice);
+  ScannerConfiguration configuration;
+  try
+  {
+    configuration = scanService->getConfiguration(usedDevice, createCallJob());
+  }
+  catch (const std::exception &exception)
+  {
+    isolate->ThrowException(Exception::Error(String::NewFromUtf8(isolate, exception.what())));
+    return;
+  }
 
   Local<Object> obj = Object::New(isolate);
   obj->Set(String::NewFromUtf8(isolate, "fromX"), Number::New(isolate, configuration.fromX));
@@ -183,11 +507,13 @@ void getConfiguration(const FunctionCallbackInfo<Value> &args)
  *     - resolutionInDPI
  *     - source
  *     - mode
+ * Missing fields keep their value, only changed options are written to the scanner.
  */
 void setConfiguration(const FunctionCallbackInfo<Value> &args)
 {
   Isolate *isolate = args.GetIsolate();
-  ScannerDeviceDescriptorPtr usedDevice = getDeviceDescriptor(isolate, args[0]);
+  ScanServicePtr scanService = getAddon(args).getScanService();
+  ScannerDeviceDescriptorPtr usedDevice = getDeviceDescriptor(isolate, scanService, args[0]);
   if (usedDevice == nullptr)
   {
     return;
@@ -199,7 +525,8 @@ void setConfiguration(const FunctionCallbackInfo<Value> &args)
     return;
   }
 
-  ScannerConfiguration configuration = scanService->getConfiguration(usedDevice);
+  // Fields that are not given keep their value (the defaults mean "unchanged"), so no read is needed first
+  ScannerConfiguration configuration;
 
   Local<Object> obj = args[1]->ToObject();
   if (obj->Has(String::NewFromUtf8(isolate, "fromX")))
@@ -233,7 +560,197 @@ void setConfiguration(const FunctionCallbackInfo<Value> &args)
     configuration.mode = *mode;
   }
 
-  scanService->setConfiguration(usedDevice, configuration);
+  try
+  {
+    scanService->setConfiguration(usedDevice, configuration, createCallJob());
+  }
+  catch (const std::exception &exception)
+  {
+    isolate->ThrowException(Exception::Error(String::NewFromUtf8(isolate, exception.what())));
+  }
+}
+
+/**
+ * Read the optional encoder options dict:
+ *  - compressionLevel (0 - 9)
+ *  - threads (number of threads compressing the image)
+ *  - format ("png", "pnm", "tiff" or "jpeg", by default taken from the file extension)
+ *  - quality (JPEG quality, 1 - 100)
+ *  - tiffCompression ("none", "lzw" or "deflate")
+ */
+EncoderOptions getEncoderOptions(Isolate *isolate, Local<Value> argument)
+{
+  EncoderOptions options;
+  if (!argument->IsObject())
+  {
+    return options;
+  }
+  Local<Object> obj = argument->ToObject();
+  if (obj->Has(String::NewFromUtf8(isolate, "compressionLevel")))
+  {
+    options.compressionLevel = obj->Get(String::NewFromUtf8(isolate, "compressionLevel"))->Int32Value();
+  }
+  if (obj->Has(String::NewFromUtf8(isolate, "threads")))
+  {
+    options.threads = obj->Get(String::NewFromUtf8(isolate, "threads"))->Uint32Value();
+  }
+  if (obj->Has(String::NewFromUtf8(isolate, "format")))
+  {
+    v8::String::Utf8Value format(obj->Get(String::NewFromUtf8(isolate, "format"))->ToString());
+    options.format = *format;
+  }
+  if (obj->Has(String::NewFromUtf8(isolate, "quality")))
+  {
+    options.quality = obj->Get(String::NewFromUtf8(isolate, "quality"))->Int32Value();
+  }
+  if (obj->Has(String::NewFromUtf8(isolate, "tiffCompression")))
+  {
+    v8::String::Utf8Value compression(obj->Get(String::NewFromUtf8(isolate, "tiffCompression"))->ToString());
+    std::string name = *compression;
+    options.tiffCompression = name == "none" ? EncoderOptions::TiffNone : name == "lzw" ? EncoderOptions::TiffLzw : EncoderOptions::TiffDeflate;
+  }
+  return options;
+}
+
+/**
+ * Read the blank page detection from the options of a batch (skipBlankPages, inkThreshold & maximumInkCoverage)
+ */
+BlankPageOptions getBlankPageOptions(Isolate *isolate, Local<Value> argument)
+{
+  BlankPageOptions options;
+  if (!argument->IsObject())
+  {
+    return options;
+  }
+  Local<Object> obj = argument->ToObject();
+  if (obj->Has(String::NewFromUtf8(isolate, "skipBlankPages")))
+  {
+    options.skip = obj->Get(String::NewFromUtf8(isolate, "skipBlankPages"))->BooleanValue();
+  }
+  if (obj->Has(String::NewFromUtf8(isolate, "inkThreshold")))
+  {
+    options.inkThreshold = static_cast<unsigned char>(std::min(255u, obj->Get(String::NewFromUtf8(isolate, "inkThreshold"))->Uint32Value()));
+  }
+  if (obj->Has(String::NewFromUtf8(isolate, "maximumInkCoverage")))
+  {
+    options.maximumInkCoverage = obj->Get(String::NewFromUtf8(isolate, "maximumInkCoverage"))->NumberValue();
+  }
+  return options;
+}
+
+/**
+ * Read where the pixels of a scanned image live from the javascript options:
+ *  - mapped (optional boolean), keep the pixels in a memory mapped temporary file, that the kernel may page out
+ *  - file (optional string), the mapped file to keep the pixels in (implies mapped), it is kept after the image is released
+ */
+ImageStorage getImageStorage(Isolate *isolate, Local<Value> argument)
+{
+  ImageStorage storage;
+  if (!argument->IsObject())
+  {
+    return storage;
+  }
+  Local<Object> obj = argument->ToObject();
+  if (obj->Has(String::NewFromUtf8(isolate, "mapped")))
+  {
+    storage.mapped = obj->Get(String::NewFromUtf8(isolate, "mapped"))->BooleanValue();
+  }
+  if (obj->Has(String::NewFromUtf8(isolate, "file")))
+  {
+    v8::String::Utf8Value file(obj->Get(String::NewFromUtf8(isolate, "file"))->ToString());
+    storage.path = std::string(*file);
+    storage.mapped = true;
+  }
+  return storage;
+}
+
+/**
+ * Read the priority of a scan job from the javascript options:
+ *  - priority (optional string): "interactive", "normal" or "batch"
+ */
+JobPriority getJobPriority(Isolate *isolate, Local<Value> argument, JobPriority defaultPriority)
+{
+  if (!argument->IsObject() || !argument->ToObject()->Has(String::NewFromUtf8(isolate, "priority")))
+  {
+    return defaultPriority;
+  }
+  v8::String::Utf8Value priority(argument->ToObject()->Get(String::NewFromUtf8(isolate, "priority"))->ToString());
+  std::string name(*priority);
+  if (name == "interactive")
+  {
+    return JobPriority::Interactive;
+  }
+  if (name == "batch")
+  {
+    return JobPriority::Batch;
+  }
+  return JobPriority::Normal;
+}
+
+/**
+ * Create the job of a scan from the javascript options:
+ *  - priority (optional string, see getJobPriority)
+ *  - timeline (optional bool), record where the time of the scan went, the result carries the timeline (see createTimelineObject)
+ */
+ScanJob createScanJob(Isolate *isolate, ScanServicePtr scanService, Local<Value> argument, JobPriority defaultPriority, const char *operation)
+{
+  ScanJob job(getJobPriority(isolate, argument, defaultPriority), scanService->createJobId());
+  if (argument->IsObject() && argument->ToObject()->Get(String::NewFromUtf8(isolate, "timeline"))->BooleanValue())
+  {
+    job.timeline = std::make_shared<ScanTimeline>(operation, job.id);
+  }
+  return job;
+}
+
+/**
+ * Convert the timeline of a scan to a dict:
+ *  - queueTime, startTime, readTime, unpackTime, encodeTime, finishTime & totalTime (in ms, see ScanTimings)
+ *  - bytesRead, readCalls & largestReadGap (the longest wait for the scanner's data, in ms)
+ *  - encodedBytes & encodeThroughput (MB/s)
+ */
+Local<Object> createTimelineObject(Isolate *isolate, const ScanTimeline &timeline)
+{
+  ScanTimings timings = timeline.getTimings();
+  Local<Object> obj = Object::New(isolate);
+  obj->Set(String::NewFromUtf8(isolate, "queueTime"), Number::New(isolate, timings.queueTime));
+  obj->Set(String::NewFromUtf8(isolate, "startTime"), Number::New(isolate, timings.startTime));
+  obj->Set(String::NewFromUtf8(isolate, "readTime"), Number::New(isolate, timings.readTime));
+  obj->Set(String::NewFromUtf8(isolate, "unpackTime"), Number::New(isolate, timings.unpackTime));
+  obj->Set(String::NewFromUtf8(isolate, "encodeTime"), Number::New(isolate, timings.encodeTime));
+  obj->Set(String::NewFromUtf8(isolate, "finishTime"), Number::New(isolate, timings.finishTime));
+  obj->Set(String::NewFromUtf8(isolate, "totalTime"), Number::New(isolate, timings.totalTime));
+  obj->Set(String::NewFromUtf8(isolate, "bytesRead"), Number::New(isolate, static_cast<double>(timings.bytesRead)));
+  obj->Set(String::NewFromUtf8(isolate, "readCalls"), Number::New(isolate, static_cast<double>(timings.readCalls)));
+  obj->Set(String::NewFromUtf8(isolate, "largestReadGap"), Number::New(isolate, timings.largestReadGap));
+  obj->Set(String::NewFromUtf8(isolate, "encodedBytes"), Number::New(isolate, static_cast<double>(timings.encodedBytes)));
+  obj->Set(String::NewFromUtf8(isolate, "encodeThroughput"), Number::New(isolate, timings.getEncodeThroughput()));
+  return obj;
+}
+
+/**
+ * Add the job's timeline (if it recorded one) to the result object of its scan
+ */
+void setTimeline(Isolate *isolate, Local<Object> result, const ScanJob &job)
+{
+  if (job.timeline)
+  {
+    result->Set(String::NewFromUtf8(isolate, "timeline"), createTimelineObject(isolate, *job.timeline));
+  }
+}
+
+/**
+ * The result of a scan to a file: true if the file was stored, a dict with stored & timeline, if the job recorded a timeline
+ */
+Local<Value> createStoredResult(Isolate *isolate, bool stored, const ScanJob &job)
+{
+  if (!job.timeline)
+  {
+    return Boolean::New(isolate, stored);
+  }
+  Local<Object> obj = Object::New(isolate);
+  obj->Set(String::NewFromUtf8(isolate, "stored"), Boolean::New(isolate, stored));
+  setTimeline(isolate, obj, job);
+  return obj;
 }
 
 /**
@@ -242,10 +759,14 @@ void setConfiguration(const FunctionCallbackInfo<Value> &args)
  * Expects javascript arguments: 
  *  - deviceName (string)
  *  - fileName (string)
+ *  - options (optional dict with format, compressionLevel, threads, quality & tiffCompression, and timeline, see createScanJob)
+ * 
+ * Returns true if the file was stored, resp. a dict with stored & timeline, if a timeline was requested.
  */
 void scanToFile(const FunctionCallbackInfo<Value> &args)
 {
   Isolate *isolate = args.GetIsolate();
+  ScanServicePtr scanService = getAddon(args).getScanService();
   if (args.Length() != 2 && !(args[0]->IsString() || args[0]->IsNull()) && !args[1]->IsString())
   {
     isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "Expecting: scanToFile(deviceName:string, filepath:string)")));
@@ -255,15 +776,96 @@ void scanToFile(const FunctionCallbackInfo<Value> &args)
   v8::String::Utf8Value paramFilePath(args[1]);
   std::string filePath = std::string(*paramFilePath);
 
-  ScannerDeviceDescriptorPtr usedDevice = getDeviceDescriptor(isolate, args[0]);
+  ScannerDeviceDescriptorPtr usedDevice = getDeviceDescriptor(isolate, scanService, args[0]);
   if (usedDevice == nullptr)
   {
     return;
   }
 
-  bool result = scanService->scanToFile(usedDevice, filePath);
+  ScanJob job = createCallJob(createScanJob(isolate, scanService, args[2], JobPriority::Normal, "scanToFile"));
+  bool result = false;
+  try
+  {
+    result = scanService->scanToFile(usedDevice, filePath, getEncoderOptions(isolate, args[2]), job);
+  }
+  catch (const std::exception &exception)
+  {
+    isolate->ThrowException(Exception::Error(String::NewFromUtf8(isolate, exception.what())));
+    return;
+  }
+
+  args.GetReturnValue().Set(createStoredResult(isolate, result, job));
+}
+
+/**
+ * Keeps a raw image alive as long as a javascript buffer references its pixels
+ */
+struct PixelOwnership
+{
+  RawImagePtr image;
+  Isolate *isolate;
+  int64_t bytes;
+};
+
+/**
+ * Called when the javascript buffer was garbage collected: release the raw image.
+ */
+void releasePixels(char *data, void *hint)
+{
+  PixelOwnership *ownership = static_cast<PixelOwnership *>(hint);
+  ownership->isolate->AdjustAmountOfExternalAllocatedMemory(-ownership->bytes);
+  delete ownership;
+}
+
+/**
+ * Wrap the pixels of a raw image in a javascript buffer without copying them.
+ * The buffer owns the raw image until it is garbage collected, the memory is reported to V8
+ * (mapped pixels too, they may be paged in).
+ * Returns null for images beyond the largest possible buffer, their pixels are only available in their file.
+ */
+Local<Value> wrapPixels(Isolate *isolate, RawImagePtr rawImage)
+{
+  size_t bytes = rawImage->bytesPerRow * rawImage->height;
+  if (bytes > node::Buffer::kMaxLength)
+  {
+    return Null(isolate);
+  }
+
+  PixelOwnership *ownership = new PixelOwnership();
+  ownership->image = rawImage;
+  ownership->isolate = isolate;
+  ownership->bytes = static_cast<int64_t>(bytes);
+  isolate->AdjustAmountOfExternalAllocatedMemory(ownership->bytes);
+  return node::Buffer::New(isolate, reinterpret_cast<char *>(rawImage->pixels), bytes, releasePixels, ownership).ToLocalChecked();
+}
+
+/**
+ * Describe the pixel layout: format (gray1, gray8, gray16, rgb8 or rgb16), bytesPerPixel (0 for lineart) & bytesPerRow
+ */
+void setPixelFormat(Isolate *isolate, Local<Object> obj, PixelFormat format, unsigned int width)
+{
+  obj->Set(String::NewFromUtf8(isolate, "format"), String::NewFromUtf8(isolate, getFormatName(format)));
+  obj->Set(String::NewFromUtf8(isolate, "bytesPerPixel"), Uint32::New(isolate, getBytesPerPixel(format)));
+  obj->Set(String::NewFromUtf8(isolate, "bytesPerRow"), Number::New(isolate, static_cast<double>(getBytesPerRow(format, width))));
+}
+
+/**
+ * Convert a raw image to the javascript result object of the scanToBuffer functions.
+ */
+Local<Object> createImageObject(Isolate *isolate, RawImagePtr rawImage)
+{
+  Local<Value> pixels = wrapPixels(isolate, rawImage);
 
-  args.GetReturnValue().Set(Boolean::New(isolate, result));
+  Local<Object> obj = Object::New(isolate);
+  obj->Set(String::NewFromUtf8(isolate, "width"), Uint32::New(isolate, rawImage->width));
+  obj->Set(String::NewFromUtf8(isolate, "height"), Uint32::New(isolate, rawImage->height));
+  setPixelFormat(isolate, obj, rawImage->format, rawImage->width);
+  obj->Set(String::NewFromUtf8(isolate, "pixels"), pixels);
+  if (rawImage->mapping && !rawImage->mapping->isTemporary())
+  {
+    obj->Set(String::NewFromUtf8(isolate, "file"), String::NewFromUtf8(isolate, rawImage->getFilePath().c_str()));
+  }
+  return obj;
 }
 
 /**
@@ -271,52 +873,1238 @@ void scanToFile(const FunctionCallbackInfo<Value> &args)
  * 
  * Expects javascript arguments: 
  *  - deviceName (string)
+ *  - options (optional dict with mapped & file, see getImageStorage, and timeline, see createScanJob)
  * 
  * The result is a dict with the following data:
  * - width (in pixel)
  * - pixel (in pixel)
- * - bytesPerPixel
- * - pixel[] (Uint8Array with the RGB pixel data (line by line))
+ * - format, bytesPerPixel & bytesPerRow (the pixels are kept in the scan mode's format, e.g. "gray8" or "rgb16")
+ * - pixel[] (Buffer with the pixel data (line by line), owning the scanned memory; null if the image is too large for a Buffer)
+ * - file (the file holding the raw pixels, if one was given)
+ * - timeline (if requested, see createTimelineObject)
  */
 void scanToBuffer(const FunctionCallbackInfo<Value> &args)
 {
   Isolate *isolate = args.GetIsolate();
-  ScannerDeviceDescriptorPtr usedDevice = getDeviceDescriptor(isolate, args[0]);
+  ScanServicePtr scanService = getAddon(args).getScanService();
+  ScannerDeviceDescriptorPtr usedDevice = getDeviceDescriptor(isolate, scanService, args[0]);
   if (usedDevice == nullptr)
   {
     return;
   }
 
-  RawImagePtr rawImage = scanService->scanToBuffer(usedDevice);
-  auto bytes = rawImage->width * rawImage->height * rawImage->bytesPerPixel;
-  v8::Local<v8::ArrayBuffer> buffer = v8::ArrayBuffer::New(isolate, rawImage->pixels, bytes);
-  v8::Local<v8::Uint8Array> array = v8::Uint8Array::New(buffer, 0, bytes);
-
-  Local<Object> obj = Object::New(isolate);
-  obj->Set(String::NewFromUtf8(isolate, "width"), Uint32::New(isolate, rawImage->width));
-  obj->Set(String::NewFromUtf8(isolate, "height"), Uint32::New(isolate, rawImage->height));
-  obj->Set(String::NewFromUtf8(isolate, "bytesPerPixel"), Uint32::New(isolate, rawImage->bytesPerPixel));
-  obj->Set(String::NewFromUtf8(isolate, "pixels"), array);
+  ScanJob job = createCallJob(createScanJob(isolate, scanService, args[1], JobPriority::Normal, "scanToBuffer"));
+  RawImagePtr rawImage;
+  try
+  {
+    rawImage = scanService->scanToBuffer(usedDevice, getImageStorage(isolate, args[1]), job);
+  }
+  catch (const std::exception &exception)
+  {
+    isolate->ThrowException(Exception::Error(String::NewFromUtf8(isolate, exception.what())));
+    return;
+  }
+  Local<Object> image = createImageObject(isolate, rawImage);
+  setTimeline(isolate, image, job);
+  args.GetReturnValue().Set(image);
+}
+
+/**
+ * Access the counters of the backend traffic:
+ *  - optionWrites (options written to the backend)
+ *  - skippedOptionWrites (writes saved, because the option already had the value)
+ */
+void getStatistics(const FunctionCallbackInfo<Value> &args)
+{
+  Isolate *isolate = args.GetIsolate();
+  ScanServicePtr scanService = getAddon(args).getScanService();
+  ScannerStatistics statistics = scanService->getStatistics();
+
+  Local<Object> obj = Object::New(isolate);
+  obj->Set(String::NewFromUtf8(isolate, "optionWrites"), Number::New(isolate, static_cast<double>(statistics.optionWrites)));
+  obj->Set(String::NewFromUtf8(isolate, "skippedOptionWrites"), Number::New(isolate, static_cast<double>(statistics.skippedOptionWrites)));
   args.GetReturnValue().Set(obj);
 }
 
 /**
- * Setup the interface / scanner service
+ * Cancel a queued or running scan: a waiting scan never starts, a running one stops mid-read.
+ * The promise of the scan is rejected.
+ * 
+ * Expects javascript arguments: 
+ *  - jobId (number, the jobId of the scan's promise)
+ * 
+ * Returns true, if the job was still queued or running.
+ */
+void cancelJob(const FunctionCallbackInfo<Value> &args)
+{
+  Isolate *isolate = args.GetIsolate();
+  ScanServicePtr scanService = getAddon(args).getScanService();
+  if (args.Length() < 1 || !args[0]->IsNumber())
+  {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "Expecting: cancelJob(jobId:number)")));
+    return;
+  }
+  bool cancelled = scanService->cancelJob(static_cast<unsigned long long>(args[0]->NumberValue()));
+  args.GetReturnValue().Set(Boolean::New(isolate, cancelled));
+}
+
+/**
+ * Access the job queue of a device:
+ *  - depth (scans waiting for the device), busy (a scan is running)
+ *  - startedJobs, cancelledJobs
+ *  - averageWaitTime, maximumWaitTime (time the started jobs waited for the device, in ms)
+ * 
+ * Expects javascript arguments: 
+ *  - deviceName (string, null for the default scanner)
+ */
+void getQueueStatistics(const FunctionCallbackInfo<Value> &args)
+{
+  Isolate *isolate = args.GetIsolate();
+  ScanServicePtr scanService = getAddon(args).getScanService();
+  ScannerDeviceDescriptorPtr usedDevice = getDeviceDescriptor(isolate, scanService, args[0]);
+  if (usedDevice == nullptr && !args[0]->IsNull())
+  {
+    return;
+  }
+  QueueStatistics statistics = scanService->getQueueStatistics(usedDevice);
+
+  Local<Object> obj = Object::New(isolate);
+  obj->Set(String::NewFromUtf8(isolate, "depth"), Uint32::New(isolate, statistics.depth));
+  obj->Set(String::NewFromUtf8(isolate, "busy"), Boolean::New(isolate, statistics.busy));
+  obj->Set(String::NewFromUtf8(isolate, "startedJobs"), Number::New(isolate, static_cast<double>(statistics.startedJobs)));
+  obj->Set(String::NewFromUtf8(isolate, "cancelledJobs"), Number::New(isolate, static_cast<double>(statistics.cancelledJobs)));
+  obj->Set(String::NewFromUtf8(isolate, "averageWaitTime"), Number::New(isolate, statistics.getAverageWaitTime()));
+  obj->Set(String::NewFromUtf8(isolate, "maximumWaitTime"), Number::New(isolate, statistics.maximumWaitTime));
+  args.GetReturnValue().Set(obj);
+}
+
+/**
+ * Access the counters of the pool the image pixels are allocated from:
+ *  - hits & misses (pooled allocations served from a cached buffer / from fresh memory)
+ *  - unpooled (small allocations served by the heap), evictions (released buffers dropped, because the pool was full)
+ *  - cachedBuffers, cachedBytes & usedBytes
+ */
+void getBufferPoolStatistics(const FunctionCallbackInfo<Value> &args)
+{
+  Isolate *isolate = args.GetIsolate();
+  BufferPoolStatistics statistics = BufferPool::getDefault().getStatistics();
+
+  Local<Object> obj = Object::New(isolate);
+  obj->Set(String::NewFromUtf8(isolate, "hits"), Number::New(isolate, static_cast<double>(statistics.hits)));
+  obj->Set(String::NewFromUtf8(isolate, "misses"), Number::New(isolate, static_cast<double>(statistics.misses)));
+  obj->Set(String::NewFromUtf8(isolate, "unpooled"), Number::New(isolate, static_cast<double>(statistics.unpooled)));
+  obj->Set(String::NewFromUtf8(isolate, "evictions"), Number::New(isolate, static_cast<double>(statistics.evictions)));
+  obj->Set(String::NewFromUtf8(isolate, "cachedBuffers"), Number::New(isolate, static_cast<double>(statistics.cachedBuffers)));
+  obj->Set(String::NewFromUtf8(isolate, "cachedBytes"), Number::New(isolate, static_cast<double>(statistics.cachedBytes)));
+  obj->Set(String::NewFromUtf8(isolate, "usedBytes"), Number::New(isolate, static_cast<double>(statistics.usedBytes)));
+  args.GetReturnValue().Set(obj);
+}
+
+/**
+ * Configure the pool of the image pixels.
+ * 
+ * Expects javascript arguments: 
+ *  - options (dict) with
+ *    - capacity (optional number), the bytes of released buffers kept for reuse (0 disables the pool)
+ *    - hugePages (optional boolean), advise new buffers to use transparent huge pages
+ */
+void configureBufferPool(const FunctionCallbackInfo<Value> &args)
+{
+  Isolate *isolate = args.GetIsolate();
+  if (args.Length() < 1 || !args[0]->IsObject())
+  {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "Expecting: configureBufferPool(options:object)")));
+    return;
+  }
+  Local<Object> obj = args[0]->ToObject();
+  if (obj->Has(String::NewFromUtf8(isolate, "capacity")))
+  {
+    BufferPool::getDefault().setCapacity(static_cast<size_t>(std::max(0.0, obj->Get(String::NewFromUtf8(isolate, "capacity"))->NumberValue())));
+  }
+  if (obj->Has(String::NewFromUtf8(isolate, "hugePages")))
+  {
+    BufferPool::getDefault().setHugePages(obj->Get(String::NewFromUtf8(isolate, "hugePages"))->BooleanValue());
+  }
+}
+
+/**
+ * Append the timeline of every scan to a file as Chrome trace events (open it with chrome://tracing or Perfetto).
+ * 
+ * Expects javascript arguments: 
+ *  - path (string, null stops the tracing)
+ */
+void setTraceFile(const FunctionCallbackInfo<Value> &args)
+{
+  Isolate *isolate = args.GetIsolate();
+  ScanServicePtr scanService = getAddon(args).getScanService();
+  if (args.Length() < 1 || !(args[0]->IsString() || args[0]->IsNull()))
+  {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "Expecting: setTraceFile(path:string)")));
+    return;
+  }
+  std::string path;
+  if (args[0]->IsString())
+  {
+    v8::String::Utf8Value paramPath(args[0]);
+    path = std::string(*paramPath);
+  }
+  scanService->setTraceFile(path);
+}
+
+/**
+ * Give the cached pixel buffers back to the system, e.g. after a batch of scans.
+ * 
+ * Expects javascript arguments: 
+ *  - keepBytes (optional number), the bytes to keep cached (default 0)
+ */
+void trimBufferPool(const FunctionCallbackInfo<Value> &args)
+{
+  double keepBytes = args.Length() > 0 && args[0]->IsNumber() ? args[0]->NumberValue() : 0.0;
+  BufferPool::getDefault().trim(static_cast<size_t>(std::max(0.0, keepBytes)));
+}
+
+/**
+ * The promise of a queued scan, it carries the jobId to cancel the scan with cancelJob
+ */
+Local<Promise> createJobPromise(Isolate *isolate, Local<Promise::Resolver> resolver, unsigned long long jobId)
+{
+  Local<Promise> promise = resolver->GetPromise();
+  promise->Set(String::NewFromUtf8(isolate, "jobId"), Number::New(isolate, static_cast<double>(jobId)));
+  return promise;
+}
+
+/**
+ * State of a scan running on the libuv thread pool.
+ * Everything except the resolver is touched by the worker thread only.
+ */
+struct AsyncScanRequest : public InFlightRequest
+{
+  enum Kind
+  {
+    ToBuffer,
+    ToFile,
+    Batch,
+    Items
+  };
+
+  uv_work_t work;
+  Isolate *isolate;
+  std::unique_ptr<RequestResource> resource;
+  Persistent<Promise::Resolver> resolver;
+  ScanServicePtr scanService;
+
+  ScannerDeviceDescriptorPtr device;
+  std::string filePath;
+  EncoderOptions options;
+  ImageStorage storage;
+  ScanJob job;
+  Kind kind = ToBuffer;
+
+  RawImagePtr image;
+  bool stored = false;
+  BlankPageOptions blankPages;
+  std::vector<ScannedPage> pages;
+  std::vector<ItemBounds> items;
+  std::string error;
+
+  virtual void abandon()
+  {
+    // the work fails right away (or it is not queued at all, see TurnRequest)
+    scanService->cancelJob(job.id);
+    resolver.Reset();
+  }
+};
+
+/**
+ * Runs on the worker thread: scan (and encode, if a file path is given).
+ */
+void runAsyncScan(uv_work_t *work)
+{
+  AsyncScanRequest *request = static_cast<AsyncScanRequest *>(work->data);
+  try
+  {
+    switch (request->kind)
+    {
+    case AsyncScanRequest::ToBuffer:
+      request->image = request->scanService->scanToBuffer(request->device, request->storage, request->job);
+      break;
+    case AsyncScanRequest::ToFile:
+      request->stored = request->scanService->scanToFile(request->device, request->filePath, request->options, request->job);
+      break;
+    case AsyncScanRequest::Batch:
+      request->pages = request->scanService->scanBatchToFiles(request->device, request->filePath, request->options, request->blankPages, request->job);
+      break;
+    case AsyncScanRequest::Items:
+      request->items = request->scanService->scanItems(request->device, request->filePath, request->options, ItemDetectorOptions(), request->job);
+      break;
+    }
+  }
+  catch (const std::exception &exception)
+  {
+    request->error = exception.what();
+  }
+  request->scanService->releaseJob(request->job.id);
+}
+
+/**
+ * Runs on the javascript thread after the worker is done: settle the promise.
+ */
+void completeAsyncScan(uv_work_t *work, int status)
+{
+  AsyncScanRequest *request = static_cast<AsyncScanRequest *>(work->data);
+  if (request->abandoned)
+  {
+    delete request;
+    return;
+  }
+  Isolate *isolate = request->isolate;
+  v8::HandleScope scope(isolate);
+  RequestResource::Scope callbackScope(*request->resource);
+  Local<v8::Context> context = isolate->GetCurrentContext();
+  Local<Promise::Resolver> resolver = Local<Promise::Resolver>::New(isolate, request->resolver);
+
+  if (status == UV_ECANCELED)
+  {
+    request->error = "Scan was cancelled.";
+  }
+
+  if (!request->error.empty())
+  {
+    resolver->Reject(context, Exception::Error(String::NewFromUtf8(isolate, request->error.c_str())));
+  }
+  else if (request->kind == AsyncScanRequest::Batch)
+  {
+    Local<Array> pages = Array::New(isolate);
+    for (unsigned int i = 0; i < request->pages.size(); ++i)
+    {
+      const ScannedPage &scannedPage = request->pages[i];
+      Local<Object> page = Object::New(isolate);
+      page->Set(String::NewFromUtf8(isolate, "page"), Uint32::New(isolate, scannedPage.number));
+      if (!scannedPage.path.empty())
+      {
+        page->Set(String::NewFromUtf8(isolate, "file"), String::NewFromUtf8(isolate, scannedPage.path.c_str()));
+      }
+      page->Set(String::NewFromUtf8(isolate, "blank"), Boolean::New(isolate, scannedPage.blank));
+      page->Set(String::NewFromUtf8(isolate, "inkCoverage"), Number::New(isolate, scannedPage.statistics.getInkCoverage()));
+      page->Set(String::NewFromUtf8(isolate, "mean"), Number::New(isolate, scannedPage.statistics.getMean()));
+      page->Set(String::NewFromUtf8(isolate, "deviation"), Number::New(isolate, scannedPage.statistics.getDeviation()));
+      pages->Set(i, page);
+    }
+    setTimeline(isolate, pages, request->job);
+    resolver->Resolve(context, pages);
+  }
+  else if (request->kind == AsyncScanRequest::Items)
+  {
+    Local<Array> items = Array::New(isolate);
+    for (unsigned int i = 0; i < request->items.size(); ++i)
+    {
+      const ItemBounds &bounds = request->items[i];
+      Local<Object> item = Object::New(isolate);
+      item->Set(String::NewFromUtf8(isolate, "x"), Uint32::New(isolate, bounds.x));
+      item->Set(String::NewFromUtf8(isolate, "y"), Uint32::New(isolate, bounds.y));
+      item->Set(String::NewFromUtf8(isolate, "width"), Uint32::New(isolate, bounds.width));
+      item->Set(String::NewFromUtf8(isolate, "height"), Uint32::New(isolate, bounds.height));
+      if (!request->filePath.empty())
+      {
+        item->Set(String::NewFromUtf8(isolate, "file"), String::NewFromUtf8(isolate, ScanService::getBatchPagePath(request->filePath, i + 1).c_str()));
+      }
+      items->Set(i, item);
+    }
+    setTimeline(isolate, items, request->job);
+    resolver->Resolve(context, items);
+  }
+  else if (request->kind == AsyncScanRequest::ToBuffer)
+  {
+    Local<Object> image = createImageObject(isolate, request->image);
+    setTimeline(isolate, image, request->job);
+    resolver->Resolve(context, image);
+  }
+  else
+  {
+    resolver->Resolve(context, createStoredResult(isolate, request->stored, request->job));
+  }
+
+  request->resolver.Reset();
+  delete request;
+}
+
+/**
+ * The async handle, that the turn of a job is signalled to from the thread that frees the device.
+ * Null once the handle is closed, so that a turn granted late does not reach a closed handle (or a torn down loop).
+ */
+struct TurnSignal
+{
+  std::mutex mutex;
+  uv_async_t *granted;
+
+  void send()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (granted)
+    {
+      uv_async_send(granted);
+    }
+  }
+
+  void close()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    granted = nullptr;
+  }
+};
+
+/**
+ * Work, that is queued on the libuv thread pool once it is its job's turn on the device (see ScanService::reserveJob),
+ * so that no thread of the pool is held while the job waits for the device
+ */
+struct TurnRequest : public InFlightRequest
+{
+  uv_async_t granted;
+  std::shared_ptr<TurnSignal> signal;
+  uv_loop_t *loop;
+  uv_work_t *work;
+  uv_work_cb run;
+  uv_after_work_cb complete;
+  ScanServicePtr scanService;
+  unsigned long long jobId;
+  bool queued = false;
+
+  virtual void abandon()
+  {
+    if (queued)
+    {
+      // the handle is closing already, the work completes on its own
+      return;
+    }
+    signal->close();
+    // a turn granted meanwhile is given back with the reservation
+    scanService->cancelJob(jobId);
+    scanService->releaseJob(jobId);
+    uv_close(reinterpret_cast<uv_handle_t *>(&granted), releaseTurnRequest);
+    complete(work, UV_ECANCELED);
+  }
+
+  static void releaseTurnRequest(uv_handle_t *handle)
+  {
+    delete static_cast<TurnRequest *>(handle->data);
+  }
+};
+
+void queueGrantedWork(uv_async_t *handle)
+{
+  TurnRequest *request = static_cast<TurnRequest *>(handle->data);
+  request->queued = true;
+  request->signal->close();
+  uv_queue_work(request->loop, request->work, request->run, request->complete);
+  uv_close(reinterpret_cast<uv_handle_t *>(handle), TurnRequest::releaseTurnRequest);
+}
+
+/**
+ * Queue the work of a job on the thread pool, once it is the job's turn on the device (or the job was cancelled).
+ * The work has to release the job's reservation, if its operation did not take it (see ScanService::releaseJob).
+ */
+void queueWorkOnTurn(AddonInstance &addon, ScanServicePtr scanService, ScannerDeviceDescriptorPtr device, const ScanJob &job,
+                     uv_work_t *work, uv_work_cb run, uv_after_work_cb complete)
+{
+  TurnRequest *request = new TurnRequest();
+  request->granted.data = request;
+  request->signal = std::make_shared<TurnSignal>();
+  request->signal->granted = &request->granted;
+  request->loop = addon.loop;
+  request->work = work;
+  request->run = run;
+  request->complete = complete;
+  request->scanService = scanService;
+  request->jobId = job.id;
+  uv_async_init(addon.loop, &request->granted, queueGrantedWork);
+  addon.track(request);
+
+  std::shared_ptr<TurnSignal> signal = request->signal;
+  try
+  {
+    // called on the thread that frees the device
+    scanService->reserveJob(device, job, [signal]() { signal->send(); });
+  }
+  catch (const std::exception &)
+  {
+    // e.g. there is no scanner: the work runs right away & fails with the same error
+    signal->send();
+  }
+}
+
+/**
+ * Queue a scan on the libuv thread pool and return the promise for its result.
+ */
+void queueAsyncScan(const FunctionCallbackInfo<Value> &args, AsyncScanRequest::Kind kind, ScannerDeviceDescriptorPtr device, const ScanJob &job, const std::string &filePath = std::string(),
+                    const EncoderOptions &options = EncoderOptions(), const BlankPageOptions &blankPages = BlankPageOptions(), const ImageStorage &storage = ImageStorage())
+{
+  Isolate *isolate = args.GetIsolate();
+  AddonInstance &addon = getAddon(args);
+  Local<Promise::Resolver> resolver = Promise::Resolver::New(isolate->GetCurrentContext()).ToLocalChecked();
+
+  AsyncScanRequest *request = new AsyncScanRequest();
+  request->work.data = request;
+  request->isolate = isolate;
+  request->resource.reset(new RequestResource(isolate, "scanahedron:scan"));
+  request->resolver.Reset(isolate, resolver);
+  request->scanService = addon.getScanService();
+  request->device = device;
+  request->filePath = filePath;
+  request->options = options;
+  request->kind = kind;
+  request->blankPages = blankPages;
+  request->storage = storage;
+  request->job = job;
+  addon.track(request);
+
+  queueWorkOnTurn(addon, request->scanService, device, request->job, &request->work, runAsyncScan, completeAsyncScan);
+  args.GetReturnValue().Set(createJobPromise(isolate, resolver, request->job.id));
+}
+
+/**
+ * State of a scan to a buffer, that is read on the javascript thread whenever the scanner's descriptor is readable (uv_poll),
+ * so that many scans share the event loop instead of blocking a thread each.
+ * Scans of backends without descriptor are read on the libuv thread pool instead.
+ */
+struct PolledScanRequest : public InFlightRequest
+{
+  uv_work_t work;
+  uv_poll_t poll;
+  bool polling = false;
+  int polledFd = -1;
+  bool complete = false;
+  uv_loop_t *loop;
+  Isolate *isolate;
+  std::unique_ptr<RequestResource> resource;
+  Persistent<Promise::Resolver> resolver;
+  ScanServicePtr scanService;
+
+  ScannerDeviceDescriptorPtr device;
+  ScanJob job;
+  std::unique_ptr<RawImageReceiver> receiver;
+  IScanSessionPtr session;
+  std::string error;
+
+  virtual void abandon();
+};
+
+void readPolledScan(uv_poll_t *poll, int status, int events);
+void completePolledScan(PolledScanRequest *request);
+
+void PolledScanRequest::abandon()
+{
+  scanService->cancelJob(job.id);
+  resolver.Reset();
+  if (polling && uv_is_active(reinterpret_cast<uv_handle_t *>(&poll)))
+  {
+    // no work is in flight while the descriptor is polled: end the session (freeing the device) now
+    uv_poll_stop(&poll);
+    completePolledScan(this);
+  }
+}
+
+/**
+ * Runs on the javascript thread once the scan is done: end the scan (freeing the device) & settle the promise.
+ */
+void completePolledScan(PolledScanRequest *request)
+{
+  request->session = nullptr;
+
+  if (!request->abandoned)
+  {
+    Isolate *isolate = request->isolate;
+    v8::HandleScope scope(isolate);
+    RequestResource::Scope callbackScope(*request->resource);
+    Local<v8::Context> context = isolate->GetCurrentContext();
+    Local<Promise::Resolver> resolver = Local<Promise::Resolver>::New(isolate, request->resolver);
+    if (!request->error.empty())
+    {
+      resolver->Reject(context, Exception::Error(String::NewFromUtf8(isolate, request->error.c_str())));
+    }
+    else
+    {
+      Local<Object> image = createImageObject(isolate, request->receiver->getImage());
+      setTimeline(isolate, image, request->job);
+      resolver->Resolve(context, image);
+    }
+    request->resolver.Reset();
+  }
+
+  if (request->polling)
+  {
+    uv_close(reinterpret_cast<uv_handle_t *>(&request->poll), [](uv_handle_t *handle) {
+      delete static_cast<PolledScanRequest *>(handle->data);
+    });
+  }
+  else
+  {
+    delete request;
+  }
+}
+
+/**
+ * Whether the scan can be read on the javascript thread: it has a descriptor, that is polled (or may be polled) already
+ */
+bool canPoll(PolledScanRequest *request, int fd)
+{
+  return fd >= 0 && (!request->polling || fd == request->polledFd);
+}
+
+/**
+ * Runs on the worker thread: the fallback for scans that cannot be polled & the start of the next frame (blocking sane_start),
+ * read until the scan is complete or it can be polled.
+ */
+void readBlockingScan(uv_work_t *work)
+{
+  PolledScanRequest *request = static_cast<PolledScanRequest *>(work->data);
+  try
+  {
+    while (!(request->complete = request->session->read()) && !canPoll(request, request->session->getSelectFd()))
+    {
+    }
+  }
+  catch (const std::exception &exception)
+  {
+    request->error = exception.what();
+  }
+}
+
+/**
+ * Runs on the javascript thread: poll the scanner's descriptor, or read on the thread pool, if there is none.
+ */
+void continuePolledScan(PolledScanRequest *request)
+{
+  int fd = request->session->getSelectFd();
+  if (canPoll(request, fd))
+  {
+    if (!request->polling)
+    {
+      uv_poll_init(request->loop, &request->poll, fd);
+      request->poll.data = request;
+      request->polling = true;
+      request->polledFd = fd;
+    }
+    uv_poll_start(&request->poll, UV_READABLE, readPolledScan);
+    return;
+  }
+
+  // the next frame is started on the thread pool, a frame without (or with another) descriptor is read there as well
+  if (request->polling)
+  {
+    uv_poll_stop(&request->poll);
+  }
+  uv_queue_work(request->loop, &request->work, readBlockingScan, [](uv_work_t *work, int status) {
+    PolledScanRequest *request = static_cast<PolledScanRequest *>(work->data);
+    if (status == UV_ECANCELED)
+    {
+      request->error = "Scan was cancelled.";
+    }
+    if (request->complete || !request->error.empty() || request->abandoned)
+    {
+      completePolledScan(request);
+    }
+    else
+    {
+      continuePolledScan(request);
+    }
+  });
+}
+
+/**
+ * Runs on the javascript thread whenever the scanner has data: read it (without blocking).
+ */
+void readPolledScan(uv_poll_t *poll, int status, int events)
+{
+  PolledScanRequest *request = static_cast<PolledScanRequest *>(poll->data);
+  bool complete = true;
+  try
+  {
+    if (status < 0)
+    {
+      throw std::runtime_error(std::string("Could not poll the scanner: ") + uv_strerror(status));
+    }
+    complete = request->session->read();
+  }
+  catch (const std::exception &exception)
+  {
+    request->error = exception.what();
+  }
+
+  if (complete)
+  {
+    uv_poll_stop(poll);
+    completePolledScan(request);
+  }
+  else if (request->session->getSelectFd() != request->polledFd)
+  {
+    continuePolledScan(request);
+  }
+}
+
+/**
+ * Runs on the worker thread: wait for the device & start the scan (sane_start may take a while, e.g. to warm up the lamp).
+ */
+void startPolledScan(uv_work_t *work)
+{
+  PolledScanRequest *request = static_cast<PolledScanRequest *>(work->data);
+  try
+  {
+    request->session = request->scanService->startScan(request->device, *request->receiver, request->job);
+  }
+  catch (const std::exception &exception)
+  {
+    request->error = exception.what();
+  }
+  request->scanService->releaseJob(request->job.id);
+}
+
+/**
+ * Queue a scan to a buffer, whose data is read on the javascript thread, and return the promise for the image.
+ */
+void queuePolledScan(const FunctionCallbackInfo<Value> &args, ScannerDeviceDescriptorPtr device, const ImageStorage &storage, const ScanJob &job)
+{
+  Isolate *isolate = args.GetIsolate();
+  AddonInstance &addon = getAddon(args);
+  Local<Promise::Resolver> resolver = Promise::Resolver::New(isolate->GetCurrentContext()).ToLocalChecked();
+
+  PolledScanRequest *request = new PolledScanRequest();
+  request->work.data = request;
+  request->loop = addon.loop;
+  request->isolate = isolate;
+  request->resource.reset(new RequestResource(isolate, "scanahedron:polledScan"));
+  request->resolver.Reset(isolate, resolver);
+  request->scanService = addon.getScanService();
+  request->device = device;
+  request->job = job;
+  request->receiver.reset(new RawImageReceiver(storage));
+  addon.track(request);
+
+  queueWorkOnTurn(addon, request->scanService, device, request->job, &request->work, startPolledScan, [](uv_work_t *work, int status) {
+    PolledScanRequest *request = static_cast<PolledScanRequest *>(work->data);
+    if (status == UV_ECANCELED)
+    {
+      request->error = "Scan was cancelled.";
+    }
+    if (!request->error.empty() || request->abandoned)
+    {
+      completePolledScan(request);
+      return;
+    }
+    continuePolledScan(request);
+  });
+  args.GetReturnValue().Set(createJobPromise(isolate, resolver, request->job.id));
+}
+
+/**
+ * Scan to a buffer without blocking the javascript thread.
+ * 
+ * Expects javascript arguments: 
+ *  - deviceName (string)
+ *  - options (optional dict with mapped & file, see getImageStorage, priority, see getJobPriority, and
+ *    polling (bool), read the scanner's data on the event loop when it is ready instead of blocking a worker thread during the scan;
+ *    backends that cannot be polled are read on a worker thread all the same)
+ * 
+ * Returns a promise, that resolves to the same dict as scanToBuffer.
+ */
+void scanToBufferAsync(const FunctionCallbackInfo<Value> &args)
+{
+  Isolate *isolate = args.GetIsolate();
+  ScanServicePtr scanService = getAddon(args).getScanService();
+  ScannerDeviceDescriptorPtr usedDevice = getDeviceDescriptor(isolate, scanService, args[0]);
+  if (usedDevice == nullptr && !args[0]->IsNull())
+  {
+    return;
+  }
+
+  ImageStorage storage = getImageStorage(isolate, args[1]);
+  if (args[1]->IsObject() && args[1]->ToObject()->Get(String::NewFromUtf8(isolate, "polling"))->BooleanValue())
+  {
+    queuePolledScan(args, usedDevice, storage, createScanJob(isolate, scanService, args[1], JobPriority::Normal, "scanToBufferAsync"));
+    return;
+  }
+  queueAsyncScan(args, AsyncScanRequest::ToBuffer, usedDevice, createScanJob(isolate, scanService, args[1], JobPriority::Normal, "scanToBufferAsync"), std::string(), EncoderOptions(),
+                 BlankPageOptions(), storage);
+}
+
+/**
+ * Scan to a given file without blocking the javascript thread.
+ * 
+ * Expects javascript arguments: 
+ *  - deviceName (string)
+ *  - fileName (string)
+ *  - options (optional dict with format, compressionLevel, threads, quality, tiffCompression, priority & timeline)
+ * 
+ * Returns a promise, that resolves like scanToFile returns.
+ */
+void scanToFileAsync(const FunctionCallbackInfo<Value> &args)
+{
+  Isolate *isolate = args.GetIsolate();
+  ScanServicePtr scanService = getAddon(args).getScanService();
+  if (args.Length() < 2 || !(args[0]->IsString() || args[0]->IsNull()) || !args[1]->IsString())
+  {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "Expecting: scanToFileAsync(deviceName:string, filepath:string, options?:object)")));
+    return;
+  }
+
+  v8::String::Utf8Value paramFilePath(args[1]);
+  std::string filePath = std::string(*paramFilePath);
+
+  ScannerDeviceDescriptorPtr usedDevice = getDeviceDescriptor(isolate, scanService, args[0]);
+  if (usedDevice == nullptr && !args[0]->IsNull())
+  {
+    return;
+  }
+
+  queueAsyncScan(args, AsyncScanRequest::ToFile, usedDevice, createScanJob(isolate, scanService, args[2], JobPriority::Normal, "scanToFileAsync"), filePath,
+                 getEncoderOptions(isolate, args[2]));
+}
+
+/**
+ * Scan all pages of the document feeder to files without blocking the javascript thread.
+ * The pages are encoded on a separate thread, while the next page is scanned.
+ * 
+ * Expects javascript arguments: 
+ *  - deviceName (string)
+ *  - pathPattern (string), a run of '#' is replaced by the number of the stored page, e.g. "page-###.png"
+ *  - options (optional dict, same as for scanToFile, plus the blank page detection:
+ *    skipBlankPages (bool), inkThreshold (0 - 255) & maximumInkCoverage (fraction of the samples); the priority defaults to "batch")
+ * 
+ * Returns a promise, that resolves to an array of dicts for all scanned pages, with the page (number in the feeder),
+ * file (unless the page was dropped as blank), blank, inkCoverage, mean & deviation (of the samples).
+ * The array carries the timeline of the batch, if one was requested.
+ */
+void scanBatchToFiles(const FunctionCallbackInfo<Value> &args)
+{
+  Isolate *isolate = args.GetIsolate();
+  ScanServicePtr scanService = getAddon(args).getScanService();
+  if (args.Length() < 2 || !(args[0]->IsString() || args[0]->IsNull()) || !args[1]->IsString())
+  {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "Expecting: scanBatchToFiles(deviceName:string, pathPattern:string, options?:object)")));
+    return;
+  }
+
+  v8::String::Utf8Value paramPathPattern(args[1]);
+  std::string pathPattern = std::string(*paramPathPattern);
+
+  ScannerDeviceDescriptorPtr usedDevice = getDeviceDescriptor(isolate, scanService, args[0]);
+  if (usedDevice == nullptr && !args[0]->IsNull())
+  {
+    return;
+  }
+
+  queueAsyncScan(args, AsyncScanRequest::Batch, usedDevice, createScanJob(isolate, scanService, args[2], JobPriority::Batch, "scanBatchToFiles"), pathPattern,
+                 getEncoderOptions(isolate, args[2]), getBlankPageOptions(isolate, args[2]));
+}
+
+/**
+ * Scan the whole flatbed once & find the separate items on it (receipts, photos, ...) without blocking the javascript thread.
+ * 
+ * Expects javascript arguments: 
+ *  - deviceName (string)
+ *  - pathPattern (optional string), if given each item is stored to a file of its own, named like the pages of scanBatchToFiles
+ *  - options (optional dict, same as for scanToFile)
+ * 
+ * Returns a promise, that resolves to an array of dicts with x, y, width & height of each item in the scanned image (in pixels)
+ * and the file of the item, if a path pattern was given. The array carries the timeline of the scan, if one was requested.
+ */
+void scanItems(const FunctionCallbackInfo<Value> &args)
+{
+  Isolate *isolate = args.GetIsolate();
+  ScanServicePtr scanService = getAddon(args).getScanService();
+  if (args.Length() < 1 || !(args[0]->IsString() || args[0]->IsNull()) || (args.Length() > 1 && !(args[1]->IsString() || args[1]->IsUndefined())))
+  {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "Expecting: scanItems(deviceName:string, pathPattern?:string, options?:object)")));
+    return;
+  }
+
+  std::string pathPattern;
+  if (args.Length() > 1 && args[1]->IsString())
+  {
+    v8::String::Utf8Value paramPathPattern(args[1]);
+    pathPattern = std::string(*paramPathPattern);
+  }
+
+  ScannerDeviceDescriptorPtr usedDevice = getDeviceDescriptor(isolate, scanService, args[0]);
+  if (usedDevice == nullptr && !args[0]->IsNull())
+  {
+    return;
+  }
+
+  queueAsyncScan(args, AsyncScanRequest::Items, usedDevice, createScanJob(isolate, scanService, args[2], JobPriority::Normal, "scanItems"), pathPattern,
+                 getEncoderOptions(isolate, args[2]));
+}
+
+/**
+ * State of a streaming scan: the worker thread collects the rows in one buffer,
+ * the javascript thread takes them all at once through an async handle.
+ */
+struct StreamScanRequest : public IScanReceiver, public InFlightRequest
+{
+  uv_work_t work;
+  uv_async_t rowsReady;
+  Isolate *isolate;
+  std::unique_ptr<RequestResource> resource;
+  Persistent<Promise::Resolver> resolver;
+  Persistent<Function> onRows;
+  ScanServicePtr scanService;
+
+  ScannerDeviceDescriptorPtr device;
+  bool preview = false;
+  ScanJob job;
+  ImageHeader header;
+  PreviewArea area;
+  std::string error;
+
+  /**
+   * The rows since the last delivery, however often the handle fired in between.
+   * The buffers swap on delivery, so they keep their capacity.
+   */
+  std::mutex rowsMutex;
+  std::vector<unsigned char> pendingRows;
+  std::vector<unsigned char> deliveredRows;
+  unsigned int pendingY = 0;
+  unsigned int pendingCount = 0;
+
+  virtual void begin(const ImageHeader &header_)
+  {
+    header = header_;
+  }
+
+  virtual void rows(const unsigned char *pixels, unsigned int y, unsigned int count)
+  {
+    bool wakeUp;
+    {
+      std::lock_guard<std::mutex> lock(rowsMutex);
+      wakeUp = pendingCount == 0;
+      if (wakeUp)
+      {
+        pendingY = y;
+      }
+      pendingRows.insert(pendingRows.end(), pixels, pixels + count * header.getBytesPerRow());
+      pendingCount += count;
+    }
+    if (wakeUp)
+    {
+      uv_async_send(&rowsReady);
+    }
+  }
+
+  virtual void end()
+  {
+  }
+
+  virtual void abandon()
+  {
+    // the handle is closed by completeStreamScan, once the work is done
+    scanService->cancelJob(job.id);
+    resolver.Reset();
+    onRows.Reset();
+  }
+};
+
+/**
+ * Runs on the javascript thread: hand the rows collected since the last call to the callback, in one batch.
+ */
+void deliverRowBatches(uv_async_t *handle)
+{
+  StreamScanRequest *request = static_cast<StreamScanRequest *>(handle->data);
+  if (request->abandoned)
+  {
+    return;
+  }
+  Isolate *isolate = request->isolate;
+  v8::HandleScope scope(isolate);
+
+  unsigned int y;
+  unsigned int count;
+  {
+    std::lock_guard<std::mutex> lock(request->rowsMutex);
+    y = request->pendingY;
+    count = request->pendingCount;
+    request->deliveredRows.swap(request->pendingRows);
+    request->pendingRows.clear();
+    request->pendingCount = 0;
+  }
+  if (count == 0)
+  {
+    return;
+  }
+
+  RawImagePtr rows(new RawImage(request->header.width, count, request->header.format));
+  std::memcpy(rows->pixels, request->deliveredRows.data(), count * rows->bytesPerRow);
+
+  Local<Object> obj = Object::New(isolate);
+  obj->Set(String::NewFromUtf8(isolate, "y"), Uint32::New(isolate, y));
+  obj->Set(String::NewFromUtf8(isolate, "rows"), Uint32::New(isolate, count));
+  obj->Set(String::NewFromUtf8(isolate, "width"), Uint32::New(isolate, request->header.width));
+  obj->Set(String::NewFromUtf8(isolate, "height"), Uint32::New(isolate, request->header.height));
+  setPixelFormat(isolate, obj, request->header.format, request->header.width);
+  obj->Set(String::NewFromUtf8(isolate, "pixels"), wrapPixels(isolate, rows));
+
+  Local<Function> onRows = Local<Function>::New(isolate, request->onRows);
+  Local<Value> argv[] = {obj};
+  request->resource->MakeCallback(onRows, 1, argv);
+}
+
+void runStreamScan(uv_work_t *work)
+{
+  StreamScanRequest *request = static_cast<StreamScanRequest *>(work->data);
+  try
+  {
+    if (request->preview)
+    {
+      request->area = request->scanService->preview(request->device, *request, request->job);
+    }
+    else
+    {
+      request->scanService->scanToStream(request->device, *request, request->job);
+    }
+  }
+  catch (const std::exception &exception)
+  {
+    request->error = exception.what();
+  }
+  request->scanService->releaseJob(request->job.id);
+}
+
+void releaseStreamScan(uv_handle_t *handle)
+{
+  StreamScanRequest *request = static_cast<StreamScanRequest *>(handle->data);
+  delete request;
+}
+
+void completeStreamScan(uv_work_t *work, int status)
+{
+  StreamScanRequest *request = static_cast<StreamScanRequest *>(work->data);
+  if (request->abandoned)
+  {
+    uv_close(reinterpret_cast<uv_handle_t *>(&request->rowsReady), releaseStreamScan);
+    return;
+  }
+  Isolate *isolate = request->isolate;
+  v8::HandleScope scope(isolate);
+  RequestResource::Scope callbackScope(*request->resource);
+  Local<v8::Context> context = isolate->GetCurrentContext();
+
+  // The async handle may not have fired for the last batches yet.
+  deliverRowBatches(&request->rowsReady);
+
+  Local<Promise::Resolver> resolver = Local<Promise::Resolver>::New(isolate, request->resolver);
+  if (status == UV_ECANCELED)
+  {
+    request->error = "Scan was cancelled.";
+  }
+  if (!request->error.empty())
+  {
+    resolver->Reject(context, Exception::Error(String::NewFromUtf8(isolate, request->error.c_str())));
+  }
+  else
+  {
+    Local<Object> obj = Object::New(isolate);
+    obj->Set(String::NewFromUtf8(isolate, "width"), Uint32::New(isolate, request->header.width));
+    obj->Set(String::NewFromUtf8(isolate, "height"), Uint32::New(isolate, request->header.height));
+    setPixelFormat(isolate, obj, request->header.format, request->header.width);
+    if (request->preview)
+    {
+      obj->Set(String::NewFromUtf8(isolate, "fromX"), Number::New(isolate, request->area.fromX));
+      obj->Set(String::NewFromUtf8(isolate, "fromY"), Number::New(isolate, request->area.fromY));
+      obj->Set(String::NewFromUtf8(isolate, "toX"), Number::New(isolate, request->area.toX));
+      obj->Set(String::NewFromUtf8(isolate, "toY"), Number::New(isolate, request->area.toY));
+      obj->Set(String::NewFromUtf8(isolate, "resolutionInDPI"), Number::New(isolate, request->area.resolutionInDPI));
+    }
+    setTimeline(isolate, obj, request->job);
+    resolver->Resolve(context, obj);
+  }
+
+  request->resolver.Reset();
+  request->onRows.Reset();
+  uv_close(reinterpret_cast<uv_handle_t *>(&request->rowsReady), releaseStreamScan);
+}
+
+/**
+ * Queue a streaming scan (or preview) on the libuv thread pool and return the promise for its result.
+ */
+void queueStreamScan(const FunctionCallbackInfo<Value> &args, const char *usage, bool preview)
+{
+  Isolate *isolate = args.GetIsolate();
+  AddonInstance &addon = getAddon(args);
+  ScanServicePtr scanService = addon.getScanService();
+  if (args.Length() < 2 || !(args[0]->IsString() || args[0]->IsNull()) || !args[1]->IsFunction())
+  {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, usage)));
+    return;
+  }
+
+  ScannerDeviceDescriptorPtr usedDevice = getDeviceDescriptor(isolate, scanService, args[0]);
+  if (usedDevice == nullptr && !args[0]->IsNull())
+  {
+    return;
+  }
+
+  Local<Promise::Resolver> resolver = Promise::Resolver::New(isolate->GetCurrentContext()).ToLocalChecked();
+
+  StreamScanRequest *request = new StreamScanRequest();
+  request->work.data = request;
+  request->rowsReady.data = request;
+  request->isolate = isolate;
+  request->resource.reset(new RequestResource(isolate, "scanahedron:streamScan"));
+  request->resolver.Reset(isolate, resolver);
+  request->onRows.Reset(isolate, Local<Function>::Cast(args[1]));
+  request->scanService = scanService;
+  request->device = usedDevice;
+  request->preview = preview;
+  request->job = createScanJob(isolate, scanService, args[2], preview ? JobPriority::Interactive : JobPriority::Normal, preview ? "preview" : "scanToStream");
+
+  uv_async_init(addon.loop, &request->rowsReady, deliverRowBatches);
+  addon.track(request);
+  queueWorkOnTurn(addon, scanService, usedDevice, request->job, &request->work, runStreamScan, completeStreamScan);
+  args.GetReturnValue().Set(createJobPromise(isolate, resolver, request->job.id));
+}
+
+/**
+ * Scan and stream the rows to a callback while the scan is running.
+ * 
+ * Expects javascript arguments: 
+ *  - deviceName (string)
+ *  - onRows (function), called with a dict for each batch of completed rows (all rows completed since the last call):
+ *     - y (index of the first row in the batch)
+ *     - rows (number of rows in the batch)
+ *     - width (in pixel)
+ *     - height (in pixel)
+ *     - format, bytesPerPixel & bytesPerRow (like for scanToBuffer)
+ *     - pixels (Buffer with the pixel data of the rows)
+ *  - options (optional dict with priority & timeline, see createScanJob)
+ * 
+ * Returns a promise, that resolves to a dict with width, height & the pixel format (and the timeline, if requested) when the scan is complete.
+ */
+void scanToStream(const FunctionCallbackInfo<Value> &args)
+{
+  queueStreamScan(args, "Expecting: scanToStream(deviceName:string, onRows:function, options?:object)", false);
+}
+
+/**
+ * Scan a fast preview of the whole area at the lowest resolution and stream the rows to a callback.
+ * The scanner configuration is restored afterwards.
+ * 
+ * Expects javascript arguments: 
+ *  - deviceName (string)
+ *  - onRows (function), called like for scanToStream
+ *  - options (optional dict with priority & timeline, see createScanJob)
+ * 
+ * Returns a promise, that resolves to a dict with width, height, the pixel format and the scanned
+ * area fromX, fromY, toX, toY (in mm) & resolutionInDPI.
+ */
+void preview(const FunctionCallbackInfo<Value> &args)
+{
+  queueStreamScan(args, "Expecting: preview(deviceName:string, onRows:function, options?:object)", true);
+}
+
+/**
+ * Map a region of a preview to the scan geometry.
+ * 
+ * Expects javascript arguments: 
+ *  - preview (the dict the preview resolved to)
+ *  - region (dict with x, y, width & height in preview pixels)
+ * 
+ * Returns a configuration dict with fromX, fromY, toX & toY (in mm), to be passed to setConfiguration.
+ */
+void getRegionConfiguration(const FunctionCallbackInfo<Value> &args)
+{
+  Isolate *isolate = args.GetIsolate();
+  if (args.Length() != 2 || !args[0]->IsObject() || !args[1]->IsObject())
+  {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "Expecting: getRegionConfiguration(preview:object, region:object)")));
+    return;
+  }
+
+  Local<Object> previewObj = args[0]->ToObject();
+  PreviewArea area;
+  area.fromX = previewObj->Get(String::NewFromUtf8(isolate, "fromX"))->NumberValue();
+  area.fromY = previewObj->Get(String::NewFromUtf8(isolate, "fromY"))->NumberValue();
+  area.toX = previewObj->Get(String::NewFromUtf8(isolate, "toX"))->NumberValue();
+  area.toY = previewObj->Get(String::NewFromUtf8(isolate, "toY"))->NumberValue();
+  area.width = previewObj->Get(String::NewFromUtf8(isolate, "width"))->Uint32Value();
+  area.height = previewObj->Get(String::NewFromUtf8(isolate, "height"))->Uint32Value();
+
+  Local<Object> regionObj = args[1]->ToObject();
+  unsigned int x = regionObj->Get(String::NewFromUtf8(isolate, "x"))->Uint32Value();
+  unsigned int y = regionObj->Get(String::NewFromUtf8(isolate, "y"))->Uint32Value();
+  unsigned int width = regionObj->Get(String::NewFromUtf8(isolate, "width"))->Uint32Value();
+  unsigned int height = regionObj->Get(String::NewFromUtf8(isolate, "height"))->Uint32Value();
+
+  ScannerConfiguration configuration;
+  try
+  {
+    configuration = ScanService::getRegionConfiguration(area, x, y, width, height);
+  }
+  catch (const std::exception &exception)
+  {
+    isolate->ThrowException(Exception::Error(String::NewFromUtf8(isolate, exception.what())));
+    return;
+  }
+
+  Local<Object> obj = Object::New(isolate);
+  obj->Set(String::NewFromUtf8(isolate, "fromX"), Number::New(isolate, configuration.fromX));
+  obj->Set(String::NewFromUtf8(isolate, "fromY"), Number::New(isolate, configuration.fromY));
+  obj->Set(String::NewFromUtf8(isolate, "toX"), Number::New(isolate, configuration.toX));
+  obj->Set(String::NewFromUtf8(isolate, "toY"), Number::New(isolate, configuration.toY));
+  args.GetReturnValue().Set(obj);
+}
+
+/**
+ * Export a function, that is called with the addon instance of the context
+ */
+void setMethod(Local<Object> exports, const char *name, v8::FunctionCallback callback, Local<v8::External> addon)
+{
+  Isolate *isolate = exports->GetIsolate();
+  Local<v8::Context> context = isolate->GetCurrentContext();
+  Local<String> functionName = String::NewFromUtf8(isolate, name, v8::NewStringType::kNormal).ToLocalChecked();
+  Local<Function> function = v8::FunctionTemplate::New(isolate, callback, addon)->GetFunction(context).ToLocalChecked();
+  function->SetName(functionName);
+  exports->Set(context, functionName, function).FromJust();
+}
+
+/**
+ * Setup the addon for a context (the main thread or a worker_thread), each context gets an instance of its own.
+ * The scanner service is shared with the other contexts (see acquireScanService), it is taken & SANE is initialised on first use (or by warmup).
+ * Scans of different contexts may run in parallel, as long as they use different devices (the scans of a device are queued).
  */
-void init(Local<Object> exports)
+void init(Local<Object> exports, Local<Value> module, Local<v8::Context> context, void *priv)
 {
-  auto interface = IScannerInterfacePtr(new SaneScannerInterface());
-  scanService = ScanServicePtr(new ScanService(interface));
+  Isolate *isolate = context->GetIsolate();
+  // the cleanup hook owns the instance, it ends the requests still in flight first (the scan service lives on for other contexts)
+  AddonInstance *instance = new AddonInstance(node::GetCurrentEventLoop(isolate));
+  node::AddEnvironmentCleanupHook(isolate, [](void *arg) {
+    AddonInstance *instance = static_cast<AddonInstance *>(arg);
+    instance->tearDown();
+    delete instance;
+  }, instance);
 
-  NODE_SET_METHOD(exports, "getScanners", getScanners);
-  NODE_SET_METHOD(exports, "getCapabilities", getCapabilities);
-  NODE_SET_METHOD(exports, "getConfiguration", getConfiguration);
-  NODE_SET_METHOD(exports, "setConfiguration", setConfiguration);
-  NODE_SET_METHOD(exports, "scanToFile", scanToFile);
-  NODE_SET_METHOD(exports, "scanToBuffer", scanToBuffer);
+  Local<v8::External> addon = v8::External::New(isolate, instance);
+  setMethod(exports, "warmup", warmup, addon);
+  setMethod(exports, "getScanners", getScanners, addon);
+  setMethod(exports, "getCapabilities", getCapabilities, addon);
+  setMethod(exports, "getConfiguration", getConfiguration, addon);
+  setMethod(exports, "setConfiguration", setConfiguration, addon);
+  setMethod(exports, "getStatistics", getStatistics, addon);
+  setMethod(exports, "getBufferPoolStatistics", getBufferPoolStatistics, addon);
+  setMethod(exports, "configureBufferPool", configureBufferPool, addon);
+  setMethod(exports, "trimBufferPool", trimBufferPool, addon);
+  setMethod(exports, "setTraceFile", setTraceFile, addon);
+  setMethod(exports, "cancelJob", cancelJob, addon);
+  setMethod(exports, "getQueueStatistics", getQueueStatistics, addon);
+  setMethod(exports, "scanToFile", scanToFile, addon);
+  setMethod(exports, "scanToBuffer", scanToBuffer, addon);
+  setMethod(exports, "scanToBufferAsync", scanToBufferAsync, addon);
+  setMethod(exports, "scanToFileAsync", scanToFileAsync, addon);
+  setMethod(exports, "scanToStream", scanToStream, addon);
+  setMethod(exports, "preview", preview, addon);
+  setMethod(exports, "getRegionConfiguration", getRegionConfiguration, addon);
+  setMethod(exports, "scanBatchToFiles", scanBatchToFiles, addon);
+  setMethod(exports, "scanItems", scanItems, addon);
 }
 
-NODE_MODULE(NODE_GYP_MODULE_NAME, init)
+NODE_MODULE_CONTEXT_AWARE(NODE_GYP_MODULE_NAME, init)
 
 } // namespace demo
 
@@ -0,0 +1,279 @@
+#include "itemdetector.h"
+#include "utils/pixelkernels.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+/**
+ * Cells are sampled on a grid of up to this many pixels per direction, that is plenty for a mean
+ */
+const unsigned int SAMPLES_PER_CELL = 4;
+
+/**
+ * Mean brightness of each cell (sum of the channels, 0 - 765 for RGB)
+ */
+std::vector<unsigned int> getCellBrightness(const RawImage &image, unsigned int cellSize, unsigned int columns, unsigned int rows)
+{
+    const unsigned int step = std::max(1u, cellSize / SAMPLES_PER_CELL);
+    const unsigned int channels = getChannels(image.format);
+    const unsigned int scale = channels == 1 ? 3 : 1;
+    const PixelKernels &kernels = getPixelKernels();
+
+    // Lineart & 16 bit rows are converted to 8 bit samples (only the sampled rows)
+    std::vector<unsigned char> converted;
+    if (getBitsPerSample(image.format) != 8)
+    {
+        converted.resize(static_cast<size_t>(image.width) * channels);
+    }
+
+    std::vector<unsigned int> sums(static_cast<size_t>(columns) * rows, 0);
+    std::vector<unsigned int> counts(sums.size(), 0);
+    for (unsigned int y = 0; y < image.height; y += step)
+    {
+        const unsigned char *row = image.pixels + y * image.bytesPerRow;
+        if (image.format == PixelFormat::Gray1)
+        {
+            kernels.expand1To8(row, converted.data(), converted.size(), 0x00);
+            row = converted.data();
+        }
+        else if (!converted.empty())
+        {
+            kernels.narrow16To8(row, converted.data(), converted.size());
+            row = converted.data();
+        }
+        unsigned int *cellSums = sums.data() + static_cast<size_t>(y / cellSize) * columns;
+        unsigned int *cellCounts = counts.data() + static_cast<size_t>(y / cellSize) * columns;
+        for (unsigned int column = 0; column < columns; ++column)
+        {
+            const unsigned int end = std::min(image.width, (column + 1) * cellSize);
+            unsigned int sum = 0;
+            unsigned int count = 0;
+            for (unsigned int x = column * cellSize; x < end; x += step, ++count)
+            {
+                const unsigned char *pixel = row + x * channels;
+                for (unsigned int channel = 0; channel < channels; ++channel)
+                {
+                    sum += pixel[channel];
+                }
+            }
+            cellSums[column] += sum * scale;
+            cellCounts[column] += count;
+        }
+    }
+    for (size_t i = 0; i < sums.size(); ++i)
+    {
+        sums[i] = counts[i] ? sums[i] / counts[i] : 0;
+    }
+    return sums;
+}
+
+/**
+ * The background is what most of the image border shows (the median of the border cells)
+ */
+unsigned int getBackground(const std::vector<unsigned int> &cells, unsigned int columns, unsigned int rows)
+{
+    std::vector<unsigned int> border;
+    for (unsigned int x = 0; x < columns; ++x)
+    {
+        border.push_back(cells[x]);
+        border.push_back(cells[static_cast<size_t>(rows - 1) * columns + x]);
+    }
+    for (unsigned int y = 1; y + 1 < rows; ++y)
+    {
+        border.push_back(cells[static_cast<size_t>(y) * columns]);
+        border.push_back(cells[static_cast<size_t>(y) * columns + columns - 1]);
+    }
+    std::nth_element(border.begin(), border.begin() + border.size() / 2, border.end());
+    return border[border.size() / 2];
+}
+
+/**
+ * Grow the mask by the given distance (square neighbourhood), separably in x & y
+ */
+std::vector<unsigned char> dilate(const std::vector<unsigned char> &mask, unsigned int columns, unsigned int rows, unsigned int distance)
+{
+    if (distance == 0)
+    {
+        return mask;
+    }
+    std::vector<unsigned char> horizontal(mask.size(), 0);
+    for (unsigned int y = 0; y < rows; ++y)
+    {
+        const unsigned char *in = mask.data() + static_cast<size_t>(y) * columns;
+        unsigned char *out = horizontal.data() + static_cast<size_t>(y) * columns;
+        for (unsigned int x = 0; x < columns; ++x)
+        {
+            if (in[x])
+            {
+                unsigned int from = x >= distance ? x - distance : 0;
+                unsigned int to = std::min(columns - 1, x + distance);
+                std::memset(out + from, 1, to - from + 1);
+            }
+        }
+    }
+    std::vector<unsigned char> result(mask.size(), 0);
+    for (unsigned int y = 0; y < rows; ++y)
+    {
+        const unsigned char *in = horizontal.data() + static_cast<size_t>(y) * columns;
+        unsigned int from = y >= distance ? y - distance : 0;
+        unsigned int to = std::min(rows - 1, y + distance);
+        for (unsigned int target = from; target <= to; ++target)
+        {
+            unsigned char *out = result.data() + static_cast<size_t>(target) * columns;
+            for (unsigned int x = 0; x < columns; ++x)
+            {
+                out[x] |= in[x];
+            }
+        }
+    }
+    return result;
+}
+
+/**
+ * Bounding boxes (in cells) of the 8-connected components of the mask
+ */
+std::vector<ItemBounds> findComponents(std::vector<unsigned char> &mask, unsigned int columns, unsigned int rows, std::vector<unsigned int> &cellCounts)
+{
+    std::vector<ItemBounds> components;
+    std::vector<unsigned int> stack;
+    for (unsigned int start = 0; start < mask.size(); ++start)
+    {
+        if (!mask[start])
+        {
+            continue;
+        }
+        unsigned int minX = columns, minY = rows, maxX = 0, maxY = 0, count = 0;
+        mask[start] = 0;
+        stack.push_back(start);
+        while (!stack.empty())
+        {
+            unsigned int cell = stack.back();
+            stack.pop_back();
+            unsigned int x = cell % columns;
+            unsigned int y = cell / columns;
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+            count++;
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    int nx = static_cast<int>(x) + dx;
+                    int ny = static_cast<int>(y) + dy;
+                    if (nx < 0 || ny < 0 || nx >= static_cast<int>(columns) || ny >= static_cast<int>(rows))
+                    {
+                        continue;
+                    }
+                    unsigned int neighbour = static_cast<unsigned int>(ny) * columns + nx;
+                    if (mask[neighbour])
+                    {
+                        mask[neighbour] = 0;
+                        stack.push_back(neighbour);
+                    }
+                }
+            }
+        }
+        ItemBounds bounds;
+        bounds.x = minX;
+        bounds.y = minY;
+        bounds.width = maxX - minX + 1;
+        bounds.height = maxY - minY + 1;
+        components.push_back(bounds);
+        cellCounts.push_back(count);
+    }
+    return components;
+}
+}
+
+ItemDetector::ItemDetector(const ItemDetectorOptions &options_)
+    : options(options_)
+{
+}
+
+std::vector<ItemBounds> ItemDetector::detect(const RawImage &image) const
+{
+    std::vector<ItemBounds> items;
+    if (image.width == 0 || image.height == 0)
+    {
+        return items;
+    }
+
+    const unsigned int cellSize = std::max(1u, (std::max(image.width, image.height) + options.maskSize - 1) / std::max(1u, options.maskSize));
+    const unsigned int columns = (image.width + cellSize - 1) / cellSize;
+    const unsigned int rows = (image.height + cellSize - 1) / cellSize;
+
+    std::vector<unsigned int> cells = getCellBrightness(image, cellSize, columns, rows);
+    const int background = static_cast<int>(getBackground(cells, columns, rows));
+    const int threshold = static_cast<int>(options.threshold) * 3;
+
+    std::vector<unsigned char> mask(cells.size());
+    for (size_t i = 0; i < cells.size(); ++i)
+    {
+        mask[i] = std::abs(static_cast<int>(cells[i]) - background) > threshold ? 1 : 0;
+    }
+    mask = dilate(mask, columns, rows, options.mergeDistance);
+
+    std::vector<unsigned int> cellCounts;
+    std::vector<ItemBounds> components = findComponents(mask, columns, rows, cellCounts);
+
+    // Dilation grew each item by the merge distance, the margin is what remains of that growth
+    const unsigned int shrink = options.mergeDistance > options.margin ? options.mergeDistance - options.margin : 0;
+    const double minimumCells = options.minimumArea * columns * rows;
+    for (size_t i = 0; i < components.size(); ++i)
+    {
+        ItemBounds cellBounds = components[i];
+        if (cellCounts[i] < minimumCells)
+        {
+            continue;
+        }
+        unsigned int left = cellBounds.x + std::min(shrink, cellBounds.width / 2);
+        unsigned int top = cellBounds.y + std::min(shrink, cellBounds.height / 2);
+        unsigned int right = cellBounds.x + cellBounds.width - std::min(shrink, cellBounds.width / 2);
+        unsigned int bottom = cellBounds.y + cellBounds.height - std::min(shrink, cellBounds.height / 2);
+
+        ItemBounds bounds;
+        bounds.x = left * cellSize;
+        bounds.y = top * cellSize;
+        bounds.width = std::min(image.width, right * cellSize) - bounds.x;
+        bounds.height = std::min(image.height, bottom * cellSize) - bounds.y;
+        items.push_back(bounds);
+    }
+    return items;
+}
+
+RawImagePtr ItemDetector::crop(const RawImage &image, const ItemBounds &bounds)
+{
+    if (bounds.x + bounds.width > image.width || bounds.y + bounds.height > image.height)
+    {
+        throw std::runtime_error("The item is not within the image.");
+    }
+    RawImagePtr item(new RawImage(bounds.width, bounds.height, image.format));
+    const unsigned int bytesPerPixel = getBytesPerPixel(image.format);
+    for (unsigned int y = 0; y < bounds.height; ++y)
+    {
+        const unsigned char *source = image.pixels + (bounds.y + y) * image.bytesPerRow;
+        unsigned char *destination = item->pixels + y * item->bytesPerRow;
+        if (bytesPerPixel)
+        {
+            std::memcpy(destination, source + bounds.x * bytesPerPixel, item->bytesPerRow);
+            continue;
+        }
+        // Lineart: the item rarely starts at a byte boundary, move the bits one by one
+        std::memset(destination, 0, item->bytesPerRow);
+        for (unsigned int x = 0; x < bounds.width; ++x)
+        {
+            unsigned int sourceX = bounds.x + x;
+            if (source[sourceX >> 3] & (0x80 >> (sourceX & 7)))
+            {
+                destination[x >> 3] |= static_cast<unsigned char>(0x80 >> (x & 7));
+            }
+        }
+    }
+    return item;
+}
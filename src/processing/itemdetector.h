@@ -0,0 +1,69 @@
+#pragma once
+
+#include "utils/types.h"
+
+/**
+ * Bounding box of an item, in pixels of the scanned image
+ */
+struct ItemBounds
+{
+  unsigned int x = 0;
+  unsigned int y = 0;
+  unsigned int width = 0;
+  unsigned int height = 0;
+};
+
+/**
+ * Tuning of the item detection
+ */
+struct ItemDetectorOptions
+{
+  /**
+   * Longer side of the downsampled mask (in cells), the detection works on the mask only
+   */
+  unsigned int maskSize = 512;
+
+  /**
+   * Difference of a cell's brightness to the background, for the cell to belong to an item
+   */
+  unsigned int threshold = 24;
+
+  /**
+   * Gaps up to this size (in cells) are closed, so that an item with a bright area stays in one piece
+   */
+  unsigned int mergeDistance = 2;
+
+  /**
+   * Items covering less than this fraction of the image are dropped (dust, noise)
+   */
+  double minimumArea = 0.002;
+
+  /**
+   * Extra border (in cells) around each item
+   */
+  unsigned int margin = 1;
+};
+
+/**
+ * Finds separate items (receipts, photos, ...) on the background of a flatbed scan.
+ * The image is reduced to a mask of cells that differ from the background (estimated from the image border),
+ * the connected components of the mask are the items.
+ */
+class ItemDetector
+{
+public:
+  explicit ItemDetector(const ItemDetectorOptions &options = ItemDetectorOptions());
+
+  /**
+   * Find the items of an image, ordered top to bottom, left to right
+   */
+  std::vector<ItemBounds> detect(const RawImage &image) const;
+
+  /**
+   * Copy an item into an image of its own
+   */
+  static RawImagePtr crop(const RawImage &image, const ItemBounds &bounds);
+
+private:
+  ItemDetectorOptions options;
+};
@@ -0,0 +1,270 @@
+#include "devicecache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+
+namespace
+{
+/**
+ * Bump, whenever the layout of the file changes
+ */
+const std::string CACHE_HEADER = "scanahedron-device-cache 1";
+
+std::vector<std::string> split(const std::string &line)
+{
+    // Empty fields (e.g. an unknown model) are kept, also at the end of the line
+    std::vector<std::string> fields;
+    size_t start = 0;
+    size_t tab;
+    while ((tab = line.find('\t', start)) != std::string::npos)
+    {
+        fields.push_back(line.substr(start, tab - start));
+        start = tab + 1;
+    }
+    fields.push_back(line.substr(start));
+    return fields;
+}
+
+template <typename T>
+void writeList(std::ostream &stream, const std::string &key, const std::vector<T> &values)
+{
+    stream << key;
+    for (const auto &value : values)
+    {
+        stream << '\t' << value;
+    }
+    stream << '\n';
+}
+}
+
+DeviceCache::DeviceCache(const std::string &path_)
+    : path(path_)
+{
+}
+
+bool DeviceCache::load(int backendVersion_)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    backendVersion = backendVersion_;
+    entries.clear();
+
+    std::ifstream stream(path);
+    std::string line;
+    if (!std::getline(stream, line) || line != CACHE_HEADER)
+    {
+        return false;
+    }
+    if (!std::getline(stream, line) || line != "version\t" + std::to_string(backendVersion))
+    {
+        return false;
+    }
+
+    // One line per record, fields separated by tabs; a device's records follow its "device" line
+    std::vector<Entry> loaded;
+    while (std::getline(stream, line))
+    {
+        std::vector<std::string> fields = split(line);
+        const std::string &key = fields[0];
+        if (key == "device" && fields.size() == 4)
+        {
+            Entry entry;
+            entry.device.name = fields[1];
+            entry.device.vendor = fields[2];
+            entry.device.model = fields[3];
+            loaded.push_back(entry);
+            continue;
+        }
+        if (loaded.empty())
+        {
+            return false;
+        }
+        Entry &entry = loaded.back();
+        try
+        {
+            if (key == "option" && fields.size() == 3)
+            {
+                entry.options[fields[1]] = std::stoul(fields[2]);
+            }
+            else if (key == "area" && fields.size() == 5)
+            {
+                entry.hasCapabilities = true;
+                entry.capabilities.minX = std::stod(fields[1]);
+                entry.capabilities.minY = std::stod(fields[2]);
+                entry.capabilities.maxX = std::stod(fields[3]);
+                entry.capabilities.maxY = std::stod(fields[4]);
+            }
+            else if (key == "resolutions")
+            {
+                for (size_t i = 1; i < fields.size() && !fields[i].empty(); ++i)
+                {
+                    entry.capabilities.possibleResolutionsInDPI.push_back(std::stoi(fields[i]));
+                }
+            }
+            else if (key == "sources")
+            {
+                entry.capabilities.possibleSources.assign(fields.begin() + 1, fields.end());
+            }
+            else if (key == "modes")
+            {
+                entry.capabilities.possibleModes.assign(fields.begin() + 1, fields.end());
+            }
+            else
+            {
+                return false;
+            }
+        }
+        catch (const std::exception &)
+        {
+            // A damaged file is treated like a missing one
+            return false;
+        }
+    }
+    entries = loaded;
+    return !entries.empty();
+}
+
+bool DeviceCache::save()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    const std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream stream(temporaryPath, std::ios::trunc);
+        stream << CACHE_HEADER << '\n';
+        stream << "version\t" << backendVersion << '\n';
+        stream << std::setprecision(17);
+        for (const auto &entry : entries)
+        {
+            stream << "device\t" << entry.device.name << '\t' << entry.device.vendor << '\t' << entry.device.model << '\n';
+            for (const auto &option : entry.options)
+            {
+                stream << "option\t" << option.first << '\t' << option.second << '\n';
+            }
+            if (entry.hasCapabilities)
+            {
+                const ScannerCapabilities &capabilities = entry.capabilities;
+                stream << "area\t" << capabilities.minX << '\t' << capabilities.minY << '\t' << capabilities.maxX << '\t' << capabilities.maxY << '\n';
+                writeList(stream, "resolutions", capabilities.possibleResolutionsInDPI);
+                writeList(stream, "sources", capabilities.possibleSources);
+                writeList(stream, "modes", capabilities.possibleModes);
+            }
+        }
+        if (!stream.flush())
+        {
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+    return std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+}
+
+std::vector<DeviceCache::Device> DeviceCache::getDevices()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Device> devices;
+    for (const auto &entry : entries)
+    {
+        devices.push_back(entry.device);
+    }
+    return devices;
+}
+
+bool DeviceCache::setDevices(const std::vector<Device> &devices)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    bool changed = devices.size() != entries.size();
+    std::vector<Entry> updated;
+    for (size_t i = 0; i < devices.size(); ++i)
+    {
+        const Device &device = devices[i];
+        auto previous = std::find_if(entries.begin(), entries.end(), [&](const Entry &entry) {
+            return entry.device.name == device.name && entry.device.vendor == device.vendor && entry.device.model == device.model;
+        });
+        if (previous != entries.end())
+        {
+            updated.push_back(*previous);
+        }
+        else
+        {
+            Entry entry;
+            entry.device = device;
+            updated.push_back(entry);
+        }
+        changed = changed || i >= entries.size() || entries[i].device.name != device.name ||
+                  entries[i].device.vendor != device.vendor || entries[i].device.model != device.model;
+    }
+    entries = updated;
+    return changed;
+}
+
+void DeviceCache::removeDevice(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [&](const Entry &entry) { return entry.device.name == name; }), entries.end());
+}
+
+bool DeviceCache::getOptionMap(const std::string &name, OptionMap &options)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry *entry = findEntry(name);
+    if (!entry || entry->options.empty())
+    {
+        return false;
+    }
+    options = entry->options;
+    return true;
+}
+
+void DeviceCache::setOptionMap(const std::string &name, const OptionMap &options)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (Entry *entry = findEntry(name))
+    {
+        entry->options = options;
+    }
+}
+
+bool DeviceCache::getCapabilities(const std::string &name, ScannerCapabilities &capabilities)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry *entry = findEntry(name);
+    if (!entry || !entry->hasCapabilities)
+    {
+        return false;
+    }
+    capabilities = entry->capabilities;
+    return true;
+}
+
+void DeviceCache::setCapabilities(const std::string &name, const ScannerCapabilities &capabilities)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (Entry *entry = findEntry(name))
+    {
+        entry->hasCapabilities = true;
+        entry->capabilities = capabilities;
+    }
+}
+
+void DeviceCache::invalidate(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (Entry *entry = findEntry(name))
+    {
+        entry->options.clear();
+        entry->hasCapabilities = false;
+        entry->capabilities = ScannerCapabilities();
+    }
+}
+
+DeviceCache::Entry *DeviceCache::findEntry(const std::string &name)
+{
+    for (auto &entry : entries)
+    {
+        if (entry.device.name == name)
+        {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
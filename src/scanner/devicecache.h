@@ -0,0 +1,87 @@
+#pragma once
+
+#include "iscannertypes.h"
+
+#include <mutex>
+
+SHARED_PTR(DeviceCache);
+/**
+ * Persistent cache of the devices, their option indices & capabilities, so that a restarted
+ * process does not have to probe the backends & walk the option descriptors again.
+ * The entries are keyed by device name, vendor & model, the whole file by the backend version.
+ * All methods may be called from any thread.
+ */
+class DeviceCache
+{
+public:
+  /**
+   * Identification of a device as reported by the backend
+   */
+  struct Device
+  {
+    std::string name;
+    std::string vendor;
+    std::string model;
+  };
+
+  typedef std::map<std::string, unsigned int> OptionMap;
+
+  explicit DeviceCache(const std::string &path);
+
+  /**
+   * Read the cache file. A missing, unreadable or outdated file (other backend version) leaves the cache empty.
+   * @return true, if entries were loaded
+   */
+  bool load(int backendVersion);
+
+  /**
+   * Write the cache file (atomically, through a temporary file).
+   * @return true, if the file was written
+   */
+  bool save();
+
+  /**
+   * The cached device list (empty, if nothing is cached)
+   */
+  std::vector<Device> getDevices();
+
+  /**
+   * Replace the device list. Option maps & capabilities of devices that are still present are kept.
+   * @return true, if the list differs from the cached one
+   */
+  bool setDevices(const std::vector<Device> &devices);
+
+  /**
+   * Drop a device, e.g. because it could not be opened anymore.
+   */
+  void removeDevice(const std::string &name);
+
+  bool getOptionMap(const std::string &name, OptionMap &options);
+
+  void setOptionMap(const std::string &name, const OptionMap &options);
+
+  bool getCapabilities(const std::string &name, ScannerCapabilities &capabilities);
+
+  void setCapabilities(const std::string &name, const ScannerCapabilities &capabilities);
+
+  /**
+   * Forget the option map & capabilities of a device, they are rebuilt on the next access.
+   */
+  void invalidate(const std::string &name);
+
+private:
+  struct Entry
+  {
+    Device device;
+    OptionMap options;
+    bool hasCapabilities = false;
+    ScannerCapabilities capabilities;
+  };
+
+  Entry *findEntry(const std::string &name);
+
+  std::string path;
+  int backendVersion = 0;
+  std::vector<Entry> entries;
+  std::mutex mutex;
+};
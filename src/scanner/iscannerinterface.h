@@ -1,6 +1,8 @@
 #pragma once
 
 #include "iscannertypes.h"
+#include "iscanreceiver.h"
+#include "iscansession.h"
 
 SHARED_PTR(IScannerInterface);
 /**
@@ -36,12 +38,42 @@ public:
 
   /**
    * Set the scanner's configuration for the next scan operations.
+   * Only changed options are written, negative numbers & empty strings leave an option as it is.
    */
   virtual void setConfiguration(ScannerDeviceDescriptorPtr device, const ScannerConfiguration &configruation) = 0;
 
+  /**
+   * Counters of the backend traffic, e.g. the option writes saved by only writing changed options
+   */
+  virtual ScannerStatistics getStatistics() = 0;
+
   /**
    * Scan an image with the active configuration to a buffer and return it.
    * @return an image buffer with the scanned image
    */
   virtual RawImagePtr scanToBuffer(ScannerDeviceDescriptorPtr device) = 0;
+
+  /**
+   * Scan an image with the active configuration and hand the rows to the receiver as they arrive.
+   */
+  virtual void scan(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver) = 0;
+
+  /**
+   * Start a scan with the active configuration, whose data is read by the caller (see IScanSession).
+   * The receiver has to outlive the session.
+   */
+  virtual IScanSessionPtr startScan(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver) = 0;
+
+  /**
+   * Scan all pages of the document feeder until it runs out of documents, any other source (a flatbed) scans one page.
+   * Each page is handed to the receiver as begin, rows & end.
+   * @return the number of scanned pages
+   */
+  virtual unsigned int scanBatch(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver) = 0;
+
+  /**
+   * Abort the scan running on the device, may be called from another thread.
+   * The running scan stops as soon as possible & throws, without a running scan nothing happens.
+   */
+  virtual void cancel(ScannerDeviceDescriptorPtr device) = 0;
 };
\ No newline at end of file
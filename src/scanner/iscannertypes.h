@@ -1,6 +1,7 @@
 #pragma once
 
 #include "utils/types.h"
+#include "scantimeline.h"
 
 SHARED_STRUCT_PTR(ScannerDeviceDescriptor);
 SHARED_STRUCT_PTR(InternalScannerDevice);
@@ -50,4 +51,150 @@ struct ScannerConfiguration
     int resolutionInDPI = -1;
     std::string source;
     std::string mode;
+    /**
+     * Preview mode of the backend (1 on, 0 off, -1 unknown resp. unchanged), ignored if the device has none
+     */
+    int preview = -1;
+};
+
+/**
+ * The area covered by a preview scan & the size of the preview image, to map pixels to mm
+ */
+struct PreviewArea
+{
+    double fromX = 0;
+    double fromY = 0;
+    double toX = 0;
+    double toY = 0;
+    int resolutionInDPI = -1;
+    unsigned int width = 0;
+    unsigned int height = 0;
+};
+
+/**
+ * Counters of the traffic between the library & the scanner backend
+ */
+struct ScannerStatistics
+{
+    unsigned long long optionWrites = 0;
+    /**
+     * Writes that were not needed, because the option already had the value
+     */
+    unsigned long long skippedOptionWrites = 0;
+};
+
+/**
+ * Priority classes of the jobs queued for a device, a waiting job of a higher class starts first
+ */
+enum class JobPriority
+{
+    /**
+     * A user is waiting for the result (previews, option changes)
+     */
+    Interactive,
+    Normal,
+    /**
+     * Long running work, that may wait (document feeder batches)
+     */
+    Batch
+};
+
+/**
+ * A scan job as it is queued for its device
+ */
+struct ScanJob
+{
+    ScanJob(JobPriority priority_ = JobPriority::Normal, unsigned long long id_ = 0)
+        : priority(priority_), id(id_)
+    {
+    }
+
+    JobPriority priority;
+
+    /**
+     * Identifies the job to cancel it (see ScanService::createJobId), 0 for a job that cannot be cancelled
+     */
+    unsigned long long id;
+
+    /**
+     * Records the phases of the job's scan, if set (see ScanTimeline)
+     */
+    ScanTimelinePtr timeline;
+
+    /**
+     * Wait for a busy device. A job that must not block (e.g. a call on the javascript thread, whose event loop
+     * may drive the running job) fails right away instead.
+     */
+    bool waitForTurn = true;
+};
+
+/**
+ * State & counters of the job queue of a device
+ */
+struct QueueStatistics
+{
+    /**
+     * Jobs waiting for the device
+     */
+    unsigned int depth = 0;
+
+    bool busy = false;
+
+    unsigned long long startedJobs = 0;
+
+    /**
+     * Jobs cancelled while they were waiting or running
+     */
+    unsigned long long cancelledJobs = 0;
+
+    /**
+     * Time the started jobs waited for the device (in ms)
+     */
+    double totalWaitTime = 0;
+    double maximumWaitTime = 0;
+
+    double getAverageWaitTime() const
+    {
+        return startedJobs ? totalWaitTime / startedJobs : 0;
+    }
+};
+
+/**
+ * Detection of blank pages (e.g. the empty back sides of a duplex batch)
+ */
+struct BlankPageOptions
+{
+    /**
+     * Drop blank pages instead of storing them
+     */
+    bool skip = false;
+
+    /**
+     * Samples below this value count as ink, the default ignores paper texture & show-through
+     */
+    unsigned char inkThreshold = 128;
+
+    /**
+     * Pages with at most this fraction of ink samples are blank
+     */
+    double maximumInkCoverage = 0.0005;
+};
+
+/**
+ * A page scanned from the document feeder
+ */
+struct ScannedPage
+{
+    /**
+     * Position of the page in the feeder (from 1)
+     */
+    unsigned int number = 0;
+
+    /**
+     * The file the page was stored to, empty if it was dropped as blank
+     */
+    std::string path;
+
+    PageStatistics statistics;
+    bool blank = false;
 };
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "iscannertypes.h"
+
+class ScanTimeline;
+
+/**
+ * Receives the image of a running scan row by row.
+ * The calls happen on the thread that runs the scan.
+ */
+class IScanReceiver
+{
+public:
+  virtual ~IScanReceiver() {}
+
+  /**
+   * Called once the image dimensions are known, before any row is delivered.
+   */
+  virtual void begin(const ImageHeader &header) = 0;
+
+  /**
+   * Called with a batch of completed rows.
+   * @param pixels the pixel data of the rows, only valid during the call
+   * @param y the index of the first row in the batch
+   * @param count the number of rows in the batch
+   */
+  virtual void rows(const unsigned char *pixels, unsigned int y, unsigned int count) = 0;
+
+  /**
+   * Called after the last row was delivered.
+   */
+  virtual void end() = 0;
+
+  /**
+   * Samples below this value count as ink in the page statistics.
+   * Receivers that need no statistics return 0, the rows are not analysed then.
+   */
+  virtual unsigned char getInkThreshold() const
+  {
+    return 0;
+  }
+
+  /**
+   * Called before end() with the statistics of all delivered samples, if the receiver has an ink threshold.
+   */
+  virtual void statistics(const PageStatistics &statistics)
+  {
+  }
+
+  /**
+   * The timeline the scan is recorded in, nullptr if the scan is not measured (the default)
+   */
+  virtual ScanTimeline *getTimeline() const
+  {
+    return nullptr;
+  }
+};
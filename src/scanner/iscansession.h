@@ -0,0 +1,29 @@
+#pragma once
+
+#include "iscannertypes.h"
+
+SHARED_PTR(IScanSession);
+/**
+ * A started scan, whose data is read step by step (e.g. when an event loop reports the scanner's descriptor as readable).
+ * The rows go to the receiver the session was started with. Destroying the session ends (or aborts) the scan.
+ */
+class IScanSession
+{
+public:
+  virtual ~IScanSession() {}
+
+  /**
+   * The descriptor that becomes readable when the scanner has data, -1 if the scan cannot be polled.
+   * Without descriptor read() blocks until it has data, so it has to run on a thread of its own.
+   * At the end of a frame of a multi frame scan it is -1 as well: the next read() starts the next frame (blocking, sane_start),
+   * the descriptor may change then.
+   */
+  virtual int getSelectFd() = 0;
+
+  /**
+   * Read the data that is available (a few buffers at most) & hand the completed rows to the receiver
+   * @return true, once the scan is complete
+   * @throws std::runtime_error if the scan fails or was cancelled
+   */
+  virtual bool read() = 0;
+};
@@ -0,0 +1,284 @@
+#include "jobscheduler.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+    const char *CANCELLED_MESSAGE = "The scan job was cancelled.";
+    const char *BUSY_MESSAGE = "The scanner is busy.";
+}
+
+JobScheduler::Turn::Turn(JobScheduler &scheduler_, ScannerDeviceDescriptorPtr device_, std::shared_ptr<Job> job_)
+    : scheduler(&scheduler_), device(device_), job(job_)
+{
+}
+
+JobScheduler::Turn::Turn(Turn &&other)
+    : scheduler(other.scheduler), device(other.device), job(other.job)
+{
+    other.job = nullptr;
+}
+
+JobScheduler::Turn::~Turn()
+{
+    if (job)
+    {
+        scheduler->finish(device, job);
+    }
+}
+
+void JobScheduler::Turn::throwIfCancelled() const
+{
+    if (job && scheduler->isCancelled(job))
+    {
+        throw std::runtime_error(CANCELLED_MESSAGE);
+    }
+}
+
+JobScheduler::JobScheduler(std::function<void(ScannerDeviceDescriptorPtr)> cancelRunning_)
+    : cancelRunning(cancelRunning_)
+{
+}
+
+JobScheduler::Turn JobScheduler::start(ScannerDeviceDescriptorPtr device, const ScanJob &scanJob)
+{
+    std::vector<std::function<void()>> granted;
+    std::unique_lock<std::mutex> lock(mutex);
+    auto reservation = scanJob.id != 0 ? reserved.find(scanJob.id) : reserved.end();
+    if (reservation != reserved.end())
+    {
+        std::shared_ptr<Job> job = reservation->second;
+        reserved.erase(reservation);
+        if (!job->cancelled)
+        {
+            return Turn(*this, device, job);
+        }
+        DeviceQueue &queue = queues[device];
+        queue.statistics.cancelledJobs++;
+        if (queue.running == job)
+        {
+            queue.running = nullptr;
+            dispatch(queue, granted);
+        }
+        lock.unlock();
+        callGranted(granted);
+        throw std::runtime_error(CANCELLED_MESSAGE);
+    }
+
+    auto job = std::make_shared<Job>();
+    job->job = scanJob;
+    job->queuedAt = std::chrono::steady_clock::now();
+    job->sequence = nextSequence++;
+    DeviceQueue &queue = queues[device];
+    queue.waiting.push_back(job);
+    if (!scanJob.waitForTurn && (queue.running || getNext(queue) != job))
+    {
+        removeWaiting(queue, job);
+        throw std::runtime_error(BUSY_MESSAGE);
+    }
+    changed.wait(lock, [&]() { return job->cancelled || (!queue.running && getNext(queue) == job); });
+
+    removeWaiting(queue, job);
+    if (job->cancelled)
+    {
+        queue.statistics.cancelledJobs++;
+        // the job may have blocked others of a lower priority
+        dispatch(queue, granted);
+        lock.unlock();
+        callGranted(granted);
+        throw std::runtime_error(CANCELLED_MESSAGE);
+    }
+
+    run(queue, job);
+    return Turn(*this, device, job);
+}
+
+void JobScheduler::reserve(ScannerDeviceDescriptorPtr device, const ScanJob &scanJob, std::function<void()> onTurn)
+{
+    auto job = std::make_shared<Job>();
+    job->job = scanJob;
+    job->queuedAt = std::chrono::steady_clock::now();
+    job->onTurn = onTurn;
+
+    std::vector<std::function<void()>> granted;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job->sequence = nextSequence++;
+        DeviceQueue &queue = queues[device];
+        queue.waiting.push_back(job);
+        dispatch(queue, granted);
+    }
+    callGranted(granted);
+}
+
+void JobScheduler::release(unsigned long long jobId)
+{
+    std::vector<std::function<void()>> granted;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto reservation = reserved.find(jobId);
+        if (reservation == reserved.end())
+        {
+            return;
+        }
+        std::shared_ptr<Job> job = reservation->second;
+        reserved.erase(reservation);
+        for (auto &entry : queues)
+        {
+            DeviceQueue &queue = entry.second;
+            if (queue.running == job)
+            {
+                if (job->cancelled)
+                {
+                    queue.statistics.cancelledJobs++;
+                }
+                queue.running = nullptr;
+                dispatch(queue, granted);
+            }
+        }
+    }
+    callGranted(granted);
+}
+
+bool JobScheduler::cancel(unsigned long long jobId)
+{
+    if (jobId == 0)
+    {
+        return false;
+    }
+
+    std::vector<std::function<void()>> granted;
+    bool found = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &entry : queues)
+        {
+            DeviceQueue &queue = entry.second;
+            if (queue.running && queue.running->job.id == jobId)
+            {
+                if (!queue.running->cancelled)
+                {
+                    queue.running->cancelled = true;
+                    cancelRunning(entry.first);
+                }
+                found = true;
+                break;
+            }
+            for (auto &job : queue.waiting)
+            {
+                if (job->job.id == jobId)
+                {
+                    job->cancelled = true;
+                    if (job->onTurn)
+                    {
+                        // a reserved job learns of the cancel in its start()
+                        std::shared_ptr<Job> cancelled = job;
+                        removeWaiting(queue, cancelled);
+                        reserved[jobId] = cancelled;
+                        granted.push_back(cancelled->onTurn);
+                    }
+                    dispatch(queue, granted);
+                    found = true;
+                    break;
+                }
+            }
+            if (found)
+            {
+                break;
+            }
+        }
+    }
+    callGranted(granted);
+    return found;
+}
+
+unsigned long long JobScheduler::createJobId()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return ++nextJobId;
+}
+
+QueueStatistics JobScheduler::getStatistics(ScannerDeviceDescriptorPtr device)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    const DeviceQueue &queue = queues[device];
+    QueueStatistics statistics = queue.statistics;
+    statistics.depth = static_cast<unsigned int>(queue.waiting.size());
+    statistics.busy = queue.running != nullptr;
+    return statistics;
+}
+
+std::shared_ptr<JobScheduler::Job> JobScheduler::getNext(const DeviceQueue &queue)
+{
+    std::shared_ptr<Job> next;
+    for (const auto &job : queue.waiting)
+    {
+        if (!job->cancelled && (!next || job->job.priority < next->job.priority ||
+                                (job->job.priority == next->job.priority && job->sequence < next->sequence)))
+        {
+            next = job;
+        }
+    }
+    return next;
+}
+
+void JobScheduler::removeWaiting(DeviceQueue &queue, const std::shared_ptr<Job> &job)
+{
+    queue.waiting.erase(std::remove(queue.waiting.begin(), queue.waiting.end(), job), queue.waiting.end());
+}
+
+void JobScheduler::run(DeviceQueue &queue, const std::shared_ptr<Job> &job)
+{
+    queue.running = job;
+    double waitTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - job->queuedAt).count();
+    queue.statistics.startedJobs++;
+    queue.statistics.totalWaitTime += waitTime;
+    queue.statistics.maximumWaitTime = std::max(queue.statistics.maximumWaitTime, waitTime);
+}
+
+void JobScheduler::dispatch(DeviceQueue &queue, std::vector<std::function<void()>> &granted)
+{
+    if (!queue.running)
+    {
+        std::shared_ptr<Job> next = getNext(queue);
+        if (next && next->onTurn)
+        {
+            removeWaiting(queue, next);
+            run(queue, next);
+            reserved[next->job.id] = next;
+            granted.push_back(next->onTurn);
+        }
+    }
+    changed.notify_all();
+}
+
+void JobScheduler::callGranted(const std::vector<std::function<void()>> &granted)
+{
+    for (const auto &onTurn : granted)
+    {
+        onTurn();
+    }
+}
+
+void JobScheduler::finish(ScannerDeviceDescriptorPtr device, const std::shared_ptr<Job> &job)
+{
+    std::vector<std::function<void()>> granted;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        DeviceQueue &queue = queues[device];
+        if (job->cancelled)
+        {
+            queue.statistics.cancelledJobs++;
+        }
+        queue.running = nullptr;
+        dispatch(queue, granted);
+    }
+    callGranted(granted);
+}
+
+bool JobScheduler::isCancelled(const std::shared_ptr<Job> &job)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return job->cancelled;
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "iscannertypes.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+
+/**
+ * Queues the jobs of each device: one job runs on a device at a time, the waiting jobs start by priority
+ * (first come, first served within a priority). Jobs of different devices run in parallel.
+ * Waiting & running jobs can be cancelled by their id.
+ */
+class JobScheduler
+{
+  struct Job;
+  struct DeviceQueue;
+
+public:
+  /**
+   * The device's turn for one job, the next job may start once it is destroyed
+   */
+  class Turn
+  {
+  public:
+    Turn(JobScheduler &scheduler, ScannerDeviceDescriptorPtr device, std::shared_ptr<Job> job);
+
+    Turn(Turn &&other);
+
+    ~Turn();
+
+    Turn(const Turn &) = delete;
+    Turn &operator=(const Turn &) = delete;
+    Turn &operator=(Turn &&) = delete;
+
+    /**
+     * @throws std::runtime_error if the job was cancelled while it was running
+     */
+    void throwIfCancelled() const;
+
+  private:
+    JobScheduler *scheduler;
+    ScannerDeviceDescriptorPtr device;
+    std::shared_ptr<Job> job;
+  };
+
+  /**
+   * @param cancelRunning aborts the work running on a device (e.g. the scanner's read), called with the scheduler locked
+   */
+  explicit JobScheduler(std::function<void(ScannerDeviceDescriptorPtr)> cancelRunning);
+
+  /**
+   * Queue the job & wait for its turn on the device. A job reserved before (see reserve) takes its reserved turn right away.
+   * @throws std::runtime_error if the job is cancelled while it is waiting, or the device is busy & the job does not wait for its turn
+   */
+  Turn start(ScannerDeviceDescriptorPtr device, const ScanJob &job);
+
+  /**
+   * Queue the job without waiting for its turn: onTurn is called once the device is reserved for the job
+   * (right away or on the thread that frees the device, with the scheduler unlocked), or once the job is cancelled.
+   * The job's start() then takes the reserved turn (or throws, if it was cancelled).
+   * @param job needs an id, that identifies the reservation
+   */
+  void reserve(ScannerDeviceDescriptorPtr device, const ScanJob &job, std::function<void()> onTurn);
+
+  /**
+   * Give up the reservation of a job, whose start() was never called (e.g. because the operation failed before),
+   * does nothing if it has none (anymore)
+   */
+  void release(unsigned long long jobId);
+
+  /**
+   * Cancel a waiting or running job
+   * @return false, if there is no such job (anymore)
+   */
+  bool cancel(unsigned long long jobId);
+
+  /**
+   * A new id for a job, that may be cancelled
+   */
+  unsigned long long createJobId();
+
+  QueueStatistics getStatistics(ScannerDeviceDescriptorPtr device);
+
+private:
+  struct Job
+  {
+    ScanJob job;
+
+    /**
+     * Position in the arrival order, for first come, first served within a priority
+     */
+    unsigned long long sequence;
+    std::chrono::steady_clock::time_point queuedAt;
+    bool cancelled = false;
+
+    /**
+     * Called when a reserved job's turn comes (see reserve), empty for a job that waits in start()
+     */
+    std::function<void()> onTurn;
+  };
+
+  struct DeviceQueue
+  {
+    std::vector<std::shared_ptr<Job>> waiting;
+    std::shared_ptr<Job> running;
+    QueueStatistics statistics;
+  };
+
+  /**
+   * The waiting job to start next (mutex held)
+   */
+  static std::shared_ptr<Job> getNext(const DeviceQueue &queue);
+
+  /**
+   * Remove a waiting job (mutex held)
+   */
+  static void removeWaiting(DeviceQueue &queue, const std::shared_ptr<Job> &job);
+
+  /**
+   * Make the job the running one (mutex held)
+   */
+  static void run(DeviceQueue &queue, const std::shared_ptr<Job> &job);
+
+  /**
+   * Reserve a free device for its next job, if that is a reserved one, & take the job's onTurn to be called (mutex held).
+   * The jobs waiting in start() are woken up.
+   */
+  void dispatch(DeviceQueue &queue, std::vector<std::function<void()>> &granted);
+
+  static void callGranted(const std::vector<std::function<void()>> &granted);
+
+  void finish(ScannerDeviceDescriptorPtr device, const std::shared_ptr<Job> &job);
+
+  bool isCancelled(const std::shared_ptr<Job> &job);
+
+  std::function<void(ScannerDeviceDescriptorPtr)> cancelRunning;
+
+  std::mutex mutex;
+
+  /**
+   * Signalled whenever a device becomes free or a job is cancelled
+   */
+  std::condition_variable changed;
+
+  std::map<ScannerDeviceDescriptorPtr, DeviceQueue> queues;
+
+  /**
+   * Reserved jobs, whose turn came (or that were cancelled), until their start() or release() (by job id)
+   */
+  std::map<unsigned long long, std::shared_ptr<Job>> reserved;
+
+  unsigned long long nextSequence = 0;
+  unsigned long long nextJobId = 0;
+};
@@ -0,0 +1,219 @@
+#include "pixelunpacker.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+// Upper bound for the rows converted in one batch
+const size_t CONVERSION_BUFFER_SIZE = 1024 * 1024;
+
+bool isPlanar(FrameParameters::Format format)
+{
+    return format == FrameParameters::Red || format == FrameParameters::Green || format == FrameParameters::Blue;
+}
+}
+
+PixelUnpacker::PixelUnpacker(IScanReceiver &receiver_, const PixelKernels &kernels_)
+    : receiver(receiver_), kernels(kernels_)
+{
+}
+
+ImageHeader PixelUnpacker::getImageHeader(const FrameParameters &parameters)
+{
+    ImageHeader header;
+    header.width = parameters.pixelsPerLine;
+    header.height = parameters.lines;
+    if (parameters.format == FrameParameters::Gray)
+    {
+        header.format = parameters.depth == 1 ? PixelFormat::Gray1 : parameters.depth == 16 ? PixelFormat::Gray16 : PixelFormat::Gray8;
+    }
+    else
+    {
+        // There is no 1 bit color format, such frames are expanded to 8 bit
+        header.format = parameters.depth == 16 ? PixelFormat::Rgb16 : PixelFormat::Rgb8;
+    }
+    return header;
+}
+
+void PixelUnpacker::beginFrame(const FrameParameters &parameters)
+{
+    if (parameters.bytesPerLine == 0)
+    {
+        throw std::runtime_error("The frame has no data.");
+    }
+    if (parameters.depth != 1 && parameters.depth != 8 && parameters.depth != 16)
+    {
+        throw std::runtime_error("Unsupported bit depth: " + std::to_string(parameters.depth));
+    }
+
+    frame = parameters;
+    row = 0;
+    partialBytes = 0;
+    partialRow.resize(frame.bytesPerLine);
+
+    if (!begun)
+    {
+        header = getImageHeader(frame);
+        outputBytesPerRow = static_cast<unsigned int>(header.getBytesPerRow());
+        inkThreshold = receiver.getInkThreshold();
+        statistics = PageStatistics();
+        receiver.begin(header);
+        begun = true;
+    }
+
+    samplesPerRow = frame.pixelsPerLine * (frame.format == FrameParameters::Rgb ? 3 : 1);
+    if (static_cast<size_t>(samplesPerRow) * frame.depth > static_cast<size_t>(frame.bytesPerLine) * 8)
+    {
+        throw std::runtime_error("The frame's lines are shorter than its pixels.");
+    }
+    if (inkThreshold && getBitsPerSample(header.format) != 8)
+    {
+        statisticsRow.resize(static_cast<size_t>(header.width) * getChannels(header.format));
+    }
+
+    if (isPlanar(frame.format))
+    {
+        planarImage.resize(static_cast<size_t>(outputBytesPerRow) * header.height);
+        converted.resize(static_cast<size_t>(frame.pixelsPerLine) * getBitsPerSample(header.format) / 8);
+    }
+    else
+    {
+        size_t rowsPerBatch = std::max<size_t>(1, CONVERSION_BUFFER_SIZE / std::max(1u, outputBytesPerRow));
+        converted.resize(rowsPerBatch * outputBytesPerRow);
+    }
+}
+
+void PixelUnpacker::feed(const unsigned char *data, size_t length)
+{
+    const unsigned int bytesPerLine = frame.bytesPerLine;
+    while (length > 0 && row < frame.lines)
+    {
+        if (partialBytes > 0 || length < bytesPerLine)
+        {
+            size_t missing = std::min<size_t>(bytesPerLine - partialBytes, length);
+            std::memcpy(partialRow.data() + partialBytes, data, missing);
+            partialBytes += missing;
+            data += missing;
+            length -= missing;
+            if (partialBytes == bytesPerLine)
+            {
+                partialBytes = 0;
+                unpackRows(partialRow.data(), 1);
+            }
+            continue;
+        }
+
+        unsigned int completeRows = static_cast<unsigned int>(std::min<size_t>(length / bytesPerLine, frame.lines - row));
+        unpackRows(data, completeRows);
+        data += static_cast<size_t>(completeRows) * bytesPerLine;
+        length -= static_cast<size_t>(completeRows) * bytesPerLine;
+    }
+}
+
+void PixelUnpacker::unpackRows(const unsigned char *data, unsigned int count)
+{
+    if (isPlanar(frame.format))
+    {
+        const unsigned int sampleBytes = getBitsPerSample(header.format) / 8;
+        const unsigned int channelOffset = (frame.format - FrameParameters::Red) * sampleBytes;
+        for (unsigned int i = 0; i < count; ++i, ++row)
+        {
+            convertRow(data + static_cast<size_t>(i) * frame.bytesPerLine, converted.data(), frame.pixelsPerLine);
+            unsigned char *destination = planarImage.data() + static_cast<size_t>(row) * outputBytesPerRow + channelOffset;
+            for (unsigned int x = 0; x < frame.pixelsPerLine; ++x)
+            {
+                std::memcpy(destination + x * 3 * sampleBytes, converted.data() + x * sampleBytes, sampleBytes);
+            }
+        }
+        return;
+    }
+
+    // Fast path: the raw rows already are the output rows (no expansion & no padding)
+    if (frame.bytesPerLine == outputBytesPerRow && !(frame.depth == 1 && frame.format != FrameParameters::Gray))
+    {
+        accumulateStatistics(data, count);
+        receiver.rows(data, row, count);
+        row += count;
+        return;
+    }
+
+    const unsigned int rowsPerBatch = static_cast<unsigned int>(converted.size() / outputBytesPerRow);
+    while (count > 0)
+    {
+        unsigned int batch = std::min(count, rowsPerBatch);
+        for (unsigned int i = 0; i < batch; ++i)
+        {
+            convertRow(data + static_cast<size_t>(i) * frame.bytesPerLine, converted.data() + static_cast<size_t>(i) * outputBytesPerRow, samplesPerRow);
+        }
+        accumulateStatistics(converted.data(), batch);
+        receiver.rows(converted.data(), row, batch);
+        row += batch;
+        count -= batch;
+        data += static_cast<size_t>(batch) * frame.bytesPerLine;
+    }
+}
+
+void PixelUnpacker::convertRow(const unsigned char *source, unsigned char *destination, unsigned int samples)
+{
+    if (frame.depth == 1 && frame.format != FrameParameters::Gray)
+    {
+        // For color frames a set bit is full intensity.
+        kernels.expand1To8(source, destination, samples, 0xFF);
+        return;
+    }
+    // Lineart stays packed, 8 & 16 bit samples are kept as they are: only the line padding is dropped
+    std::memcpy(destination, source, (static_cast<size_t>(samples) * frame.depth + 7) / 8);
+}
+
+void PixelUnpacker::accumulateStatistics(const unsigned char *pixels, unsigned int count)
+{
+    if (!inkThreshold)
+    {
+        return;
+    }
+    if (getBitsPerSample(header.format) == 8)
+    {
+        kernels.accumulateStatistics(pixels, static_cast<size_t>(count) * outputBytesPerRow, inkThreshold, statistics);
+        return;
+    }
+    // The statistics are collected on 8 bit samples, wider & narrower rows are converted one at a time
+    const unsigned int samples = header.width * getChannels(header.format);
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        const unsigned char *source = pixels + static_cast<size_t>(i) * outputBytesPerRow;
+        if (header.format == PixelFormat::Gray1)
+        {
+            kernels.expand1To8(source, statisticsRow.data(), samples, 0x00);
+        }
+        else
+        {
+            kernels.narrow16To8(source, statisticsRow.data(), samples);
+        }
+        kernels.accumulateStatistics(statisticsRow.data(), samples, inkThreshold, statistics);
+    }
+}
+
+void PixelUnpacker::endFrame()
+{
+    // The receiver's buffer may be pooled: missing rows would keep the pixels of an earlier scan
+    if (row < frame.lines)
+    {
+        throw std::runtime_error("The frame ended after " + std::to_string(row) + " of its " + std::to_string(frame.lines) + " lines.");
+    }
+    if (!frame.lastFrame)
+    {
+        return;
+    }
+    if (isPlanar(frame.format) && header.height > 0)
+    {
+        accumulateStatistics(planarImage.data(), header.height);
+        receiver.rows(planarImage.data(), 0, header.height);
+        planarImage = std::vector<unsigned char>();
+    }
+    if (inkThreshold)
+    {
+        receiver.statistics(statistics);
+    }
+    receiver.end();
+}
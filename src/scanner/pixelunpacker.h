@@ -0,0 +1,97 @@
+#pragma once
+
+#include "iscanreceiver.h"
+#include "utils/pixelkernels.h"
+
+/**
+ * Layout of a frame, as delivered by the scanner (mirrors SANE_Parameters)
+ */
+struct FrameParameters
+{
+  enum Format
+  {
+    Gray,
+    Rgb,
+    Red,
+    Green,
+    Blue
+  };
+
+  Format format = Rgb;
+  bool lastFrame = true;
+  unsigned int bytesPerLine = 0;
+  unsigned int pixelsPerLine = 0;
+  unsigned int lines = 0;
+  unsigned int depth = 8;
+};
+
+/**
+ * Converts the raw byte stream of a scan to rows of pixels in their native format (lineart, 8 or 16 bit gray or RGB).
+ * Handles every frame format & depth, rows split between reads and the padding at the end of a line.
+ * Only 1 bit color frames are expanded to 8 bit, as no encoder supports them.
+ * Rows that need no conversion are passed to the receiver without copying them.
+ * If the receiver asks for page statistics, the rows are analysed while they are hot in the cache.
+ */
+class PixelUnpacker
+{
+public:
+  explicit PixelUnpacker(IScanReceiver &receiver, const PixelKernels &kernels = getPixelKernels());
+
+  /**
+   * Start a new frame. Starts the image on the receiver with the first frame.
+   */
+  void beginFrame(const FrameParameters &parameters);
+
+  /**
+   * Feed the next chunk of raw frame data, as read from the scanner.
+   */
+  void feed(const unsigned char *data, size_t length);
+
+  /**
+   * Complete the current frame. Ends the image on the receiver after the last frame.
+   * @throws std::runtime_error if the frame ended before all of its lines arrived
+   */
+  void endFrame();
+
+  /**
+   * Derive the image header for the given (first) frame.
+   */
+  static ImageHeader getImageHeader(const FrameParameters &parameters);
+
+private:
+  /**
+   * Convert & deliver complete raw rows
+   */
+  void unpackRows(const unsigned char *data, unsigned int count);
+
+  /**
+   * Convert the samples of a single raw row to the output format
+   */
+  void convertRow(const unsigned char *source, unsigned char *destination, unsigned int samples);
+
+  /**
+   * Add output rows to the page statistics, if the receiver asked for them
+   */
+  void accumulateStatistics(const unsigned char *pixels, unsigned int count);
+
+  IScanReceiver &receiver;
+  const PixelKernels &kernels;
+
+  ImageHeader header;
+  FrameParameters frame;
+  bool begun = false;
+
+  unsigned char inkThreshold = 0;
+  PageStatistics statistics;
+
+  unsigned int samplesPerRow = 0;
+  unsigned int outputBytesPerRow = 0;
+  unsigned int row = 0;
+
+  std::vector<unsigned char> partialRow;
+  unsigned int partialBytes = 0;
+
+  std::vector<unsigned char> converted;
+  std::vector<unsigned char> planarImage;
+  std::vector<unsigned char> statisticsRow;
+};
@@ -0,0 +1,31 @@
+#include "rawimagereceiver.h"
+
+#include <cstring>
+
+RawImageReceiver::RawImageReceiver(const ImageStorage &storage_) : storage(storage_)
+{
+}
+
+void RawImageReceiver::begin(const ImageHeader &header)
+{
+    image = RawImagePtr(new RawImage(header.width, header.height, header.format, storage));
+}
+
+void RawImageReceiver::rows(const unsigned char *pixels, unsigned int y, unsigned int count)
+{
+    if (y >= image->height)
+    {
+        return;
+    }
+    count = std::min(count, image->height - y);
+    std::memcpy(image->pixels + y * image->bytesPerRow, pixels, count * image->bytesPerRow);
+}
+
+void RawImageReceiver::end()
+{
+}
+
+RawImagePtr RawImageReceiver::getImage() const
+{
+    return image;
+}
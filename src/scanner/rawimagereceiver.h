@@ -0,0 +1,30 @@
+#pragma once
+
+#include "iscanreceiver.h"
+
+/**
+ * Scan receiver that collects all rows in a raw image.
+ */
+class RawImageReceiver : public IScanReceiver
+{
+public:
+  /**
+   * @param storage where the pixels of the collected image live
+   */
+  explicit RawImageReceiver(const ImageStorage &storage = ImageStorage());
+
+  virtual void begin(const ImageHeader &header);
+
+  virtual void rows(const unsigned char *pixels, unsigned int y, unsigned int count);
+
+  virtual void end();
+
+  /**
+   * Access the collected image (nullptr until the scan has begun)
+   */
+  RawImagePtr getImage() const;
+
+private:
+  ImageStorage storage;
+  RawImagePtr image;
+};
@@ -0,0 +1,307 @@
+#include "replayscannerinterface.h"
+#include "rawimagereceiver.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <iostream>
+#include <stdexcept>
+
+SHARED_STRUCT_PTR(ReplayInternalScannerDevice);
+struct ReplayInternalScannerDevice : InternalScannerDevice
+{
+    /**
+     * The device's recorded scans (indices into the recording) & the one to replay next
+     */
+    std::vector<size_t> scans;
+    size_t nextScan = 0;
+
+    ScannerConfiguration configuration;
+
+    /**
+     * Guards the cancel of a running replay
+     */
+    std::mutex mutex;
+    std::condition_variable cancelledChanged;
+    bool scanning = false;
+    bool cancelled = false;
+
+    virtual ~ReplayInternalScannerDevice(){};
+};
+
+namespace
+{
+/**
+ * Merge the set fields of a configuration (negative numbers & empty strings are unchanged)
+ */
+void mergeConfiguration(ScannerConfiguration &configuration, const ScannerConfiguration &changes)
+{
+    auto mergeNumber = [](double &value, double change) {
+        if (change >= 0)
+        {
+            value = change;
+        }
+    };
+    mergeNumber(configuration.fromX, changes.fromX);
+    mergeNumber(configuration.fromY, changes.fromY);
+    mergeNumber(configuration.toX, changes.toX);
+    mergeNumber(configuration.toY, changes.toY);
+    if (changes.resolutionInDPI >= 0)
+    {
+        configuration.resolutionInDPI = changes.resolutionInDPI;
+    }
+    if (changes.preview >= 0)
+    {
+        configuration.preview = changes.preview;
+    }
+    if (!changes.source.empty())
+    {
+        configuration.source = changes.source;
+    }
+    if (!changes.mode.empty())
+    {
+        configuration.mode = changes.mode;
+    }
+}
+
+/**
+ * Replays the pages of a recorded scan step by step: the start of a frame, one recorded read or the end of a frame per step
+ */
+class ReplaySession : public IScanSession
+{
+public:
+    ReplaySession(ReplayInternalScannerDevicePtr device_, const RecordedScan &scan_, size_t pages_, IScanReceiver &receiver_, ReplayScannerInterface::Pace pace_)
+        : device(device_), scan(scan_), pages(std::min(pages_, scan_.pages.size())), receiver(receiver_), timeline(receiver_.getTimeline()), pace(pace_)
+    {
+        std::lock_guard<std::mutex> lock(device->mutex);
+        device->scanning = true;
+        device->cancelled = false;
+    }
+
+    ~ReplaySession()
+    {
+        std::lock_guard<std::mutex> lock(device->mutex);
+        device->scanning = false;
+        device->cancelled = false;
+    }
+
+    virtual int getSelectFd()
+    {
+        return -1;
+    }
+
+    virtual bool read()
+    {
+        if (page >= pages)
+        {
+            return true;
+        }
+        const std::vector<RecordedFrame> &frames = scan.pages[page];
+        if (frames.empty())
+        {
+            throw std::runtime_error("The recorded page has no frames.");
+        }
+        const RecordedFrame &frame = frames[frameIndex];
+
+        if (!started)
+        {
+            {
+                ScanTimeline::Span starting(timeline, ScanPhase::Start);
+                wait(frame.startTime);
+            }
+            if (!unpacker)
+            {
+                unpacker.reset(new PixelUnpacker(receiver));
+            }
+            ScanTimeline::Span unpacking(timeline, ScanPhase::Unpack);
+            unpacker->beginFrame(frame.parameters);
+            started = true;
+        }
+        else if (readIndex < frame.reads.size())
+        {
+            const RecordedRead &recordedRead = frame.reads[readIndex++];
+            ScanTimeline::Clock::time_point start = ScanTimeline::Clock::now();
+            wait(recordedRead.waitTime);
+            if (timeline)
+            {
+                timeline->addRead(start, recordedRead.data.size());
+            }
+            ScanTimeline::Span unpacking(timeline, ScanPhase::Unpack);
+            unpacker->feed(recordedRead.data.data(), recordedRead.data.size());
+        }
+        else
+        {
+            {
+                ScanTimeline::Span unpacking(timeline, ScanPhase::Unpack);
+                unpacker->endFrame();
+            }
+            started = false;
+            readIndex = 0;
+            if (++frameIndex == frames.size())
+            {
+                // a page begins the image on a new unpacker
+                unpacker.reset();
+                frameIndex = 0;
+                page++;
+            }
+        }
+        return page >= pages;
+    }
+
+private:
+    /**
+     * Wait as long as the scanner did (at the original pace), a cancel ends the wait
+     * @throws std::runtime_error if the replay was cancelled
+     */
+    void wait(unsigned int microseconds)
+    {
+        std::unique_lock<std::mutex> lock(device->mutex);
+        if (pace == ReplayScannerInterface::Original)
+        {
+            device->cancelledChanged.wait_for(lock, std::chrono::microseconds(microseconds), [this]() { return device->cancelled; });
+        }
+        if (device->cancelled)
+        {
+            throw std::runtime_error("The scan was cancelled.");
+        }
+    }
+
+    ReplayInternalScannerDevicePtr device;
+    const RecordedScan &scan;
+    size_t pages;
+    IScanReceiver &receiver;
+    ScanTimeline *timeline;
+    ReplayScannerInterface::Pace pace;
+
+    std::unique_ptr<PixelUnpacker> unpacker;
+    size_t page = 0;
+    size_t frameIndex = 0;
+    size_t readIndex = 0;
+    bool started = false;
+};
+}
+
+ReplayScannerInterface::ReplayScannerInterface(const std::string &recordingFile_, Pace pace_)
+    : recordingFile(recordingFile_), pace(pace_)
+{
+}
+
+bool ReplayScannerInterface::init()
+{
+    try
+    {
+        scans = ScanRecording::load(recordingFile);
+    }
+    catch (const std::exception &exception)
+    {
+        std::cerr << exception.what() << std::endl;
+        return false;
+    }
+
+    devices.clear();
+    for (size_t i = 0; i < scans.size(); ++i)
+    {
+        auto existing = std::find_if(devices.begin(), devices.end(), [&](ScannerDeviceDescriptorPtr device) { return device->descriptor == scans[i].descriptor; });
+        if (existing == devices.end())
+        {
+            ReplayInternalScannerDevicePtr replayDevice(new ReplayInternalScannerDevice());
+            replayDevice->configuration = scans[i].configuration;
+
+            ScannerDeviceDescriptorPtr device(new ScannerDeviceDescriptor());
+            device->descriptor = scans[i].descriptor;
+            device->device = replayDevice;
+            existing = devices.insert(devices.end(), device);
+        }
+        std::dynamic_pointer_cast<ReplayInternalScannerDevice>((*existing)->device)->scans.push_back(i);
+    }
+    return !scans.empty();
+}
+
+bool ReplayScannerInterface::exit()
+{
+    return true;
+}
+
+std::vector<ScannerDeviceDescriptorPtr> ReplayScannerInterface::getDevices()
+{
+    return devices;
+}
+
+ScannerCapabilities ReplayScannerInterface::getCapabilities(ScannerDeviceDescriptorPtr device)
+{
+    ReplayInternalScannerDevicePtr replayDevice = std::dynamic_pointer_cast<ReplayInternalScannerDevice>(device->device);
+    return scans[replayDevice->scans.front()].capabilities;
+}
+
+ScannerConfiguration ReplayScannerInterface::getConfiguration(ScannerDeviceDescriptorPtr device)
+{
+    return std::dynamic_pointer_cast<ReplayInternalScannerDevice>(device->device)->configuration;
+}
+
+void ReplayScannerInterface::setConfiguration(ScannerDeviceDescriptorPtr device, const ScannerConfiguration &configuration)
+{
+    mergeConfiguration(std::dynamic_pointer_cast<ReplayInternalScannerDevice>(device->device)->configuration, configuration);
+    optionWrites++;
+}
+
+ScannerStatistics ReplayScannerInterface::getStatistics()
+{
+    ScannerStatistics statistics;
+    statistics.optionWrites = optionWrites;
+    return statistics;
+}
+
+RawImagePtr ReplayScannerInterface::scanToBuffer(ScannerDeviceDescriptorPtr device)
+{
+    RawImageReceiver receiver;
+    scan(device, receiver);
+    return receiver.getImage();
+}
+
+void ReplayScannerInterface::scan(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver)
+{
+    IScanSessionPtr session = startScan(device, receiver);
+    while (!session->read())
+    {
+    }
+}
+
+IScanSessionPtr ReplayScannerInterface::startScan(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver)
+{
+    const RecordedScan &recordedScan = takeNextScan(device);
+    if (recordedScan.pages.empty())
+    {
+        throw std::runtime_error("Could not start the scan: Document feeder out of documents");
+    }
+    ReplayInternalScannerDevicePtr replayDevice = std::dynamic_pointer_cast<ReplayInternalScannerDevice>(device->device);
+    return IScanSessionPtr(new ReplaySession(replayDevice, recordedScan, 1, receiver, pace));
+}
+
+unsigned int ReplayScannerInterface::scanBatch(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver)
+{
+    const RecordedScan &recordedScan = takeNextScan(device);
+    ReplayInternalScannerDevicePtr replayDevice = std::dynamic_pointer_cast<ReplayInternalScannerDevice>(device->device);
+    ReplaySession session(replayDevice, recordedScan, recordedScan.pages.size(), receiver, pace);
+    while (!session.read())
+    {
+    }
+    return static_cast<unsigned int>(recordedScan.pages.size());
+}
+
+void ReplayScannerInterface::cancel(ScannerDeviceDescriptorPtr device)
+{
+    ReplayInternalScannerDevicePtr replayDevice = std::dynamic_pointer_cast<ReplayInternalScannerDevice>(device->device);
+    std::lock_guard<std::mutex> lock(replayDevice->mutex);
+    if (replayDevice->scanning)
+    {
+        replayDevice->cancelled = true;
+        replayDevice->cancelledChanged.notify_all();
+    }
+}
+
+const RecordedScan &ReplayScannerInterface::takeNextScan(ScannerDeviceDescriptorPtr device)
+{
+    ReplayInternalScannerDevicePtr replayDevice = std::dynamic_pointer_cast<ReplayInternalScannerDevice>(device->device);
+    size_t index = replayDevice->scans[replayDevice->nextScan];
+    replayDevice->nextScan = (replayDevice->nextScan + 1) % replayDevice->scans.size();
+    return scans[index];
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "iscannerinterface.h"
+#include "scanrecording.h"
+
+#include <atomic>
+#include <mutex>
+
+/**
+ * Scanner interface, that replays scans recorded by SaneScannerInterface (see SaneScannerInterface::setRecordingFile),
+ * so that the whole pipeline (reads, unpacking, encoding) can be run & measured without a scanner.
+ * Every recorded device is available, its scans are replayed in turn (starting over after the last one),
+ * the data arrives in the recorded chunks, at the recorded pace or as fast as possible.
+ * The calls for the same device have to be serialised by the caller (see ScanService).
+ */
+class ReplayScannerInterface : public IScannerInterface
+{
+public:
+  enum Pace
+  {
+    /**
+     * Wait as long as the scanner did for each sane_start & sane_read
+     */
+    Original,
+    AsFastAsPossible
+  };
+
+  /**
+   * The recording is loaded by init()
+   */
+  explicit ReplayScannerInterface(const std::string &recordingFile, Pace pace = Original);
+
+  /**
+   * Load the recording
+   * @return false, if the file cannot be read or has no scans
+   */
+  virtual bool init();
+
+  virtual bool exit();
+
+  /**
+   * The recorded devices
+   */
+  virtual std::vector<ScannerDeviceDescriptorPtr> getDevices();
+
+  /**
+   * The capabilities of the device's first recorded scan
+   */
+  virtual ScannerCapabilities getCapabilities(ScannerDeviceDescriptorPtr device);
+
+  /**
+   * The configuration of the device's first recorded scan, with the changes set since
+   */
+  virtual ScannerConfiguration getConfiguration(ScannerDeviceDescriptorPtr device);
+
+  /**
+   * Change the configuration, the replayed data stays as it was recorded
+   */
+  virtual void setConfiguration(ScannerDeviceDescriptorPtr device, const ScannerConfiguration &configuration);
+
+  virtual ScannerStatistics getStatistics();
+
+  virtual RawImagePtr scanToBuffer(ScannerDeviceDescriptorPtr device);
+
+  /**
+   * Replay the first page of the device's next recorded scan
+   */
+  virtual void scan(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver);
+
+  /**
+   * Replay the device's next recorded scan step by step: one recorded read per step, the session has no descriptor to poll
+   */
+  virtual IScanSessionPtr startScan(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver);
+
+  /**
+   * Replay all pages of the device's next recorded scan
+   */
+  virtual unsigned int scanBatch(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver);
+
+  /**
+   * Stop the replay running on the device, a pending wait ends right away
+   */
+  virtual void cancel(ScannerDeviceDescriptorPtr device);
+
+private:
+  /**
+   * The next recorded scan of the device (the scans of a device are replayed in turn)
+   */
+  const RecordedScan &takeNextScan(ScannerDeviceDescriptorPtr device);
+
+  std::string recordingFile;
+  Pace pace;
+
+  std::vector<RecordedScan> scans;
+  std::vector<ScannerDeviceDescriptorPtr> devices;
+
+  std::atomic<unsigned long long> optionWrites{0};
+};
@@ -0,0 +1,129 @@
+#include "saneoptionschema.h"
+
+#include <cstring>
+
+void SaneOptionSchema::load(SANE_Handle handle)
+{
+    options.clear();
+    indices.clear();
+
+    SANE_Int numDevOptions = 0;
+    sane_control_option(handle, 0, SANE_ACTION_GET_VALUE, &numDevOptions, 0);
+    options.resize(numDevOptions > 0 ? numDevOptions : 0);
+
+    std::vector<SANE_Byte> buffer;
+    for (int i = 0; i < numDevOptions; ++i)
+    {
+        const SANE_Option_Descriptor *descriptor = sane_get_option_descriptor(handle, i);
+        if (!descriptor)
+        {
+            continue;
+        }
+        SaneOption &option = options[i];
+        option.name = descriptor->name ? descriptor->name : "";
+        option.type = descriptor->type;
+        option.unit = descriptor->unit;
+        option.size = descriptor->size;
+        option.capabilities = descriptor->cap;
+        option.constraintType = descriptor->constraint_type;
+        switch (descriptor->constraint_type)
+        {
+        case SANE_CONSTRAINT_RANGE:
+            option.range = *descriptor->constraint.range;
+            break;
+        case SANE_CONSTRAINT_WORD_LIST:
+            // The first word is the length of the list
+            option.wordList.assign(descriptor->constraint.word_list + 1, descriptor->constraint.word_list + 1 + descriptor->constraint.word_list[0]);
+            break;
+        case SANE_CONSTRAINT_STRING_LIST:
+            for (int j = 0; descriptor->constraint.string_list[j] != nullptr; ++j)
+            {
+                option.stringList.push_back(descriptor->constraint.string_list[j]);
+            }
+            break;
+        default:
+            break;
+        }
+        if (!option.name.empty())
+        {
+            indices[option.name] = i;
+        }
+
+        if (i == 0 || !SANE_OPTION_IS_ACTIVE(option.capabilities) || option.type == SANE_TYPE_BUTTON || option.type == SANE_TYPE_GROUP || option.size <= 0)
+        {
+            continue;
+        }
+        buffer.assign(option.size + 1, 0);
+        if (sane_control_option(handle, i, SANE_ACTION_GET_VALUE, buffer.data(), nullptr) == SANE_STATUS_GOOD)
+        {
+            storeValue(option, buffer.data());
+        }
+    }
+    loaded = true;
+}
+
+void SaneOptionSchema::invalidate()
+{
+    loaded = false;
+    options.clear();
+    indices.clear();
+}
+
+bool SaneOptionSchema::isLoaded() const
+{
+    return loaded;
+}
+
+int SaneOptionSchema::indexOf(const std::string &name) const
+{
+    auto index = indices.find(name);
+    return index == indices.end() ? -1 : index->second;
+}
+
+const SaneOption *SaneOptionSchema::find(const std::string &name) const
+{
+    int index = indexOf(name);
+    return index < 0 ? nullptr : &options[index];
+}
+
+const std::vector<SaneOption> &SaneOptionSchema::getOptions() const
+{
+    return options;
+}
+
+SANE_Status SaneOptionSchema::setValue(SANE_Handle handle, int index, void *value)
+{
+    SANE_Int info = 0;
+    SANE_Status saneStatus = sane_control_option(handle, index, SANE_ACTION_SET_VALUE, value, &info);
+    if (saneStatus != SANE_STATUS_GOOD)
+    {
+        return saneStatus;
+    }
+    if (info & SANE_INFO_RELOAD_OPTIONS)
+    {
+        // Other options (or their constraints) may have changed as well
+        invalidate();
+    }
+    else if (loaded && index >= 0 && index < static_cast<int>(options.size()))
+    {
+        // The backend wrote the actually used value back (SANE_INFO_INEXACT).
+        // SANE_INFO_RELOAD_PARAMS only concerns the scan parameters, the other options are unchanged.
+        storeValue(options[index], value);
+    }
+    return saneStatus;
+}
+
+void SaneOptionSchema::storeValue(SaneOption &option, const void *value)
+{
+    option.hasValue = true;
+    if (option.type == SANE_TYPE_STRING)
+    {
+        const char *characters = static_cast<const char *>(value);
+        option.stringValue = std::string(characters, strnlen(characters, option.size));
+    }
+    else
+    {
+        const SANE_Word *words = static_cast<const SANE_Word *>(value);
+        option.value.assign(words, words + std::max<SANE_Int>(1, option.size / sizeof(SANE_Word)));
+    }
+}
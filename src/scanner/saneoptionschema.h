@@ -0,0 +1,80 @@
+#pragma once
+
+#include "utils/defines.h"
+
+#include <sane/sane.h>
+#include <unordered_map>
+
+/**
+ * Copy of a SANE option descriptor, its constraint & its current value
+ */
+struct SaneOption
+{
+  std::string name;
+  SANE_Value_Type type = SANE_TYPE_INT;
+  SANE_Unit unit = SANE_UNIT_NONE;
+  SANE_Int size = 0;
+  SANE_Int capabilities = 0;
+
+  SANE_Constraint_Type constraintType = SANE_CONSTRAINT_NONE;
+  SANE_Range range = {0, 0, 0};
+  std::vector<SANE_Word> wordList;
+  std::vector<std::string> stringList;
+
+  /**
+   * False for inactive options, buttons & groups
+   */
+  bool hasValue = false;
+  std::vector<SANE_Word> value;
+  std::string stringValue;
+};
+
+/**
+ * All options of an opened device, indexed by option number.
+ * Loaded once & served from memory, until a set reports SANE_INFO_RELOAD_OPTIONS.
+ * Not thread safe, the calls for a device are serialised anyway.
+ */
+class SaneOptionSchema
+{
+public:
+  /**
+   * Read all option descriptors & values of the device
+   */
+  void load(SANE_Handle handle);
+
+  /**
+   * Forget the options, they are loaded again on the next access
+   */
+  void invalidate();
+
+  bool isLoaded() const;
+
+  /**
+   * The option index for a name, -1 if the device does not have the option
+   */
+  int indexOf(const std::string &name) const;
+
+  /**
+   * Access an option by name (nullptr if the device does not have it)
+   */
+  const SaneOption *find(const std::string &name) const;
+
+  const std::vector<SaneOption> &getOptions() const;
+
+  /**
+   * Set an option on the device & keep the cached value in sync.
+   * @param value the value in the SANE representation, the backend may round it (SANE_INFO_INEXACT)
+   * @return the SANE status of the set, the schema is invalidated if the backend asked for a reload
+   */
+  SANE_Status setValue(SANE_Handle handle, int index, void *value);
+
+private:
+  /**
+   * Store the current value of an option in the cache
+   */
+  void storeValue(SaneOption &option, const void *value);
+
+  bool loaded = false;
+  std::vector<SaneOption> options;
+  std::unordered_map<std::string, int> indices;
+};
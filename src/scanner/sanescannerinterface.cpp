@@ -1,4 +1,8 @@
 #include "sanescannerinterface.h"
+#include "rawimagereceiver.h"
+#include "pixelunpacker.h"
+#include "saneoptionschema.h"
+#include "scanrecording.h"
 #include <sane/sane.h>
 #include <sane/saneopts.h>
 #include <iostream>
@@ -6,6 +10,9 @@
 #include <fstream>
 #include <cstring>
 #include <cmath>
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
 
 #define SANE_SANITY(saneStatus)                                                                                                                             \
     if (saneStatus != SANE_STATUS_GOOD)                                                                                                                     \
@@ -13,18 +20,98 @@
         std::stringstream stream;                                                                                                                           \
         stream << "Sane operation failed: . (code:" << saneStatus << " = " << sane_strstatus(saneStatus) << ", at: " << __FILE__ << ":" << __LINE__ << ")"; \
         std::cout << stream.str() << std::endl;                                                                                                             \
-        std::runtime_error(stream.str());                                                                                                                   \
+        throw std::runtime_error(stream.str());                                                                                                             \
     }
 
 SHARED_STRUCT_PTR(SaneInternalScannerDevice);
 struct SaneInternalScannerDevice : InternalScannerDevice
 {
-    const SANE_Device *device;
+    std::string name;
     SANE_Handle handle;
 
+    /**
+     * The device's options, valid while the device is open
+     */
+    SaneOptionSchema options;
+
+    /**
+     * Per device read buffer, so that different devices can be read in parallel
+     */
+    std::vector<SANE_Byte> readBuffer;
+
+    /**
+     * A scan is running & may be cancelled from another thread
+     */
+    std::atomic<bool> scanning{false};
+    std::atomic<bool> cancelled{false};
+
+    /**
+     * The cached capabilities were queued to be checked against the device
+     */
+    std::atomic<bool> capabilitiesChecked{false};
+
     virtual ~SaneInternalScannerDevice(){};
 };
 
+/**
+ * Serialises the background SANE calls (sane_get_devices, the checks of the cache) with the device calls:
+ * device calls run in parallel (shared), background work only runs while no device call does (exclusive).
+ * A scan session takes its share per step, a probe may run between the steps of a polled scan.
+ */
+class SaneCallGate
+{
+public:
+    class Shared
+    {
+    public:
+        explicit Shared(SaneCallGate &gate_) : gate(gate_)
+        {
+            std::unique_lock<std::mutex> lock(gate.mutex);
+            gate.changed.wait(lock, [this]() { return !gate.exclusive; });
+            gate.shared++;
+        }
+
+        ~Shared()
+        {
+            std::lock_guard<std::mutex> lock(gate.mutex);
+            if (--gate.shared == 0)
+            {
+                gate.changed.notify_all();
+            }
+        }
+
+    private:
+        SaneCallGate &gate;
+    };
+
+    class Exclusive
+    {
+    public:
+        explicit Exclusive(SaneCallGate &gate_) : gate(gate_)
+        {
+            std::unique_lock<std::mutex> lock(gate.mutex);
+            gate.changed.wait(lock, [this]() { return !gate.exclusive && gate.shared == 0; });
+            gate.exclusive = true;
+        }
+
+        ~Exclusive()
+        {
+            std::lock_guard<std::mutex> lock(gate.mutex);
+            gate.exclusive = false;
+            gate.changed.notify_all();
+        }
+
+    private:
+        SaneCallGate &gate;
+    };
+
+private:
+    std::mutex mutex;
+    std::condition_variable changed;
+    unsigned int shared = 0;
+    bool exclusive = false;
+};
+
 namespace
 {
 void authCallback(SANE_String_Const resource,
@@ -34,337 +121,939 @@ void authCallback(SANE_String_Const resource,
     throw std::runtime_error("Not implemented.");
 }
 
-const unsigned int SANE_BUFFER_SIZE = 1024 * 1024 * 8; // 1MB
-SANE_Byte buffer[SANE_BUFFER_SIZE];
+const unsigned int SANE_BUFFER_SIZE = 1024 * 1024 * 8; // 8MB
+
+/**
+ * Reads of a scan session per step, so that one fast scanner does not hold up an event loop
+ */
+const unsigned int MAX_READS_PER_STEP = 4;
 
 const unsigned int SCANE_NAME_BUFFER_SIZE = 128;
-SANE_Char stringValueBuffer[SCANE_NAME_BUFFER_SIZE];
+
+/**
+ * The options every supported device must have
+ */
+std::vector<std::string> getNeededOptions()
+{
+    std::vector<std::string> neededOptions;
+    neededOptions.push_back(SANE_NAME_SCAN_TL_X);
+    neededOptions.push_back(SANE_NAME_SCAN_TL_Y);
+    neededOptions.push_back(SANE_NAME_SCAN_BR_X);
+    neededOptions.push_back(SANE_NAME_SCAN_BR_Y);
+    neededOptions.push_back(SANE_NAME_SCAN_RESOLUTION);
+    neededOptions.push_back(SANE_NAME_SCAN_SOURCE);
+    neededOptions.push_back(SANE_NAME_SCAN_MODE);
+    return neededOptions;
 }
 
-SaneScannerInterface::SaneScannerInterface()
+/**
+ * The numeric value of an int or fixed point option
+ */
+double getNumber(const SaneOption &option)
 {
+    if (option.value.empty())
+    {
+        return -1;
+    }
+    return option.type == SANE_TYPE_FIXED ? SANE_UNFIX(option.value[0]) : option.value[0];
 }
 
-bool SaneScannerInterface::init()
+/**
+ * The SANE representation of a number for an int or fixed point option
+ */
+SANE_Word toWord(const SaneOption &option, double value)
 {
-    SANE_Int version_code = 0;
-    sane_init(&version_code, authCallback);
-    return true;
+    return option.type == SANE_TYPE_FIXED ? SANE_FIX(value) : static_cast<SANE_Word>(std::lround(value));
 }
 
-bool SaneScannerInterface::exit()
+/**
+ * The resolutions a device supports. Ranges are reduced to the common resolutions within them.
+ */
+std::vector<int> getResolutions(const SaneOption &option)
 {
-    for (auto device : openedDevices)
+    std::vector<int> resolutions;
+    auto toInt = [&](SANE_Word word) {
+        return option.type == SANE_TYPE_FIXED ? static_cast<int>(std::lround(SANE_UNFIX(word))) : word;
+    };
+    if (option.constraintType == SANE_CONSTRAINT_WORD_LIST)
     {
-        closeDevice(device);
+        for (auto word : option.wordList)
+        {
+            resolutions.push_back(toInt(word));
+        }
     }
-    openedDevices.clear();
-    sane_exit();
-    return true;
+    else if (option.constraintType == SANE_CONSTRAINT_RANGE)
+    {
+        const int minimum = toInt(option.range.min);
+        const int maximum = toInt(option.range.max);
+        const int quant = toInt(option.range.quant);
+        resolutions.push_back(minimum);
+        for (int resolution : {75, 100, 150, 200, 300, 400, 600, 1200, 2400, 4800, 9600})
+        {
+            if (resolution > minimum && resolution < maximum && (quant <= 1 || (resolution - minimum) % quant == 0))
+            {
+                resolutions.push_back(resolution);
+            }
+        }
+        if (maximum > minimum)
+        {
+            resolutions.push_back(maximum);
+        }
+    }
+    return resolutions;
 }
 
-std::vector<ScannerDeviceDescriptorPtr> SaneScannerInterface::getDevices()
+FrameParameters toFrameParameters(const SANE_Parameters &params)
 {
-    std::vector<ScannerDeviceDescriptorPtr> result;
-    const SANE_Device **deviceList;
-    SANE_Status saneStatus = SANE_STATUS_GOOD;
-    saneStatus = sane_get_devices(&deviceList, SANE_FALSE);
-    int it = 0;
+    FrameParameters parameters;
+    switch (params.format)
+    {
+    case SANE_FRAME_GRAY:
+        parameters.format = FrameParameters::Gray;
+        break;
+    case SANE_FRAME_RED:
+        parameters.format = FrameParameters::Red;
+        break;
+    case SANE_FRAME_GREEN:
+        parameters.format = FrameParameters::Green;
+        break;
+    case SANE_FRAME_BLUE:
+        parameters.format = FrameParameters::Blue;
+        break;
+    default:
+        parameters.format = FrameParameters::Rgb;
+        break;
+    }
+    parameters.lastFrame = params.last_frame == SANE_TRUE;
+    parameters.bytesPerLine = params.bytes_per_line;
+    parameters.pixelsPerLine = params.pixels_per_line;
+    parameters.lines = params.lines;
+    parameters.depth = params.depth;
+    return parameters;
+}
 
-    if (saneStatus == SANE_STATUS_GOOD)
+/**
+ * Marks a device as scanning for the lifetime of a scan, a cancel only applies to the scan it interrupted
+ */
+class ScanningScope
+{
+public:
+    explicit ScanningScope(SaneInternalScannerDevicePtr device_) : device(device_)
     {
-        do
-        {
-            std::ostringstream stream;
-            stream << deviceList[it]->name << " (" << deviceList[it]->vendor << " / " << deviceList[it]->model << ")";
+        device->cancelled = false;
+        device->scanning = true;
+    }
+
+    ~ScanningScope()
+    {
+        device->scanning = false;
+        device->cancelled = false;
+    }
 
-            SaneInternalScannerDevicePtr saneDevice = SaneInternalScannerDevicePtr(new SaneInternalScannerDevice());
-            saneDevice->device = deviceList[it];
-            saneDevice->handle = 0;
+private:
+    SaneInternalScannerDevicePtr device;
+};
 
-            ScannerDeviceDescriptorPtr scanner(new ScannerDeviceDescriptor());
-            scanner->descriptor = stream.str();
-            scanner->device = saneDevice;
-            result.push_back(scanner);
-            it++;
-        } while (deviceList[it] != nullptr);
+void throwIfCancelled(SaneInternalScannerDevicePtr internalDevice, SANE_Status saneStatus = SANE_STATUS_GOOD)
+{
+    if (saneStatus == SANE_STATUS_CANCELLED || internalDevice->cancelled)
+    {
+        throw std::runtime_error("The scan was cancelled.");
     }
-    return result;
 }
 
-const SaneScannerInterface::OptionMap &SaneScannerInterface::buildOptionMap(ScannerDeviceDescriptorPtr device)
+/**
+ * The capabilities described by the options of a device
+ */
+ScannerCapabilities readCapabilities(const SaneOptionSchema &schema)
 {
-    OptionMap map;
-    openDevice(device);
+    ScannerCapabilities capabilities;
+    capabilities.minX = SANE_UNFIX(schema.find(SANE_NAME_SCAN_TL_X)->range.min);
+    capabilities.maxX = SANE_UNFIX(schema.find(SANE_NAME_SCAN_BR_X)->range.max);
+    capabilities.minY = SANE_UNFIX(schema.find(SANE_NAME_SCAN_TL_Y)->range.min);
+    capabilities.maxY = SANE_UNFIX(schema.find(SANE_NAME_SCAN_BR_Y)->range.max);
+    capabilities.possibleResolutionsInDPI = getResolutions(*schema.find(SANE_NAME_SCAN_RESOLUTION));
+    capabilities.possibleSources = schema.find(SANE_NAME_SCAN_SOURCE)->stringList;
+    capabilities.possibleModes = schema.find(SANE_NAME_SCAN_MODE)->stringList;
+    return capabilities;
+}
 
-    SaneInternalScannerDevicePtr internalDevice = std::dynamic_pointer_cast<SaneInternalScannerDevice>(device->device);
-    SANE_Handle handle = internalDevice->handle;
-    SANE_Int numDevOptions;
-    sane_control_option(handle, 0, SANE_ACTION_GET_VALUE, &numDevOptions, 0);
+bool sameCapabilities(const ScannerCapabilities &a, const ScannerCapabilities &b)
+{
+    return a.minX == b.minX && a.maxX == b.maxX && a.minY == b.minY && a.maxY == b.maxY &&
+           a.possibleResolutionsInDPI == b.possibleResolutionsInDPI && a.possibleSources == b.possibleSources && a.possibleModes == b.possibleModes;
+}
 
-    std::vector<std::string> neededOptions;
-    neededOptions.push_back(SANE_NAME_SCAN_TL_X);
-    neededOptions.push_back(SANE_NAME_SCAN_TL_Y);
-    neededOptions.push_back(SANE_NAME_SCAN_BR_X);
-    neededOptions.push_back(SANE_NAME_SCAN_BR_Y);
-    neededOptions.push_back(SANE_NAME_SCAN_RESOLUTION);
-    neededOptions.push_back(SANE_NAME_SCAN_SOURCE);
-    neededOptions.push_back(SANE_NAME_SCAN_MODE);
+/**
+ * Only SANE_STATUS_EOF completes a frame, any other status that ends the reading (a jam, an I/O error) aborts the scan
+ */
+void throwUnlessEndOfFrame(SaneInternalScannerDevicePtr internalDevice, SANE_Status saneStatus)
+{
+    throwIfCancelled(internalDevice, saneStatus);
+    if (saneStatus != SANE_STATUS_EOF)
+    {
+        throw std::runtime_error(std::string("Could not read the scan: ") + sane_strstatus(saneStatus));
+    }
+}
 
-    for (auto i = 0; i < numDevOptions; ++i)
+/**
+ * Whether a source feeds the documents (ADF, duplex), a flatbed would scan the same page again & again
+ */
+bool isFeederSource(const std::string &source)
+{
+    std::string lowerSource(source);
+    std::transform(lowerSource.begin(), lowerSource.end(), lowerSource.begin(), [](unsigned char c) { return std::tolower(c); });
+    for (const char *feeder : {"adf", "feeder", "duplex"})
     {
-        const SANE_Option_Descriptor *option = sane_get_option_descriptor(handle, i);
-        if (!option->name)
+        if (lowerSource.find(feeder) != std::string::npos)
         {
-            continue;
+            return true;
         }
-        std::string name = std::string(option->name);
-        if (std::find(neededOptions.begin(), neededOptions.end(), name) != neededOptions.end())
+    }
+    return false;
+}
+
+/**
+ * sane_start & the frame's parameters, recorded in the timeline & the recording (if any)
+ */
+SANE_Status startTimed(SANE_Handle handle, SANE_Parameters &params, ScanTimeline *timeline, ScanRecorder *recorder)
+{
+    ScanTimeline::Span starting(timeline, ScanPhase::Start);
+    if (recorder)
+    {
+        recorder->beginFrame();
+    }
+    SANE_Status saneStatus = sane_start(handle);
+    if (saneStatus == SANE_STATUS_GOOD)
+    {
+        sane_get_parameters(handle, &params);
+        if (recorder && params.lines >= 0)
         {
-            map[name] = i;
+            recorder->addFrame(toFrameParameters(params));
         }
     }
-    if (map.size() != neededOptions.size())
+    return saneStatus;
+}
+
+/**
+ * sane_read into the device's read buffer, recorded in the timeline & the recording (if any)
+ */
+SANE_Status readTimed(SANE_Handle handle, SANE_Byte *buffer, SANE_Int *length, ScanTimeline *timeline, ScanRecorder *recorder)
+{
+    if (!timeline && !recorder)
     {
-        throw std::runtime_error("Not all required scanner options were found. Likely your device is not supported.");
+        return sane_read(handle, buffer, SANE_BUFFER_SIZE, length);
     }
-    optionMaps[device] = map;
-    return optionMaps[device];
+    if (recorder)
+    {
+        recorder->beginRead();
+    }
+    ScanTimeline::Clock::time_point start = ScanTimeline::Clock::now();
+    SANE_Status saneStatus = sane_read(handle, buffer, SANE_BUFFER_SIZE, length);
+    size_t bytes = saneStatus == SANE_STATUS_GOOD ? *length : 0;
+    if (timeline)
+    {
+        timeline->addRead(start, bytes);
+    }
+    if (recorder)
+    {
+        recorder->addRead(buffer, bytes);
+    }
+    return saneStatus;
 }
 
-const SaneScannerInterface::OptionMap &SaneScannerInterface::getOptionMap(ScannerDeviceDescriptorPtr device)
+/**
+ * Read all frames of the next page & hand them to the receiver.
+ * @param recorder records the page, if the scans are recorded (otherwise nullptr)
+ * @return the status of the page's first sane_start, the receiver is not called unless it is SANE_STATUS_GOOD
+ */
+SANE_Status scanPage(SaneInternalScannerDevicePtr internalDevice, IScanReceiver &receiver, ScanRecorder *recorder)
 {
-    auto result = optionMaps.find(device);
-    if (result == optionMaps.end())
+    SANE_Handle handle = internalDevice->handle;
+    if (internalDevice->readBuffer.empty())
     {
-        return buildOptionMap(device);
+        internalDevice->readBuffer.resize(SANE_BUFFER_SIZE);
     }
-    else
+    SANE_Byte *buffer = internalDevice->readBuffer.data();
+
+    PixelUnpacker unpacker(receiver);
+    ScanTimeline *timeline = receiver.getTimeline();
+    SANE_Parameters params;
+    bool firstFrame = true;
+    do
     {
-        return result->second;
-    }
+        // after a sane_cancel a new sane_start would scan (the next page) again
+        throwIfCancelled(internalDevice);
+        SANE_Status saneStatus = startTimed(handle, params, timeline, recorder);
+        if (saneStatus != SANE_STATUS_GOOD)
+        {
+            if (firstFrame)
+            {
+                return saneStatus;
+            }
+            sane_cancel(handle);
+            throw std::runtime_error(std::string("Could not start the scan: ") + sane_strstatus(saneStatus));
+        }
+        firstFrame = false;
+        if (params.lines < 0)
+        {
+            sane_cancel(handle);
+            throw std::runtime_error("Scans of unknown height are not supported.");
+        }
+        {
+            ScanTimeline::Span unpacking(timeline, ScanPhase::Unpack);
+            unpacker.beginFrame(toFrameParameters(params));
+        }
+
+        SANE_Int usedBuffer = 0;
+        SANE_Status readStatus;
+        while ((readStatus = readTimed(handle, buffer, &usedBuffer, timeline, recorder)) == SANE_STATUS_GOOD)
+        {
+            ScanTimeline::Span unpacking(timeline, ScanPhase::Unpack);
+            unpacker.feed(buffer, usedBuffer);
+        }
+        throwUnlessEndOfFrame(internalDevice, readStatus);
+        {
+            ScanTimeline::Span unpacking(timeline, ScanPhase::Unpack);
+            unpacker.endFrame();
+        }
+    } while (!params.last_frame);
+    return SANE_STATUS_GOOD;
 }
 
-ScannerCapabilities SaneScannerInterface::getCapabilities(ScannerDeviceDescriptorPtr device)
+/**
+ * Reads a scan step by step, without blocking if the backend can be polled
+ */
+class SaneScanSession : public IScanSession
 {
-    ScannerCapabilities capabilities;
-    openDevice(device);
+public:
+    SaneScanSession(SaneCallGate &gate_, SaneInternalScannerDevicePtr internalDevice_, IScanReceiver &receiver, std::unique_ptr<ScanRecorder> recorder_)
+        : gate(gate_), internalDevice(internalDevice_), scanning(internalDevice_), unpacker(receiver), timeline(receiver.getTimeline()), recorder(std::move(recorder_))
+    {
+        if (internalDevice->readBuffer.empty())
+        {
+            internalDevice->readBuffer.resize(SANE_BUFFER_SIZE);
+        }
+        SaneCallGate::Shared deviceCall(gate);
+        try
+        {
+            startFrame();
+        }
+        catch (...)
+        {
+            sane_cancel(internalDevice->handle);
+            throw;
+        }
+    }
 
-    SaneInternalScannerDevicePtr internalDevice = std::dynamic_pointer_cast<SaneInternalScannerDevice>(device->device);
-    SANE_Handle handle = internalDevice->handle;
+    ~SaneScanSession()
+    {
+        SaneCallGate::Shared deviceCall(gate);
+        sane_cancel(internalDevice->handle);
+    }
 
-    SANE_Int info;
-    SANE_Status saneStatus;
+    virtual int getSelectFd()
+    {
+        return selectFd;
+    }
 
-    const OptionMap &options = getOptionMap(device);
+    virtual bool read()
     {
-        int index = options.at(SANE_NAME_SCAN_TL_X);
-        const SANE_Option_Descriptor *option = sane_get_option_descriptor(handle, index);
-        capabilities.minX = SANE_UNFIX(option->constraint.range->min);
+        SaneCallGate::Shared deviceCall(gate);
+        if (frameEnded)
+        {
+            // the next frame starts in a step of its own, the caller may run it where blocking does not hurt
+            frameEnded = false;
+            startFrame();
+            return false;
+        }
+        SANE_Handle handle = internalDevice->handle;
+        SANE_Byte *buffer = internalDevice->readBuffer.data();
+        for (unsigned int reads = 0; reads < MAX_READS_PER_STEP && !complete; ++reads)
+        {
+            SANE_Int length = 0;
+            SANE_Status saneStatus = readTimed(handle, buffer, &length, timeline, recorder.get());
+            if (saneStatus == SANE_STATUS_GOOD)
+            {
+                if (length == 0)
+                {
+                    // non-blocking mode: no data yet
+                    return false;
+                }
+                ScanTimeline::Span unpacking(timeline, ScanPhase::Unpack);
+                unpacker.feed(buffer, length);
+                continue;
+            }
+
+            throwUnlessEndOfFrame(internalDevice, saneStatus);
+            {
+                ScanTimeline::Span unpacking(timeline, ScanPhase::Unpack);
+                unpacker.endFrame();
+            }
+            if (params.last_frame)
+            {
+                complete = true;
+                if (recorder)
+                {
+                    recorder->save();
+                }
+            }
+            else
+            {
+                // sane_start may take a while (e.g. the lamp warms up again): without descriptor the caller reads blocking
+                frameEnded = true;
+                selectFd = -1;
+                return false;
+            }
+        }
+        return complete;
     }
+
+private:
+    void startFrame()
     {
-        int index = options.at(SANE_NAME_SCAN_BR_X);
-        const SANE_Option_Descriptor *option = sane_get_option_descriptor(handle, index);
-        capabilities.maxX = SANE_UNFIX(option->constraint.range->max);
+        SANE_Handle handle = internalDevice->handle;
+        throwIfCancelled(internalDevice);
+        SANE_Status saneStatus = startTimed(handle, params, timeline, recorder.get());
+        if (saneStatus != SANE_STATUS_GOOD)
+        {
+            throw std::runtime_error(std::string("Could not start the scan: ") + sane_strstatus(saneStatus));
+        }
+        if (params.lines < 0)
+        {
+            throw std::runtime_error("Scans of unknown height are not supported.");
+        }
+        {
+            ScanTimeline::Span unpacking(timeline, ScanPhase::Unpack);
+            unpacker.beginFrame(toFrameParameters(params));
+        }
+
+        // The mode is set per sane_start (per frame), without descriptor the frame is read blocking
+        SANE_Int fd = -1;
+        selectFd = -1;
+        if (sane_set_io_mode(handle, SANE_TRUE) == SANE_STATUS_GOOD)
+        {
+            if (sane_get_select_fd(handle, &fd) == SANE_STATUS_GOOD)
+            {
+                selectFd = fd;
+            }
+            else
+            {
+                sane_set_io_mode(handle, SANE_FALSE);
+            }
+        }
     }
+
+    SaneCallGate &gate;
+    SaneInternalScannerDevicePtr internalDevice;
+    ScanningScope scanning;
+    PixelUnpacker unpacker;
+    ScanTimeline *timeline;
+    std::unique_ptr<ScanRecorder> recorder;
+    SANE_Parameters params;
+
+    /**
+     * The descriptor of the current frame
+     */
+    int selectFd = -1;
+    bool frameEnded = false;
+    bool complete = false;
+};
+}
+
+SaneScannerInterface::SaneScannerInterface(const std::string &cacheFile)
+    : gate(new SaneCallGate())
+{
+    if (!cacheFile.empty())
     {
-        int index = options.at(SANE_NAME_SCAN_TL_Y);
-        const SANE_Option_Descriptor *option = sane_get_option_descriptor(handle, index);
-        capabilities.minY = SANE_UNFIX(option->constraint.range->min);
+        cache = DeviceCachePtr(new DeviceCache(cacheFile));
     }
+}
+
+SaneScannerInterface::~SaneScannerInterface()
+{
+    joinBackground();
+}
+
+bool SaneScannerInterface::init()
+{
+    SANE_Int version_code = 0;
+    sane_init(&version_code, authCallback);
+    if (cache)
     {
-        int index = options.at(SANE_NAME_SCAN_BR_Y);
-        const SANE_Option_Descriptor *option = sane_get_option_descriptor(handle, index);
-        capabilities.maxY = SANE_UNFIX(option->constraint.range->max);
+        cache->load(version_code);
     }
+    return true;
+}
+
+bool SaneScannerInterface::exit()
+{
+    joinBackground();
+    std::lock_guard<std::mutex> lock(stateMutex);
+    for (auto device : openedDevices)
     {
-        int index = options.at(SANE_NAME_SCAN_RESOLUTION);
-        const SANE_Option_Descriptor *option = sane_get_option_descriptor(handle, index);
-        auto list = option->constraint.word_list;
-        int length = *list++;
-        for (int i = 0; i < length; i++)
-            capabilities.possibleResolutionsInDPI.push_back(list[i]);
+        closeDevice(device);
     }
+    openedDevices.clear();
+    sane_exit();
+    return true;
+}
+
+std::vector<ScannerDeviceDescriptorPtr> SaneScannerInterface::getDevices()
+{
+    if (cache)
     {
-        int index = options.at(SANE_NAME_SCAN_SOURCE);
-        const SANE_Option_Descriptor *option = sane_get_option_descriptor(handle, index);
-        for (int i = 0; option->constraint.string_list[i] != nullptr; ++i)
+        std::vector<DeviceCache::Device> cachedDevices = cache->getDevices();
+        if (!cachedDevices.empty())
         {
-            capabilities.possibleSources.push_back(option->constraint.string_list[i]);
+            revalidateDevicesInBackground();
+            return createDescriptors(cachedDevices);
         }
     }
+
+    std::vector<DeviceCache::Device> devices;
+    {
+        SaneCallGate::Exclusive probing(*gate);
+        devices = probeDevices();
+    }
+    if (cache)
+    {
+        cache->setDevices(devices);
+        cache->save();
+    }
+    return createDescriptors(devices);
+}
+
+std::vector<DeviceCache::Device> SaneScannerInterface::probeDevices()
+{
+    std::vector<DeviceCache::Device> result;
+    const SANE_Device **deviceList;
+    SANE_Status saneStatus = sane_get_devices(&deviceList, SANE_FALSE);
+    if (saneStatus == SANE_STATUS_GOOD)
     {
-        int index = options.at(SANE_NAME_SCAN_MODE);
-        const SANE_Option_Descriptor *option = sane_get_option_descriptor(handle, index);
-        for (int i = 0; option->constraint.string_list[i] != nullptr; ++i)
+        for (int it = 0; deviceList[it] != nullptr; ++it)
         {
-            capabilities.possibleModes.push_back(option->constraint.string_list[i]);
+            DeviceCache::Device device;
+            device.name = deviceList[it]->name;
+            device.vendor = deviceList[it]->vendor;
+            device.model = deviceList[it]->model;
+            result.push_back(device);
         }
     }
-    return capabilities;
+    return result;
 }
 
-ScannerConfiguration SaneScannerInterface::getConfiguration(ScannerDeviceDescriptorPtr device)
+std::vector<ScannerDeviceDescriptorPtr> SaneScannerInterface::createDescriptors(const std::vector<DeviceCache::Device> &devices)
 {
-    ScannerConfiguration configuration;
-    openDevice(device);
+    std::vector<ScannerDeviceDescriptorPtr> result;
+    for (const auto &device : devices)
+    {
+        std::ostringstream stream;
+        stream << device.name << " (" << device.vendor << " / " << device.model << ")";
 
-    SANE_Int info;
-    SaneInternalScannerDevicePtr internalDevice = std::dynamic_pointer_cast<SaneInternalScannerDevice>(device->device);
-    SANE_Handle handle = internalDevice->handle;
+        SaneInternalScannerDevicePtr saneDevice = SaneInternalScannerDevicePtr(new SaneInternalScannerDevice());
+        saneDevice->name = device.name;
+        saneDevice->handle = 0;
+
+        ScannerDeviceDescriptorPtr scanner(new ScannerDeviceDescriptor());
+        scanner->descriptor = stream.str();
+        scanner->device = saneDevice;
+        result.push_back(scanner);
+    }
+    return result;
+}
 
-    const OptionMap &options = getOptionMap(device);
+void SaneScannerInterface::revalidateDevicesInBackground()
+{
     {
-        int index = options.at(SANE_NAME_SCAN_TL_X);
-        SANE_Fixed fixedValue = 0;
-        sane_control_option(handle, index, SANE_ACTION_GET_VALUE, &fixedValue, &info);
-        configuration.fromX = SANE_UNFIX(fixedValue);
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (devicesRevalidated)
+        {
+            return;
+        }
+        devicesRevalidated = true;
     }
+    // Devices that appeared or vanished show up in the next device query
+    runInBackground([this]() {
+        if (cache->setDevices(probeDevices()))
+        {
+            cache->save();
+        }
+    });
+}
+
+void SaneScannerInterface::runInBackground(std::function<void()> task)
+{
+    std::lock_guard<std::mutex> lock(stateMutex);
+    backgroundTasks.push_back(task);
+    if (backgroundRunning)
     {
-        int index = options.at(SANE_NAME_SCAN_BR_X);
-        SANE_Fixed fixedValue = 0;
-        sane_control_option(handle, index, SANE_ACTION_GET_VALUE, &fixedValue, &info);
-        configuration.toX = SANE_UNFIX(fixedValue);
+        return;
     }
+    if (background.joinable())
     {
-        int index = options.at(SANE_NAME_SCAN_TL_Y);
-        SANE_Fixed fixedValue = 0;
-        sane_control_option(handle, index, SANE_ACTION_GET_VALUE, &fixedValue, &info);
-        configuration.fromY = SANE_UNFIX(fixedValue);
+        // it ran out of tasks & ended
+        background.join();
     }
+    backgroundRunning = true;
+    background = std::thread([this]() {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::lock_guard<std::mutex> lock(stateMutex);
+                if (backgroundTasks.empty())
+                {
+                    backgroundRunning = false;
+                    return;
+                }
+                task = backgroundTasks.front();
+                backgroundTasks.pop_front();
+            }
+            SaneCallGate::Exclusive backgroundCall(*gate);
+            try
+            {
+                task();
+            }
+            catch (const std::exception &exception)
+            {
+                std::cerr << "Background check of the device cache failed: " << exception.what() << std::endl;
+            }
+        }
+    });
+}
+
+void SaneScannerInterface::joinBackground()
+{
+    std::thread finishing;
     {
-        int index = options.at(SANE_NAME_SCAN_BR_Y);
-        SANE_Fixed fixedValue = 0;
-        sane_control_option(handle, index, SANE_ACTION_GET_VALUE, &fixedValue, &info);
-        configuration.toY = SANE_UNFIX(fixedValue);
+        std::lock_guard<std::mutex> lock(stateMutex);
+        finishing.swap(background);
     }
+    if (finishing.joinable())
     {
-        int index = options.at(SANE_NAME_SCAN_RESOLUTION);
-        SANE_Int intValue;
-        sane_control_option(handle, index, SANE_ACTION_GET_VALUE, &intValue, &info);
-        configuration.resolutionInDPI = intValue;
+        finishing.join();
     }
+}
+
+SaneOptionSchema &SaneScannerInterface::getOptionSchema(ScannerDeviceDescriptorPtr device)
+{
+    SaneInternalScannerDevicePtr internalDevice = std::dynamic_pointer_cast<SaneInternalScannerDevice>(device->device);
+    SaneOptionSchema &schema = internalDevice->options;
+    if (schema.isLoaded())
     {
-        int index = options.at(SANE_NAME_SCAN_SOURCE);
-        SANE_SANITY(sane_control_option(handle, index, SANE_ACTION_GET_VALUE, stringValueBuffer, &info));
-        configuration.source = std::string(stringValueBuffer);
+        return schema;
     }
+
+    schema.load(internalDevice->handle);
+    DeviceCache::OptionMap map;
+    for (const auto &name : getNeededOptions())
     {
-        int index = options.at(SANE_NAME_SCAN_MODE);
-        SANE_SANITY(sane_control_option(handle, index, SANE_ACTION_GET_VALUE, stringValueBuffer, &info));
-        configuration.mode = std::string(stringValueBuffer);
+        int index = schema.indexOf(name);
+        if (index < 0)
+        {
+            schema.invalidate();
+            throw std::runtime_error("Not all required scanner options were found. Likely your device is not supported.");
+        }
+        map[name] = index;
     }
 
-    return configuration;
+    if (cache)
+    {
+        DeviceCache::OptionMap cachedMap;
+        if (cache->getOptionMap(internalDevice->name, cachedMap) && cachedMap != map)
+        {
+            // The device (or its backend) changed since the cache was written: rebuild the entry
+            cache->invalidate(internalDevice->name);
+        }
+        if (cachedMap != map)
+        {
+            cache->setOptionMap(internalDevice->name, map);
+            cache->save();
+        }
+    }
+    return schema;
 }
 
-void SaneScannerInterface::setConfiguration(ScannerDeviceDescriptorPtr device, const ScannerConfiguration &configuration)
+ScannerCapabilities SaneScannerInterface::getCapabilities(ScannerDeviceDescriptorPtr device)
 {
-    openDevice(device);
-
-    SANE_Int info;
+    ScannerCapabilities capabilities;
     SaneInternalScannerDevicePtr internalDevice = std::dynamic_pointer_cast<SaneInternalScannerDevice>(device->device);
-    SANE_Handle handle = internalDevice->handle;
+    // Cached capabilities are dropped, once the device's option map turns out to be stale.
+    // They are returned right away & checked against the device in the background (once).
+    if (cache && cache->getCapabilities(internalDevice->name, capabilities))
+    {
+        if (!internalDevice->capabilitiesChecked.exchange(true))
+        {
+            runInBackground([this, device, internalDevice]() {
+                ScannerCapabilities cachedCapabilities;
+                openDevice(device, true);
+                ScannerCapabilities actualCapabilities = readCapabilities(getOptionSchema(device));
+                if (!cache->getCapabilities(internalDevice->name, cachedCapabilities) || !sameCapabilities(cachedCapabilities, actualCapabilities))
+                {
+                    cache->setCapabilities(internalDevice->name, actualCapabilities);
+                    cache->save();
+                }
+            });
+        }
+        return capabilities;
+    }
 
-    const OptionMap &options = getOptionMap(device);
+    openDevice(device);
+    SaneCallGate::Shared deviceCall(*gate);
+    capabilities = readCapabilities(getOptionSchema(device));
+    internalDevice->capabilitiesChecked = true;
+
+    if (cache)
     {
-        int index = options.at(SANE_NAME_SCAN_TL_X);
-        SANE_Fixed fixedValue = SANE_FIX(configuration.fromX);
-        SANE_SANITY(sane_control_option(handle, index, SANE_ACTION_SET_VALUE, &fixedValue, &info));
+        cache->setCapabilities(internalDevice->name, capabilities);
+        cache->save();
     }
+    return capabilities;
+}
+
+ScannerConfiguration SaneScannerInterface::getConfiguration(ScannerDeviceDescriptorPtr device)
+{
+    openDevice(device);
+    SaneCallGate::Shared deviceCall(*gate);
+    ScannerConfiguration configuration;
+    const SaneOptionSchema &schema = getOptionSchema(device);
+
+    configuration.fromX = getNumber(*schema.find(SANE_NAME_SCAN_TL_X));
+    configuration.toX = getNumber(*schema.find(SANE_NAME_SCAN_BR_X));
+    configuration.fromY = getNumber(*schema.find(SANE_NAME_SCAN_TL_Y));
+    configuration.toY = getNumber(*schema.find(SANE_NAME_SCAN_BR_Y));
+    configuration.resolutionInDPI = static_cast<int>(std::lround(getNumber(*schema.find(SANE_NAME_SCAN_RESOLUTION))));
+    configuration.source = schema.find(SANE_NAME_SCAN_SOURCE)->stringValue;
+    configuration.mode = schema.find(SANE_NAME_SCAN_MODE)->stringValue;
+    const SaneOption *preview = schema.find(SANE_NAME_PREVIEW);
+    if (preview && preview->hasValue)
     {
-        int index = options.at(SANE_NAME_SCAN_BR_X);
-        SANE_Fixed fixedValue = SANE_FIX(configuration.toX);
-        SANE_SANITY(sane_control_option(handle, index, SANE_ACTION_SET_VALUE, &fixedValue, &info));
+        configuration.preview = preview->value[0] == SANE_TRUE ? 1 : 0;
     }
+
+    return configuration;
+}
+
+void SaneScannerInterface::setConfiguration(ScannerDeviceDescriptorPtr device, const ScannerConfiguration &configuration)
+{
+    openDevice(device);
+    SaneCallGate::Shared deviceCall(*gate);
+    SaneInternalScannerDevicePtr internalDevice = std::dynamic_pointer_cast<SaneInternalScannerDevice>(device->device);
+
+    // Only changed options are written, compared against the schema (the last known device state).
+    // A write that makes the backend reload the options invalidates the schema, the next comparison reloads it once.
+    auto writeOption = [&](const std::string &name, void *value) {
+        SaneOptionSchema &schema = getOptionSchema(device);
+        SANE_Status saneStatus = schema.setValue(internalDevice->handle, schema.indexOf(name), value);
+        if (saneStatus != SANE_STATUS_GOOD)
+        {
+            throw std::runtime_error("Could not set the option " + name + ": " + sane_strstatus(saneStatus));
+        }
+        optionWrites++;
+    };
+    auto setNumber = [&](const std::string &name, double value) {
+        if (value < 0)
+        {
+            return;
+        }
+        const SaneOption &option = *getOptionSchema(device).find(name);
+        SANE_Word word = toWord(option, value);
+        if (option.hasValue && option.value[0] == word)
+        {
+            skippedOptionWrites++;
+            return;
+        }
+        writeOption(name, &word);
+    };
+    auto setString = [&](const std::string &name, const std::string &value) {
+        if (value.empty())
+        {
+            return;
+        }
+        const SaneOption &option = *getOptionSchema(device).find(name);
+        if (option.hasValue && option.stringValue == value)
+        {
+            skippedOptionWrites++;
+            return;
+        }
+        std::vector<SANE_Char> buffer(std::max<size_t>(option.size, value.length() + 1), 0);
+        std::memcpy(buffer.data(), value.c_str(), value.length());
+        writeOption(name, buffer.data());
+    };
+
+    // Dependency order: preview, mode & source constrain the resolution, the resolution constrains the geometry
+    if (getOptionSchema(device).find(SANE_NAME_PREVIEW))
     {
-        int index = options.at(SANE_NAME_SCAN_TL_Y);
-        SANE_Fixed fixedValue = SANE_FIX(configuration.fromY);
-        SANE_SANITY(sane_control_option(handle, index, SANE_ACTION_SET_VALUE, &fixedValue, &info));
+        setNumber(SANE_NAME_PREVIEW, configuration.preview);
     }
+    setString(SANE_NAME_SCAN_MODE, configuration.mode);
+    setString(SANE_NAME_SCAN_SOURCE, configuration.source);
+    setNumber(SANE_NAME_SCAN_RESOLUTION, configuration.resolutionInDPI);
+    setNumber(SANE_NAME_SCAN_TL_X, configuration.fromX);
+    setNumber(SANE_NAME_SCAN_TL_Y, configuration.fromY);
+    setNumber(SANE_NAME_SCAN_BR_X, configuration.toX);
+    setNumber(SANE_NAME_SCAN_BR_Y, configuration.toY);
+}
+
+ScannerStatistics SaneScannerInterface::getStatistics()
+{
+    ScannerStatistics statistics;
+    statistics.optionWrites = optionWrites;
+    statistics.skippedOptionWrites = skippedOptionWrites;
+    return statistics;
+}
+
+RawImagePtr SaneScannerInterface::scanToBuffer(ScannerDeviceDescriptorPtr device)
+{
+    RawImageReceiver receiver;
+    scan(device, receiver);
+    return receiver.getImage();
+}
+
+void SaneScannerInterface::scan(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver)
+{
+    openDevice(device);
+    SaneCallGate::Shared deviceCall(*gate);
+
+    SaneInternalScannerDevicePtr internalDevice = std::dynamic_pointer_cast<SaneInternalScannerDevice>(device->device);
+    SANE_Handle handle = internalDevice->handle;
+
+    std::unique_ptr<ScanRecorder> recorder = createRecorder(device);
+    ScanningScope scanning(internalDevice);
+    SANE_Status saneStatus;
+    try
     {
-        int index = options.at(SANE_NAME_SCAN_BR_Y);
-        SANE_Fixed fixedValue = SANE_FIX(configuration.toY);
-        SANE_SANITY(sane_control_option(handle, index, SANE_ACTION_SET_VALUE, &fixedValue, &info));
+        saneStatus = scanPage(internalDevice, receiver, recorder.get());
     }
+    catch (...)
     {
-        int index = options.at(SANE_NAME_SCAN_RESOLUTION);
-        SANE_Int intValue = configuration.resolutionInDPI;
-        SANE_SANITY(sane_control_option(handle, index, SANE_ACTION_SET_VALUE, &intValue, &info));
+        sane_cancel(handle);
+        throw;
     }
+    sane_cancel(handle);
+    if (saneStatus != SANE_STATUS_GOOD)
     {
-        int index = options.at(SANE_NAME_SCAN_SOURCE);
-        assert(configuration.source.length() <= SCANE_NAME_BUFFER_SIZE);
-        std::memset(stringValueBuffer, 0, SCANE_NAME_BUFFER_SIZE);
-        std::strncpy(stringValueBuffer, configuration.source.c_str(), configuration.source.length());
-        SANE_SANITY(sane_control_option(handle, index, SANE_ACTION_SET_VALUE, stringValueBuffer, &info));
+        throw std::runtime_error(std::string("Could not start the scan: ") + sane_strstatus(saneStatus));
     }
+    if (recorder)
     {
-        int index = options.at(SANE_NAME_SCAN_MODE);
-        assert(configuration.mode.length() <= SCANE_NAME_BUFFER_SIZE);
-        std::memset(stringValueBuffer, 0, SCANE_NAME_BUFFER_SIZE);
-        std::strncpy(stringValueBuffer, configuration.mode.c_str(), configuration.mode.length());
-        SANE_SANITY(sane_control_option(handle, index, SANE_ACTION_SET_VALUE, stringValueBuffer, &info));
+        recorder->save();
     }
 }
 
-RawImagePtr SaneScannerInterface::scanToBuffer(ScannerDeviceDescriptorPtr device)
+unsigned int SaneScannerInterface::scanBatch(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver)
 {
     openDevice(device);
+    SaneCallGate::Shared deviceCall(*gate);
 
     SaneInternalScannerDevicePtr internalDevice = std::dynamic_pointer_cast<SaneInternalScannerDevice>(device->device);
     SANE_Handle handle = internalDevice->handle;
 
-    SANE_Int usedBuffer = 0;
-    SANE_Int saneStatus = SANE_STATUS_GOOD;
-
-    SANE_SANITY(sane_start(internalDevice->handle));
+    // The feeder keeps going as long as sane_start is called without sane_cancel in between.
+    // Any other source never runs out of documents, it scans one page.
+    const SaneOption *source = getOptionSchema(device).find(SANE_NAME_SCAN_SOURCE);
+    bool feeder = source && isFeederSource(source->stringValue);
+    std::unique_ptr<ScanRecorder> recorder = createRecorder(device);
+    ScanningScope scanning(internalDevice);
+    unsigned int pages = 0;
+    SANE_Status saneStatus = SANE_STATUS_GOOD;
+    try
+    {
+        while ((saneStatus = scanPage(internalDevice, receiver, recorder.get())) == SANE_STATUS_GOOD)
+        {
+            pages++;
+            if (!feeder)
+            {
+                break;
+            }
+        }
+    }
+    catch (...)
+    {
+        sane_cancel(handle);
+        throw;
+    }
+    sane_cancel(handle);
 
-    SANE_Parameters params;
-    sane_get_parameters(handle, &params);
+    if (saneStatus != SANE_STATUS_GOOD && saneStatus != SANE_STATUS_NO_DOCS)
+    {
+        throw std::runtime_error(std::string("Could not start the scan: ") + sane_strstatus(saneStatus));
+    }
+    if (recorder)
+    {
+        recorder->save();
+    }
+    return pages;
+}
 
-    unsigned int width = params.pixels_per_line;
-    unsigned int height = params.lines;
+IScanSessionPtr SaneScannerInterface::startScan(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver)
+{
+    openDevice(device);
+    SaneCallGate::Shared deviceCall(*gate);
 
-    RawImagePtr rawImage(new RawImage(width, height));
+    SaneInternalScannerDevicePtr internalDevice = std::dynamic_pointer_cast<SaneInternalScannerDevice>(device->device);
+    return IScanSessionPtr(new SaneScanSession(*gate, internalDevice, receiver, createRecorder(device)));
+}
 
-    unsigned int x = 0;
-    unsigned int y = 0;
-    unsigned int total = 0;
-    while (true)
+void SaneScannerInterface::cancel(ScannerDeviceDescriptorPtr device)
+{
+    SaneInternalScannerDevicePtr internalDevice = std::dynamic_pointer_cast<SaneInternalScannerDevice>(device->device);
+    // sane_cancel may be called while another thread is blocked in sane_read (it is even signal safe)
+    if (internalDevice && internalDevice->scanning && internalDevice->handle != 0)
     {
-        saneStatus = sane_read(internalDevice->handle, buffer, SANE_BUFFER_SIZE, &usedBuffer);
-        if (saneStatus != SANE_STATUS_GOOD)
-        {
-            break;
-        }
-        unsigned int offset = 0;
-        unsigned char *pivot = buffer;
-        while (offset < usedBuffer && y < height)
-        {
-            for (unsigned int j = 0; j < 3; ++j)
-                rawImage->pixels[(y * width + x) * 3 + j] = *pivot++;
+        internalDevice->cancelled = true;
+        sane_cancel(internalDevice->handle);
+    }
+}
 
-            x = (x + 1) % width;
-            if (x == 0)
-            {
-                y++;
-            }
+void SaneScannerInterface::setRecordingFile(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(stateMutex);
+    recordingFile = path;
+}
 
-            offset += 3;
-        }
-        total += usedBuffer;
+std::unique_ptr<ScanRecorder> SaneScannerInterface::createRecorder(ScannerDeviceDescriptorPtr device)
+{
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        path = recordingFile;
     }
-    sane_cancel(internalDevice->handle);
-    return rawImage;
+    if (path.empty())
+    {
+        return nullptr;
+    }
+    return std::unique_ptr<ScanRecorder>(new ScanRecorder(path, device->descriptor, getCapabilities(device), getConfiguration(device)));
 }
 
-void SaneScannerInterface::openDevice(ScannerDeviceDescriptorPtr device)
+void SaneScannerInterface::openDevice(ScannerDeviceDescriptorPtr device, bool exclusive)
 {
     SaneInternalScannerDevicePtr internalDevice = std::dynamic_pointer_cast<SaneInternalScannerDevice>(device->device);
     if (internalDevice->handle == 0)
     {
-        SANE_SANITY(sane_open(internalDevice->device->name, &internalDevice->handle));
+        SANE_Status saneStatus;
+        {
+            std::unique_ptr<SaneCallGate::Shared> deviceCall(exclusive ? nullptr : new SaneCallGate::Shared(*gate));
+            saneStatus = sane_open(internalDevice->name.c_str(), &internalDevice->handle);
+        }
+        if (saneStatus != SANE_STATUS_GOOD && cache)
+        {
+            // A cached device may not be known to its backend before sane_get_devices (or it is gone):
+            // probe the backends, which also drops a vanished device from the cache, & try once more
+            std::unique_ptr<SaneCallGate::Exclusive> probing(exclusive ? nullptr : new SaneCallGate::Exclusive(*gate));
+            if (cache->setDevices(probeDevices()))
+            {
+                cache->save();
+            }
+            saneStatus = sane_open(internalDevice->name.c_str(), &internalDevice->handle);
+        }
+        if (saneStatus != SANE_STATUS_GOOD)
+        {
+            internalDevice->handle = 0;
+        }
+        SANE_SANITY(saneStatus);
+        std::lock_guard<std::mutex> lock(stateMutex);
         openedDevices.push_back(device);
     }
 }
@@ -372,9 +1061,10 @@ void SaneScannerInterface::openDevice(ScannerDeviceDescriptorPtr device)
 void SaneScannerInterface::closeDevice(ScannerDeviceDescriptorPtr device)
 {
     SaneInternalScannerDevicePtr internalDevice = std::dynamic_pointer_cast<SaneInternalScannerDevice>(device->device);
-    if (internalDevice->handle == 0)
+    if (internalDevice->handle != 0)
     {
-        sane_close(&internalDevice->handle);
+        sane_close(internalDevice->handle);
         internalDevice->handle = 0;
+        internalDevice->options.invalidate();
     }
 }
@@ -1,14 +1,33 @@
 #pragma once
 
 #include "iscannerinterface.h"
+#include "devicecache.h"
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+class SaneOptionSchema;
+class ScanRecorder;
+class SaneCallGate;
 
 /**
- * SANE specific implementation of the scanner interface
+ * SANE specific implementation of the scanner interface.
+ * Different devices can be used from different threads in parallel,
+ * the calls for the same device have to be serialised by the caller (see ScanService).
  */
 class SaneScannerInterface : public IScannerInterface
 {
 public:
-  SaneScannerInterface();
+  /**
+   * @param cacheFile optional file that keeps the devices, option maps & capabilities across restarts.
+   * A cached device list is returned right away and checked against the backends in the background.
+   */
+  explicit SaneScannerInterface(const std::string &cacheFile = std::string());
+
+  ~SaneScannerInterface();
 
   /**
    * Initialize the scanner interface
@@ -37,23 +56,83 @@ public:
 
   /**
    * Set the scanner's configuration for the next scan operations.
+   * Only changed options are written, negative numbers & empty strings leave an option as it is.
    */
   virtual void setConfiguration(ScannerDeviceDescriptorPtr device, const ScannerConfiguration &configruation);
 
+  /**
+   * Counters of the backend traffic, e.g. the option writes saved by only writing changed options
+   */
+  virtual ScannerStatistics getStatistics();
+
   /**
    * Scan an image with the active configuration to a buffer and return it.
    * @return an image buffer with the scanned image
    */
   virtual RawImagePtr scanToBuffer(ScannerDeviceDescriptorPtr device);
 
-  typedef std::map<std::string, unsigned int> OptionMap;
+  /**
+   * Scan an image with the active configuration and hand the rows to the receiver as they arrive.
+   */
+  virtual void scan(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver);
+
+  /**
+   * Start a scan, that is read without blocking, if the backend supports it (sane_set_io_mode & sane_get_select_fd).
+   * Otherwise the session reads blocking, like scan().
+   */
+  virtual IScanSessionPtr startScan(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver);
+
+  /**
+   * Scan all pages of the document feeder until it runs out of documents, any other source (a flatbed) scans one page.
+   * Each page is handed to the receiver as begin, rows & end.
+   * @return the number of scanned pages
+   */
+  virtual unsigned int scanBatch(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver);
+
+  /**
+   * Abort the running scan with sane_cancel, the backend ends the pending sane_read
+   */
+  virtual void cancel(ScannerDeviceDescriptorPtr device);
+
+  /**
+   * Record every completed scan to the given file: the options, the frame parameters and each sane_read's data & timing,
+   * to be replayed without the scanner by ReplayScannerInterface. An empty path stops the recording (the default).
+   */
+  void setRecordingFile(const std::string &path);
 
 private:
+  /**
+   * Query the backends for the available devices (slow, the backends probe the network & USB)
+   */
+  std::vector<DeviceCache::Device> probeDevices();
+
+  /**
+   * Create the descriptors for the given devices
+   */
+  std::vector<ScannerDeviceDescriptorPtr> createDescriptors(const std::vector<DeviceCache::Device> &devices);
+
+  /**
+   * Start checking the cached device list against the backends (once), without waiting for it.
+   */
+  void revalidateDevicesInBackground();
+
+  /**
+   * Run a task on the background thread (started on demand), while no device call is running
+   */
+  void runInBackground(std::function<void()> task);
+
+  /**
+   * Wait for the background thread to run out of tasks
+   */
+  void joinBackground();
+
   /**
    * Asserts the a device is opened/resource if ready. 
    * Can be called multiple time.
+   * A failed sane_open re-probes the backends, which needs the gate exclusively: called before the device call takes its
+   * share (or by background work, which holds the gate exclusively already).
    */
-  void openDevice(ScannerDeviceDescriptorPtr device);
+  void openDevice(ScannerDeviceDescriptorPtr device, bool exclusive = false);
 
   /**
    * Close/release a device
@@ -61,14 +140,14 @@ private:
   void closeDevice(ScannerDeviceDescriptorPtr device);
 
   /**
-   * Get the device information an create a new option map
+   * Access the option schema of an opened device, (re)loaded if it is not yet or not anymore valid
    */
-  const OptionMap &buildOptionMap(ScannerDeviceDescriptorPtr device);
+  SaneOptionSchema &getOptionSchema(ScannerDeviceDescriptorPtr device);
 
   /**
-   * Access the option map for a given device (allows lazy access)
+   * The recorder of a scan with the device's current options, nullptr if the scans are not recorded
    */
-  const OptionMap &getOptionMap(ScannerDeviceDescriptorPtr device);
+  std::unique_ptr<ScanRecorder> createRecorder(ScannerDeviceDescriptorPtr device);
 
   /**
    * Keeps track of the opened devices
@@ -76,7 +155,30 @@ private:
   std::vector<ScannerDeviceDescriptorPtr> openedDevices;
 
   /**
-   * Option maps for the opened devices
+   * Guards the opened devices, the background thread & its tasks & the recording file
+   */
+  std::mutex stateMutex;
+
+  std::string recordingFile;
+
+  /**
+   * Optional persistent cache (nullptr without cache file)
+   */
+  DeviceCachePtr cache;
+
+  /**
+   * Serialises the background work with the device calls (sane_get_devices must not run concurrently with them)
+   */
+  std::unique_ptr<SaneCallGate> gate;
+
+  /**
+   * Checks the cached device list & capabilities against the backends
    */
-  std::map<ScannerDeviceDescriptorPtr, OptionMap> optionMaps;
+  std::thread background;
+  std::deque<std::function<void()>> backgroundTasks;
+  bool backgroundRunning = false;
+  bool devicesRevalidated = false;
+
+  std::atomic<unsigned long long> optionWrites{0};
+  std::atomic<unsigned long long> skippedOptionWrites{0};
 };
\ No newline at end of file
@@ -0,0 +1,258 @@
+#include "scanrecording.h"
+
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <stdexcept>
+
+namespace
+{
+/**
+ * Bump, whenever the layout of the file changes
+ */
+const std::string RECORDING_HEADER = "scanahedron-recording 1";
+
+/**
+ * Serialises the appends of scans running in parallel
+ */
+std::mutex appendMutex;
+
+std::vector<std::string> split(const std::string &line)
+{
+    std::vector<std::string> fields;
+    size_t start = 0;
+    size_t tab;
+    while ((tab = line.find('\t', start)) != std::string::npos)
+    {
+        fields.push_back(line.substr(start, tab - start));
+        start = tab + 1;
+    }
+    fields.push_back(line.substr(start));
+    return fields;
+}
+
+template <typename T>
+void writeList(std::ostream &stream, const std::string &key, const std::vector<T> &values)
+{
+    stream << key;
+    for (const auto &value : values)
+    {
+        stream << '\t' << value;
+    }
+    stream << '\n';
+}
+
+unsigned int toMicroseconds(ScanRecorder::Clock::duration duration)
+{
+    return static_cast<unsigned int>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+}
+}
+
+ScanRecorder::ScanRecorder(const std::string &path_, const std::string &descriptor, const ScannerCapabilities &capabilities,
+                           const ScannerConfiguration &configuration)
+    : path(path_)
+{
+    scan.descriptor = descriptor;
+    scan.capabilities = capabilities;
+    scan.configuration = configuration;
+}
+
+void ScanRecorder::beginFrame()
+{
+    frameStarted = Clock::now();
+    waiting = false;
+}
+
+void ScanRecorder::addFrame(const FrameParameters &parameters)
+{
+    if (pageComplete)
+    {
+        scan.pages.emplace_back();
+    }
+    RecordedFrame frame;
+    frame.parameters = parameters;
+    frame.startTime = toMicroseconds(Clock::now() - frameStarted);
+    scan.pages.back().push_back(frame);
+    pageComplete = parameters.lastFrame;
+}
+
+void ScanRecorder::beginRead()
+{
+    if (!waiting)
+    {
+        waitingSince = Clock::now();
+        waiting = true;
+    }
+}
+
+void ScanRecorder::addRead(const unsigned char *data, size_t length)
+{
+    if (length == 0 || scan.pages.empty())
+    {
+        return;
+    }
+    RecordedRead read;
+    read.waitTime = toMicroseconds(Clock::now() - waitingSince);
+    read.data.assign(data, data + length);
+    scan.pages.back().back().reads.push_back(std::move(read));
+    waiting = false;
+}
+
+const RecordedScan &ScanRecorder::getScan() const
+{
+    return scan;
+}
+
+void ScanRecorder::save() const
+{
+    ScanRecording::append(path, scan);
+}
+
+void ScanRecording::append(const std::string &path, const RecordedScan &scan)
+{
+    std::lock_guard<std::mutex> lock(appendMutex);
+    std::ofstream stream(path, std::ios::app | std::ios::binary);
+    stream.seekp(0, std::ios::end);
+    if (stream.tellp() == 0)
+    {
+        stream << RECORDING_HEADER << '\n';
+    }
+
+    const ScannerCapabilities &capabilities = scan.capabilities;
+    const ScannerConfiguration &configuration = scan.configuration;
+    stream << std::setprecision(17);
+    stream << "scan\t" << scan.descriptor << '\n';
+    stream << "area\t" << capabilities.minX << '\t' << capabilities.minY << '\t' << capabilities.maxX << '\t' << capabilities.maxY << '\n';
+    writeList(stream, "resolutions", capabilities.possibleResolutionsInDPI);
+    writeList(stream, "sources", capabilities.possibleSources);
+    writeList(stream, "modes", capabilities.possibleModes);
+    stream << "configuration\t" << configuration.fromX << '\t' << configuration.fromY << '\t' << configuration.toX << '\t' << configuration.toY << '\t'
+           << configuration.resolutionInDPI << '\t' << configuration.preview << '\t' << configuration.source << '\t' << configuration.mode << '\n';
+    for (const auto &page : scan.pages)
+    {
+        stream << "page\n";
+        for (const auto &frame : page)
+        {
+            const FrameParameters &parameters = frame.parameters;
+            stream << "frame\t" << frame.startTime << '\t' << static_cast<int>(parameters.format) << '\t' << (parameters.lastFrame ? 1 : 0) << '\t'
+                   << parameters.bytesPerLine << '\t' << parameters.pixelsPerLine << '\t' << parameters.lines << '\t' << parameters.depth << '\n';
+            for (const auto &read : frame.reads)
+            {
+                stream << "read\t" << read.waitTime << '\t' << read.data.size() << '\n';
+                stream.write(reinterpret_cast<const char *>(read.data.data()), read.data.size());
+                stream << '\n';
+            }
+        }
+    }
+    stream.flush();
+    if (!stream)
+    {
+        throw std::runtime_error("Could not write the recording " + path);
+    }
+}
+
+std::vector<RecordedScan> ScanRecording::load(const std::string &path)
+{
+    std::ifstream stream(path, std::ios::binary);
+    std::string line;
+    if (!std::getline(stream, line) || line != RECORDING_HEADER)
+    {
+        throw std::runtime_error("Not a scan recording: " + path);
+    }
+
+    std::vector<RecordedScan> scans;
+    auto damaged = [&]() { return std::runtime_error("The scan recording " + path + " is damaged."); };
+    while (std::getline(stream, line))
+    {
+        std::vector<std::string> fields = split(line);
+        const std::string &key = fields[0];
+        if (key == "scan" && fields.size() == 2)
+        {
+            scans.emplace_back();
+            scans.back().descriptor = fields[1];
+            continue;
+        }
+        if (scans.empty())
+        {
+            throw damaged();
+        }
+        RecordedScan &scan = scans.back();
+        try
+        {
+            if (key == "area" && fields.size() == 5)
+            {
+                scan.capabilities.minX = std::stod(fields[1]);
+                scan.capabilities.minY = std::stod(fields[2]);
+                scan.capabilities.maxX = std::stod(fields[3]);
+                scan.capabilities.maxY = std::stod(fields[4]);
+            }
+            else if (key == "resolutions")
+            {
+                for (size_t i = 1; i < fields.size() && !fields[i].empty(); ++i)
+                {
+                    scan.capabilities.possibleResolutionsInDPI.push_back(std::stoi(fields[i]));
+                }
+            }
+            else if (key == "sources")
+            {
+                scan.capabilities.possibleSources.assign(fields.begin() + 1, fields.end());
+            }
+            else if (key == "modes")
+            {
+                scan.capabilities.possibleModes.assign(fields.begin() + 1, fields.end());
+            }
+            else if (key == "configuration" && fields.size() == 9)
+            {
+                scan.configuration.fromX = std::stod(fields[1]);
+                scan.configuration.fromY = std::stod(fields[2]);
+                scan.configuration.toX = std::stod(fields[3]);
+                scan.configuration.toY = std::stod(fields[4]);
+                scan.configuration.resolutionInDPI = std::stoi(fields[5]);
+                scan.configuration.preview = std::stoi(fields[6]);
+                scan.configuration.source = fields[7];
+                scan.configuration.mode = fields[8];
+            }
+            else if (key == "page" && fields.size() == 1)
+            {
+                scan.pages.emplace_back();
+            }
+            else if (key == "frame" && fields.size() == 8 && !scan.pages.empty())
+            {
+                RecordedFrame frame;
+                frame.startTime = std::stoul(fields[1]);
+                frame.parameters.format = static_cast<FrameParameters::Format>(std::stoi(fields[2]));
+                frame.parameters.lastFrame = fields[3] == "1";
+                frame.parameters.bytesPerLine = std::stoul(fields[4]);
+                frame.parameters.pixelsPerLine = std::stoul(fields[5]);
+                frame.parameters.lines = std::stoul(fields[6]);
+                frame.parameters.depth = std::stoul(fields[7]);
+                scan.pages.back().push_back(frame);
+            }
+            else if (key == "read" && fields.size() == 3 && !scan.pages.empty() && !scan.pages.back().empty())
+            {
+                RecordedRead read;
+                read.waitTime = std::stoul(fields[1]);
+                read.data.resize(std::stoul(fields[2]));
+                stream.read(reinterpret_cast<char *>(read.data.data()), read.data.size());
+                if (!stream || stream.get() != '\n')
+                {
+                    throw damaged();
+                }
+                scan.pages.back().back().reads.push_back(std::move(read));
+            }
+            else
+            {
+                throw damaged();
+            }
+        }
+        catch (const std::invalid_argument &)
+        {
+            throw damaged();
+        }
+        catch (const std::out_of_range &)
+        {
+            throw damaged();
+        }
+    }
+    return scans;
+}
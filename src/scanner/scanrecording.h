@@ -0,0 +1,114 @@
+#pragma once
+
+#include "iscannertypes.h"
+#include "pixelunpacker.h"
+
+#include <chrono>
+
+/**
+ * A read of a recorded frame: the data exactly as the backend returned it
+ */
+struct RecordedRead
+{
+  /**
+   * How long the scanner kept us waiting for the data (in µs): from the first read attempt after the previous data
+   * (or the start of the frame) until the data arrived, including the empty reads of a non-blocking scan
+   */
+  unsigned int waitTime = 0;
+
+  std::vector<unsigned char> data;
+};
+
+/**
+ * A recorded frame, with the time its sane_start took (in µs, e.g. the lamp warm-up)
+ */
+struct RecordedFrame
+{
+  FrameParameters parameters;
+  unsigned int startTime = 0;
+  std::vector<RecordedRead> reads;
+};
+
+/**
+ * A recorded scan of one device, with the device's options at the time of the scan.
+ * A single scan has one page, a scan of the document feeder one per fed page.
+ */
+struct RecordedScan
+{
+  std::string descriptor;
+  ScannerCapabilities capabilities;
+  ScannerConfiguration configuration;
+  std::vector<std::vector<RecordedFrame>> pages;
+};
+
+/**
+ * Records a scan while it runs, the scanner interface reports each sane_start & sane_read.
+ * Used by one thread at a time.
+ */
+class ScanRecorder
+{
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  /**
+   * @param path the recording file, the scan is appended to it by save()
+   */
+  ScanRecorder(const std::string &path, const std::string &descriptor, const ScannerCapabilities &capabilities, const ScannerConfiguration &configuration);
+
+  /**
+   * Called before sane_start
+   */
+  void beginFrame();
+
+  /**
+   * Called once the frame started, a frame after the last frame of a page starts the next page
+   */
+  void addFrame(const FrameParameters &parameters);
+
+  /**
+   * Called before each sane_read
+   */
+  void beginRead();
+
+  /**
+   * Called after a sane_read that returned data, empty reads are only counted as waiting time
+   */
+  void addRead(const unsigned char *data, size_t length);
+
+  const RecordedScan &getScan() const;
+
+  /**
+   * Append the recorded scan to the recording file
+   * @throws std::runtime_error if the file could not be written
+   */
+  void save() const;
+
+private:
+  std::string path;
+  RecordedScan scan;
+  Clock::time_point frameStarted;
+  Clock::time_point waitingSince;
+  bool waiting = false;
+  bool pageComplete = true;
+};
+
+/**
+ * The recording file: a header line, then one line per record with tab separated fields;
+ * each "read" line is followed by the raw data of the read & a newline.
+ * Several scans (also of different devices) may be appended to one file.
+ */
+class ScanRecording
+{
+public:
+  /**
+   * Append a scan to the file (the header is written, if the file is new)
+   * @throws std::runtime_error if the file could not be written
+   */
+  static void append(const std::string &path, const RecordedScan &scan);
+
+  /**
+   * Read all scans of the file
+   * @throws std::runtime_error if the file cannot be read or is damaged
+   */
+  static std::vector<RecordedScan> load(const std::string &path);
+};
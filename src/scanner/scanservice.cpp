@@ -1,49 +1,316 @@
 #include "scanservice.h"
 #include "iscannerinterface.h"
+#include "rawimagereceiver.h"
+#include "utils/threadpool.h"
 
-#include <png.hpp>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
+
+namespace
+{
+/**
+ * Pages that may wait for their encoding, before the feeder has to wait for the encoder
+ */
+const size_t MAX_PENDING_PAGES = 2;
+
+/**
+ * Collects each page of a batch & hands it on with its statistics once it is complete
+ */
+class BatchPageReceiver : public RawImageReceiver
+{
+public:
+    BatchPageReceiver(unsigned char inkThreshold_, std::function<void(RawImagePtr, const PageStatistics &)> onPage_)
+        : inkThreshold(inkThreshold_), onPage(onPage_)
+    {
+    }
+
+    virtual unsigned char getInkThreshold() const
+    {
+        return inkThreshold;
+    }
+
+    virtual void statistics(const PageStatistics &statistics)
+    {
+        pageStatistics = statistics;
+    }
+
+    virtual void end()
+    {
+        RawImageReceiver::end();
+        onPage(getImage(), pageStatistics);
+        pageStatistics = PageStatistics();
+    }
+
+private:
+    unsigned char inkThreshold;
+    std::function<void(RawImagePtr, const PageStatistics &)> onPage;
+    PageStatistics pageStatistics;
+};
+
+/**
+ * Forwards the rows to another receiver & remembers the image header
+ */
+class HeaderRecordingReceiver : public IScanReceiver
+{
+public:
+    explicit HeaderRecordingReceiver(IScanReceiver &receiver_)
+        : receiver(receiver_)
+    {
+    }
+
+    virtual void begin(const ImageHeader &header_)
+    {
+        header = header_;
+        receiver.begin(header);
+    }
+
+    virtual void rows(const unsigned char *pixels, unsigned int y, unsigned int count)
+    {
+        receiver.rows(pixels, y, count);
+    }
+
+    virtual void end()
+    {
+        receiver.end();
+    }
+
+    virtual unsigned char getInkThreshold() const
+    {
+        return receiver.getInkThreshold();
+    }
+
+    virtual void statistics(const PageStatistics &statistics)
+    {
+        receiver.statistics(statistics);
+    }
+
+    ImageHeader header;
+
+private:
+    IScanReceiver &receiver;
+};
+
+/**
+ * Forwards the rows to the encoder of a file & removes the file, if the encoder opened it without completing it
+ */
+class FileReceiver : public IScanReceiver
+{
+public:
+    FileReceiver(IImageEncoderPtr encoder_, const std::string &path_)
+        : encoder(encoder_), path(path_)
+    {
+    }
+
+    ~FileReceiver()
+    {
+        if (begun && !encoder->isComplete())
+        {
+            // the encoder closes the file first
+            encoder.reset();
+            std::remove(path.c_str());
+        }
+    }
+
+    virtual void begin(const ImageHeader &header)
+    {
+        begun = true;
+        encoder->begin(header);
+    }
+
+    virtual void rows(const unsigned char *pixels, unsigned int y, unsigned int count)
+    {
+        encoder->rows(pixels, y, count);
+    }
+
+    virtual void end()
+    {
+        encoder->end();
+    }
+
+    virtual unsigned char getInkThreshold() const
+    {
+        return encoder->getInkThreshold();
+    }
+
+    virtual void statistics(const PageStatistics &statistics)
+    {
+        encoder->statistics(statistics);
+    }
+
+    bool isComplete() const
+    {
+        return encoder->isComplete();
+    }
+
+private:
+    IImageEncoderPtr encoder;
+    std::string path;
+    bool begun = false;
+};
+
+/**
+ * Forwards the rows to another receiver & records the receiver's time in the scan's timeline
+ */
+class TimelineReceiver : public IScanReceiver
+{
+public:
+    TimelineReceiver(IScanReceiver &receiver_, ScanTimelinePtr timeline_)
+        : receiver(receiver_), timeline(timeline_)
+    {
+    }
+
+    virtual void begin(const ImageHeader &header)
+    {
+        ScanTimeline::Span encoding(timeline.get(), ScanPhase::Encode);
+        bytesPerRow = header.getBytesPerRow();
+        receiver.begin(header);
+    }
+
+    virtual void rows(const unsigned char *pixels, unsigned int y, unsigned int count)
+    {
+        ScanTimeline::Span encoding(timeline.get(), ScanPhase::Encode);
+        receiver.rows(pixels, y, count);
+        if (timeline)
+        {
+            timeline->addEncodedBytes(count * bytesPerRow);
+        }
+    }
+
+    virtual void end()
+    {
+        ScanTimeline::Span finishing(timeline.get(), ScanPhase::Finish);
+        receiver.end();
+    }
+
+    virtual unsigned char getInkThreshold() const
+    {
+        return receiver.getInkThreshold();
+    }
+
+    virtual void statistics(const PageStatistics &statistics)
+    {
+        receiver.statistics(statistics);
+    }
+
+    virtual ScanTimeline *getTimeline() const
+    {
+        return timeline.get();
+    }
+
+    /**
+     * The receiver to scan to: the forwarding one, if there is a timeline, otherwise the wrapped receiver itself
+     */
+    IScanReceiver &getReceiver()
+    {
+        return timeline ? *this : receiver;
+    }
+
+private:
+    IScanReceiver &receiver;
+    ScanTimelinePtr timeline;
+    size_t bytesPerRow = 0;
+};
+
+/**
+ * A scan session, that keeps the device's turn until it is destroyed
+ */
+class ScheduledScanSession : public IScanSession
+{
+public:
+    ScheduledScanSession(JobScheduler::Turn &&turn_, std::unique_ptr<TimelineReceiver> receiver_, IScanSessionPtr session_, std::function<void()> onComplete_)
+        : turn(std::move(turn_)), receiver(std::move(receiver_)), session(session_), onComplete(onComplete_)
+    {
+    }
+
+    virtual int getSelectFd()
+    {
+        return session->getSelectFd();
+    }
+
+    virtual bool read()
+    {
+        bool complete = session->read();
+        turn.throwIfCancelled();
+        if (complete)
+        {
+            onComplete();
+        }
+        return complete;
+    }
+
+private:
+    // declared first, so that the scan ends before the next job may start
+    JobScheduler::Turn turn;
+    std::unique_ptr<TimelineReceiver> receiver;
+    IScanSessionPtr session;
+    std::function<void()> onComplete;
+};
+}
 
 ScanService::ScanService(IScannerInterfacePtr interface_)
-    : interface(interface_)
+    : interface(interface_), scheduler([this](ScannerDeviceDescriptorPtr device) { interface->cancel(device); })
 {
     if (!interface)
     {
         throw std::runtime_error("No scanner interface given!");
     }
-    if (!interface->init())
-    {
-        throw std::runtime_error("Could not initialize scanner interface!");
-    }
 }
 
 ScanService::~ScanService()
 {
-    if (interface)
+    if (interface && initialized)
     {
         interface->exit();
     }
 }
 
+void ScanService::ensureInitialized()
+{
+    std::lock_guard<std::mutex> lock(initMutex);
+    if (initialized)
+    {
+        return;
+    }
+    if (!interface->init())
+    {
+        throw std::runtime_error("Could not initialize scanner interface!");
+    }
+    initialized = true;
+}
+
+void ScanService::warmup()
+{
+    getAvailableScanners();
+}
+
 void ScanService::loadScanners()
 {
+    ensureInitialized();
+    std::lock_guard<std::mutex> lock(devicesMutex);
     availableScanners = interface->getDevices();
 }
 
-const std::vector<ScannerDeviceDescriptorPtr> &ScanService::getAvailableScanners()
+std::vector<ScannerDeviceDescriptorPtr> ScanService::getAvailableScanners()
 {
+    ensureInitialized();
+    std::lock_guard<std::mutex> lock(devicesMutex);
     if (availableScanners.empty())
     {
-        loadScanners();
+        availableScanners = interface->getDevices();
     }
     return availableScanners;
 }
 
 ScannerDeviceDescriptorPtr ScanService::getActualDevice(ScannerDeviceDescriptorPtr device)
 {
+    ensureInitialized();
     if (device == nullptr)
     {
-        const auto &scanners = getAvailableScanners();
+        const auto scanners = getAvailableScanners();
         if (scanners.empty())
         {
             throw std::runtime_error("No scanner found!");
@@ -53,56 +320,349 @@ ScannerDeviceDescriptorPtr ScanService::getActualDevice(ScannerDeviceDescriptorP
     return device;
 }
 
-ScannerCapabilities ScanService::getCapabilities(ScannerDeviceDescriptorPtr device)
+ScannerCapabilities ScanService::getCapabilities(ScannerDeviceDescriptorPtr device, const ScanJob &job)
 {
     ScannerDeviceDescriptorPtr actualDevice = getActualDevice(device);
+    auto turn = scheduler.start(actualDevice, job);
     return interface->getCapabilities(actualDevice);
 }
 
-ScannerConfiguration ScanService::getConfiguration(ScannerDeviceDescriptorPtr device)
+ScannerConfiguration ScanService::getConfiguration(ScannerDeviceDescriptorPtr device, const ScanJob &job)
 {
     ScannerDeviceDescriptorPtr actualDevice = getActualDevice(device);
+    auto turn = scheduler.start(actualDevice, job);
     return interface->getConfiguration(actualDevice);
 }
 
-void ScanService::setConfiguration(ScannerDeviceDescriptorPtr device, const ScannerConfiguration &configuration)
+void ScanService::setConfiguration(ScannerDeviceDescriptorPtr device, const ScannerConfiguration &configuration, const ScanJob &job)
 {
     ScannerDeviceDescriptorPtr actualDevice = getActualDevice(device);
+    auto turn = scheduler.start(actualDevice, job);
     interface->setConfiguration(actualDevice, configuration);
 }
 
-RawImagePtr ScanService::scanToBuffer(ScannerDeviceDescriptorPtr device)
+ScannerStatistics ScanService::getStatistics()
+{
+    return interface->getStatistics();
+}
+
+unsigned long long ScanService::createJobId()
+{
+    return scheduler.createJobId();
+}
+
+bool ScanService::cancelJob(unsigned long long jobId)
+{
+    return scheduler.cancel(jobId);
+}
+
+void ScanService::reserveJob(ScannerDeviceDescriptorPtr device, const ScanJob &job, std::function<void()> onTurn)
+{
+    // The queue phase of the timeline lasts until the reservation
+    auto queueing = std::make_shared<std::unique_ptr<ScanTimeline::Span>>(new ScanTimeline::Span(job.timeline.get(), ScanPhase::Queue));
+    scheduler.reserve(getActualDevice(device), job, [queueing, onTurn]() {
+        queueing->reset();
+        onTurn();
+    });
+}
+
+void ScanService::releaseJob(unsigned long long jobId)
+{
+    scheduler.release(jobId);
+}
+
+QueueStatistics ScanService::getQueueStatistics(ScannerDeviceDescriptorPtr device)
+{
+    return scheduler.getStatistics(getActualDevice(device));
+}
+
+RawImagePtr ScanService::scanToBuffer(ScannerDeviceDescriptorPtr device, const ImageStorage &storage, const ScanJob &job)
+{
+    ScannerDeviceDescriptorPtr actualDevice = getActualDevice(device);
+    ScanTimelinePtr timeline = getTimeline(job, "scanToBuffer");
+    auto turn = startJob(actualDevice, job, timeline);
+    RawImagePtr image;
+    if (!storage.mapped && !timeline)
+    {
+        image = interface->scanToBuffer(actualDevice);
+    }
+    else
+    {
+        RawImageReceiver receiver(storage);
+        TimelineReceiver timedReceiver(receiver, timeline);
+        interface->scan(actualDevice, timedReceiver.getReceiver());
+        image = receiver.getImage();
+    }
+    // a cancel may come too late to abort the read, the job fails all the same
+    turn.throwIfCancelled();
+    writeTrace(timeline);
+    return image;
+}
+
+void ScanService::scanToStream(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver, const ScanJob &job)
+{
+    scanToReceiver(device, receiver, job, "scanToStream");
+}
+
+void ScanService::scanToReceiver(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver, const ScanJob &job, const char *operation)
 {
     ScannerDeviceDescriptorPtr actualDevice = getActualDevice(device);
-    return interface->scanToBuffer(actualDevice);
+    ScanTimelinePtr timeline = getTimeline(job, operation);
+    auto turn = startJob(actualDevice, job, timeline);
+    TimelineReceiver timedReceiver(receiver, timeline);
+    interface->scan(actualDevice, timedReceiver.getReceiver());
+    turn.throwIfCancelled();
+    writeTrace(timeline);
 }
 
-bool ScanService::scanToFile(ScannerDeviceDescriptorPtr device, const std::string &destinationPath)
+IScanSessionPtr ScanService::startScan(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver, const ScanJob &job)
 {
-    RawImagePtr buffer = scanToBuffer(device);
+    ScannerDeviceDescriptorPtr actualDevice = getActualDevice(device);
+    ScanTimelinePtr timeline = getTimeline(job, "startScan");
+    auto turn = startJob(actualDevice, job, timeline);
+    std::unique_ptr<TimelineReceiver> timedReceiver(new TimelineReceiver(receiver, timeline));
+    IScanSessionPtr session = interface->startScan(actualDevice, timedReceiver->getReceiver());
+    return IScanSessionPtr(new ScheduledScanSession(std::move(turn), std::move(timedReceiver), session, [this, timeline]() { writeTrace(timeline); }));
+}
 
-    if (buffer == nullptr)
+PreviewArea ScanService::preview(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver, const ScanJob &job)
+{
+    ScannerDeviceDescriptorPtr actualDevice = getActualDevice(device);
+    ScanTimelinePtr timeline = getTimeline(job, "preview");
+    auto turn = startJob(actualDevice, job, timeline);
+
+    ScannerConfiguration previous = interface->getConfiguration(actualDevice);
+    ScannerCapabilities capabilities = interface->getCapabilities(actualDevice);
+    if (capabilities.possibleResolutionsInDPI.empty())
     {
-        return false;
+        throw std::runtime_error("The scanner reports no resolutions.");
     }
 
-    png::image<png::rgb_pixel> image(buffer->width, buffer->height);
-    unsigned char *pivot = buffer->pixels;
-    for (int y = 0; y < buffer->height; ++y)
+    ScannerConfiguration configuration;
+    configuration.fromX = capabilities.minX;
+    configuration.fromY = capabilities.minY;
+    configuration.toX = capabilities.maxX;
+    configuration.toY = capabilities.maxY;
+    configuration.resolutionInDPI = *std::min_element(capabilities.possibleResolutionsInDPI.begin(), capabilities.possibleResolutionsInDPI.end());
+    configuration.preview = 1;
+
+    // Only the changed options are written back, i.e. the resolution, the geometry & the preview mode
+    previous.preview = 0;
+    HeaderRecordingReceiver recorder(receiver);
+    TimelineReceiver timedReceiver(recorder, timeline);
+    try
     {
-        for (int x = 0; x < buffer->width; ++x)
+        interface->setConfiguration(actualDevice, configuration);
+        turn.throwIfCancelled();
+        interface->scan(actualDevice, timedReceiver.getReceiver());
+    }
+    catch (...)
+    {
+        interface->setConfiguration(actualDevice, previous);
+        throw;
+    }
+    interface->setConfiguration(actualDevice, previous);
+    turn.throwIfCancelled();
+    writeTrace(timeline);
+
+    PreviewArea area;
+    area.fromX = configuration.fromX;
+    area.fromY = configuration.fromY;
+    area.toX = configuration.toX;
+    area.toY = configuration.toY;
+    area.resolutionInDPI = configuration.resolutionInDPI;
+    area.width = recorder.header.width;
+    area.height = recorder.header.height;
+    return area;
+}
+
+ScannerConfiguration ScanService::getRegionConfiguration(const PreviewArea &preview, unsigned int x, unsigned int y, unsigned int width, unsigned int height)
+{
+    if (preview.width == 0 || preview.height == 0)
+    {
+        throw std::runtime_error("The preview is empty.");
+    }
+    // The backend may round the area to whole pixels, so the scale is taken from the actual preview image
+    const double mmPerPixelX = (preview.toX - preview.fromX) / preview.width;
+    const double mmPerPixelY = (preview.toY - preview.fromY) / preview.height;
+
+    ScannerConfiguration configuration;
+    configuration.fromX = preview.fromX + std::min(x, preview.width) * mmPerPixelX;
+    configuration.fromY = preview.fromY + std::min(y, preview.height) * mmPerPixelY;
+    configuration.toX = preview.fromX + std::min(x + width, preview.width) * mmPerPixelX;
+    configuration.toY = preview.fromY + std::min(y + height, preview.height) * mmPerPixelY;
+    return configuration;
+}
+
+bool ScanService::scanToFile(ScannerDeviceDescriptorPtr device, const std::string &destinationPath, const EncoderOptions &options, const ScanJob &job)
+{
+    FileReceiver file(encoders.create(destinationPath, options), destinationPath);
+    scanToReceiver(device, file, job, "scanToFile");
+    return file.isComplete();
+}
+
+std::vector<ScannedPage> ScanService::scanBatchToFiles(ScannerDeviceDescriptorPtr device, const std::string &pathPattern, const EncoderOptions &options,
+                                                       const BlankPageOptions &blankPages, const ScanJob &job)
+{
+    ScannerDeviceDescriptorPtr actualDevice = getActualDevice(device);
+    ScanTimelinePtr timeline = getTimeline(job, "scanBatchToFiles");
+    auto turn = startJob(actualDevice, job, timeline);
+
+    std::vector<ScannedPage> pages;
+    unsigned int storedPages = 0;
+    std::deque<std::future<void>> pendingPages;
+    ThreadPool encoding(1);
+
+    // The ink threshold must not be 0, the statistics are always collected for the report
+    BatchPageReceiver receiver(std::max<unsigned char>(1, blankPages.inkThreshold), [&](RawImagePtr page, const PageStatistics &statistics) {
+        ScannedPage scannedPage;
+        scannedPage.number = static_cast<unsigned int>(pages.size()) + 1;
+        scannedPage.statistics = statistics;
+        scannedPage.blank = statistics.getInkCoverage() <= blankPages.maximumInkCoverage;
+        if (scannedPage.blank && blankPages.skip)
         {
-            if (buffer->bytesPerPixel == 3)
-            {
-                image[y][x] = png::rgb_pixel(*pivot++, *pivot++, *pivot++);
-            }
-            else if (buffer->bytesPerPixel == 1)
-            {
-                image[y][x] = png::rgb_pixel(*pivot, *pivot, *pivot++);
-            }
+            pages.push_back(scannedPage);
+            return;
         }
+
+        // Only block the feeder, if the encoder falls behind by more than a few pages
+        while (pendingPages.size() >= MAX_PENDING_PAGES)
+        {
+            pendingPages.front().get();
+            pendingPages.pop_front();
+        }
+
+        std::string path = getBatchPagePath(pathPattern, ++storedPages);
+        scannedPage.path = path;
+        pages.push_back(scannedPage);
+        pendingPages.push_back(encoding.submit([this, page, path, options]() { storeImage(*page, path, options); }));
+    });
+
+    TimelineReceiver timedReceiver(receiver, timeline);
+    interface->scanBatch(actualDevice, timedReceiver.getReceiver());
+    turn.throwIfCancelled();
+    for (auto &pendingPage : pendingPages)
+    {
+        pendingPage.get();
+    }
+    writeTrace(timeline);
+    return pages;
+}
+
+std::vector<ItemBounds> ScanService::scanItems(ScannerDeviceDescriptorPtr device, const std::string &pathPattern, const EncoderOptions &options,
+                                               const ItemDetectorOptions &detectorOptions, const ScanJob &job)
+{
+    RawImagePtr image = scanToBuffer(device, ImageStorage(), job);
+    std::vector<ItemBounds> items = ItemDetector(detectorOptions).detect(*image);
+    if (pathPattern.empty())
+    {
+        return items;
     }
 
-    image.write(destinationPath);
-    return true;
+    // The items are cut from the one full resolution pass & encoded in parallel
+    ThreadPool encoding(std::min<size_t>(items.size(), std::max(1u, std::thread::hardware_concurrency())));
+    std::vector<std::future<void>> pendingItems;
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+        std::string path = getBatchPagePath(pathPattern, static_cast<unsigned int>(i) + 1);
+        ItemBounds bounds = items[i];
+        pendingItems.push_back(encoding.submit([this, image, bounds, path, options]() {
+            storeImage(*ItemDetector::crop(*image, bounds), path, options);
+        }));
+    }
+    for (auto &pendingItem : pendingItems)
+    {
+        pendingItem.get();
+    }
+    return items;
+}
+
+std::string ScanService::getBatchPagePath(const std::string &pathPattern, unsigned int page)
+{
+    size_t separator = pathPattern.find_last_of('/');
+    size_t fileStart = separator == std::string::npos ? 0 : separator + 1;
+
+    size_t placeholder = pathPattern.find('#', fileStart);
+    if (placeholder == std::string::npos)
+    {
+        size_t dot = pathPattern.find_last_of('.');
+        size_t insertAt = dot == std::string::npos || dot < fileStart ? pathPattern.size() : dot;
+        return pathPattern.substr(0, insertAt) + "-" + std::to_string(page) + pathPattern.substr(insertAt);
+    }
+
+    size_t placeholderEnd = pathPattern.find_first_not_of('#', placeholder);
+    if (placeholderEnd == std::string::npos)
+    {
+        placeholderEnd = pathPattern.size();
+    }
+    std::ostringstream stream;
+    stream << pathPattern.substr(0, placeholder) << std::setw(placeholderEnd - placeholder) << std::setfill('0') << page
+           << pathPattern.substr(placeholderEnd);
+    return stream.str();
+}
+
+EncoderRegistry &ScanService::getEncoders()
+{
+    return encoders;
+}
+
+void ScanService::setTraceFile(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(traceMutex);
+    traceFile = path;
+}
+
+JobScheduler::Turn ScanService::startJob(ScannerDeviceDescriptorPtr device, const ScanJob &job, const ScanTimelinePtr &timeline)
+{
+    ScanTimeline::Span queueing(timeline.get(), ScanPhase::Queue);
+    return scheduler.start(device, job);
+}
+
+ScanTimelinePtr ScanService::getTimeline(const ScanJob &job, const char *operation)
+{
+    if (job.timeline)
+    {
+        return job.timeline;
+    }
+    std::lock_guard<std::mutex> lock(traceMutex);
+    return traceFile.empty() ? nullptr : std::make_shared<ScanTimeline>(operation, job.id);
+}
+
+void ScanService::writeTrace(const ScanTimelinePtr &timeline)
+{
+    if (!timeline)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(traceMutex);
+    if (traceFile.empty())
+    {
+        return;
+    }
+    std::ofstream stream(traceFile, std::ios::app);
+    stream.seekp(0, std::ios::end);
+    // the closing bracket is optional in the JSON array format, the file stays appendable
+    stream << (stream.tellp() == 0 ? "[\n" : ",\n");
+    timeline->writeTraceEvents(stream);
+    if (!stream)
+    {
+        std::cerr << "Could not write the scan trace to " << traceFile << std::endl;
+    }
+}
+
+void ScanService::storeImage(const RawImage &image, const std::string &path, const EncoderOptions &options)
+{
+    ImageHeader header;
+    header.width = image.width;
+    header.height = image.height;
+    header.format = image.format;
+
+    FileReceiver file(encoders.create(path, options), path);
+    file.begin(header);
+    file.rows(image.pixels, 0, image.height);
+    file.end();
+    if (!file.isComplete())
+    {
+        throw std::runtime_error("Could not store " + path);
+    }
 }
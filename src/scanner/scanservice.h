@@ -1,22 +1,37 @@
 #pragma once
 
 #include "iscannerinterface.h"
+#include "encoder/encoderregistry.h"
+#include "processing/itemdetector.h"
+#include "jobscheduler.h"
+
+#include <mutex>
 
 SHARED_PTR(ScanService);
 
 /**
  * The scan service allows scanner access through a simple interface.
+ * All operations may be called from any thread. Operations on the same device are queued & run one at a time
+ * (by the priority of their job, see JobScheduler), operations on different devices run in parallel.
+ * The scanner interface is initialised on first use.
  */
 class ScanService
 {
 public:
   /**
-   * Constructs a scan service with a specific implementation of the scanner interface
+   * Constructs a scan service with a specific implementation of the scanner interface.
+   * The interface is not initialised before the first operation (or warmup).
    */
   ScanService(IScannerInterfacePtr interface);
 
   ~ScanService();
 
+  /**
+   * Initialise the interface & discover the scanners ahead of the first operation.
+   * Blocks until done, meant to be run on a background thread.
+   */
+  void warmup();
+
   /**
    * Loads the available scanners
    */
@@ -25,36 +40,165 @@ public:
   /**
    * Retrieve a list of available scanners
    */
-  const std::vector<ScannerDeviceDescriptorPtr> &getAvailableScanners();
+  std::vector<ScannerDeviceDescriptorPtr> getAvailableScanners();
 
   /**
    * Read the scanner capabilities
    */
-  ScannerCapabilities getCapabilities(ScannerDeviceDescriptorPtr device);
+  ScannerCapabilities getCapabilities(ScannerDeviceDescriptorPtr device, const ScanJob &job = ScanJob(JobPriority::Interactive));
 
   /**
    * Read the current scanner configuration
    */
-  ScannerConfiguration getConfiguration(ScannerDeviceDescriptorPtr device);
+  ScannerConfiguration getConfiguration(ScannerDeviceDescriptorPtr device, const ScanJob &job = ScanJob(JobPriority::Interactive));
 
   /**
    * Set the scanner configuration (not nessecary, if automatic settings are good enough)
    */
-  void setConfiguration(ScannerDeviceDescriptorPtr device, const ScannerConfiguration &configuration);
+  void setConfiguration(ScannerDeviceDescriptorPtr device, const ScannerConfiguration &configuration, const ScanJob &job = ScanJob(JobPriority::Interactive));
+
+  /**
+   * Counters of the backend traffic
+   */
+  ScannerStatistics getStatistics();
+
+  /**
+   * A new id for a job, that may be cancelled with cancelJob
+   */
+  unsigned long long createJobId();
+
+  /**
+   * Cancel a waiting job or abort a running one (its scan stops mid-read), the job's operation throws
+   * @return false, if there is no such job (anymore)
+   */
+  bool cancelJob(unsigned long long jobId);
+
+  /**
+   * Queue a job without blocking the calling thread: onTurn is called once the device is reserved for the job
+   * (or the job was cancelled), the job's operation then starts without waiting. The job needs an id (see createJobId).
+   * Meant for callers that must not hold a thread while the job waits, e.g. a thread pool.
+   */
+  void reserveJob(ScannerDeviceDescriptorPtr device, const ScanJob &job, std::function<void()> onTurn);
+
+  /**
+   * Give up the reservation of a job, that its operation did not take (e.g. because it failed before), see reserveJob
+   */
+  void releaseJob(unsigned long long jobId);
+
+  /**
+   * The queue depth & the time the jobs waited for the device
+   */
+  QueueStatistics getQueueStatistics(ScannerDeviceDescriptorPtr device);
 
   /**
    * Scan an image with the active configuration to a buffer and return it.
+   * @param storage where the pixels live, a memory mapped file keeps very large scans out of the memory
    * @return a raw image buffer with the scanned image
    */
-  RawImagePtr scanToBuffer(ScannerDeviceDescriptorPtr device);
+  RawImagePtr scanToBuffer(ScannerDeviceDescriptorPtr device, const ImageStorage &storage = ImageStorage(), const ScanJob &job = ScanJob());
+
+  /**
+   * Scan an image with the active configuration and hand the rows to the receiver while the scan is running.
+   */
+  void scanToStream(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver, const ScanJob &job = ScanJob());
+
+  /**
+   * Start a scan with the active configuration, whose data is read by the caller when the scanner has data (see IScanSession),
+   * so that many scans can share one event loop. The device is reserved for the job until the session is destroyed.
+   * Blocks until it is the job's turn & the scan started.
+   */
+  IScanSessionPtr startScan(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver, const ScanJob &job = ScanJob());
+
+  /**
+   * Scan a fast preview of the whole scan area at the lowest resolution (& in the backend's preview mode, if it has one)
+   * and hand the rows to the receiver. The configuration is restored afterwards.
+   * @return the scanned area, to map a region of the preview to a configuration (see getRegionConfiguration)
+   */
+  PreviewArea preview(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver, const ScanJob &job = ScanJob(JobPriority::Interactive));
 
   /**
-   * Scan to the given file (PNG) format. This is merely a wrapper around scan to buffer.
+   * Map a region of a preview image (in pixels) to the scan geometry (in mm).
+   * Only the geometry of the returned configuration is set, the other options stay unchanged when it is applied.
+   */
+  static ScannerConfiguration getRegionConfiguration(const PreviewArea &preview, unsigned int x, unsigned int y, unsigned int width, unsigned int height);
+
+  /**
+   * Scan to the given file. The format is taken from the options or the file extension (PNG, PNM, TIFF, JPEG),
+   * the rows are encoded while the scan is running.
+   * A failed or cancelled scan removes the partial file.
    * @return true, if the file was successfully stored on the disk.
    */
-  bool scanToFile(ScannerDeviceDescriptorPtr device, const std::string &destinationPath);
+  bool scanToFile(ScannerDeviceDescriptorPtr device, const std::string &destinationPath, const EncoderOptions &options = EncoderOptions(), const ScanJob &job = ScanJob());
+
+  /**
+   * Scan all pages of the document feeder to files. A page is encoded on a separate thread,
+   * while the feeder already scans the next one. Blank pages are detected from statistics collected while the rows
+   * are unpacked, dropped blank pages are never encoded.
+   * @param pathPattern the destination of the pages, a run of '#' is replaced by the zero padded number (from 1) of the stored page
+   * @return every scanned page with its statistics & the file it was stored to
+   */
+  std::vector<ScannedPage> scanBatchToFiles(ScannerDeviceDescriptorPtr device, const std::string &pathPattern, const EncoderOptions &options = EncoderOptions(),
+                                            const BlankPageOptions &blankPages = BlankPageOptions(), const ScanJob &job = ScanJob(JobPriority::Batch));
+
+  /**
+   * Scan the whole flatbed once & find the separate items on it (receipts, photos, ...).
+   * @param pathPattern if given, each item is stored to a file of its own, named like the pages of a batch (see getBatchPagePath)
+   * @return the bounds of the items in the scanned image, in the order of their files
+   */
+  std::vector<ItemBounds> scanItems(ScannerDeviceDescriptorPtr device, const std::string &pathPattern = std::string(),
+                                    const EncoderOptions &options = EncoderOptions(), const ItemDetectorOptions &detectorOptions = ItemDetectorOptions(),
+                                    const ScanJob &job = ScanJob());
+
+  /**
+   * The destination of a batch page: "scan-###.png" becomes "scan-007.png" for page 7,
+   * without placeholder the page number is appended to the file name ("scan-7.png").
+   */
+  static std::string getBatchPagePath(const std::string &pathPattern, unsigned int page);
+
+  /**
+   * The encoders used by scanToFile, additional formats may be registered here (from any thread)
+   */
+  EncoderRegistry &getEncoders();
+
+  /**
+   * Append the timeline of every scan to the given file as Chrome trace events (see ScanTimeline::writeTraceEvents),
+   * scans record a timeline then, even if their job has none. An empty path stops the tracing (the default).
+   */
+  void setTraceFile(const std::string &path);
 
 private:
+  /**
+   * Initialise the scanner interface, unless it is already
+   * @throws std::runtime_error if the interface cannot be initialised
+   */
+  void ensureInitialized();
+
+  /**
+   * Encode a complete image to the given file (a partial file is removed)
+   * @throws std::runtime_error if the file could not be stored
+   */
+  void storeImage(const RawImage &image, const std::string &path, const EncoderOptions &options);
+
+  /**
+   * Scan to the receiver (the common part of scanToStream & scanToFile)
+   */
+  void scanToReceiver(ScannerDeviceDescriptorPtr device, IScanReceiver &receiver, const ScanJob &job, const char *operation);
+
+  /**
+   * Wait for the job's turn on the device, recorded as the queue phase of the timeline
+   */
+  JobScheduler::Turn startJob(ScannerDeviceDescriptorPtr device, const ScanJob &job, const ScanTimelinePtr &timeline);
+
+  /**
+   * The timeline a scan records: the job's, a new one if the scans are traced, nullptr otherwise
+   */
+  ScanTimelinePtr getTimeline(const ScanJob &job, const char *operation);
+
+  /**
+   * Append the timeline to the trace file, if the scans are traced
+   */
+  void writeTrace(const ScanTimelinePtr &timeline);
+
   /**
    * Retrieve the actual scanner, if a nullptr is passed, the defulat resp. first scanner is used.
    */
@@ -62,5 +206,31 @@ private:
 
   IScannerInterfacePtr interface;
 
+  EncoderRegistry encoders;
+
+  /**
+   * Guards the lazy initialisation of the interface
+   */
+  std::mutex initMutex;
+
+  bool initialized = false;
+
+  /**
+   * Guards the available scanners
+   */
+  std::mutex devicesMutex;
+
+  /**
+   * Runs the operations of each device one at a time
+   */
+  JobScheduler scheduler;
+
   std::vector<ScannerDeviceDescriptorPtr> availableScanners;
+
+  /**
+   * Guards the trace file
+   */
+  std::mutex traceMutex;
+
+  std::string traceFile;
 };
\ No newline at end of file
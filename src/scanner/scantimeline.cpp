@@ -0,0 +1,153 @@
+#include "scantimeline.h"
+
+#include <atomic>
+#include <iomanip>
+#include <unistd.h>
+
+namespace
+{
+    double toMilliseconds(ScanTimeline::Clock::duration duration)
+    {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    double toMicroseconds(ScanTimeline::Clock::time_point time)
+    {
+        return std::chrono::duration<double, std::micro>(time.time_since_epoch()).count();
+    }
+
+    /**
+     * Small ids for the threads, in the order they first recorded a phase
+     */
+    size_t getThreadId()
+    {
+        static std::atomic<size_t> nextId{1};
+        thread_local size_t id = nextId++;
+        return id;
+    }
+}
+
+ScanTimeline::Span::Span(ScanTimeline *timeline_, ScanPhase phase_)
+    : timeline(timeline_), phase(phase_)
+{
+    if (timeline)
+    {
+        timeline->beginSpan();
+        start = Clock::now();
+    }
+}
+
+ScanTimeline::Span::~Span()
+{
+    if (timeline)
+    {
+        timeline->endSpan(phase, start);
+    }
+}
+
+ScanTimeline::ScanTimeline(const std::string &name_, unsigned long long jobId_)
+    : name(name_), jobId(jobId_), created(Clock::now()), lastEnd(created), lastData(created)
+{
+}
+
+void ScanTimeline::beginSpan()
+{
+    openSpans.push_back(Clock::duration::zero());
+}
+
+void ScanTimeline::endSpan(ScanPhase phase, Clock::time_point start)
+{
+    Clock::time_point end = Clock::now();
+    Clock::duration duration = end - start;
+    phaseTimes[static_cast<int>(phase)] += duration - openSpans.back();
+    openSpans.pop_back();
+    if (!openSpans.empty())
+    {
+        openSpans.back() += duration;
+    }
+
+    if (events.size() < MAX_EVENTS)
+    {
+        events.push_back(Event{phase, start, end, getThreadId()});
+    }
+    lastEnd = std::max(lastEnd, end);
+    if (phase == ScanPhase::Start)
+    {
+        // the scanner's data is expected from now on
+        lastData = end;
+    }
+}
+
+void ScanTimeline::addRead(Clock::time_point start, size_t bytes)
+{
+    beginSpan();
+    endSpan(ScanPhase::Read, start);
+    readCalls++;
+    if (bytes > 0)
+    {
+        bytesRead += bytes;
+        largestReadGap = std::max(largestReadGap, lastEnd - lastData);
+        lastData = lastEnd;
+    }
+}
+
+void ScanTimeline::addEncodedBytes(size_t bytes)
+{
+    encodedBytes += bytes;
+}
+
+ScanTimings ScanTimeline::getTimings() const
+{
+    ScanTimings timings;
+    timings.queueTime = toMilliseconds(phaseTimes[static_cast<int>(ScanPhase::Queue)]);
+    timings.startTime = toMilliseconds(phaseTimes[static_cast<int>(ScanPhase::Start)]);
+    timings.readTime = toMilliseconds(phaseTimes[static_cast<int>(ScanPhase::Read)]);
+    timings.unpackTime = toMilliseconds(phaseTimes[static_cast<int>(ScanPhase::Unpack)]);
+    timings.encodeTime = toMilliseconds(phaseTimes[static_cast<int>(ScanPhase::Encode)]);
+    timings.finishTime = toMilliseconds(phaseTimes[static_cast<int>(ScanPhase::Finish)]);
+    timings.totalTime = toMilliseconds(lastEnd - created);
+    timings.bytesRead = bytesRead;
+    timings.readCalls = readCalls;
+    timings.largestReadGap = toMilliseconds(largestReadGap);
+    timings.encodedBytes = encodedBytes;
+    return timings;
+}
+
+void ScanTimeline::writeTraceEvents(std::ostream &stream) const
+{
+    const int pid = static_cast<int>(getpid());
+    const size_t scanThread = events.empty() ? getThreadId() : events.front().thread;
+    const ScanTimings timings = getTimings();
+
+    stream << std::fixed << std::setprecision(3);
+    stream << "{\"name\":\"" << name << "\",\"cat\":\"scan\",\"ph\":\"X\",\"ts\":" << toMicroseconds(created)
+           << ",\"dur\":" << toMilliseconds(lastEnd - created) * 1000.0 << ",\"pid\":" << pid << ",\"tid\":" << scanThread
+           << ",\"args\":{\"job\":" << jobId << ",\"bytesRead\":" << timings.bytesRead << ",\"readCalls\":" << timings.readCalls
+           << ",\"largestReadGap\":" << timings.largestReadGap << ",\"encodeThroughput\":" << timings.getEncodeThroughput() << "}}";
+    for (const auto &event : events)
+    {
+        stream << ",\n{\"name\":\"" << getPhaseName(event.phase) << "\",\"cat\":\"scan\",\"ph\":\"X\",\"ts\":" << toMicroseconds(event.start)
+               << ",\"dur\":" << toMilliseconds(event.end - event.start) * 1000.0 << ",\"pid\":" << pid << ",\"tid\":" << event.thread
+               << ",\"args\":{\"job\":" << jobId << "}}";
+    }
+}
+
+const char *ScanTimeline::getPhaseName(ScanPhase phase)
+{
+    switch (phase)
+    {
+    case ScanPhase::Queue:
+        return "queue";
+    case ScanPhase::Start:
+        return "start";
+    case ScanPhase::Read:
+        return "read";
+    case ScanPhase::Unpack:
+        return "unpack";
+    case ScanPhase::Encode:
+        return "encode";
+    case ScanPhase::Finish:
+        return "finish";
+    }
+    return "unknown";
+}
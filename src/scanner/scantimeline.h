@@ -0,0 +1,190 @@
+#pragma once
+
+#include "utils/defines.h"
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+SHARED_PTR(ScanTimeline);
+
+/**
+ * The phases of a scan, as recorded by ScanTimeline
+ */
+enum class ScanPhase
+{
+  /**
+   * Waiting for the device (the job queue)
+   */
+  Queue,
+  /**
+   * Starting a frame (sane_start, includes e.g. the lamp warm-up)
+   */
+  Start,
+  /**
+   * Waiting for the scanner's data (sane_read)
+   */
+  Read,
+  /**
+   * Converting the scanner's data to rows
+   */
+  Unpack,
+  /**
+   * The receiver handling the rows (encoding, for a file)
+   */
+  Encode,
+  /**
+   * The receiver completing the image (the encoder's last writes & closing the file)
+   */
+  Finish
+};
+
+/**
+ * Where the time of a scan went. The times are in ms, nested phases are not included in the outer phase
+ * (e.g. the unpack time does not include the time the receiver took for the unpacked rows).
+ */
+struct ScanTimings
+{
+  double queueTime = 0;
+  double startTime = 0;
+  double readTime = 0;
+  double unpackTime = 0;
+  double encodeTime = 0;
+  double finishTime = 0;
+
+  /**
+   * From the start of the timeline (the job was queued) until the end of its last phase
+   */
+  double totalTime = 0;
+
+  unsigned long long bytesRead = 0;
+
+  /**
+   * All reads, including those of a non-blocking scan that found no data
+   */
+  unsigned long long readCalls = 0;
+
+  /**
+   * The longest time without data from the scanner: between the start of a frame & its first data, or between two reads with data
+   */
+  double largestReadGap = 0;
+
+  /**
+   * The bytes of the rows handed to the receiver
+   */
+  unsigned long long encodedBytes = 0;
+
+  /**
+   * The rows the receiver handled per second (MB/s), 0 if it took no measurable time
+   */
+  double getEncodeThroughput() const
+  {
+    return encodeTime > 0 ? encodedBytes / (encodeTime * 1000.0) : 0;
+  }
+};
+
+/**
+ * Records the phases & reads of one scan, to tell where the time of a slow scan went.
+ * The scanner interface finds the timeline of a scan through its receiver (see IScanReceiver::getTimeline),
+ * without timeline nothing is measured at all.
+ * A timeline is recorded by one thread at a time (the thread running the scan resp. reading its session).
+ */
+class ScanTimeline
+{
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  /**
+   * The phases kept for the trace, later phases are only added to the timings
+   */
+  static const size_t MAX_EVENTS = 65536;
+
+  /**
+   * Measures a phase for its lifetime, does nothing without timeline.
+   * Spans may nest, the time of an inner span is taken off the outer one.
+   */
+  class Span
+  {
+  public:
+    Span(ScanTimeline *timeline, ScanPhase phase);
+
+    ~Span();
+
+    Span(const Span &) = delete;
+    Span &operator=(const Span &) = delete;
+
+  private:
+    ScanTimeline *timeline;
+    ScanPhase phase;
+    Clock::time_point start;
+  };
+
+  /**
+   * @param name the operation, that is scanned (e.g. "scanToFile"), names the scan in the trace
+   * @param jobId the job of the scan, 0 if it has none
+   */
+  explicit ScanTimeline(const std::string &name = "scan", unsigned long long jobId = 0);
+
+  /**
+   * Record a read, that started at the given time
+   * @param bytes the data the read returned, 0 if it had none
+   */
+  void addRead(Clock::time_point start, size_t bytes);
+
+  /**
+   * Count the bytes of rows handed to the receiver
+   */
+  void addEncodedBytes(size_t bytes);
+
+  ScanTimings getTimings() const;
+
+  /**
+   * Write the phases as Chrome trace events ("X" events of the JSON array format, for chrome://tracing or Perfetto),
+   * plus one event for the whole scan with the timings as arguments. The events are separated by ",\n", without
+   * enclosing brackets, so that the scans of a process can be appended to one trace file.
+   */
+  void writeTraceEvents(std::ostream &stream) const;
+
+  /**
+   * The display name of a phase
+   */
+  static const char *getPhaseName(ScanPhase phase);
+
+private:
+  struct Event
+  {
+    ScanPhase phase;
+    Clock::time_point start;
+    Clock::time_point end;
+    size_t thread;
+  };
+
+  void beginSpan();
+
+  void endSpan(ScanPhase phase, Clock::time_point start);
+
+  std::string name;
+  unsigned long long jobId;
+
+  Clock::time_point created;
+  Clock::time_point lastEnd;
+
+  /**
+   * Time per phase, without the nested phases
+   */
+  Clock::duration phaseTimes[6] = {};
+
+  /**
+   * Time of the nested phases of each open span
+   */
+  std::vector<Clock::duration> openSpans;
+
+  std::vector<Event> events;
+
+  Clock::time_point lastData;
+  Clock::duration largestReadGap = Clock::duration::zero();
+  unsigned long long bytesRead = 0;
+  unsigned long long readCalls = 0;
+  unsigned long long encodedBytes = 0;
+};
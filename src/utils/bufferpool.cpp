@@ -0,0 +1,184 @@
+#include "bufferpool.h"
+
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace
+{
+    const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    /**
+     * Size classes per power of two, so a pooled buffer wastes at most a quarter
+     */
+    const size_t CLASSES_PER_DOUBLING = 4;
+
+    size_t getPageSize()
+    {
+        static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        return pageSize;
+    }
+
+    size_t roundUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+BufferPool::BufferPool(size_t capacity, bool hugePages) : capacity(capacity), hugePages(hugePages)
+{
+}
+
+BufferPool::~BufferPool()
+{
+    trim();
+}
+
+BufferPool &BufferPool::getDefault()
+{
+    static BufferPool pool;
+    return pool;
+}
+
+size_t BufferPool::getSizeClass(size_t bytes)
+{
+    if (bytes < MINIMUM_POOLED_SIZE)
+    {
+        return bytes;
+    }
+    size_t doubling = MINIMUM_POOLED_SIZE;
+    while (doubling * 2 <= bytes)
+    {
+        doubling *= 2;
+    }
+    return roundUp(roundUp(bytes, doubling / CLASSES_PER_DOUBLING), getPageSize());
+}
+
+unsigned char *BufferPool::acquire(size_t bytes)
+{
+    if (bytes < MINIMUM_POOLED_SIZE)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++statistics.unpooled;
+        return new unsigned char[bytes];
+    }
+
+    const size_t sizeClass = getSizeClass(bytes);
+    bool useHugePages;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        statistics.usedBytes += sizeClass;
+        auto cached = cache.find(sizeClass);
+        if (cached != cache.end())
+        {
+            unsigned char *buffer = cached->second;
+            cache.erase(cached);
+            --statistics.cachedBuffers;
+            statistics.cachedBytes -= sizeClass;
+            ++statistics.hits;
+            return buffer;
+        }
+        ++statistics.misses;
+        useHugePages = hugePages;
+    }
+
+    // map outside of the lock, the kernel may take a while for large buffers
+    void *mapping = MAP_FAILED;
+    if (useHugePages && sizeClass >= HUGE_PAGE_SIZE)
+    {
+        // over map to cut out a huge page aligned range of exactly the size class
+        const size_t mappedBytes = sizeClass + HUGE_PAGE_SIZE;
+        mapping = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping != MAP_FAILED)
+        {
+            unsigned char *start = static_cast<unsigned char *>(mapping);
+            unsigned char *aligned = reinterpret_cast<unsigned char *>(roundUp(reinterpret_cast<size_t>(start), HUGE_PAGE_SIZE));
+            if (aligned > start)
+            {
+                munmap(start, aligned - start);
+            }
+            munmap(aligned + sizeClass, start + mappedBytes - aligned - sizeClass);
+            mapping = aligned;
+#ifdef MADV_HUGEPAGE
+            madvise(mapping, sizeClass, MADV_HUGEPAGE);
+#endif
+        }
+    }
+    else
+    {
+        mapping = mmap(nullptr, sizeClass, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+
+    if (mapping == MAP_FAILED)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        statistics.usedBytes -= sizeClass;
+        throw std::bad_alloc();
+    }
+    return static_cast<unsigned char *>(mapping);
+}
+
+void BufferPool::release(unsigned char *buffer, size_t bytes)
+{
+    if (buffer == nullptr)
+    {
+        return;
+    }
+    if (bytes < MINIMUM_POOLED_SIZE)
+    {
+        delete[] buffer;
+        return;
+    }
+
+    const size_t sizeClass = getSizeClass(bytes);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        statistics.usedBytes -= sizeClass;
+        if (statistics.cachedBytes + sizeClass <= capacity)
+        {
+            cache.emplace(sizeClass, buffer);
+            ++statistics.cachedBuffers;
+            statistics.cachedBytes += sizeClass;
+            return;
+        }
+        ++statistics.evictions;
+    }
+    munmap(buffer, sizeClass);
+}
+
+void BufferPool::trim(size_t keepBytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    evict(keepBytes);
+}
+
+void BufferPool::setCapacity(size_t newCapacity)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    capacity = newCapacity;
+    evict(capacity);
+}
+
+void BufferPool::setHugePages(bool newHugePages)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    hugePages = newHugePages;
+}
+
+BufferPoolStatistics BufferPool::getStatistics()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return statistics;
+}
+
+void BufferPool::evict(size_t keepBytes)
+{
+    while (statistics.cachedBytes > keepBytes)
+    {
+        auto largest = std::prev(cache.end());
+        munmap(largest->second, largest->first);
+        --statistics.cachedBuffers;
+        statistics.cachedBytes -= largest->first;
+        cache.erase(largest);
+    }
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+
+/**
+ * Counters of a buffer pool
+ */
+struct BufferPoolStatistics
+{
+  /**
+   * Pooled allocations served from a cached buffer (no fresh pages to fault in)
+   */
+  unsigned long long hits = 0;
+
+  /**
+   * Pooled allocations that had to map fresh memory
+   */
+  unsigned long long misses = 0;
+
+  /**
+   * Allocations below the pooled size, served by the heap
+   */
+  unsigned long long unpooled = 0;
+
+  /**
+   * Released buffers that were unmapped, because the cache was full
+   */
+  unsigned long long evictions = 0;
+
+  size_t cachedBuffers = 0;
+  size_t cachedBytes = 0;
+
+  /**
+   * Bytes of the pooled buffers currently in use
+   */
+  size_t usedBytes = 0;
+};
+
+/**
+ * Size class pool for the large pixel buffers of the scanned images.
+ * Released buffers are cached (up to the capacity) and handed out again for the same size class,
+ * so a batch of scans reuses memory that is already faulted in instead of mapping & zero-filling fresh pages.
+ * Buffers are anonymous mappings, optionally advised to use transparent huge pages.
+ * Small buffers are not worth the caching and come from the heap.
+ */
+class BufferPool
+{
+public:
+  /**
+   * Buffers from this size on are pooled
+   */
+  static const size_t MINIMUM_POOLED_SIZE = 256 * 1024;
+
+  static const size_t DEFAULT_CAPACITY = 512 * 1024 * 1024;
+
+  explicit BufferPool(size_t capacity = DEFAULT_CAPACITY, bool hugePages = false);
+
+  /**
+   * Unmaps the cached buffers, buffers in use must not be released after the pool is gone
+   */
+  ~BufferPool();
+
+  BufferPool(const BufferPool &) = delete;
+  BufferPool &operator=(const BufferPool &) = delete;
+
+  /**
+   * The pool used for the pixels of all raw images
+   */
+  static BufferPool &getDefault();
+
+  /**
+   * Get a buffer of at least the given size, its content is undefined
+   * @throws std::bad_alloc if no memory is left
+   */
+  unsigned char *acquire(size_t bytes);
+
+  /**
+   * Give a buffer back, bytes has to be the size it was acquired with
+   */
+  void release(unsigned char *buffer, size_t bytes);
+
+  /**
+   * Unmap cached buffers until at most keepBytes remain cached
+   */
+  void trim(size_t keepBytes = 0);
+
+  /**
+   * Limit the bytes kept in the cache, the cache is trimmed to the new capacity
+   */
+  void setCapacity(size_t capacity);
+
+  /**
+   * Advise buffers mapped from now on to use transparent huge pages (fewer page faults & TLB misses)
+   */
+  void setHugePages(bool hugePages);
+
+  BufferPoolStatistics getStatistics();
+
+  /**
+   * The size class a pooled buffer of the given size is rounded up to
+   */
+  static size_t getSizeClass(size_t bytes);
+
+private:
+  /**
+   * Unmap the largest cached buffers until at most keepBytes remain (mutex held)
+   */
+  void evict(size_t keepBytes);
+
+  std::mutex mutex;
+  size_t capacity;
+  bool hugePages;
+
+  /**
+   * Cached buffers by size class
+   */
+  std::multimap<size_t, unsigned char *> cache;
+
+  BufferPoolStatistics statistics;
+};
@@ -0,0 +1,150 @@
+#include "mappedfile.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+    std::string describeError(const std::string &what, const std::string &path)
+    {
+        return what + " " + path + ": " + std::strerror(errno);
+    }
+
+    int createTemporaryFile(std::string &path)
+    {
+        const char *directory = std::getenv("TMPDIR");
+        std::string pattern = std::string(directory && *directory ? directory : "/tmp") + "/scanahedron-XXXXXX";
+        std::vector<char> name(pattern.begin(), pattern.end());
+        name.push_back('\0');
+        int fd = mkstemp(name.data());
+        path = name.data();
+        return fd;
+    }
+
+    /**
+     * Copy a file to a new one, for moves across file systems
+     */
+    void copyFile(const std::string &sourcePath, const std::string &destinationPath)
+    {
+        FILE *source = std::fopen(sourcePath.c_str(), "rb");
+        if (!source)
+        {
+            throw std::runtime_error(describeError("Cannot open", sourcePath));
+        }
+        FILE *destination = std::fopen(destinationPath.c_str(), "wb");
+        if (!destination)
+        {
+            std::fclose(source);
+            throw std::runtime_error(describeError("Cannot create", destinationPath));
+        }
+
+        std::vector<char> buffer(1024 * 1024);
+        bool good = true;
+        size_t length;
+        while (good && (length = std::fread(buffer.data(), 1, buffer.size(), source)) > 0)
+        {
+            good = std::fwrite(buffer.data(), 1, length, destination) == length;
+        }
+        good = good && !std::ferror(source);
+        std::fclose(source);
+        if (std::fclose(destination) != 0 || !good)
+        {
+            std::remove(destinationPath.c_str());
+            throw std::runtime_error("Cannot copy " + sourcePath + " to " + destinationPath);
+        }
+    }
+}
+
+MappedFile::MappedFile(const std::string &path_, size_t size_) : path(path_), size(size_), temporary(path_.empty())
+{
+    int fd = temporary ? createTemporaryFile(path) : open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        throw std::runtime_error(describeError("Cannot create", path));
+    }
+
+    // reserve the blocks up front: a full disk fails here instead of faulting while the rows are written
+    int error = size > 0 ? posix_fallocate(fd, 0, static_cast<off_t>(size)) : 0;
+    void *mapping = MAP_FAILED;
+    if (error == 0 && size > 0)
+    {
+        mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        error = mapping == MAP_FAILED ? errno : 0;
+    }
+    close(fd);
+
+    if (error != 0)
+    {
+        if (temporary)
+        {
+            unlink(path.c_str());
+        }
+        errno = error;
+        throw std::runtime_error(describeError("Cannot map", path));
+    }
+    data = static_cast<unsigned char *>(mapping == MAP_FAILED ? nullptr : mapping);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data)
+    {
+        munmap(data, size);
+    }
+    if (temporary)
+    {
+        unlink(path.c_str());
+    }
+}
+
+unsigned char *MappedFile::getData() const
+{
+    return data;
+}
+
+size_t MappedFile::getSize() const
+{
+    return size;
+}
+
+const std::string &MappedFile::getPath() const
+{
+    return path;
+}
+
+bool MappedFile::isTemporary() const
+{
+    return temporary;
+}
+
+void MappedFile::persist(const std::string &destinationPath)
+{
+    if (data && msync(data, size, MS_SYNC) != 0)
+    {
+        throw std::runtime_error(describeError("Cannot flush", path));
+    }
+    if (destinationPath == path)
+    {
+        temporary = false;
+        return;
+    }
+    if (std::rename(path.c_str(), destinationPath.c_str()) != 0)
+    {
+        if (errno != EXDEV)
+        {
+            throw std::runtime_error(describeError("Cannot move " + path + " to", destinationPath));
+        }
+        copyFile(path, destinationPath);
+        unlink(path.c_str());
+    }
+    // after a copy the mapping still refers to the unlinked original, so later writes do not reach the destination
+    path = destinationPath;
+    temporary = false;
+}
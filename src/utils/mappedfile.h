@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/**
+ * A file mapped to memory (shared, so written pages go to the file & the kernel may page them out).
+ * Temporary files are removed with the mapping, unless they were persisted.
+ */
+class MappedFile
+{
+public:
+  /**
+   * Create (or truncate) the file & map it.
+   * @param path the file, empty for a temporary file in $TMPDIR (or /tmp)
+   * @throws std::runtime_error if the file cannot be created, sized or mapped
+   */
+  MappedFile(const std::string &path, size_t size);
+
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  unsigned char *getData() const;
+
+  size_t getSize() const;
+
+  const std::string &getPath() const;
+
+  /**
+   * true, if the file is removed with the mapping
+   */
+  bool isTemporary() const;
+
+  /**
+   * Flush the mapped pages & move the file to the given path (a rename, copied only across file systems).
+   * The file is kept from now on, the mapping stays valid.
+   * @throws std::runtime_error if the file cannot be moved
+   */
+  void persist(const std::string &destinationPath);
+
+private:
+  std::string path;
+  size_t size;
+  bool temporary;
+  unsigned char *data = nullptr;
+};
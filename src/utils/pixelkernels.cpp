@@ -0,0 +1,273 @@
+#include "pixelkernels.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PIXEL_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+void narrow16To8Scalar(const unsigned char *source, unsigned char *destination, size_t samples)
+{
+    for (size_t i = 0; i < samples; ++i)
+    {
+        uint16_t sample;
+        std::memcpy(&sample, source + i * 2, sizeof(sample));
+        destination[i] = static_cast<unsigned char>(sample >> 8);
+    }
+}
+
+void swap16Scalar(const unsigned char *source, unsigned char *destination, size_t samples)
+{
+    for (size_t i = 0; i < samples; ++i)
+    {
+        unsigned char high = source[i * 2 + 1];
+        destination[i * 2 + 1] = source[i * 2];
+        destination[i * 2] = high;
+    }
+}
+
+void expand1To8Scalar(const unsigned char *source, unsigned char *destination, size_t samples, unsigned char setValue)
+{
+    const unsigned char clearValue = static_cast<unsigned char>(~setValue);
+    for (size_t i = 0; i < samples; ++i)
+    {
+        bool set = (source[i >> 3] & (0x80 >> (i & 7))) != 0;
+        destination[i] = set ? setValue : clearValue;
+    }
+}
+
+void accumulateStatisticsScalar(const unsigned char *samples, size_t count, unsigned char inkThreshold, PageStatistics &statistics)
+{
+    uint64_t sum = 0;
+    uint64_t sumOfSquares = 0;
+    uint64_t ink = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        unsigned int sample = samples[i];
+        sum += sample;
+        sumOfSquares += sample * sample;
+        ink += sample < inkThreshold ? 1 : 0;
+    }
+    statistics.samples += count;
+    statistics.sum += sum;
+    statistics.sumOfSquares += sumOfSquares;
+    statistics.inkSamples += ink;
+}
+
+#ifdef PIXEL_KERNELS_X86
+const uint64_t BYTE_BROADCAST = 0x0101010101010101ULL;
+
+__attribute__((target("sse2"))) void narrow16To8Sse2(const unsigned char *source, unsigned char *destination, size_t samples)
+{
+    size_t i = 0;
+    for (; i + 16 <= samples; i += 16)
+    {
+        __m128i low = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i * 2)), 8);
+        __m128i high = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i * 2 + 16)), 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i), _mm_packus_epi16(low, high));
+    }
+    narrow16To8Scalar(source + i * 2, destination + i, samples - i);
+}
+
+__attribute__((target("sse2"))) void swap16Sse2(const unsigned char *source, unsigned char *destination, size_t samples)
+{
+    size_t i = 0;
+    for (; i + 8 <= samples; i += 8)
+    {
+        __m128i vector = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i * 2));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i * 2), _mm_or_si128(_mm_slli_epi16(vector, 8), _mm_srli_epi16(vector, 8)));
+    }
+    swap16Scalar(source + i * 2, destination + i * 2, samples - i);
+}
+
+__attribute__((target("sse2"))) void expand1To8Sse2(const unsigned char *source, unsigned char *destination, size_t samples, unsigned char setValue)
+{
+    const __m128i bits = _mm_set_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80,
+                                      0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80);
+    const __m128i clear = _mm_set1_epi8(static_cast<char>(~setValue));
+    size_t i = 0;
+    for (; i + 16 <= samples; i += 16)
+    {
+        const unsigned char *pivot = source + (i >> 3);
+        __m128i broadcast = _mm_set_epi64x(BYTE_BROADCAST * pivot[1], BYTE_BROADCAST * pivot[0]);
+        __m128i set = _mm_cmpeq_epi8(_mm_and_si128(broadcast, bits), bits);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i), _mm_xor_si128(set, clear));
+    }
+    for (; i < samples; ++i)
+    {
+        bool set = (source[i >> 3] & (0x80 >> (i & 7))) != 0;
+        destination[i] = set ? setValue : static_cast<unsigned char>(~setValue);
+    }
+}
+
+/**
+ * Vectors accumulated in 32 bit lanes, before the squares have to be widened to 64 bit (to prevent an overflow)
+ */
+const size_t SQUARES_BLOCK = 8192;
+
+__attribute__((target("sse2"))) void accumulateStatisticsSse2(const unsigned char *samples, size_t count, unsigned char inkThreshold, PageStatistics &statistics)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    // There is no unsigned byte compare, shift both sides to the signed range
+    const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+    const __m128i threshold = _mm_set1_epi8(static_cast<char>(inkThreshold ^ 0x80));
+    __m128i sums = zero;
+    __m128i squares = zero;
+    __m128i ink = zero;
+    size_t i = 0;
+    while (i + 16 <= count)
+    {
+        const size_t blockEnd = std::min(count, i + SQUARES_BLOCK * 16);
+        __m128i blockSquares = zero;
+        for (; i + 16 <= blockEnd; i += 16)
+        {
+            __m128i vector = _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples + i));
+            sums = _mm_add_epi64(sums, _mm_sad_epu8(vector, zero));
+            __m128i low = _mm_unpacklo_epi8(vector, zero);
+            __m128i high = _mm_unpackhi_epi8(vector, zero);
+            blockSquares = _mm_add_epi32(blockSquares, _mm_add_epi32(_mm_madd_epi16(low, low), _mm_madd_epi16(high, high)));
+            __m128i isInk = _mm_cmplt_epi8(_mm_xor_si128(vector, bias), threshold);
+            ink = _mm_add_epi64(ink, _mm_sad_epu8(_mm_and_si128(isInk, one), zero));
+        }
+        squares = _mm_add_epi64(squares, _mm_add_epi64(_mm_unpacklo_epi32(blockSquares, zero), _mm_unpackhi_epi32(blockSquares, zero)));
+    }
+
+    uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), sums);
+    statistics.sum += lanes[0] + lanes[1];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), squares);
+    statistics.sumOfSquares += lanes[0] + lanes[1];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), ink);
+    statistics.inkSamples += lanes[0] + lanes[1];
+    statistics.samples += i;
+    accumulateStatisticsScalar(samples + i, count - i, inkThreshold, statistics);
+}
+
+__attribute__((target("avx2"))) void narrow16To8Avx2(const unsigned char *source, unsigned char *destination, size_t samples)
+{
+    size_t i = 0;
+    for (; i + 32 <= samples; i += 32)
+    {
+        __m256i low = _mm256_srli_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + i * 2)), 8);
+        __m256i high = _mm256_srli_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + i * 2 + 32)), 8);
+        // packus works per 128 bit lane, restore the sample order afterwards
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + i), packed);
+    }
+    narrow16To8Sse2(source + i * 2, destination + i, samples - i);
+}
+
+__attribute__((target("avx2"))) void swap16Avx2(const unsigned char *source, unsigned char *destination, size_t samples)
+{
+    size_t i = 0;
+    for (; i + 16 <= samples; i += 16)
+    {
+        __m256i vector = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + i * 2));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + i * 2), _mm256_or_si256(_mm256_slli_epi16(vector, 8), _mm256_srli_epi16(vector, 8)));
+    }
+    swap16Sse2(source + i * 2, destination + i * 2, samples - i);
+}
+
+__attribute__((target("avx2"))) void expand1To8Avx2(const unsigned char *source, unsigned char *destination, size_t samples, unsigned char setValue)
+{
+    const __m256i bits = _mm256_set_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80,
+                                         0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80,
+                                         0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80,
+                                         0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80);
+    const __m256i clear = _mm256_set1_epi8(static_cast<char>(~setValue));
+    size_t i = 0;
+    for (; i + 32 <= samples; i += 32)
+    {
+        const unsigned char *pivot = source + (i >> 3);
+        __m256i broadcast = _mm256_set_epi64x(BYTE_BROADCAST * pivot[3], BYTE_BROADCAST * pivot[2],
+                                              BYTE_BROADCAST * pivot[1], BYTE_BROADCAST * pivot[0]);
+        __m256i set = _mm256_cmpeq_epi8(_mm256_and_si256(broadcast, bits), bits);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + i), _mm256_xor_si256(set, clear));
+    }
+    expand1To8Sse2(source + (i >> 3), destination + i, samples - i, setValue);
+}
+
+__attribute__((target("avx2"))) void accumulateStatisticsAvx2(const unsigned char *samples, size_t count, unsigned char inkThreshold, PageStatistics &statistics)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i bias = _mm256_set1_epi8(static_cast<char>(0x80));
+    const __m256i threshold = _mm256_set1_epi8(static_cast<char>(inkThreshold ^ 0x80));
+    __m256i sums = zero;
+    __m256i squares = zero;
+    __m256i ink = zero;
+    size_t i = 0;
+    while (i + 32 <= count)
+    {
+        const size_t blockEnd = std::min(count, i + SQUARES_BLOCK * 32);
+        __m256i blockSquares = zero;
+        for (; i + 32 <= blockEnd; i += 32)
+        {
+            __m256i vector = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(samples + i));
+            sums = _mm256_add_epi64(sums, _mm256_sad_epu8(vector, zero));
+            __m256i low = _mm256_unpacklo_epi8(vector, zero);
+            __m256i high = _mm256_unpackhi_epi8(vector, zero);
+            blockSquares = _mm256_add_epi32(blockSquares, _mm256_add_epi32(_mm256_madd_epi16(low, low), _mm256_madd_epi16(high, high)));
+            __m256i isInk = _mm256_cmpgt_epi8(threshold, _mm256_xor_si256(vector, bias));
+            ink = _mm256_add_epi64(ink, _mm256_sad_epu8(_mm256_and_si256(isInk, one), zero));
+        }
+        squares = _mm256_add_epi64(squares, _mm256_add_epi64(_mm256_unpacklo_epi32(blockSquares, zero), _mm256_unpackhi_epi32(blockSquares, zero)));
+    }
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), sums);
+    statistics.sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), squares);
+    statistics.sumOfSquares += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), ink);
+    statistics.inkSamples += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    statistics.samples += i;
+    accumulateStatisticsSse2(samples + i, count - i, inkThreshold, statistics);
+}
+#endif
+
+const PixelKernels SCALAR_KERNELS = {KernelLevel::Scalar, "scalar", narrow16To8Scalar, swap16Scalar, expand1To8Scalar, accumulateStatisticsScalar};
+#ifdef PIXEL_KERNELS_X86
+const PixelKernels SSE2_KERNELS = {KernelLevel::Sse2, "sse2", narrow16To8Sse2, swap16Sse2, expand1To8Sse2, accumulateStatisticsSse2};
+const PixelKernels AVX2_KERNELS = {KernelLevel::Avx2, "avx2", narrow16To8Avx2, swap16Avx2, expand1To8Avx2, accumulateStatisticsAvx2};
+#endif
+}
+
+const PixelKernels *getPixelKernels(KernelLevel level)
+{
+    switch (level)
+    {
+    case KernelLevel::Scalar:
+        return &SCALAR_KERNELS;
+#ifdef PIXEL_KERNELS_X86
+    case KernelLevel::Sse2:
+        return __builtin_cpu_supports("sse2") ? &SSE2_KERNELS : nullptr;
+    case KernelLevel::Avx2:
+        return __builtin_cpu_supports("avx2") ? &AVX2_KERNELS : nullptr;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+const PixelKernels &getPixelKernels()
+{
+    static const PixelKernels *best = []() {
+        for (KernelLevel level : {KernelLevel::Avx2, KernelLevel::Sse2})
+        {
+            if (const PixelKernels *kernels = getPixelKernels(level))
+            {
+                return kernels;
+            }
+        }
+        return &SCALAR_KERNELS;
+    }();
+    return *best;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "types.h"
+
+#include <cstddef>
+
+/**
+ * 16 bit samples are kept in host byte order, formats that store them big endian (PNG, PNM) have to swap them then
+ */
+const bool HOST_IS_LITTLE_ENDIAN = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+
+/**
+ * Instruction set level of a pixel kernel implementation
+ */
+enum class KernelLevel
+{
+  Scalar,
+  Sse2,
+  Avx2
+};
+
+/**
+ * Bulk pixel conversion routines, one set per instruction set level.
+ */
+struct PixelKernels
+{
+  KernelLevel level;
+  const char *name;
+
+  /**
+   * Convert 16 bit samples (host byte order) to 8 bit samples by keeping the most significant byte.
+   */
+  void (*narrow16To8)(const unsigned char *source, unsigned char *destination, size_t samples);
+
+  /**
+   * Swap the bytes of 16 bit samples (host to big endian order & vice versa).
+   */
+  void (*swap16)(const unsigned char *source, unsigned char *destination, size_t samples);
+
+  /**
+   * Expand 1 bit samples (most significant bit first) to 8 bit samples.
+   * A set bit becomes setValue, a cleared bit becomes ~setValue.
+   */
+  void (*expand1To8)(const unsigned char *source, unsigned char *destination, size_t samples, unsigned char setValue);
+
+  /**
+   * Add 8 bit samples to the statistics, samples below inkThreshold count as ink.
+   */
+  void (*accumulateStatistics)(const unsigned char *samples, size_t count, unsigned char inkThreshold, PageStatistics &statistics);
+};
+
+/**
+ * Access the fastest kernels the CPU supports (detected once at runtime)
+ */
+const PixelKernels &getPixelKernels();
+
+/**
+ * Access the kernels of a specific level.
+ * @return nullptr, if the CPU (or the build) does not support the level
+ */
+const PixelKernels *getPixelKernels(KernelLevel level);
@@ -0,0 +1,58 @@
+#include "threadpool.h"
+
+ThreadPool::ThreadPool(unsigned int threads)
+{
+    for (unsigned int i = 0; i < std::max(1u, threads); ++i)
+    {
+        workers.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task)
+{
+    std::packaged_task<void()> packagedTask(task);
+    std::future<void> result = packagedTask.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(packagedTask));
+    }
+    wakeUp.notify_one();
+    return result;
+}
+
+unsigned int ThreadPool::size() const
+{
+    return static_cast<unsigned int>(workers.size());
+}
+
+void ThreadPool::work()
+{
+    while (true)
+    {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeUp.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (tasks.empty())
+            {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "defines.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+/**
+ * Fixed size pool of worker threads running queued tasks in submission order.
+ */
+class ThreadPool
+{
+public:
+  explicit ThreadPool(unsigned int threads);
+
+  /**
+   * Runs the remaining queued tasks and joins the workers.
+   */
+  ~ThreadPool();
+
+  /**
+   * Queue a task.
+   * @return a future that becomes ready (or holds the task's exception) once the task has run
+   */
+  std::future<void> submit(std::function<void()> task);
+
+  /**
+   * Number of worker threads
+   */
+  unsigned int size() const;
+
+private:
+  void work();
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wakeUp;
+  std::deque<std::packaged_task<void()>> tasks;
+  bool stopping = false;
+};
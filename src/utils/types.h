@@ -1,24 +1,207 @@
 #pragma once
 #include "defines.h"
+#include "bufferpool.h"
+#include "mappedfile.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+
+/**
+ * Layout of the pixels in a row
+ */
+enum class PixelFormat
+{
+    /**
+     * Lineart: 8 pixels per byte, the most significant bit first, a set bit is black
+     */
+    Gray1,
+    Gray8,
+    /**
+     * 16 bit samples in host byte order
+     */
+    Gray16,
+    Rgb8,
+    Rgb16
+};
+
+inline unsigned int getChannels(PixelFormat format)
+{
+    return format == PixelFormat::Rgb8 || format == PixelFormat::Rgb16 ? 3 : 1;
+}
+
+inline unsigned int getBitsPerSample(PixelFormat format)
+{
+    return format == PixelFormat::Gray1 ? 1 : format == PixelFormat::Gray16 || format == PixelFormat::Rgb16 ? 16 : 8;
+}
+
+/**
+ * Bytes of a pixel, 0 for formats that pack several pixels into a byte
+ */
+inline unsigned int getBytesPerPixel(PixelFormat format)
+{
+    return getChannels(format) * getBitsPerSample(format) / 8;
+}
+
+/**
+ * Bytes of a row, rows of packed pixels are padded to full bytes
+ */
+inline size_t getBytesPerRow(PixelFormat format, unsigned int width)
+{
+    return (static_cast<size_t>(width) * getChannels(format) * getBitsPerSample(format) + 7) / 8;
+}
+
+/**
+ * Name of the format, as used by the javascript bindings (e.g. "gray8")
+ */
+inline const char *getFormatName(PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::Gray1:
+        return "gray1";
+    case PixelFormat::Gray8:
+        return "gray8";
+    case PixelFormat::Gray16:
+        return "gray16";
+    case PixelFormat::Rgb16:
+        return "rgb16";
+    default:
+        return "rgb8";
+    }
+}
+
+/**
+ * Dimensions & layout of an image, known before its pixels are
+ */
+struct ImageHeader
+{
+    unsigned int width = 0;
+    unsigned int height = 0;
+    PixelFormat format = PixelFormat::Rgb8;
+
+    size_t getBytesPerRow() const
+    {
+        return ::getBytesPerRow(format, width);
+    }
+};
+
+/**
+ * Sample statistics of an image, collected while its rows are unpacked (e.g. to detect blank pages)
+ */
+struct PageStatistics
+{
+    uint64_t samples = 0;
+    uint64_t sum = 0;
+    uint64_t sumOfSquares = 0;
+    /**
+     * Samples darker than the ink threshold
+     */
+    uint64_t inkSamples = 0;
+
+    double getMean() const
+    {
+        return samples ? static_cast<double>(sum) / samples : 0;
+    }
+
+    double getDeviation() const
+    {
+        if (!samples)
+        {
+            return 0;
+        }
+        double mean = getMean();
+        return std::sqrt(std::max(0.0, static_cast<double>(sumOfSquares) / samples - mean * mean));
+    }
+
+    /**
+     * Fraction of the samples that are ink (0 - 1)
+     */
+    double getInkCoverage() const
+    {
+        return samples ? static_cast<double>(inkSamples) / samples : 0;
+    }
+};
+
+/**
+ * Where the pixels of a raw image live
+ */
+struct ImageStorage
+{
+    /**
+     * false: in memory (the buffer pool), true: in a memory mapped file, that the kernel may page out
+     */
+    bool mapped = false;
+
+    /**
+     * The file of a mapped image, it is kept after the image is released.
+     * Empty for a temporary file (in $TMPDIR), that is removed with the image unless it is persisted.
+     */
+    std::string path;
+};
 
 SHARED_STRUCT_PTR(RawImage);
 /**
- * Basic image buffer
+ * Basic image buffer, the pixels come from the default buffer pool or a memory mapped file
  */
 struct RawImage
 {
-    explicit RawImage(unsigned int width_, unsigned int height_, unsigned int bytesPerPixel_ = 3)
-        : width(width_), height(height_), bytesPerPixel(bytesPerPixel_), pixels(new unsigned char[width * height * bytesPerPixel_])
+    /**
+     * @throws std::runtime_error if the file of a mapped image cannot be created
+     */
+    explicit RawImage(unsigned int width_, unsigned int height_, PixelFormat format_ = PixelFormat::Rgb8, const ImageStorage &storage = ImageStorage())
+        : width(width_), height(height_), format(format_), bytesPerRow(::getBytesPerRow(format_, width_)),
+          mapping(storage.mapped ? new MappedFile(storage.path, bytesPerRow * height_) : nullptr),
+          pixels(mapping ? mapping->getData() : BufferPool::getDefault().acquire(bytesPerRow * height_))
     {
     }
 
     ~RawImage()
     {
-        delete[] pixels;
+        if (!mapping)
+        {
+            BufferPool::getDefault().release(pixels, bytesPerRow * height);
+        }
+    }
+
+    // The image owns its pixels, copies would free them twice.
+    RawImage(const RawImage &) = delete;
+    RawImage &operator=(const RawImage &) = delete;
+
+    /**
+     * Store the raw pixels (rows of bytesPerRow) to the given file.
+     * A mapped image is moved there (a rename instead of a copy), its file is kept from now on.
+     * @throws std::runtime_error if the file cannot be written
+     */
+    void persist(const std::string &path)
+    {
+        if (mapping)
+        {
+            mapping->persist(path);
+            return;
+        }
+        MappedFile file(path, bytesPerRow * height);
+        if (file.getData())
+        {
+            std::memcpy(file.getData(), pixels, file.getSize());
+        }
+        file.persist(path);
+    }
+
+    /**
+     * The file holding the pixels, empty for an image in memory
+     */
+    std::string getFilePath() const
+    {
+        return mapping ? mapping->getPath() : std::string();
     }
 
-    unsigned int bytesPerPixel;
     unsigned int width;
     unsigned int height;
+    PixelFormat format;
+    size_t bytesPerRow;
+    std::unique_ptr<MappedFile> mapping;
     unsigned char *pixels;
 };
\ No newline at end of file
@@ -1,5 +1,7 @@
 const scanahedron = require("../../build/Release/libscanahedron.node")
 
+scanahedron.warmup().then((warmedUp) => console.log(warmedUp));
+
 const scanners = scanahedron.getScanners();
 console.log(scanners);
 
@@ -21,3 +23,21 @@ console.log(buffer.width);
 console.log(buffer.height);
 console.log(buffer.bytesPerPixel);
 console.log(buffer.pixels);
+
+
+scanahedron.scanToBufferAsync(scanners[0]).then((asyncBuffer) => {
+    console.log(asyncBuffer.width);
+    console.log(asyncBuffer.height);
+    return scanahedron.scanToFileAsync(scanners[0], "test_async.png");
+}).then((stored) => console.log(stored));
+
+scanahedron.scanToStream(scanners[0], (batch) => {
+    console.log(batch.y, batch.rows);
+}).then((image) => console.log(image));
+
+scanahedron.scanBatchToFiles(scanners[0], "test_batch-###.png", { skipBlankPages: true }).then((pages) => console.log(pages));
+
+scanahedron.preview(scanners[0], (batch) => console.log(batch.y, batch.rows)).then((preview) => {
+    console.log(preview);
+    console.log(scanahedron.getRegionConfiguration(preview, { x: 0, y: 0, width: 10, height: 10 }));
+});
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "encoder/encoderregistry.h"
+#include "encoder/jpegencoder.h"
+#include "encoder/parallelpngencoder.h"
+#include "encoder/pngencoder.h"
+#include "encoder/pnmencoder.h"
+#include "encoder/tiffencoder.h"
+
+#include <thread>
+
+TEST(EncoderRegistry, PicksTheEncoderByExtension)
+{
+  EncoderRegistry registry;
+  EncoderOptions options;
+
+  ASSERT_NE(dynamic_cast<PngEncoder *>(registry.create("scan.png", options).get()), nullptr);
+  ASSERT_NE(dynamic_cast<PnmEncoder *>(registry.create("scan.PGM", options).get()), nullptr);
+  ASSERT_NE(dynamic_cast<TiffEncoder *>(registry.create("scan.tif", options).get()), nullptr);
+  ASSERT_NE(dynamic_cast<JpegEncoder *>(registry.create("/tmp/scan.jpeg", options).get()), nullptr);
+}
+
+TEST(EncoderRegistry, DefaultsToPng)
+{
+  EncoderRegistry registry;
+  EncoderOptions options;
+
+  ASSERT_NE(dynamic_cast<PngEncoder *>(registry.create("scan", options).get()), nullptr);
+  ASSERT_NE(dynamic_cast<PngEncoder *>(registry.create("my.folder/scan", options).get()), nullptr);
+
+  options.threads = 4;
+  ASSERT_NE(dynamic_cast<ParallelPngEncoder *>(registry.create("scan.png", options).get()), nullptr);
+}
+
+TEST(EncoderRegistry, TheFormatOptionWins)
+{
+  EncoderRegistry registry;
+  EncoderOptions options;
+  options.format = "jpeg";
+
+  ASSERT_NE(dynamic_cast<JpegEncoder *>(registry.create("scan.png", options).get()), nullptr);
+
+  options.format = "gif";
+  ASSERT_THROW(registry.create("scan.gif", options), std::runtime_error);
+}
+
+TEST(EncoderRegistry, AcceptsAdditionalEncoders)
+{
+  EncoderRegistry registry;
+  registry.registerEncoder("raw", {"raw"}, [](const std::string &path, const EncoderOptions &options) {
+    return IImageEncoderPtr(new PnmEncoder(path));
+  });
+
+  ASSERT_NE(dynamic_cast<PnmEncoder *>(registry.create("scan.raw", EncoderOptions()).get()), nullptr);
+  ASSERT_THAT(registry.getFormats(), ::testing::ElementsAre("jpeg", "png", "pnm", "raw", "tiff"));
+}
+
+TEST(EncoderRegistry, RegistersWhileOtherThreadsCreateEncoders)
+{
+  EncoderRegistry registry;
+  std::thread creating([&]() {
+    for (int it = 0; it < 1000; ++it)
+    {
+      ASSERT_NE(registry.create("scan.pnm", EncoderOptions()), nullptr);
+    }
+  });
+  for (int it = 0; it < 1000; ++it)
+  {
+    registry.registerEncoder("raw" + std::to_string(it), {"raw" + std::to_string(it)}, [](const std::string &path, const EncoderOptions &options) {
+      return IImageEncoderPtr(new PnmEncoder(path));
+    });
+  }
+  creating.join();
+
+  ASSERT_EQ(registry.getFormats().size(), 1004u);
+}
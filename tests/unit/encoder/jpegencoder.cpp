@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "encoder/jpegencoder.h"
+
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+const std::string TEST_FILE = "jpegencoder_test.jpg";
+
+std::vector<unsigned char> readJpeg(const std::string &path, unsigned int &width, unsigned int &height, unsigned int &components)
+{
+  FILE *file = std::fopen(path.c_str(), "rb");
+  jpeg_decompress_struct jpeg;
+  jpeg_error_mgr errors;
+  jpeg.err = jpeg_std_error(&errors);
+  jpeg_create_decompress(&jpeg);
+  jpeg_stdio_src(&jpeg, file);
+  jpeg_read_header(&jpeg, TRUE);
+  jpeg_start_decompress(&jpeg);
+  width = jpeg.output_width;
+  height = jpeg.output_height;
+  components = jpeg.output_components;
+  std::vector<unsigned char> pixels(width * height * components);
+  while (jpeg.output_scanline < height)
+  {
+    JSAMPROW row = pixels.data() + jpeg.output_scanline * width * components;
+    jpeg_read_scanlines(&jpeg, &row, 1);
+  }
+  jpeg_finish_decompress(&jpeg);
+  jpeg_destroy_decompress(&jpeg);
+  std::fclose(file);
+  return pixels;
+}
+}
+
+TEST(JpegEncoder, EncodesRgbImages)
+{
+  ImageHeader header;
+  header.width = 16;
+  header.height = 16;
+  header.format = PixelFormat::Rgb8;
+  std::vector<unsigned char> pixels(16 * 16 * 3, 200);
+
+  {
+    EncoderOptions options;
+    options.quality = 95;
+    JpegEncoder encoder(TEST_FILE, options);
+    encoder.begin(header);
+    encoder.rows(pixels.data(), 0, 10);
+    encoder.rows(pixels.data() + 10 * 16 * 3, 10, 6);
+    encoder.end();
+    ASSERT_TRUE(encoder.isComplete());
+  }
+
+  unsigned int width, height, components;
+  auto decoded = readJpeg(TEST_FILE, width, height, components);
+  std::remove(TEST_FILE.c_str());
+
+  ASSERT_EQ(width, 16);
+  ASSERT_EQ(height, 16);
+  ASSERT_EQ(components, 3);
+  for (auto value : decoded)
+  {
+    ASSERT_LE(std::abs(value - 200), 2);
+  }
+}
+
+TEST(JpegEncoder, EncodesGrayImages)
+{
+  ImageHeader header;
+  header.width = 8;
+  header.height = 2;
+  header.format = PixelFormat::Gray8;
+  std::vector<unsigned char> pixels(8 * 2, 50);
+
+  {
+    JpegEncoder encoder(TEST_FILE);
+    encoder.begin(header);
+    encoder.rows(pixels.data(), 0, 2);
+    encoder.end();
+  }
+
+  unsigned int width, height, components;
+  readJpeg(TEST_FILE, width, height, components);
+  std::remove(TEST_FILE.c_str());
+
+  ASSERT_EQ(width, 8);
+  ASSERT_EQ(height, 2);
+  ASSERT_EQ(components, 1);
+}
+
+TEST(JpegEncoder, ConvertsSixteenBitAndLineartRows)
+{
+  ImageHeader header;
+  header.width = 16;
+  header.height = 8;
+  header.format = PixelFormat::Gray16;
+  std::vector<uint16_t> samples(16 * 8, 0x64FF);
+  // Lineart: the left half black, the right half white
+  std::vector<unsigned char> lineart(2 * 8);
+  for (size_t i = 0; i < lineart.size(); i += 2)
+  {
+    lineart[i] = 0xFF;
+  }
+
+  for (auto format : {PixelFormat::Gray16, PixelFormat::Gray1})
+  {
+    header.format = format;
+    const unsigned char *pixels = format == PixelFormat::Gray1 ? lineart.data() : reinterpret_cast<const unsigned char *>(samples.data());
+    {
+      JpegEncoder encoder(TEST_FILE);
+      encoder.begin(header);
+      encoder.rows(pixels, 0, 8);
+      encoder.end();
+      ASSERT_TRUE(encoder.isComplete());
+    }
+
+    unsigned int width, height, components;
+    auto decoded = readJpeg(TEST_FILE, width, height, components);
+    std::remove(TEST_FILE.c_str());
+
+    ASSERT_EQ(components, 1);
+    for (unsigned int i = 0; i < decoded.size(); ++i)
+    {
+      int expected = format == PixelFormat::Gray16 ? 0x64 : (i % 16 < 8 ? 0 : 255);
+      ASSERT_LE(std::abs(decoded[i] - expected), 24) << i;
+    }
+  }
+}
\ No newline at end of file
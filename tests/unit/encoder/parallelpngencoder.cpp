@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "encoder/parallelpngencoder.h"
+
+#include <cstdio>
+#include <cstring>
+#include <png.h>
+
+namespace
+{
+const std::string TEST_FILE = "parallelpngencoder_test.png";
+
+std::vector<unsigned char> createPixels(unsigned int width, unsigned int height, unsigned int bytesPerPixel)
+{
+  std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * bytesPerPixel);
+  for (size_t i = 0; i < pixels.size(); ++i)
+  {
+    // Repeating pattern, so that the stripes find matches in their dictionary
+    pixels[i] = static_cast<unsigned char>((i % 97) * 3 + i / 4096);
+  }
+  return pixels;
+}
+
+std::vector<unsigned char> encodeAndDecode(const std::vector<unsigned char> &pixels, const ImageHeader &header, const EncoderOptions &options, size_t stripeBytes, unsigned int batchRows)
+{
+  {
+    ParallelPngEncoder encoder(TEST_FILE, options, stripeBytes);
+    encoder.begin(header);
+    const size_t bytesPerRow = header.getBytesPerRow();
+    for (unsigned int y = 0; y < header.height; y += batchRows)
+    {
+      encoder.rows(pixels.data() + y * bytesPerRow, y, std::min(batchRows, header.height - y));
+    }
+    encoder.end();
+    EXPECT_TRUE(encoder.isComplete());
+  }
+
+  png_image image;
+  std::memset(&image, 0, sizeof(image));
+  image.version = PNG_IMAGE_VERSION;
+  std::vector<unsigned char> decoded;
+  if (png_image_begin_read_from_file(&image, TEST_FILE.c_str()))
+  {
+    EXPECT_EQ(image.width, header.width);
+    EXPECT_EQ(image.height, header.height);
+    decoded.resize(PNG_IMAGE_SIZE(image));
+    EXPECT_TRUE(png_image_finish_read(&image, nullptr, decoded.data(), 0, nullptr)) << image.message;
+  }
+  std::remove(TEST_FILE.c_str());
+  return decoded;
+}
+}
+
+TEST(ParallelPngEncoder, JoinsManyStripesToAValidPng)
+{
+  ImageHeader header;
+  header.width = 301;
+  header.height = 211;
+  header.format = PixelFormat::Rgb8;
+  auto pixels = createPixels(header.width, header.height, getBytesPerPixel(header.format));
+
+  EncoderOptions options;
+  options.threads = 4;
+  // Small stripes: many stripes in flight, each with a dictionary from its predecessor
+  ASSERT_EQ(encodeAndDecode(pixels, header, options, 10000, 7), pixels);
+}
+
+TEST(ParallelPngEncoder, EncodesGrayImagesWithAnyCompressionLevel)
+{
+  ImageHeader header;
+  header.width = 64;
+  header.height = 100;
+  header.format = PixelFormat::Gray8;
+  auto pixels = createPixels(header.width, header.height, getBytesPerPixel(header.format));
+
+  for (int level : {0, 1, 9})
+  {
+    EncoderOptions options;
+    options.threads = 3;
+    options.compressionLevel = level;
+    ASSERT_EQ(encodeAndDecode(pixels, header, options, 500, 13), pixels) << "level " << level;
+  }
+}
+
+TEST(ParallelPngEncoder, HandlesSingleStripeImages)
+{
+  ImageHeader header;
+  header.width = 5;
+  header.height = 3;
+  header.format = PixelFormat::Rgb8;
+  auto pixels = createPixels(header.width, header.height, getBytesPerPixel(header.format));
+
+  EncoderOptions options;
+  options.threads = 2;
+  ASSERT_EQ(encodeAndDecode(pixels, header, options, ParallelPngEncoder::DEFAULT_STRIPE_BYTES, 3), pixels);
+}
+
+TEST(ParallelPngEncoder, ThrowsIfTheScanEndsEarly)
+{
+  ImageHeader header;
+  header.width = 2;
+  header.height = 2;
+  header.format = PixelFormat::Gray8;
+  std::vector<unsigned char> pixels = {0, 64};
+
+  ParallelPngEncoder encoder(TEST_FILE, EncoderOptions());
+  encoder.begin(header);
+  encoder.rows(pixels.data(), 0, 1);
+  ASSERT_ANY_THROW(encoder.end());
+  std::remove(TEST_FILE.c_str());
+}
+
+TEST(ParallelPngEncoder, EncodesSixteenBitSamplesNatively)
+{
+  ImageHeader header;
+  header.width = 97;
+  header.height = 61;
+  header.format = PixelFormat::Gray16;
+  std::vector<uint16_t> samples(static_cast<size_t>(header.width) * header.height);
+  for (size_t i = 0; i < samples.size(); ++i)
+  {
+    samples[i] = static_cast<uint16_t>(i * 257 + 3);
+  }
+
+  EncoderOptions options;
+  options.threads = 3;
+  {
+    ParallelPngEncoder encoder(TEST_FILE, options, 1024);
+    encoder.begin(header);
+    encoder.rows(reinterpret_cast<const unsigned char *>(samples.data()), 0, header.height);
+    encoder.end();
+  }
+
+  png_image image;
+  std::memset(&image, 0, sizeof(image));
+  image.version = PNG_IMAGE_VERSION;
+  ASSERT_TRUE(png_image_begin_read_from_file(&image, TEST_FILE.c_str()));
+  // The simplified API reports 16 bit gray as linear gray
+  image.format = PNG_FORMAT_LINEAR_Y;
+  std::vector<uint16_t> decoded(samples.size());
+  ASSERT_TRUE(png_image_finish_read(&image, nullptr, decoded.data(), 0, nullptr)) << image.message;
+  std::remove(TEST_FILE.c_str());
+
+  ASSERT_EQ(decoded, samples);
+}
\ No newline at end of file
@@ -0,0 +1,172 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "encoder/pngencoder.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+const std::string TEST_FILE = "pngencoder_test.png";
+
+std::vector<unsigned char> readPng(const std::string &path, png_image &image)
+{
+  std::memset(&image, 0, sizeof(image));
+  image.version = PNG_IMAGE_VERSION;
+  if (!png_image_begin_read_from_file(&image, path.c_str()))
+  {
+    return std::vector<unsigned char>();
+  }
+  std::vector<unsigned char> pixels(PNG_IMAGE_SIZE(image));
+  png_image_finish_read(&image, nullptr, pixels.data(), 0, nullptr);
+  return pixels;
+}
+
+/**
+ * Read the rows as they are stored (big endian samples, packed lineart)
+ */
+std::vector<unsigned char> readStoredRows(const std::string &path, int &bitDepth, int &colorType)
+{
+  FILE *file = std::fopen(path.c_str(), "rb");
+  png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+  png_infop info = png_create_info_struct(png);
+  png_init_io(png, file);
+  png_read_png(png, info, PNG_TRANSFORM_IDENTITY, nullptr);
+  bitDepth = png_get_bit_depth(png, info);
+  colorType = png_get_color_type(png, info);
+  std::vector<unsigned char> rows;
+  png_bytepp rowPointers = png_get_rows(png, info);
+  for (png_uint_32 y = 0; y < png_get_image_height(png, info); ++y)
+  {
+    rows.insert(rows.end(), rowPointers[y], rowPointers[y] + png_get_rowbytes(png, info));
+  }
+  png_destroy_read_struct(&png, &info, nullptr);
+  std::fclose(file);
+  return rows;
+}
+}
+
+TEST(PngEncoder, EncodesRowBatchesToAReadablePng)
+{
+  ImageHeader header;
+  header.width = 3;
+  header.height = 4;
+  header.format = PixelFormat::Rgb8;
+  std::vector<unsigned char> pixels(3 * 4 * 3);
+  for (unsigned int i = 0; i < pixels.size(); ++i)
+  {
+    pixels[i] = static_cast<unsigned char>(i * 5);
+  }
+
+  {
+    PngEncoder encoder(TEST_FILE);
+    encoder.begin(header);
+    encoder.rows(pixels.data(), 0, 1);
+    encoder.rows(pixels.data() + 9, 1, 3);
+    encoder.end();
+    ASSERT_TRUE(encoder.isComplete());
+  }
+
+  png_image image;
+  auto decoded = readPng(TEST_FILE, image);
+  std::remove(TEST_FILE.c_str());
+
+  ASSERT_EQ(image.width, 3);
+  ASSERT_EQ(image.height, 4);
+  ASSERT_EQ(image.format, PNG_FORMAT_RGB);
+  ASSERT_EQ(decoded, pixels);
+}
+
+TEST(PngEncoder, EncodesGrayImages)
+{
+  ImageHeader header;
+  header.width = 2;
+  header.height = 2;
+  header.format = PixelFormat::Gray8;
+  std::vector<unsigned char> pixels = {0, 64, 128, 255};
+
+  {
+    PngEncoder encoder(TEST_FILE);
+    encoder.begin(header);
+    encoder.rows(pixels.data(), 0, 2);
+    encoder.end();
+  }
+
+  png_image image;
+  auto decoded = readPng(TEST_FILE, image);
+  std::remove(TEST_FILE.c_str());
+
+  ASSERT_EQ(image.format, PNG_FORMAT_GRAY);
+  ASSERT_EQ(decoded, pixels);
+}
+
+TEST(PngEncoder, EncodesSixteenBitSamplesNatively)
+{
+  ImageHeader header;
+  header.width = 2;
+  header.height = 1;
+  header.format = PixelFormat::Rgb16;
+  std::vector<uint16_t> samples = {0x0102, 0x0304, 0x0506, 0xA0B0, 0xC0D0, 0xE0F0};
+
+  {
+    PngEncoder encoder(TEST_FILE);
+    encoder.begin(header);
+    encoder.rows(reinterpret_cast<const unsigned char *>(samples.data()), 0, 1);
+    encoder.end();
+  }
+
+  int bitDepth, colorType;
+  auto stored = readStoredRows(TEST_FILE, bitDepth, colorType);
+  std::remove(TEST_FILE.c_str());
+
+  ASSERT_EQ(bitDepth, 16);
+  ASSERT_EQ(colorType, PNG_COLOR_TYPE_RGB);
+  ASSERT_EQ(stored, std::vector<unsigned char>({0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0xA0, 0xB0, 0xC0, 0xD0, 0xE0, 0xF0}));
+}
+
+TEST(PngEncoder, EncodesLineartAsOneBitGray)
+{
+  ImageHeader header;
+  header.width = 10;
+  header.height = 2;
+  header.format = PixelFormat::Gray1;
+  // A set bit is black, PNG stores black as 0
+  std::vector<unsigned char> pixels = {0xF0, 0x40, 0x0F, 0x80};
+
+  {
+    PngEncoder encoder(TEST_FILE);
+    encoder.begin(header);
+    encoder.rows(pixels.data(), 0, 2);
+    encoder.end();
+  }
+
+  int bitDepth, colorType;
+  auto stored = readStoredRows(TEST_FILE, bitDepth, colorType);
+  std::remove(TEST_FILE.c_str());
+
+  ASSERT_EQ(bitDepth, 1);
+  ASSERT_EQ(colorType, PNG_COLOR_TYPE_GRAY);
+  ASSERT_EQ(stored.size(), 4u);
+  ASSERT_EQ(stored[0], 0x0F);
+  ASSERT_EQ(stored[1] & 0xC0, 0x80);
+  ASSERT_EQ(stored[2], 0xF0);
+  ASSERT_EQ(stored[3] & 0xC0, 0x40);
+}
+
+TEST(PngEncoder, ThrowsIfTheScanEndsEarly)
+{
+  ImageHeader header;
+  header.width = 2;
+  header.height = 2;
+  header.format = PixelFormat::Gray8;
+  std::vector<unsigned char> pixels = {0, 64};
+
+  PngEncoder encoder(TEST_FILE);
+  encoder.begin(header);
+  encoder.rows(pixels.data(), 0, 1);
+  ASSERT_ANY_THROW(encoder.end());
+  ASSERT_FALSE(encoder.isComplete());
+  std::remove(TEST_FILE.c_str());
+}
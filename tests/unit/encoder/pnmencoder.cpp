@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "encoder/pnmencoder.h"
+
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace
+{
+const std::string TEST_FILE = "pnmencoder_test.pnm";
+
+std::string readFile(const std::string &path)
+{
+  std::ifstream stream(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+}
+}
+
+TEST(PnmEncoder, WritesAPpmForRgbImages)
+{
+  ImageHeader header;
+  header.width = 2;
+  header.height = 3;
+  header.format = PixelFormat::Rgb8;
+  std::vector<unsigned char> pixels(2 * 3 * 3);
+  for (unsigned int i = 0; i < pixels.size(); ++i)
+  {
+    pixels[i] = static_cast<unsigned char>('a' + i);
+  }
+
+  {
+    PnmEncoder encoder(TEST_FILE);
+    encoder.begin(header);
+    encoder.rows(pixels.data(), 0, 2);
+    encoder.rows(pixels.data() + 12, 2, 1);
+    encoder.end();
+    ASSERT_TRUE(encoder.isComplete());
+  }
+
+  std::string content = readFile(TEST_FILE);
+  std::remove(TEST_FILE.c_str());
+  ASSERT_EQ(content, "P6\n2 3\n255\n" + std::string(pixels.begin(), pixels.end()));
+}
+
+TEST(PnmEncoder, WritesAPamHeader)
+{
+  ImageHeader header;
+  header.width = 4;
+  header.height = 1;
+  header.format = PixelFormat::Gray8;
+  std::vector<unsigned char> pixels = {1, 2, 3, 4};
+
+  {
+    PnmEncoder encoder(TEST_FILE, true);
+    encoder.begin(header);
+    encoder.rows(pixels.data(), 0, 1);
+    encoder.end();
+  }
+
+  std::string content = readFile(TEST_FILE);
+  std::remove(TEST_FILE.c_str());
+  ASSERT_EQ(content, "P7\nWIDTH 4\nHEIGHT 1\nDEPTH 1\nMAXVAL 255\nTUPLTYPE GRAYSCALE\nENDHDR\n\x01\x02\x03\x04");
+}
+
+TEST(PnmEncoder, WritesLineartAsPbm)
+{
+  ImageHeader header;
+  header.width = 10;
+  header.height = 1;
+  header.format = PixelFormat::Gray1;
+  std::vector<unsigned char> pixels = {0xA5, 0x40};
+
+  {
+    PnmEncoder encoder(TEST_FILE);
+    encoder.begin(header);
+    encoder.rows(pixels.data(), 0, 1);
+    encoder.end();
+  }
+
+  std::string content = readFile(TEST_FILE);
+  std::remove(TEST_FILE.c_str());
+  ASSERT_EQ(content, "P4\n10 1\n\xA5\x40");
+}
+
+TEST(PnmEncoder, WritesLineartAsBlackAndWhitePam)
+{
+  ImageHeader header;
+  header.width = 3;
+  header.height = 1;
+  header.format = PixelFormat::Gray1;
+  std::vector<unsigned char> pixels = {0xA0};
+
+  {
+    PnmEncoder encoder(TEST_FILE, true);
+    encoder.begin(header);
+    encoder.rows(pixels.data(), 0, 1);
+    encoder.end();
+  }
+
+  std::string content = readFile(TEST_FILE);
+  std::remove(TEST_FILE.c_str());
+  ASSERT_EQ(content, std::string("P7\nWIDTH 3\nHEIGHT 1\nDEPTH 1\nMAXVAL 1\nTUPLTYPE BLACKANDWHITE\nENDHDR\n\x00\x01\x00", 70));
+}
+
+TEST(PnmEncoder, WritesSixteenBitSamplesBigEndian)
+{
+  ImageHeader header;
+  header.width = 2;
+  header.height = 1;
+  header.format = PixelFormat::Gray16;
+  std::vector<uint16_t> samples = {0x1234, 0xABCD};
+
+  {
+    PnmEncoder encoder(TEST_FILE);
+    encoder.begin(header);
+    encoder.rows(reinterpret_cast<const unsigned char *>(samples.data()), 0, 1);
+    encoder.end();
+  }
+
+  std::string content = readFile(TEST_FILE);
+  std::remove(TEST_FILE.c_str());
+  ASSERT_EQ(content, "P5\n2 1\n65535\n\x12\x34\xAB\xCD");
+}
+
+TEST(PnmEncoder, IsIncompleteWhenRowsAreMissing)
+{
+  ImageHeader header;
+  header.width = 1;
+  header.height = 2;
+  header.format = PixelFormat::Gray8;
+  unsigned char pixel = 0;
+
+  PnmEncoder encoder(TEST_FILE);
+  encoder.begin(header);
+  encoder.rows(&pixel, 0, 1);
+  ASSERT_THROW(encoder.end(), std::runtime_error);
+  ASSERT_FALSE(encoder.isComplete());
+  std::remove(TEST_FILE.c_str());
+}
@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "encoder/tiffencoder.h"
+
+#include <vector>
+
+namespace
+{
+const std::string TEST_FILE = "tiffencoder_test.tiff";
+
+std::vector<unsigned char> readTiff(const std::string &path, uint32_t &width, uint32_t &height, uint16_t &compression)
+{
+  TIFF *tiff = TIFFOpen(path.c_str(), "r");
+  TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &width);
+  TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &height);
+  TIFFGetField(tiff, TIFFTAG_COMPRESSION, &compression);
+  std::vector<unsigned char> pixels(TIFFScanlineSize(tiff) * height);
+  for (uint32_t y = 0; y < height; ++y)
+  {
+    TIFFReadScanline(tiff, pixels.data() + y * TIFFScanlineSize(tiff), y, 0);
+  }
+  TIFFClose(tiff);
+  return pixels;
+}
+}
+
+TEST(TiffEncoder, EncodesWithEveryCompression)
+{
+  ImageHeader header;
+  header.width = 30;
+  header.height = 20;
+  header.format = PixelFormat::Rgb8;
+  std::vector<unsigned char> pixels(30 * 20 * 3);
+  for (unsigned int i = 0; i < pixels.size(); ++i)
+  {
+    pixels[i] = static_cast<unsigned char>(i * 7);
+  }
+
+  const std::vector<std::pair<EncoderOptions::TiffCompression, uint16_t>> compressions = {
+      {EncoderOptions::TiffNone, COMPRESSION_NONE},
+      {EncoderOptions::TiffLzw, COMPRESSION_LZW},
+      {EncoderOptions::TiffDeflate, COMPRESSION_ADOBE_DEFLATE}};
+  for (const auto &compression : compressions)
+  {
+    {
+      EncoderOptions options;
+      options.tiffCompression = compression.first;
+      TiffEncoder encoder(TEST_FILE, options);
+      encoder.begin(header);
+      encoder.rows(pixels.data(), 0, 5);
+      encoder.rows(pixels.data() + 5 * 30 * 3, 5, 15);
+      encoder.end();
+      ASSERT_TRUE(encoder.isComplete());
+    }
+
+    uint32_t width, height;
+    uint16_t usedCompression;
+    auto decoded = readTiff(TEST_FILE, width, height, usedCompression);
+    std::remove(TEST_FILE.c_str());
+
+    ASSERT_EQ(width, 30);
+    ASSERT_EQ(height, 20);
+    ASSERT_EQ(usedCompression, compression.second);
+    ASSERT_EQ(decoded, pixels);
+  }
+}
+
+TEST(TiffEncoder, EncodesLineartAndSixteenBitNatively)
+{
+  ImageHeader header;
+  header.width = 12;
+  header.height = 2;
+  header.format = PixelFormat::Gray1;
+  std::vector<unsigned char> lineart = {0xF0, 0x30, 0x0F, 0xC0};
+
+  std::vector<uint16_t> samples(12 * 2);
+  for (size_t i = 0; i < samples.size(); ++i)
+  {
+    samples[i] = static_cast<uint16_t>(i * 2731);
+  }
+
+  for (auto format : {PixelFormat::Gray1, PixelFormat::Gray16})
+  {
+    header.format = format;
+    const unsigned char *pixels = format == PixelFormat::Gray1 ? lineart.data() : reinterpret_cast<const unsigned char *>(samples.data());
+    {
+      EncoderOptions options;
+      options.tiffCompression = EncoderOptions::TiffLzw;
+      TiffEncoder encoder(TEST_FILE, options);
+      encoder.begin(header);
+      encoder.rows(pixels, 0, 2);
+      encoder.end();
+      ASSERT_TRUE(encoder.isComplete());
+    }
+
+    TIFF *tiff = TIFFOpen(TEST_FILE.c_str(), "r");
+    uint16_t bitsPerSample, photometric;
+    TIFFGetField(tiff, TIFFTAG_BITSPERSAMPLE, &bitsPerSample);
+    TIFFGetField(tiff, TIFFTAG_PHOTOMETRIC, &photometric);
+    TIFFClose(tiff);
+
+    uint32_t width, height;
+    uint16_t usedCompression;
+    auto decoded = readTiff(TEST_FILE, width, height, usedCompression);
+    std::remove(TEST_FILE.c_str());
+
+    ASSERT_EQ(bitsPerSample, getBitsPerSample(format));
+    ASSERT_EQ(photometric, format == PixelFormat::Gray1 ? PHOTOMETRIC_MINISWHITE : PHOTOMETRIC_MINISBLACK);
+    ASSERT_EQ(decoded, std::vector<unsigned char>(pixels, pixels + header.getBytesPerRow() * 2));
+  }
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "processing/itemdetector.h"
+
+#include <cstring>
+
+namespace
+{
+RawImagePtr createImage(unsigned int width, unsigned int height, unsigned int bytesPerPixel, unsigned char background)
+{
+  RawImagePtr image(new RawImage(width, height, bytesPerPixel == 1 ? PixelFormat::Gray8 : PixelFormat::Rgb8));
+  std::memset(image->pixels, background, static_cast<size_t>(width) * height * bytesPerPixel);
+  return image;
+}
+
+void fill(RawImage &image, unsigned int x, unsigned int y, unsigned int width, unsigned int height, unsigned char value)
+{
+  for (unsigned int row = y; row < y + height; ++row)
+  {
+    std::memset(image.pixels + (static_cast<size_t>(row) * image.width + x) * getBytesPerPixel(image.format), value, static_cast<size_t>(width) * getBytesPerPixel(image.format));
+  }
+}
+
+/**
+ * The detected bounds may include the margin, but must cover the item
+ */
+void expectCovers(const ItemBounds &bounds, unsigned int x, unsigned int y, unsigned int width, unsigned int height, unsigned int tolerance)
+{
+  EXPECT_LE(bounds.x, x);
+  EXPECT_LE(bounds.y, y);
+  EXPECT_GE(bounds.x + bounds.width, x + width);
+  EXPECT_GE(bounds.y + bounds.height, y + height);
+  EXPECT_GE(bounds.x + tolerance, x);
+  EXPECT_GE(bounds.y + tolerance, y);
+  EXPECT_LE(bounds.x + bounds.width, x + width + tolerance);
+  EXPECT_LE(bounds.y + bounds.height, y + height + tolerance);
+}
+}
+
+TEST(ItemDetector, FindsSeparateItemsOnABrightBackground)
+{
+  RawImagePtr image = createImage(1000, 800, 3, 250);
+  fill(*image, 100, 80, 300, 200, 40);
+  fill(*image, 550, 400, 350, 300, 120);
+
+  ItemDetectorOptions options;
+  options.maskSize = 100;
+  std::vector<ItemBounds> items = ItemDetector(options).detect(*image);
+
+  ASSERT_EQ(2u, items.size());
+  expectCovers(items[0], 100, 80, 300, 200, 20);
+  expectCovers(items[1], 550, 400, 350, 300, 20);
+}
+
+TEST(ItemDetector, KeepsAnItemWithABrightAreaInOnePiece)
+{
+  RawImagePtr image = createImage(400, 400, 1, 20);
+  fill(*image, 50, 50, 300, 300, 200);
+  // A stripe of background colour through the item, narrower than the merge distance
+  fill(*image, 198, 50, 4, 300, 20);
+
+  ItemDetectorOptions options;
+  options.maskSize = 100;
+  std::vector<ItemBounds> items = ItemDetector(options).detect(*image);
+
+  ASSERT_EQ(1u, items.size());
+  expectCovers(items[0], 50, 50, 300, 300, 8);
+}
+
+TEST(ItemDetector, DropsDust)
+{
+  RawImagePtr image = createImage(500, 500, 3, 255);
+  fill(*image, 100, 100, 3, 3, 0);
+
+  ItemDetectorOptions options;
+  options.maskSize = 250;
+  EXPECT_TRUE(ItemDetector(options).detect(*image).empty());
+}
+
+TEST(ItemDetector, CropCopiesTheItem)
+{
+  RawImagePtr image(new RawImage(4, 3, PixelFormat::Gray8));
+  for (unsigned int i = 0; i < 12; ++i)
+  {
+    image->pixels[i] = static_cast<unsigned char>(i);
+  }
+  ItemBounds bounds;
+  bounds.x = 1;
+  bounds.y = 1;
+  bounds.width = 2;
+  bounds.height = 2;
+
+  RawImagePtr item = ItemDetector::crop(*image, bounds);
+  ASSERT_EQ(2u, item->width);
+  ASSERT_EQ(2u, item->height);
+  EXPECT_THAT(std::vector<unsigned char>(item->pixels, item->pixels + 4), ::testing::ElementsAre(5, 6, 9, 10));
+
+  bounds.width = 4;
+  EXPECT_THROW(ItemDetector::crop(*image, bounds), std::runtime_error);
+}
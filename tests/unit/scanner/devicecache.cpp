@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "scanner/devicecache.h"
+
+#include <cstdio>
+#include <fstream>
+
+namespace
+{
+const std::string TEST_FILE = "devicecache_test.cache";
+const int BACKEND_VERSION = 0x01000019;
+
+DeviceCache::Device createDevice(const std::string &name, const std::string &model)
+{
+  DeviceCache::Device device;
+  device.name = name;
+  device.vendor = "Vendor";
+  device.model = model;
+  return device;
+}
+}
+
+TEST(DeviceCache, StoresDevicesOptionsAndCapabilities)
+{
+  ScannerCapabilities capabilities;
+  capabilities.minX = 0.5;
+  capabilities.maxY = 297.25;
+  capabilities.possibleResolutionsInDPI = {75, 300};
+  capabilities.possibleSources = {"Flatbed", "ADF Duplex"};
+  DeviceCache::OptionMap options = {{"tl-x", 2}, {"resolution", 7}};
+  {
+    DeviceCache cache(TEST_FILE);
+    cache.load(BACKEND_VERSION);
+    cache.setDevices({createDevice("net:one", "A"), createDevice("usb:two", "")});
+    cache.setOptionMap("usb:two", options);
+    cache.setCapabilities("usb:two", capabilities);
+    ASSERT_TRUE(cache.save());
+  }
+
+  DeviceCache cache(TEST_FILE);
+  ASSERT_TRUE(cache.load(BACKEND_VERSION));
+  std::remove(TEST_FILE.c_str());
+
+  auto devices = cache.getDevices();
+  ASSERT_EQ(devices.size(), 2);
+  ASSERT_EQ(devices[1].name, "usb:two");
+  ASSERT_EQ(devices[1].model, "");
+
+  DeviceCache::OptionMap loadedOptions;
+  ASSERT_FALSE(cache.getOptionMap("net:one", loadedOptions));
+  ASSERT_TRUE(cache.getOptionMap("usb:two", loadedOptions));
+  ASSERT_EQ(loadedOptions, options);
+
+  ScannerCapabilities loaded;
+  ASSERT_TRUE(cache.getCapabilities("usb:two", loaded));
+  ASSERT_EQ(loaded.minX, capabilities.minX);
+  ASSERT_EQ(loaded.maxY, capabilities.maxY);
+  ASSERT_EQ(loaded.possibleResolutionsInDPI, capabilities.possibleResolutionsInDPI);
+  ASSERT_EQ(loaded.possibleSources, capabilities.possibleSources);
+  ASSERT_TRUE(loaded.possibleModes.empty());
+}
+
+TEST(DeviceCache, IgnoresOtherBackendVersionsAndDamagedFiles)
+{
+  {
+    DeviceCache cache(TEST_FILE);
+    cache.load(BACKEND_VERSION);
+    cache.setDevices({createDevice("net:one", "A")});
+    cache.save();
+  }
+  {
+    DeviceCache cache(TEST_FILE);
+    ASSERT_FALSE(cache.load(BACKEND_VERSION + 1));
+    ASSERT_TRUE(cache.getDevices().empty());
+  }
+  {
+    std::ofstream stream(TEST_FILE, std::ios::app);
+    stream << "option\tresolution\tnot-a-number\n";
+  }
+  DeviceCache cache(TEST_FILE);
+  ASSERT_FALSE(cache.load(BACKEND_VERSION));
+  ASSERT_TRUE(cache.getDevices().empty());
+  std::remove(TEST_FILE.c_str());
+}
+
+TEST(DeviceCache, ChangedDevicesDropTheirEntries)
+{
+  DeviceCache cache(TEST_FILE);
+  cache.setDevices({createDevice("net:one", "A"), createDevice("usb:two", "B")});
+  cache.setOptionMap("net:one", {{"mode", 1}});
+  cache.setOptionMap("usb:two", {{"mode", 1}});
+
+  ASSERT_FALSE(cache.setDevices({createDevice("net:one", "A"), createDevice("usb:two", "B")}));
+  ASSERT_TRUE(cache.setDevices({createDevice("net:one", "A"), createDevice("usb:two", "C")}));
+
+  DeviceCache::OptionMap options;
+  ASSERT_TRUE(cache.getOptionMap("net:one", options));
+  ASSERT_FALSE(cache.getOptionMap("usb:two", options));
+
+  cache.invalidate("net:one");
+  ASSERT_FALSE(cache.getOptionMap("net:one", options));
+
+  cache.removeDevice("net:one");
+  ASSERT_EQ(cache.getDevices().size(), 1);
+}
@@ -0,0 +1,189 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "scanner/jobscheduler.h"
+
+#include <chrono>
+#include <thread>
+
+namespace
+{
+  /**
+   * Wait until the given number of jobs is queued for the device
+   */
+  void waitForDepth(JobScheduler &scheduler, ScannerDeviceDescriptorPtr device, unsigned int depth)
+  {
+    while (scheduler.getStatistics(device).depth < depth)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+}
+
+TEST(JobScheduler, WaitingJobsStartByPriorityThenInOrder)
+{
+  auto device = ScannerDeviceDescriptorPtr(new ScannerDeviceDescriptor());
+  JobScheduler scheduler([](ScannerDeviceDescriptorPtr) {});
+  std::mutex orderMutex;
+  std::vector<int> order;
+
+  std::vector<std::thread> jobs;
+  {
+    auto blocking = scheduler.start(device, ScanJob());
+    const JobPriority priorities[] = {JobPriority::Batch, JobPriority::Normal, JobPriority::Interactive, JobPriority::Normal};
+    for (int i = 0; i < 4; ++i)
+    {
+      jobs.emplace_back([&, i]() {
+        auto turn = scheduler.start(device, ScanJob(priorities[i]));
+        std::lock_guard<std::mutex> lock(orderMutex);
+        order.push_back(i);
+      });
+      waitForDepth(scheduler, device, i + 1);
+    }
+  }
+  for (auto &job : jobs)
+  {
+    job.join();
+  }
+
+  ASSERT_THAT(order, ::testing::ElementsAre(2, 1, 3, 0));
+  auto statistics = scheduler.getStatistics(device);
+  ASSERT_EQ(statistics.startedJobs, 5);
+  ASSERT_EQ(statistics.depth, 0);
+  ASSERT_FALSE(statistics.busy);
+  ASSERT_GT(statistics.maximumWaitTime, 0);
+}
+
+TEST(JobScheduler, CancelledWaitingJobsNeverStart)
+{
+  auto device = ScannerDeviceDescriptorPtr(new ScannerDeviceDescriptor());
+  JobScheduler scheduler([](ScannerDeviceDescriptorPtr) { FAIL() << "No running job was cancelled"; });
+  unsigned long long id = scheduler.createJobId();
+  bool cancelled = false;
+
+  auto blocking = scheduler.start(device, ScanJob());
+  std::thread waiting([&]() {
+    try
+    {
+      scheduler.start(device, ScanJob(JobPriority::Normal, id));
+    }
+    catch (const std::runtime_error &)
+    {
+      cancelled = true;
+    }
+  });
+  waitForDepth(scheduler, device, 1);
+  ASSERT_TRUE(scheduler.cancel(id));
+  waiting.join();
+
+  ASSERT_TRUE(cancelled);
+  ASSERT_FALSE(scheduler.cancel(id));
+  ASSERT_EQ(scheduler.getStatistics(device).cancelledJobs, 1);
+  ASSERT_EQ(scheduler.getStatistics(device).depth, 0);
+}
+
+TEST(JobScheduler, JobsThatDoNotWaitFailOnABusyDevice)
+{
+  auto device = ScannerDeviceDescriptorPtr(new ScannerDeviceDescriptor());
+  JobScheduler scheduler([](ScannerDeviceDescriptorPtr) {});
+  ScanJob immediate(JobPriority::Interactive);
+  immediate.waitForTurn = false;
+
+  {
+    auto running = scheduler.start(device, ScanJob());
+    ASSERT_THROW(scheduler.start(device, immediate), std::runtime_error);
+    ASSERT_EQ(scheduler.getStatistics(device).depth, 0);
+  }
+  auto turn = scheduler.start(device, immediate);
+  ASSERT_EQ(scheduler.getStatistics(device).startedJobs, 2);
+}
+
+TEST(JobScheduler, CancellingARunningJobAbortsItsDevice)
+{
+  auto device = ScannerDeviceDescriptorPtr(new ScannerDeviceDescriptor());
+  ScannerDeviceDescriptorPtr aborted;
+  JobScheduler scheduler([&](ScannerDeviceDescriptorPtr device) { aborted = device; });
+  unsigned long long id = scheduler.createJobId();
+  {
+    auto turn = scheduler.start(device, ScanJob(JobPriority::Normal, id));
+    ASSERT_NO_THROW(turn.throwIfCancelled());
+    ASSERT_TRUE(scheduler.cancel(id));
+    ASSERT_EQ(aborted, device);
+    ASSERT_THROW(turn.throwIfCancelled(), std::runtime_error);
+  }
+  ASSERT_EQ(scheduler.getStatistics(device).cancelledJobs, 1);
+  ASSERT_FALSE(scheduler.cancel(0));
+}
+
+TEST(JobScheduler, DevicesDoNotWaitForEachOther)
+{
+  auto first = ScannerDeviceDescriptorPtr(new ScannerDeviceDescriptor());
+  auto second = ScannerDeviceDescriptorPtr(new ScannerDeviceDescriptor());
+  JobScheduler scheduler([](ScannerDeviceDescriptorPtr) {});
+
+  auto firstTurn = scheduler.start(first, ScanJob());
+  auto secondTurn = scheduler.start(second, ScanJob());
+  ASSERT_TRUE(scheduler.getStatistics(first).busy);
+  ASSERT_TRUE(scheduler.getStatistics(second).busy);
+}
+
+TEST(JobScheduler, ReservedJobsAreCalledOnTheirTurn)
+{
+  auto device = ScannerDeviceDescriptorPtr(new ScannerDeviceDescriptor());
+  JobScheduler scheduler([](ScannerDeviceDescriptorPtr) {});
+  ScanJob reservedJob(JobPriority::Normal, scheduler.createJobId());
+  int turns = 0;
+
+  {
+    auto running = scheduler.start(device, ScanJob());
+    scheduler.reserve(device, reservedJob, [&]() { turns++; });
+    ASSERT_EQ(turns, 0);
+    ASSERT_EQ(scheduler.getStatistics(device).depth, 1);
+  }
+  ASSERT_EQ(turns, 1);
+  ASSERT_TRUE(scheduler.getStatistics(device).busy);
+
+  ScanJob immediate;
+  immediate.waitForTurn = false;
+  ASSERT_THROW(scheduler.start(device, immediate), std::runtime_error);
+  {
+    auto turn = scheduler.start(device, reservedJob);
+    ASSERT_EQ(scheduler.getStatistics(device).startedJobs, 2);
+  }
+  ASSERT_FALSE(scheduler.getStatistics(device).busy);
+}
+
+TEST(JobScheduler, CancelledReservedJobsFailOnStart)
+{
+  auto device = ScannerDeviceDescriptorPtr(new ScannerDeviceDescriptor());
+  JobScheduler scheduler([](ScannerDeviceDescriptorPtr) {});
+  ScanJob reservedJob(JobPriority::Normal, scheduler.createJobId());
+  int turns = 0;
+
+  auto running = scheduler.start(device, ScanJob());
+  scheduler.reserve(device, reservedJob, [&]() { turns++; });
+  ASSERT_TRUE(scheduler.cancel(reservedJob.id));
+  ASSERT_EQ(turns, 1);
+  ASSERT_THROW(scheduler.start(device, reservedJob), std::runtime_error);
+  ASSERT_EQ(scheduler.getStatistics(device).cancelledJobs, 1);
+  ASSERT_TRUE(scheduler.getStatistics(device).busy);
+}
+
+TEST(JobScheduler, ReleasedReservationsFreeTheDevice)
+{
+  auto device = ScannerDeviceDescriptorPtr(new ScannerDeviceDescriptor());
+  JobScheduler scheduler([](ScannerDeviceDescriptorPtr) {});
+  ScanJob first(JobPriority::Normal, scheduler.createJobId());
+  ScanJob second(JobPriority::Normal, scheduler.createJobId());
+  std::vector<unsigned long long> turns;
+
+  scheduler.reserve(device, first, [&]() { turns.push_back(first.id); });
+  scheduler.reserve(device, second, [&]() { turns.push_back(second.id); });
+  ASSERT_THAT(turns, ::testing::ElementsAre(first.id));
+
+  scheduler.release(first.id);
+  ASSERT_THAT(turns, ::testing::ElementsAre(first.id, second.id));
+  scheduler.release(second.id);
+  scheduler.release(second.id);
+  ASSERT_FALSE(scheduler.getStatistics(device).busy);
+}
@@ -0,0 +1,219 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "scanner/pixelunpacker.h"
+#include "scanner/rawimagereceiver.h"
+
+#include <vector>
+
+namespace
+{
+FrameParameters createFrame(FrameParameters::Format format, unsigned int depth, unsigned int width, unsigned int height, unsigned int padding = 0)
+{
+  FrameParameters frame;
+  frame.format = format;
+  frame.depth = depth;
+  frame.pixelsPerLine = width;
+  frame.lines = height;
+  unsigned int samples = width * (format == FrameParameters::Rgb ? 3 : 1);
+  frame.bytesPerLine = (samples * depth + 7) / 8 + padding;
+  frame.lastFrame = format == FrameParameters::Gray || format == FrameParameters::Rgb || format == FrameParameters::Blue;
+  return frame;
+}
+
+/**
+ * Feed the data in small, odd chunks, so that rows are split between chunks
+ */
+void feedInChunks(PixelUnpacker &unpacker, const std::vector<unsigned char> &data, size_t chunkSize = 5)
+{
+  for (size_t offset = 0; offset < data.size(); offset += chunkSize)
+  {
+    unpacker.feed(data.data() + offset, std::min(chunkSize, data.size() - offset));
+  }
+}
+
+std::vector<unsigned char> pixelsOf(RawImagePtr image)
+{
+  return std::vector<unsigned char>(image->pixels, image->pixels + image->bytesPerRow * image->height);
+}
+}
+
+TEST(PixelUnpacker, PassesRgbRowsThrough)
+{
+  std::vector<unsigned char> data = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+  RawImageReceiver receiver;
+  PixelUnpacker unpacker(receiver);
+  unpacker.beginFrame(createFrame(FrameParameters::Rgb, 8, 2, 2));
+  feedInChunks(unpacker, data);
+  unpacker.endFrame();
+
+  ASSERT_EQ(receiver.getImage()->format, PixelFormat::Rgb8);
+  ASSERT_EQ(pixelsOf(receiver.getImage()), data);
+}
+
+TEST(PixelUnpacker, KeepsGrayAsSingleChannel)
+{
+  std::vector<unsigned char> data = {10, 20, 30, 40, 50, 60};
+  RawImageReceiver receiver;
+  PixelUnpacker unpacker(receiver);
+  unpacker.beginFrame(createFrame(FrameParameters::Gray, 8, 3, 2));
+  feedInChunks(unpacker, data, 4);
+  unpacker.endFrame();
+
+  ASSERT_EQ(receiver.getImage()->format, PixelFormat::Gray8);
+  ASSERT_EQ(pixelsOf(receiver.getImage()), data);
+}
+
+TEST(PixelUnpacker, DropsLinePadding)
+{
+  std::vector<unsigned char> data = {1, 2, 0xEE, 3, 4, 0xEE};
+  RawImageReceiver receiver;
+  PixelUnpacker unpacker(receiver);
+  unpacker.beginFrame(createFrame(FrameParameters::Gray, 8, 2, 2, 1));
+  feedInChunks(unpacker, data, 3);
+  unpacker.endFrame();
+
+  ASSERT_EQ(pixelsOf(receiver.getImage()), std::vector<unsigned char>({1, 2, 3, 4}));
+}
+
+TEST(PixelUnpacker, KeepsLineartPacked)
+{
+  // 11 pixels per row: two bytes, the last one padded
+  std::vector<unsigned char> data = {0xA0, 0x40, 0x12, 0xE0};
+  RawImageReceiver receiver;
+  PixelUnpacker unpacker(receiver);
+  unpacker.beginFrame(createFrame(FrameParameters::Gray, 1, 11, 2));
+  feedInChunks(unpacker, data, 1);
+  unpacker.endFrame();
+
+  ASSERT_EQ(receiver.getImage()->format, PixelFormat::Gray1);
+  ASSERT_EQ(pixelsOf(receiver.getImage()), data);
+}
+
+TEST(PixelUnpacker, ExpandsColorLineartToEightBit)
+{
+  std::vector<unsigned char> data = {0xA0};
+  RawImageReceiver receiver;
+  PixelUnpacker unpacker(receiver);
+  unpacker.beginFrame(createFrame(FrameParameters::Rgb, 1, 1, 1));
+  feedInChunks(unpacker, data, 1);
+  unpacker.endFrame();
+
+  ASSERT_EQ(receiver.getImage()->format, PixelFormat::Rgb8);
+  ASSERT_EQ(pixelsOf(receiver.getImage()), std::vector<unsigned char>({255, 0, 255}));
+}
+
+TEST(PixelUnpacker, KeepsSixteenBitSamples)
+{
+  std::vector<uint16_t> samples = {0x1234, 0xABCD, 0x00FF, 0xFF00, 0x8080, 0x0101};
+  std::vector<unsigned char> data(reinterpret_cast<unsigned char *>(samples.data()), reinterpret_cast<unsigned char *>(samples.data() + samples.size()));
+  RawImageReceiver receiver;
+  PixelUnpacker unpacker(receiver);
+  unpacker.beginFrame(createFrame(FrameParameters::Rgb, 16, 1, 2));
+  feedInChunks(unpacker, data, 7);
+  unpacker.endFrame();
+
+  ASSERT_EQ(receiver.getImage()->format, PixelFormat::Rgb16);
+  ASSERT_EQ(pixelsOf(receiver.getImage()), data);
+}
+
+TEST(PixelUnpacker, DropsThePaddingOfSixteenBitLines)
+{
+  std::vector<uint16_t> samples = {0x1234, 0xABCD, 0xEEEE, 0x00FF, 0xFF00, 0xEEEE};
+  std::vector<unsigned char> data(reinterpret_cast<unsigned char *>(samples.data()), reinterpret_cast<unsigned char *>(samples.data() + samples.size()));
+  RawImageReceiver receiver;
+  PixelUnpacker unpacker(receiver);
+  unpacker.beginFrame(createFrame(FrameParameters::Gray, 16, 2, 2, 2));
+  feedInChunks(unpacker, data, 3);
+  unpacker.endFrame();
+
+  std::vector<uint16_t> expected = {0x1234, 0xABCD, 0x00FF, 0xFF00};
+  ASSERT_EQ(receiver.getImage()->format, PixelFormat::Gray16);
+  ASSERT_EQ(pixelsOf(receiver.getImage()), std::vector<unsigned char>(reinterpret_cast<unsigned char *>(expected.data()), reinterpret_cast<unsigned char *>(expected.data() + expected.size())));
+}
+
+TEST(PixelUnpacker, InterleavesPlanarFrames)
+{
+  RawImageReceiver receiver;
+  PixelUnpacker unpacker(receiver);
+  unsigned char channel = 0;
+  for (auto format : {FrameParameters::Red, FrameParameters::Green, FrameParameters::Blue})
+  {
+    std::vector<unsigned char> data = {static_cast<unsigned char>(channel + 1), static_cast<unsigned char>(channel + 11)};
+    unpacker.beginFrame(createFrame(format, 8, 1, 2));
+    feedInChunks(unpacker, data, 1);
+    unpacker.endFrame();
+    channel++;
+  }
+
+  ASSERT_EQ(pixelsOf(receiver.getImage()), std::vector<unsigned char>({1, 2, 3, 11, 12, 13}));
+}
+
+TEST(PixelUnpacker, IgnoresDataBeyondTheLastLine)
+{
+  std::vector<unsigned char> data = {1, 2, 3, 4};
+  RawImageReceiver receiver;
+  PixelUnpacker unpacker(receiver);
+  unpacker.beginFrame(createFrame(FrameParameters::Gray, 8, 2, 1));
+  feedInChunks(unpacker, data, 4);
+  unpacker.endFrame();
+
+  ASSERT_EQ(pixelsOf(receiver.getImage()), std::vector<unsigned char>({1, 2}));
+}
+
+TEST(PixelUnpacker, RejectsShortFrames)
+{
+  std::vector<unsigned char> data = {1, 2, 3};
+  RawImageReceiver receiver;
+  PixelUnpacker unpacker(receiver);
+  unpacker.beginFrame(createFrame(FrameParameters::Gray, 8, 2, 2));
+  feedInChunks(unpacker, data, 4);
+  ASSERT_ANY_THROW(unpacker.endFrame());
+}
+
+TEST(PixelUnpacker, RejectsUnsupportedDepths)
+{
+  RawImageReceiver receiver;
+  PixelUnpacker unpacker(receiver);
+  ASSERT_ANY_THROW(unpacker.beginFrame(createFrame(FrameParameters::Gray, 4, 2, 1)));
+}
+
+namespace
+{
+/**
+ * Collects the image & asks for its statistics
+ */
+class StatisticsReceiver : public RawImageReceiver
+{
+public:
+  virtual unsigned char getInkThreshold() const
+  {
+    return 100;
+  }
+
+  virtual void statistics(const PageStatistics &statistics)
+  {
+    collected = statistics;
+    delivered++;
+  }
+
+  PageStatistics collected;
+  unsigned int delivered = 0;
+};
+}
+
+TEST(PixelUnpacker, CollectsStatisticsOfTheDeliveredSamples)
+{
+  // 16 bit samples, the statistics see the converted 8 bit values: 0x10, 0xF0, 0x50, 0xFF
+  std::vector<unsigned char> data = {0x00, 0x10, 0x00, 0xF0, 0x00, 0x50, 0xFF, 0xFF};
+  StatisticsReceiver receiver;
+  PixelUnpacker unpacker(receiver);
+  unpacker.beginFrame(createFrame(FrameParameters::Gray, 16, 2, 2));
+  feedInChunks(unpacker, data, 3);
+  unpacker.endFrame();
+
+  ASSERT_EQ(receiver.delivered, 1u);
+  ASSERT_EQ(receiver.collected.samples, 4u);
+  ASSERT_EQ(receiver.collected.sum, 0x10u + 0xF0 + 0x50 + 0xFF);
+  ASSERT_EQ(receiver.collected.inkSamples, 2u);
+}
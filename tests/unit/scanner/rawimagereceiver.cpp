@@ -0,0 +1,50 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "scanner/rawimagereceiver.h"
+
+TEST(RawImageReceiver, HasNoImageBeforeTheScanBegins)
+{
+  RawImageReceiver receiver;
+  ASSERT_EQ(receiver.getImage(), nullptr);
+}
+
+TEST(RawImageReceiver, CollectsRowBatches)
+{
+  ImageHeader header;
+  header.width = 2;
+  header.height = 3;
+  header.format = PixelFormat::Gray8;
+  const unsigned char firstRows[] = {1, 2, 3, 4};
+  const unsigned char lastRow[] = {5, 6};
+
+  RawImageReceiver receiver;
+  receiver.begin(header);
+  receiver.rows(firstRows, 0, 2);
+  receiver.rows(lastRow, 2, 1);
+  receiver.end();
+
+  RawImagePtr image = receiver.getImage();
+  ASSERT_EQ(image->width, 2);
+  ASSERT_EQ(image->height, 3);
+  for (unsigned int i = 0; i < 6; ++i)
+  {
+    ASSERT_EQ(image->pixels[i], i + 1);
+  }
+}
+
+TEST(RawImageReceiver, IgnoresRowsBeyondTheImage)
+{
+  ImageHeader header;
+  header.width = 1;
+  header.height = 1;
+  header.format = PixelFormat::Gray8;
+  const unsigned char rows[] = {7, 8};
+
+  RawImageReceiver receiver;
+  receiver.begin(header);
+  receiver.rows(rows, 0, 2);
+  receiver.rows(rows, 1, 1);
+
+  ASSERT_EQ(receiver.getImage()->pixels[0], 7);
+}
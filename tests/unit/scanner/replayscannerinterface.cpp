@@ -0,0 +1,173 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "scanner/rawimagereceiver.h"
+#include "scanner/replayscannerinterface.h"
+
+#include <chrono>
+#include <cstdio>
+
+namespace
+{
+const std::string TEST_FILE = "replayscannerinterface_test.recording";
+
+class CountingReceiver : public IScanReceiver
+{
+public:
+  virtual void begin(const ImageHeader &header)
+  {
+    pages++;
+  }
+
+  virtual void rows(const unsigned char *pixels, unsigned int y, unsigned int count)
+  {
+    rowCount += count;
+  }
+
+  virtual void end()
+  {
+  }
+
+  unsigned int pages = 0;
+  unsigned int rowCount = 0;
+};
+
+/**
+ * A 4x3 gray page, delivered in reads of 5 & 7 bytes that each kept the scanner busy for the given time
+ */
+std::vector<RecordedFrame> createPage(unsigned char firstPixel, unsigned int waitTime = 0)
+{
+  RecordedFrame frame;
+  frame.parameters.format = FrameParameters::Gray;
+  frame.parameters.depth = 8;
+  frame.parameters.pixelsPerLine = 4;
+  frame.parameters.bytesPerLine = 4;
+  frame.parameters.lines = 3;
+  frame.parameters.lastFrame = true;
+  RecordedRead first, second;
+  first.waitTime = waitTime;
+  second.waitTime = waitTime;
+  for (unsigned char i = 0; i < 12; ++i)
+  {
+    (i < 5 ? first : second).data.push_back(firstPixel + i);
+  }
+  frame.reads = {first, second};
+  return {frame};
+}
+
+RecordedScan createScan(const std::string &descriptor, size_t pages, unsigned int waitTime = 0)
+{
+  RecordedScan scan;
+  scan.descriptor = descriptor;
+  scan.capabilities.possibleResolutionsInDPI = {150, 300};
+  scan.configuration.resolutionInDPI = 150;
+  scan.configuration.source = "Flatbed";
+  for (size_t i = 0; i < pages; ++i)
+  {
+    scan.pages.push_back(createPage(static_cast<unsigned char>(i * 100), waitTime));
+  }
+  return scan;
+}
+
+class ReplayScannerInterfaceTest : public ::testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    std::remove(TEST_FILE.c_str());
+  }
+
+  virtual void TearDown()
+  {
+    std::remove(TEST_FILE.c_str());
+  }
+};
+}
+
+TEST_F(ReplayScannerInterfaceTest, ReplaysTheRecordedPixelsOfEachDevice)
+{
+  ScanRecording::append(TEST_FILE, createScan("test:0", 1));
+  ScanRecording::append(TEST_FILE, createScan("test:1", 3));
+  ScanRecording::append(TEST_FILE, createScan("test:0", 2));
+  ReplayScannerInterface interface(TEST_FILE, ReplayScannerInterface::AsFastAsPossible);
+  ASSERT_TRUE(interface.init());
+
+  std::vector<ScannerDeviceDescriptorPtr> devices = interface.getDevices();
+  ASSERT_EQ(2u, devices.size());
+  ASSERT_EQ("test:0", devices[0]->descriptor);
+  ASSERT_EQ(std::vector<int>({150, 300}), interface.getCapabilities(devices[0]).possibleResolutionsInDPI);
+
+  RawImagePtr image = interface.scanToBuffer(devices[0]);
+  ASSERT_EQ(4u, image->width);
+  ASSERT_EQ(3u, image->height);
+  for (unsigned int i = 0; i < 12; ++i)
+  {
+    ASSERT_EQ(i, image->pixels[(i / 4) * image->bytesPerRow + i % 4]);
+  }
+
+  // the device's scans are replayed in turn
+  CountingReceiver receiver;
+  ASSERT_EQ(2u, interface.scanBatch(devices[0], receiver));
+  ASSERT_EQ(2u, receiver.pages);
+  ASSERT_EQ(6u, receiver.rowCount);
+  CountingReceiver otherReceiver;
+  ASSERT_EQ(3u, interface.scanBatch(devices[1], otherReceiver));
+  ASSERT_EQ(9u, otherReceiver.rowCount);
+}
+
+TEST_F(ReplayScannerInterfaceTest, KeepsTheConfigurationChanges)
+{
+  ScanRecording::append(TEST_FILE, createScan("test:0", 1));
+  ReplayScannerInterface interface(TEST_FILE);
+  ASSERT_TRUE(interface.init());
+  ScannerDeviceDescriptorPtr device = interface.getDevices().front();
+
+  ScannerConfiguration changes;
+  changes.resolutionInDPI = 300;
+  interface.setConfiguration(device, changes);
+
+  ScannerConfiguration configuration = interface.getConfiguration(device);
+  ASSERT_EQ(300, configuration.resolutionInDPI);
+  ASSERT_EQ("Flatbed", configuration.source);
+  ASSERT_EQ(1u, interface.getStatistics().optionWrites);
+}
+
+TEST_F(ReplayScannerInterfaceTest, WaitsAsLongAsTheScannerUnlessReplayingFast)
+{
+  ScanRecording::append(TEST_FILE, createScan("test:0", 1, 20000));
+  ReplayScannerInterface original(TEST_FILE);
+  ReplayScannerInterface fast(TEST_FILE, ReplayScannerInterface::AsFastAsPossible);
+  ASSERT_TRUE(original.init());
+  ASSERT_TRUE(fast.init());
+
+  auto measure = [](ReplayScannerInterface &interface) {
+    auto start = std::chrono::steady_clock::now();
+    interface.scanToBuffer(interface.getDevices().front());
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+  };
+  ASSERT_GE(measure(original), 40);
+  ASSERT_LT(measure(fast), 20);
+}
+
+TEST_F(ReplayScannerInterfaceTest, CancelEndsTheReplay)
+{
+  ScanRecording::append(TEST_FILE, createScan("test:0", 1, 2000000));
+  ReplayScannerInterface interface(TEST_FILE);
+  ASSERT_TRUE(interface.init());
+  ScannerDeviceDescriptorPtr device = interface.getDevices().front();
+
+  RawImageReceiver receiver;
+  IScanSessionPtr session = interface.startScan(device, receiver);
+  ASSERT_EQ(-1, session->getSelectFd());
+  ASSERT_FALSE(session->read());
+  interface.cancel(device);
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_THROW(session->read(), std::runtime_error);
+  ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+}
+
+TEST_F(ReplayScannerInterfaceTest, FailsWithoutRecording)
+{
+  ReplayScannerInterface interface(TEST_FILE);
+  ASSERT_FALSE(interface.init());
+}
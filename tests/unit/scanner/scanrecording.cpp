@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "scanner/scanrecording.h"
+
+#include <cstdio>
+#include <fstream>
+
+namespace
+{
+const std::string TEST_FILE = "scanrecording_test.recording";
+
+FrameParameters createGrayFrame(unsigned int width, unsigned int height)
+{
+  FrameParameters frame;
+  frame.format = FrameParameters::Gray;
+  frame.depth = 8;
+  frame.pixelsPerLine = width;
+  frame.bytesPerLine = width;
+  frame.lines = height;
+  frame.lastFrame = true;
+  return frame;
+}
+}
+
+TEST(ScanRecording, RecordsEveryFrameOnItsOwnPageAndSkipsEmptyReads)
+{
+  ScannerCapabilities capabilities;
+  capabilities.maxX = 215.9;
+  capabilities.possibleResolutionsInDPI = {75, 300};
+  capabilities.possibleSources = {"Flatbed", "ADF Duplex"};
+  ScannerConfiguration configuration;
+  configuration.resolutionInDPI = 300;
+  configuration.source = "ADF Duplex";
+  ScanRecorder recorder(TEST_FILE, "test:0", capabilities, configuration);
+
+  const unsigned char data[] = {1, 2, '\n', 4, 5, 6};
+  for (int page = 0; page < 2; ++page)
+  {
+    recorder.beginFrame();
+    recorder.addFrame(createGrayFrame(3, 2));
+    recorder.beginRead();
+    recorder.addRead(data, 0);
+    recorder.beginRead();
+    recorder.addRead(data, 4);
+    recorder.beginRead();
+    recorder.addRead(data + 4, 2);
+  }
+
+  const RecordedScan &scan = recorder.getScan();
+  ASSERT_EQ(2u, scan.pages.size());
+  ASSERT_EQ(1u, scan.pages[1].size());
+  ASSERT_EQ(2u, scan.pages[1][0].reads.size());
+  ASSERT_EQ(std::vector<unsigned char>({1, 2, '\n', 4}), scan.pages[1][0].reads[0].data);
+
+  std::remove(TEST_FILE.c_str());
+  recorder.save();
+  recorder.save();
+  std::vector<RecordedScan> scans = ScanRecording::load(TEST_FILE);
+  std::remove(TEST_FILE.c_str());
+
+  ASSERT_EQ(2u, scans.size());
+  const RecordedScan &loaded = scans[1];
+  ASSERT_EQ("test:0", loaded.descriptor);
+  ASSERT_DOUBLE_EQ(215.9, loaded.capabilities.maxX);
+  ASSERT_EQ(capabilities.possibleResolutionsInDPI, loaded.capabilities.possibleResolutionsInDPI);
+  ASSERT_EQ(capabilities.possibleSources, loaded.capabilities.possibleSources);
+  ASSERT_EQ(300, loaded.configuration.resolutionInDPI);
+  ASSERT_EQ("ADF Duplex", loaded.configuration.source);
+  ASSERT_EQ(2u, loaded.pages.size());
+  const RecordedFrame &frame = loaded.pages[1][0];
+  ASSERT_EQ(FrameParameters::Gray, frame.parameters.format);
+  ASSERT_TRUE(frame.parameters.lastFrame);
+  ASSERT_EQ(3u, frame.parameters.bytesPerLine);
+  ASSERT_EQ(2u, frame.parameters.lines);
+  ASSERT_EQ(2u, frame.reads.size());
+  ASSERT_EQ(scan.pages[1][0].reads[0].data, frame.reads[0].data);
+  ASSERT_EQ(scan.pages[1][0].reads[1].waitTime, frame.reads[1].waitTime);
+}
+
+TEST(ScanRecording, RejectsDamagedFiles)
+{
+  {
+    std::ofstream stream(TEST_FILE);
+    stream << "scanahedron-recording 1\nscan\ttest:0\npage\nframe\t0\t0\t1\t3\t3\t2\t8\nread\t0\t6\n12";
+  }
+  ASSERT_THROW(ScanRecording::load(TEST_FILE), std::runtime_error);
+  {
+    std::ofstream stream(TEST_FILE);
+    stream << "not a recording\n";
+  }
+  ASSERT_THROW(ScanRecording::load(TEST_FILE), std::runtime_error);
+  std::remove(TEST_FILE.c_str());
+  ASSERT_THROW(ScanRecording::load(TEST_FILE), std::runtime_error);
+}
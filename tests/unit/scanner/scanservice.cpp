@@ -3,8 +3,20 @@
 
 #include "scanner/iscannerinterface.h"
 #include "scanner/scanservice.h"
+#include "scanner/rawimagereceiver.h"
+#include "scanner/replayscannerinterface.h"
+#include "scanner/scanrecording.h"
+#include "utils/pixelkernels.h"
 #include "utils/types.h"
 
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <thread>
+
+using ::testing::Invoke;
 using ::testing::Return;
 using ::testing::_;
 
@@ -17,16 +29,21 @@ public:
   MOCK_METHOD1(getCapabilities, ScannerCapabilities(ScannerDeviceDescriptorPtr));
   MOCK_METHOD1(getConfiguration, ScannerConfiguration(ScannerDeviceDescriptorPtr));
   MOCK_METHOD2(setConfiguration, void(ScannerDeviceDescriptorPtr, const ScannerConfiguration &));
+  MOCK_METHOD0(getStatistics, ScannerStatistics());
   MOCK_METHOD1(scanToBuffer, RawImagePtr(ScannerDeviceDescriptorPtr));
+  MOCK_METHOD2(scan, void(ScannerDeviceDescriptorPtr, IScanReceiver &));
+  MOCK_METHOD2(startScan, IScanSessionPtr(ScannerDeviceDescriptorPtr, IScanReceiver &));
+  MOCK_METHOD2(scanBatch, unsigned int(ScannerDeviceDescriptorPtr, IScanReceiver &));
+  MOCK_METHOD1(cancel, void(ScannerDeviceDescriptorPtr));
 };
 
 SHARED_PTR(MockScannerInterface);
 
-TEST(ScannerService, ConstructionCallsInitAndDoesNotThrowIfOk)
+TEST(ScannerService, ConstructionDoesNotInitTheInterface)
 {
   MockScannerInterfacePtr interface(new MockScannerInterface());
-  EXPECT_CALL(*interface, init()).Times(1).WillRepeatedly(Return(true));
-  EXPECT_CALL(*interface, exit()).Times(1);
+  EXPECT_CALL(*interface, init()).Times(0);
+  EXPECT_CALL(*interface, exit()).Times(0);
 
   ScanService service(interface);
 }
@@ -36,21 +53,54 @@ TEST(ScannerService, CannotConstructWithoutInterface)
   ASSERT_ANY_THROW(ScanService service(nullptr));
 }
 
-TEST(ScannerService, ConstructorThrowsIfCannotInit)
+TEST(ScannerService, FirstUseCallsInitOnce)
+{
+  MockScannerInterfacePtr interface(new MockScannerInterface());
+  EXPECT_CALL(*interface, init()).Times(1).WillRepeatedly(Return(true));
+  EXPECT_CALL(*interface, getDevices()).Times(2).WillRepeatedly(Return(std::vector<ScannerDeviceDescriptorPtr>()));
+  EXPECT_CALL(*interface, exit()).Times(1);
+
+  ScanService service(interface);
+  service.loadScanners();
+  service.loadScanners();
+}
+
+TEST(ScannerService, FirstUseThrowsIfCannotInit)
 {
   MockScannerInterfacePtr interface(new MockScannerInterface());
   EXPECT_CALL(*interface, init()).Times(1).WillRepeatedly(Return(false));
+  EXPECT_CALL(*interface, exit()).Times(0);
 
-  ASSERT_ANY_THROW(ScanService service(interface));
+  ScanService service(interface);
+  ASSERT_ANY_THROW(service.getAvailableScanners());
 }
 
 TEST(ScannerService, DestructionCallsExit)
 {
   MockScannerInterfacePtr interface(new MockScannerInterface());
   EXPECT_CALL(*interface, init()).Times(1).WillRepeatedly(Return(true));
+  EXPECT_CALL(*interface, getDevices()).Times(1).WillRepeatedly(Return(std::vector<ScannerDeviceDescriptorPtr>()));
+  EXPECT_CALL(*interface, exit()).Times(1);
+  {
+    ScanService service(interface);
+    service.loadScanners();
+  }
+}
+
+TEST(ScannerService, WarmupDiscoversTheDevicesForLaterCalls)
+{
+  std::vector<ScannerDeviceDescriptorPtr> available;
+  available.push_back(ScannerDeviceDescriptorPtr(new ScannerDeviceDescriptor()));
+  MockScannerInterfacePtr interface(new MockScannerInterface());
+  EXPECT_CALL(*interface, init()).Times(1).WillRepeatedly(Return(true));
+  EXPECT_CALL(*interface, getDevices()).Times(1).WillRepeatedly(Return(available));
   EXPECT_CALL(*interface, exit()).Times(1);
   {
     ScanService service(interface);
+    std::thread warmup([&]() { service.warmup(); });
+    warmup.join();
+
+    ASSERT_EQ(service.getAvailableScanners(), available);
   }
 }
 
@@ -173,9 +223,25 @@ TEST(ScannerService, SetConfiguration)
   }
 }
 
+TEST(ScannerService, GetStatistics)
+{
+  ScannerStatistics statistics;
+  statistics.optionWrites = 3;
+  statistics.skippedOptionWrites = 11;
+
+  MockScannerInterfacePtr interface(new MockScannerInterface());
+  EXPECT_CALL(*interface, getStatistics()).Times(1).WillOnce(Return(statistics));
+  {
+    ScanService service(interface);
+    auto result = service.getStatistics();
+    ASSERT_EQ(result.optionWrites, 3);
+    ASSERT_EQ(result.skippedOptionWrites, 11);
+  }
+}
+
 TEST(ScannerService, ScanToBuffer)
 {
-  auto buffer = RawImagePtr(new RawImage(5, 5, 3));
+  auto buffer = RawImagePtr(new RawImage(5, 5, PixelFormat::Rgb8));
   std::vector<ScannerDeviceDescriptorPtr> available;
   available.push_back(ScannerDeviceDescriptorPtr(new ScannerDeviceDescriptor()));
 
@@ -190,3 +256,549 @@ TEST(ScannerService, ScanToBuffer)
     ASSERT_EQ(result, buffer);
   }
 }
+
+TEST(ScannerService, ScanToMappedBufferCollectsTheRowsInAFile)
+{
+  std::vector<ScannerDeviceDescriptorPtr> available;
+  available.push_back(ScannerDeviceDescriptorPtr(new ScannerDeviceDescriptor()));
+
+  MockScannerInterfacePtr interface(new MockScannerInterface());
+  EXPECT_CALL(*interface, init()).Times(1).WillRepeatedly(Return(true));
+  EXPECT_CALL(*interface, getDevices()).Times(1).WillRepeatedly(Return(available));
+  EXPECT_CALL(*interface, scanToBuffer(_)).Times(0);
+  EXPECT_CALL(*interface, scan(available[0], _)).Times(1).WillOnce(Invoke([](ScannerDeviceDescriptorPtr, IScanReceiver &receiver) {
+    ImageHeader header;
+    header.width = 2;
+    header.height = 1;
+    header.format = PixelFormat::Gray8;
+    const unsigned char row[] = {3, 4};
+    receiver.begin(header);
+    receiver.rows(row, 0, 1);
+    receiver.end();
+  }));
+  EXPECT_CALL(*interface, exit()).Times(1);
+  {
+    ScanService service(interface);
+    ImageStorage storage;
+    storage.mapped = true;
+    auto result = service.scanToBuffer(nullptr, storage);
+    ASSERT_NE(result->getFilePath(), "");
+    ASSERT_EQ(result->pixels[0], 3);
+    ASSERT_EQ(result->pixels[1], 4);
+  }
+}
+
+TEST(ScannerService, ScanToStreamForwardsTheReceiver)
+{
+  std::vector<ScannerDeviceDescriptorPtr> available;
+  available.push_back(ScannerDeviceDescriptorPtr(new ScannerDeviceDescriptor()));
+  RawImageReceiver receiver;
+
+  MockScannerInterfacePtr interface(new MockScannerInterface());
+  EXPECT_CALL(*interface, init()).Times(1).WillRepeatedly(Return(true));
+  EXPECT_CALL(*interface, getDevices()).Times(1).WillRepeatedly(Return(available));
+  EXPECT_CALL(*interface, scan(available[0], ::testing::Ref(receiver))).Times(1);
+  EXPECT_CALL(*interface, exit()).Times(1);
+  {
+    ScanService service(interface);
+    service.scanToStream(nullptr, receiver);
+  }
+}
+
+TEST(ScannerService, FailedScansToFileRemoveThePartialFile)
+{
+  std::vector<ScannerDeviceDescriptorPtr> available;
+  available.push_back(ScannerDeviceDescriptorPtr(new ScannerDeviceDescriptor()));
+  const std::string path = "scanservice_partial.pnm";
+
+  MockScannerInterfacePtr interface(new MockScannerInterface());
+  EXPECT_CALL(*interface, init()).Times(1).WillRepeatedly(Return(true));
+  EXPECT_CALL(*interface, getDevices()).Times(1).WillRepeatedly(Return(available));
+  EXPECT_CALL(*interface, scan(available[0], _)).Times(1).WillOnce(Invoke([&](ScannerDeviceDescriptorPtr, IScanReceiver &receiver) {
+    ImageHeader header;
+    header.width = 4;
+    header.height = 4;
+    header.format = PixelFormat::Gray8;
+    receiver.begin(header);
+    std::vector<unsigned char> row(4, 0);
+    receiver.rows(row.data(), 0, 1);
+    ASSERT_TRUE(std::ifstream(path).good());
+    throw std::runtime_error("Could not read the scan: Document feeder jammed");
+  }));
+  EXPECT_CALL(*interface, exit()).Times(1);
+  {
+    ScanService service(interface);
+    ASSERT_THROW(service.scanToFile(nullptr, path), std::runtime_error);
+    ASSERT_FALSE(std::ifstream(path).good());
+  }
+}
+
+TEST(ScannerService, ScansRecordTheTimelineOfTheirJob)
+{
+  std::vector<ScannerDeviceDescriptorPtr> available;
+  available.push_back(ScannerDeviceDescriptorPtr(new ScannerDeviceDescriptor()));
+  RawImageReceiver receiver;
+  const std::string traceFile = "scanservice_trace.json";
+  std::remove(traceFile.c_str());
+
+  MockScannerInterfacePtr interface(new MockScannerInterface());
+  EXPECT_CALL(*interface, init()).Times(1).WillRepeatedly(Return(true));
+  EXPECT_CALL(*interface, getDevices()).Times(1).WillRepeatedly(Return(available));
+  EXPECT_CALL(*interface, scan(available[0], _)).Times(2).WillRepeatedly(Invoke([](ScannerDeviceDescriptorPtr, IScanReceiver &receiver) {
+    ASSERT_NE(receiver.getTimeline(), nullptr);
+    ImageHeader header;
+    header.width = 2;
+    header.height = 3;
+    header.format = PixelFormat::Rgb8;
+    const unsigned char rows[18] = {};
+    receiver.begin(header);
+    receiver.rows(rows, 0, 3);
+    receiver.end();
+  }));
+  EXPECT_CALL(*interface, exit()).Times(1);
+  {
+    ScanService service(interface);
+    ScanJob job;
+    job.timeline = std::make_shared<ScanTimeline>();
+    service.scanToStream(nullptr, receiver, job);
+    ASSERT_EQ(job.timeline->getTimings().encodedBytes, 18);
+    ASSERT_EQ(receiver.getImage()->height, 3);
+
+    // traced scans record a timeline of their own
+    service.setTraceFile(traceFile);
+    service.scanToStream(nullptr, receiver);
+  }
+  std::ifstream trace(traceFile);
+  std::string line;
+  std::getline(trace, line);
+  ASSERT_EQ(line, "[");
+  std::getline(trace, line);
+  ASSERT_NE(line.find("\"name\":\"scanToStream\""), std::string::npos);
+  std::remove(traceFile.c_str());
+}
+
+TEST(ScannerService, StartedScansKeepTheDeviceUntilTheSessionEnds)
+{
+  /**
+   * Session that completes with its second read
+   */
+  class TwoStepSession : public IScanSession
+  {
+  public:
+    virtual int getSelectFd() { return 7; }
+    virtual bool read() { return ++reads == 2; }
+    int reads = 0;
+  };
+
+  std::vector<ScannerDeviceDescriptorPtr> available;
+  available.push_back(ScannerDeviceDescriptorPtr(new ScannerDeviceDescriptor()));
+  RawImageReceiver receiver;
+
+  MockScannerInterfacePtr interface(new MockScannerInterface());
+  EXPECT_CALL(*interface, init()).Times(1).WillRepeatedly(Return(true));
+  EXPECT_CALL(*interface, getDevices()).Times(1).WillRepeatedly(Return(available));
+  EXPECT_CALL(*interface, startScan(available[0], ::testing::Ref(receiver))).Times(1).WillOnce(Return(IScanSessionPtr(new TwoStepSession())));
+  EXPECT_CALL(*interface, exit()).Times(1);
+  {
+    ScanService service(interface);
+    IScanSessionPtr session = service.startScan(nullptr, receiver);
+    ASSERT_TRUE(service.getQueueStatistics(nullptr).busy);
+    ASSERT_EQ(session->getSelectFd(), 7);
+    ASSERT_FALSE(session->read());
+    ASSERT_TRUE(session->read());
+
+    session = nullptr;
+    ASSERT_FALSE(service.getQueueStatistics(nullptr).busy);
+  }
+}
+
+TEST(ScannerService, PreviewScansTheWholeAreaAtTheLowestResolution)
+{
+  std::vector<ScannerDeviceDescriptorPtr> available;
+  available.push_back(ScannerDeviceDescriptorPtr(new ScannerDeviceDescriptor()));
+  ScannerCapabilities capabilities;
+  capabilities.minX = 0;
+  capabilities.minY = 0;
+  capabilities.maxX = 215.9;
+  capabilities.maxY = 297;
+  capabilities.possibleResolutionsInDPI = {300, 75, 150};
+  ScannerConfiguration previous;
+  previous.fromX = 10;
+  previous.toX = 20;
+  previous.resolutionInDPI = 300;
+  RawImageReceiver receiver;
+
+  MockScannerInterfacePtr interface(new MockScannerInterface());
+  EXPECT_CALL(*interface, init()).Times(1).WillRepeatedly(Return(true));
+  EXPECT_CALL(*interface, getConfiguration(available[0])).Times(1).WillOnce(Return(previous));
+  EXPECT_CALL(*interface, getCapabilities(available[0])).Times(1).WillOnce(Return(capabilities));
+  {
+    ::testing::InSequence sequence;
+    EXPECT_CALL(*interface, setConfiguration(available[0], ::testing::AllOf(
+                                                               ::testing::Field(&ScannerConfiguration::resolutionInDPI, 75),
+                                                               ::testing::Field(&ScannerConfiguration::toY, 297),
+                                                               ::testing::Field(&ScannerConfiguration::preview, 1))))
+        .Times(1);
+    EXPECT_CALL(*interface, scan(available[0], _)).Times(1).WillOnce(Invoke([](ScannerDeviceDescriptorPtr, IScanReceiver &scanReceiver) {
+      ImageHeader header;
+      header.width = 637;
+      header.height = 877;
+      scanReceiver.begin(header);
+      scanReceiver.end();
+    }));
+    EXPECT_CALL(*interface, setConfiguration(available[0], ::testing::AllOf(
+                                                               ::testing::Field(&ScannerConfiguration::resolutionInDPI, 300),
+                                                               ::testing::Field(&ScannerConfiguration::toX, 20),
+                                                               ::testing::Field(&ScannerConfiguration::preview, 0))))
+        .Times(1);
+  }
+  EXPECT_CALL(*interface, exit()).Times(1);
+  {
+    ScanService service(interface);
+    PreviewArea area = service.preview(available[0], receiver);
+
+    ASSERT_EQ(area.resolutionInDPI, 75);
+    ASSERT_EQ(area.width, 637);
+    ASSERT_EQ(area.height, 877);
+    ASSERT_DOUBLE_EQ(area.toX, 215.9);
+    ASSERT_EQ(receiver.getImage()->width, 637);
+  }
+}
+
+TEST(ScannerService, PreviewRegionsMapToTheGeometry)
+{
+  PreviewArea area;
+  area.fromX = 10;
+  area.fromY = 0;
+  area.toX = 110;
+  area.toY = 50;
+  area.width = 200;
+  area.height = 100;
+
+  ScannerConfiguration configuration = ScanService::getRegionConfiguration(area, 20, 10, 100, 200);
+  ASSERT_DOUBLE_EQ(configuration.fromX, 20);
+  ASSERT_DOUBLE_EQ(configuration.toX, 70);
+  ASSERT_DOUBLE_EQ(configuration.fromY, 5);
+  ASSERT_DOUBLE_EQ(configuration.toY, 50);
+  ASSERT_EQ(configuration.resolutionInDPI, -1);
+  ASSERT_TRUE(configuration.mode.empty());
+}
+
+TEST(ScannerService, BatchPagePathsReplaceThePlaceholder)
+{
+  ASSERT_EQ(ScanService::getBatchPagePath("scan-###.png", 7), "scan-007.png");
+  ASSERT_EQ(ScanService::getBatchPagePath("scan-#.png", 12), "scan-12.png");
+  ASSERT_EQ(ScanService::getBatchPagePath("/tmp/scan.png", 3), "/tmp/scan-3.png");
+  ASSERT_EQ(ScanService::getBatchPagePath("/tmp/my.folder/scan", 3), "/tmp/my.folder/scan-3");
+}
+
+TEST(ScannerService, ScanBatchToFilesStoresEveryPage)
+{
+  std::vector<ScannerDeviceDescriptorPtr> available;
+  available.push_back(ScannerDeviceDescriptorPtr(new ScannerDeviceDescriptor()));
+  const unsigned int pages = 5;
+
+  MockScannerInterfacePtr interface(new MockScannerInterface());
+  EXPECT_CALL(*interface, init()).Times(1).WillRepeatedly(Return(true));
+  EXPECT_CALL(*interface, scanBatch(available[0], _)).Times(1).WillOnce(Invoke([&](ScannerDeviceDescriptorPtr, IScanReceiver &receiver) {
+    ImageHeader header;
+    header.width = 2;
+    header.height = 1;
+    header.format = PixelFormat::Gray8;
+    for (unsigned int page = 0; page < pages; ++page)
+    {
+      unsigned char pixels[] = {static_cast<unsigned char>(page), 0};
+      receiver.begin(header);
+      receiver.rows(pixels, 0, 1);
+      receiver.end();
+    }
+    return pages;
+  }));
+  EXPECT_CALL(*interface, exit()).Times(1);
+  {
+    ScanService service(interface);
+    auto scannedPages = service.scanBatchToFiles(available[0], "batch-##.pgm");
+
+    ASSERT_EQ(scannedPages.size(), pages);
+    for (unsigned int page = 0; page < pages; ++page)
+    {
+      ASSERT_EQ(scannedPages[page].number, page + 1);
+      ASSERT_EQ(scannedPages[page].path, ScanService::getBatchPagePath("batch-##.pgm", page + 1));
+      std::ifstream stream(scannedPages[page].path, std::ios::binary);
+      std::string content((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+      std::remove(scannedPages[page].path.c_str());
+      ASSERT_EQ(content, std::string("P5\n2 1\n255\n") + static_cast<char>(page) + '\0');
+    }
+  }
+}
+
+TEST(ScannerService, ScanBatchToFilesDropsBlankPages)
+{
+  std::vector<ScannerDeviceDescriptorPtr> available;
+  available.push_back(ScannerDeviceDescriptorPtr(new ScannerDeviceDescriptor()));
+
+  MockScannerInterfacePtr interface(new MockScannerInterface());
+  EXPECT_CALL(*interface, init()).Times(1).WillRepeatedly(Return(true));
+  EXPECT_CALL(*interface, scanBatch(available[0], _)).Times(1).WillOnce(Invoke([&](ScannerDeviceDescriptorPtr, IScanReceiver &receiver) {
+    ImageHeader header;
+    header.width = 100;
+    header.height = 1;
+    header.format = PixelFormat::Gray8;
+    // The front sides have text, the back sides are blank
+    for (unsigned int page = 0; page < 4; ++page)
+    {
+      std::vector<unsigned char> pixels(100, 250);
+      if (page % 2 == 0)
+      {
+        std::fill(pixels.begin(), pixels.begin() + 10, 0);
+      }
+      PageStatistics statistics;
+      getPixelKernels().accumulateStatistics(pixels.data(), pixels.size(), receiver.getInkThreshold(), statistics);
+      receiver.begin(header);
+      receiver.rows(pixels.data(), 0, 1);
+      receiver.statistics(statistics);
+      receiver.end();
+    }
+    return 4u;
+  }));
+  EXPECT_CALL(*interface, exit()).Times(1);
+  {
+    ScanService service(interface);
+    BlankPageOptions blankPages;
+    blankPages.skip = true;
+    auto scannedPages = service.scanBatchToFiles(available[0], "duplex-#.pgm", EncoderOptions(), blankPages);
+
+    ASSERT_EQ(scannedPages.size(), 4u);
+    for (unsigned int page = 0; page < 4; ++page)
+    {
+      ASSERT_EQ(scannedPages[page].blank, page % 2 == 1);
+      ASSERT_EQ(scannedPages[page].path.empty(), page % 2 == 1);
+    }
+    ASSERT_DOUBLE_EQ(scannedPages[0].statistics.getInkCoverage(), 0.1);
+    // The stored pages are numbered without gaps
+    ASSERT_EQ(scannedPages[2].path, "duplex-2.pgm");
+    std::remove(scannedPages[0].path.c_str());
+    std::remove(scannedPages[2].path.c_str());
+    std::ifstream dropped("duplex-3.pgm");
+    ASSERT_FALSE(dropped.good());
+  }
+}
+
+TEST(ScannerService, ScanItemsStoresEachItemOfOnePass)
+{
+  std::vector<ScannerDeviceDescriptorPtr> available;
+  available.push_back(ScannerDeviceDescriptorPtr(new ScannerDeviceDescriptor()));
+
+  auto buffer = RawImagePtr(new RawImage(200, 100, PixelFormat::Gray8));
+  for (unsigned int y = 0; y < 100; ++y)
+  {
+    for (unsigned int x = 0; x < 200; ++x)
+    {
+      bool onItem = y >= 20 && y < 80 && ((x >= 20 && x < 80) || (x >= 120 && x < 180));
+      buffer->pixels[y * 200 + x] = onItem ? 0 : 255;
+    }
+  }
+
+  MockScannerInterfacePtr interface(new MockScannerInterface());
+  EXPECT_CALL(*interface, init()).Times(1).WillRepeatedly(Return(true));
+  EXPECT_CALL(*interface, scanToBuffer(available[0])).Times(1).WillOnce(Return(buffer));
+  EXPECT_CALL(*interface, exit()).Times(1);
+  {
+    ScanService service(interface);
+    auto items = service.scanItems(available[0], "item-#.pgm");
+
+    ASSERT_EQ(items.size(), 2u);
+    ASSERT_LT(items[0].x, items[1].x);
+    for (unsigned int i = 0; i < items.size(); ++i)
+    {
+      std::string path = ScanService::getBatchPagePath("item-#.pgm", i + 1);
+      std::ifstream stream(path, std::ios::binary);
+      std::string content((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+      std::remove(path.c_str());
+      ASSERT_EQ(content.substr(0, 3), "P5\n");
+      ASSERT_NE(content.find(std::to_string(items[i].width) + " " + std::to_string(items[i].height)), std::string::npos);
+    }
+  }
+}
+
+namespace
+{
+const std::string RECORDING_FILE = "scanservice_test.recording";
+
+/**
+ * A recorded 4x3 gray page, delivered in two reads
+ */
+RecordedScan createRecordedScan(const std::string &descriptor)
+{
+  RecordedFrame frame;
+  frame.parameters.format = FrameParameters::Gray;
+  frame.parameters.depth = 8;
+  frame.parameters.pixelsPerLine = 4;
+  frame.parameters.bytesPerLine = 4;
+  frame.parameters.lines = 3;
+  frame.parameters.lastFrame = true;
+  RecordedRead first, second;
+  first.data.assign(4, 0);
+  second.data.assign(8, 255);
+  frame.reads = {first, second};
+
+  RecordedScan scan;
+  scan.descriptor = descriptor;
+  scan.capabilities.possibleResolutionsInDPI = {150};
+  scan.configuration.resolutionInDPI = 150;
+  scan.pages.push_back({frame});
+  return scan;
+}
+
+/**
+ * Counts the scans that are between their first rows & their end at the same time.
+ * A scan waits in its first rows until the expected number of scans got there as well, or the time is up.
+ */
+class ScanLatch
+{
+public:
+  ScanLatch(unsigned int expected_, std::chrono::milliseconds timeout_)
+      : expected(expected_), timeout(timeout_)
+  {
+  }
+
+  void arrive()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    maxRunning = std::max(maxRunning, ++running);
+    changed.notify_all();
+    changed.wait_for(lock, timeout, [this]() { return running >= expected; });
+  }
+
+  void leave()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running--;
+  }
+
+  unsigned int getMaxRunning()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return maxRunning;
+  }
+
+private:
+  unsigned int expected;
+  std::chrono::milliseconds timeout;
+  std::mutex mutex;
+  std::condition_variable changed;
+  unsigned int running = 0;
+  unsigned int maxRunning = 0;
+};
+
+class LatchedReceiver : public RawImageReceiver
+{
+public:
+  explicit LatchedReceiver(ScanLatch &latch_)
+      : latch(latch_)
+  {
+  }
+
+  virtual void rows(const unsigned char *pixels, unsigned int y, unsigned int count)
+  {
+    if (y == 0)
+    {
+      latch.arrive();
+    }
+    RawImageReceiver::rows(pixels, y, count);
+  }
+
+  virtual void end()
+  {
+    RawImageReceiver::end();
+    latch.leave();
+  }
+
+private:
+  ScanLatch &latch;
+};
+
+/**
+ * Replay a scan on each device at the same time (through the unpacking of the recorded reads)
+ */
+void scanInParallel(ScanService &service, ScannerDeviceDescriptorPtr first, ScannerDeviceDescriptorPtr second, ScanLatch &latch)
+{
+  LatchedReceiver firstReceiver(latch), secondReceiver(latch);
+  std::thread firstScan([&]() { service.scanToStream(first, firstReceiver); });
+  std::thread secondScan([&]() { service.scanToStream(second, secondReceiver); });
+  firstScan.join();
+  secondScan.join();
+  ASSERT_EQ(firstReceiver.getImage()->height, 3u);
+  ASSERT_EQ(secondReceiver.getImage()->pixels[2 * 4], 255);
+}
+}
+
+TEST(ScannerService, CancelJobAbortsTheRunningScan)
+{
+  std::vector<ScannerDeviceDescriptorPtr> available;
+  available.push_back(ScannerDeviceDescriptorPtr(new ScannerDeviceDescriptor()));
+  std::promise<void> scanning;
+  std::promise<void> aborted;
+
+  MockScannerInterfacePtr interface(new MockScannerInterface());
+  EXPECT_CALL(*interface, init()).Times(1).WillRepeatedly(Return(true));
+  EXPECT_CALL(*interface, getDevices()).Times(1).WillRepeatedly(Return(available));
+  EXPECT_CALL(*interface, scan(available[0], _)).Times(1).WillOnce(Invoke([&](ScannerDeviceDescriptorPtr, IScanReceiver &) {
+    // like sane_read, the scan blocks until the backend is cancelled
+    scanning.set_value();
+    aborted.get_future().wait();
+    throw std::runtime_error("The scan was cancelled.");
+  }));
+  EXPECT_CALL(*interface, cancel(available[0])).Times(1).WillOnce(Invoke([&](ScannerDeviceDescriptorPtr) { aborted.set_value(); }));
+  EXPECT_CALL(*interface, exit()).Times(1);
+  {
+    ScanService service(interface);
+    unsigned long long id = service.createJobId();
+    RawImageReceiver receiver;
+    std::thread scan([&]() { ASSERT_THROW(service.scanToStream(nullptr, receiver, ScanJob(JobPriority::Normal, id)), std::runtime_error); });
+    scanning.get_future().wait();
+    ASSERT_TRUE(service.getQueueStatistics(nullptr).busy);
+    ASSERT_TRUE(service.cancelJob(id));
+    scan.join();
+
+    auto statistics = service.getQueueStatistics(nullptr);
+    ASSERT_FALSE(statistics.busy);
+    ASSERT_EQ(statistics.startedJobs, 1);
+    ASSERT_EQ(statistics.cancelledJobs, 1);
+  }
+}
+
+TEST(ScannerService, ScansOnDifferentDevicesRunInParallel)
+{
+  std::remove(RECORDING_FILE.c_str());
+  ScanRecording::append(RECORDING_FILE, createRecordedScan("test:0"));
+  ScanRecording::append(RECORDING_FILE, createRecordedScan("test:1"));
+  {
+    ScanService service(IScannerInterfacePtr(new ReplayScannerInterface(RECORDING_FILE, ReplayScannerInterface::AsFastAsPossible)));
+    auto available = service.getAvailableScanners();
+    ASSERT_EQ(available.size(), 2u);
+
+    // Each scan waits for the other to deliver rows as well, which only happens if they overlap
+    ScanLatch latch(2, std::chrono::seconds(10));
+    scanInParallel(service, available[0], available[1], latch);
+    ASSERT_EQ(latch.getMaxRunning(), 2u);
+  }
+  std::remove(RECORDING_FILE.c_str());
+}
+
+TEST(ScannerService, ScansOnTheSameDeviceAreSerialised)
+{
+  std::remove(RECORDING_FILE.c_str());
+  ScanRecording::append(RECORDING_FILE, createRecordedScan("test:0"));
+  {
+    ScanService service(IScannerInterfacePtr(new ReplayScannerInterface(RECORDING_FILE, ReplayScannerInterface::AsFastAsPossible)));
+    auto available = service.getAvailableScanners();
+    ASSERT_EQ(available.size(), 1u);
+
+    // The first scan waits a while for the second one, which must not start before the first one ended
+    ScanLatch latch(2, std::chrono::milliseconds(100));
+    scanInParallel(service, available[0], available[0], latch);
+    ASSERT_EQ(latch.getMaxRunning(), 1u);
+  }
+  std::remove(RECORDING_FILE.c_str());
+}
@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "scanner/scantimeline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+  void sleep(int milliseconds)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+  }
+}
+
+TEST(ScanTimeline, NestedSpansAreTakenOffTheOuterPhase)
+{
+  ScanTimeline timeline;
+  {
+    ScanTimeline::Span unpacking(&timeline, ScanPhase::Unpack);
+    sleep(2);
+    ScanTimeline::Span encoding(&timeline, ScanPhase::Encode);
+    sleep(20);
+  }
+  {
+    // without timeline nothing is recorded
+    ScanTimeline::Span unpacking(nullptr, ScanPhase::Unpack);
+  }
+
+  ScanTimings timings = timeline.getTimings();
+  ASSERT_GE(timings.encodeTime, 20);
+  ASSERT_GE(timings.unpackTime, 2);
+  ASSERT_LT(timings.unpackTime, 15);
+  ASSERT_GE(timings.totalTime, timings.unpackTime + timings.encodeTime);
+}
+
+TEST(ScanTimeline, ReadsCountTheCallsTheBytesAndTheLargestGap)
+{
+  ScanTimeline timeline;
+  {
+    ScanTimeline::Span starting(&timeline, ScanPhase::Start);
+  }
+  timeline.addRead(ScanTimeline::Clock::now(), 100);
+  sleep(10);
+  timeline.addRead(ScanTimeline::Clock::now(), 0);
+  timeline.addRead(ScanTimeline::Clock::now(), 50);
+  timeline.addEncodedBytes(2000000);
+
+  ScanTimings timings = timeline.getTimings();
+  ASSERT_EQ(timings.readCalls, 3);
+  ASSERT_EQ(timings.bytesRead, 150);
+  ASSERT_GE(timings.largestReadGap, 10);
+  ASSERT_EQ(timings.encodedBytes, 2000000);
+  ASSERT_EQ(timings.getEncodeThroughput(), 0);
+}
+
+TEST(ScanTimeline, TraceEventsNameTheScanAndItsPhases)
+{
+  ScanTimeline timeline("scanToFile", 42);
+  {
+    ScanTimeline::Span queueing(&timeline, ScanPhase::Queue);
+  }
+  timeline.addRead(ScanTimeline::Clock::now(), 10);
+
+  std::ostringstream stream;
+  timeline.writeTraceEvents(stream);
+  const std::string trace = stream.str();
+  ASSERT_EQ(trace.find("{\"name\":\"scanToFile\",\"cat\":\"scan\",\"ph\":\"X\""), 0);
+  ASSERT_NE(trace.find("\"name\":\"queue\""), std::string::npos);
+  ASSERT_NE(trace.find("\"name\":\"read\""), std::string::npos);
+  ASSERT_NE(trace.find("\"job\":42"), std::string::npos);
+  ASSERT_EQ(std::count(trace.begin(), trace.end(), '\n'), 2);
+}
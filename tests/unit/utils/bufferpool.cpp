@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "utils/bufferpool.h"
+
+#include <cstring>
+
+namespace
+{
+  const size_t LARGE = 4 * 1024 * 1024;
+}
+
+TEST(BufferPool, ReusesReleasedBuffersOfTheSameSizeClass)
+{
+  BufferPool pool;
+  unsigned char *first = pool.acquire(LARGE);
+  std::memset(first, 0xAB, LARGE);
+  pool.release(first, LARGE);
+
+  // slightly smaller, but rounded up to the same class
+  unsigned char *second = pool.acquire(LARGE - 1000);
+  ASSERT_EQ(second, first);
+  pool.release(second, LARGE - 1000);
+
+  auto statistics = pool.getStatistics();
+  ASSERT_EQ(statistics.hits, 1);
+  ASSERT_EQ(statistics.misses, 1);
+  ASSERT_EQ(statistics.cachedBuffers, 1);
+  ASSERT_EQ(statistics.cachedBytes, BufferPool::getSizeClass(LARGE));
+  ASSERT_EQ(statistics.usedBytes, 0);
+}
+
+TEST(BufferPool, SizeClassesWasteAtMostAQuarter)
+{
+  for (size_t bytes = BufferPool::MINIMUM_POOLED_SIZE; bytes < 256 * 1024 * 1024; bytes = bytes * 3 / 2 + 4097)
+  {
+    size_t sizeClass = BufferPool::getSizeClass(bytes);
+    ASSERT_GE(sizeClass, bytes);
+    ASSERT_LE(sizeClass, bytes + bytes / 4 + 4096);
+  }
+  ASSERT_EQ(BufferPool::getSizeClass(1000), 1000);
+}
+
+TEST(BufferPool, UnmapsReleasedBuffersBeyondTheCapacity)
+{
+  BufferPool pool(BufferPool::getSizeClass(LARGE));
+  unsigned char *first = pool.acquire(LARGE);
+  unsigned char *second = pool.acquire(LARGE);
+  pool.release(first, LARGE);
+  pool.release(second, LARGE);
+
+  auto statistics = pool.getStatistics();
+  ASSERT_EQ(statistics.cachedBuffers, 1);
+  ASSERT_EQ(statistics.evictions, 1);
+
+  pool.setCapacity(0);
+  ASSERT_EQ(pool.getStatistics().cachedBuffers, 0);
+}
+
+TEST(BufferPool, TrimKeepsAtMostTheGivenBytes)
+{
+  BufferPool pool;
+  unsigned char *small = pool.acquire(LARGE);
+  unsigned char *large = pool.acquire(2 * LARGE);
+  pool.release(small, LARGE);
+  pool.release(large, 2 * LARGE);
+
+  pool.trim(BufferPool::getSizeClass(LARGE));
+  auto statistics = pool.getStatistics();
+  ASSERT_EQ(statistics.cachedBuffers, 1);
+  ASSERT_EQ(statistics.cachedBytes, BufferPool::getSizeClass(LARGE));
+
+  pool.trim();
+  ASSERT_EQ(pool.getStatistics().cachedBytes, 0);
+}
+
+TEST(BufferPool, SmallBuffersComeFromTheHeap)
+{
+  BufferPool pool;
+  unsigned char *buffer = pool.acquire(1024);
+  std::memset(buffer, 1, 1024);
+  pool.release(buffer, 1024);
+
+  auto statistics = pool.getStatistics();
+  ASSERT_EQ(statistics.unpooled, 1);
+  ASSERT_EQ(statistics.hits + statistics.misses, 0);
+  ASSERT_EQ(statistics.cachedBuffers, 0);
+}
+
+TEST(BufferPool, HugePageBuffersAreUsable)
+{
+  BufferPool pool;
+  pool.setHugePages(true);
+  unsigned char *buffer = pool.acquire(LARGE);
+  ASSERT_EQ(reinterpret_cast<size_t>(buffer) % (2 * 1024 * 1024), 0);
+  std::memset(buffer, 0xFF, LARGE);
+  ASSERT_EQ(buffer[LARGE - 1], 0xFF);
+  pool.release(buffer, LARGE);
+}
@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "utils/mappedfile.h"
+
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
+
+namespace
+{
+  bool exists(const std::string &path)
+  {
+    return access(path.c_str(), F_OK) == 0;
+  }
+}
+
+TEST(MappedFile, TemporaryFilesAreRemovedWithTheMapping)
+{
+  std::string path;
+  {
+    MappedFile file("", 8192);
+    path = file.getPath();
+    ASSERT_TRUE(file.isTemporary());
+    ASSERT_TRUE(exists(path));
+    file.getData()[8191] = 1;
+  }
+  ASSERT_FALSE(exists(path));
+}
+
+TEST(MappedFile, GivenFilesAreKeptWithTheirContent)
+{
+  std::string path = ::testing::TempDir() + "scanahedron-given.raw";
+  {
+    MappedFile file(path, 3);
+    ASSERT_FALSE(file.isTemporary());
+    file.getData()[0] = 'x';
+    file.getData()[1] = 'y';
+    file.getData()[2] = 'z';
+  }
+  std::ifstream stream(path);
+  std::string content;
+  stream >> content;
+  ASSERT_EQ(content, "xyz");
+  std::remove(path.c_str());
+}
+
+TEST(MappedFile, PersistMovesTheTemporaryFile)
+{
+  std::string path = ::testing::TempDir() + "scanahedron-persisted.raw";
+  std::string temporaryPath;
+  {
+    MappedFile file("", 2);
+    temporaryPath = file.getPath();
+    file.getData()[0] = 'o';
+    file.getData()[1] = 'k';
+    file.persist(path);
+    ASSERT_FALSE(file.isTemporary());
+    ASSERT_EQ(file.getPath(), path);
+  }
+  ASSERT_FALSE(exists(temporaryPath));
+
+  std::ifstream stream(path);
+  std::string content;
+  stream >> content;
+  ASSERT_EQ(content, "ok");
+  std::remove(path.c_str());
+}
+
+TEST(MappedFile, ThrowsIfTheFileCannotBeCreated)
+{
+  ASSERT_THROW(MappedFile("/nonexistent-directory/image.raw", 16), std::runtime_error);
+}
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "utils/pixelkernels.h"
+
+#include <vector>
+
+namespace
+{
+std::vector<const PixelKernels *> supportedKernels()
+{
+  std::vector<const PixelKernels *> result;
+  for (KernelLevel level : {KernelLevel::Scalar, KernelLevel::Sse2, KernelLevel::Avx2})
+  {
+    if (const PixelKernels *kernels = getPixelKernels(level))
+    {
+      result.push_back(kernels);
+    }
+  }
+  return result;
+}
+}
+
+TEST(PixelKernels, ScalarKernelsAreAlwaysAvailable)
+{
+  ASSERT_NE(getPixelKernels(KernelLevel::Scalar), nullptr);
+}
+
+TEST(PixelKernels, Narrow16To8KeepsTheMostSignificantByte)
+{
+  // Odd sample count to cover the vector loops and the scalar tail
+  const size_t samples = 77;
+  std::vector<uint16_t> source(samples);
+  for (size_t i = 0; i < samples; ++i)
+  {
+    source[i] = static_cast<uint16_t>(i * 771);
+  }
+
+  for (const PixelKernels *kernels : supportedKernels())
+  {
+    std::vector<unsigned char> destination(samples);
+    kernels->narrow16To8(reinterpret_cast<const unsigned char *>(source.data()), destination.data(), samples);
+    for (size_t i = 0; i < samples; ++i)
+    {
+      ASSERT_EQ(destination[i], source[i] >> 8) << kernels->name << " sample " << i;
+    }
+  }
+}
+
+TEST(PixelKernels, Expand1To8MapsSetBitsToTheSetValue)
+{
+  const size_t samples = 83;
+  std::vector<unsigned char> source((samples + 7) / 8);
+  for (size_t i = 0; i < source.size(); ++i)
+  {
+    source[i] = static_cast<unsigned char>(i * 37 + 0x81);
+  }
+
+  for (const PixelKernels *kernels : supportedKernels())
+  {
+    for (unsigned char setValue : {0x00, 0xFF})
+    {
+      std::vector<unsigned char> destination(samples);
+      kernels->expand1To8(source.data(), destination.data(), samples, setValue);
+      for (size_t i = 0; i < samples; ++i)
+      {
+        bool set = (source[i / 8] >> (7 - i % 8)) & 1;
+        ASSERT_EQ(destination[i], set ? setValue : static_cast<unsigned char>(~setValue)) << kernels->name << " sample " << i;
+      }
+    }
+  }
+}
+
+TEST(PixelKernels, AccumulateStatisticsMatchesTheDefinition)
+{
+  // Long enough for the widening of the squares, odd for the scalar tail
+  const size_t samples = 300007;
+  std::vector<unsigned char> source(samples);
+  uint64_t sum = 0, sumOfSquares = 0, ink = 0;
+  for (size_t i = 0; i < samples; ++i)
+  {
+    source[i] = static_cast<unsigned char>((i * 7919) ^ (i >> 3));
+    sum += source[i];
+    sumOfSquares += source[i] * source[i];
+    ink += source[i] < 0x90 ? 1 : 0;
+  }
+
+  for (const PixelKernels *kernels : supportedKernels())
+  {
+    PageStatistics statistics;
+    kernels->accumulateStatistics(source.data(), samples, 0x90, statistics);
+    ASSERT_EQ(statistics.samples, samples) << kernels->name;
+    ASSERT_EQ(statistics.sum, sum) << kernels->name;
+    ASSERT_EQ(statistics.sumOfSquares, sumOfSquares) << kernels->name;
+    ASSERT_EQ(statistics.inkSamples, ink) << kernels->name;
+  }
+}
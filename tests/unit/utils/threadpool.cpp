@@ -0,0 +1,39 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "utils/threadpool.h"
+
+#include <atomic>
+
+TEST(ThreadPool, RunsAllSubmittedTasks)
+{
+  std::atomic<int> counter(0);
+  std::vector<std::future<void>> results;
+  {
+    ThreadPool pool(3);
+    ASSERT_EQ(pool.size(), 3);
+    for (int i = 0; i < 100; ++i)
+    {
+      results.push_back(pool.submit([&counter]() { counter++; }));
+    }
+    for (auto &result : results)
+    {
+      result.get();
+    }
+  }
+  ASSERT_EQ(counter, 100);
+}
+
+TEST(ThreadPool, ForwardsExceptionsToTheFuture)
+{
+  ThreadPool pool(1);
+  auto result = pool.submit([]() { throw std::runtime_error("failed"); });
+  ASSERT_THROW(result.get(), std::runtime_error);
+}
+
+TEST(ThreadPool, HasAtLeastOneWorker)
+{
+  ThreadPool pool(0);
+  ASSERT_EQ(pool.size(), 1);
+  pool.submit([]() {}).get();
+}
@@ -3,6 +3,10 @@
 
 #include "utils/types.h"
 
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
 using ::testing::Return;
 using ::testing::_;
 
@@ -12,6 +16,55 @@ TEST(RawImage, ConstructionSuceeds)
 
     ASSERT_EQ(image.width, 13);
     ASSERT_EQ(image.height, 14);
-    ASSERT_EQ(image.bytesPerPixel, 3);
+    ASSERT_EQ(image.format, PixelFormat::Rgb8);
+    ASSERT_EQ(image.bytesPerRow, 13 * 3);
     ASSERT_NE(image.pixels, nullptr);
-}
\ No newline at end of file
+}
+
+TEST(RawImage, RowsHaveTheSizeOfTheirFormat)
+{
+    ASSERT_EQ(RawImage(13, 1, PixelFormat::Gray1).bytesPerRow, 2);
+    ASSERT_EQ(RawImage(13, 1, PixelFormat::Gray8).bytesPerRow, 13);
+    ASSERT_EQ(RawImage(13, 1, PixelFormat::Gray16).bytesPerRow, 26);
+    ASSERT_EQ(RawImage(13, 1, PixelFormat::Rgb16).bytesPerRow, 78);
+    ASSERT_EQ(getBytesPerPixel(PixelFormat::Gray1), 0u);
+    ASSERT_EQ(getBytesPerPixel(PixelFormat::Rgb16), 6u);
+}
+TEST(RawImage, MappedPixelsArePersistedToAFile)
+{
+    std::string path = ::testing::TempDir() + "scanahedron-mapped.raw";
+    {
+        ImageStorage storage;
+        storage.mapped = true;
+        RawImage image(4, 2, PixelFormat::Gray8, storage);
+        ASSERT_NE(image.getFilePath(), "");
+        for (unsigned int i = 0; i < 8; ++i)
+        {
+            image.pixels[i] = static_cast<unsigned char>(i);
+        }
+        image.persist(path);
+        ASSERT_EQ(image.getFilePath(), path);
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    ASSERT_EQ(content, std::string("\x00\x01\x02\x03\x04\x05\x06\x07", 8));
+    std::remove(path.c_str());
+}
+
+TEST(RawImage, PixelsInMemoryArePersistedByACopy)
+{
+    std::string path = ::testing::TempDir() + "scanahedron-memory.raw";
+    RawImage image(3, 1, PixelFormat::Gray8);
+    image.pixels[0] = 'a';
+    image.pixels[1] = 'b';
+    image.pixels[2] = 'c';
+    image.persist(path);
+    ASSERT_EQ(image.getFilePath(), "");
+
+    std::ifstream file(path);
+    std::string content;
+    file >> content;
+    ASSERT_EQ(content, "abc");
+    std::remove(path.c_str());
+}